@@ -283,7 +283,8 @@ extern "C" {
      *
      * \brief   Registers a function which gets called, when LED index or vibration state changes
      *          occur on the provided target device. This function fails if the provided target
-     *          device isn't fully operational or in an erroneous state.
+     *          device isn't fully operational or in an erroneous state. It may also be called
+     *          before the target is added, notifications then start once it's plugged in.
      *
      * \author  Benjamin "Nefarius" Hglinger
      * \date    28.08.2017
@@ -301,7 +302,8 @@ extern "C" {
      *
      * \brief   Registers a function which gets called, when LightBar or vibration state changes
      *          occur on the provided target device. This function fails if the provided target
-     *          device isn't fully operational or in an erroneous state.
+     *          device isn't fully operational or in an erroneous state. It may also be called
+     *          before the target is added, notifications then start once it's plugged in.
      *
      * \author  Benjamin "Nefarius" Hglinger
      * \date    28.08.2017
@@ -490,6 +492,22 @@ extern "C" {
      */
     VIGEM_API VIGEM_ERROR vigem_target_x360_get_user_index(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PULONG index);
 
+    /**
+     * \fn  VIGEM_API VIGEM_ERROR vigem_target_set_submit_queue(PVIGEM_TARGET target, ULONG depth);
+     *
+     * \brief   Makes vigem_target_x360_update/vigem_target_ds4_update return without waiting for the
+     *          driver to finish with the report, with up to depth reports outstanding at once (once
+     *          they're all in-flight the next update waits for the oldest). Errors are returned by
+     *          the next update that finds out about them. A depth of 0 (the default) waits for
+     *          every report. Outstanding reports are waited for before the target is removed/freed.
+     *
+     * \param   target  The target device object.
+     * \param   depth   Max number of outstanding reports, up to VIGEM_SUBMIT_QUEUE_MAX (8).
+     *
+     * \return  A VIGEM_ERROR.
+     */
+    VIGEM_API VIGEM_ERROR vigem_target_set_submit_queue(PVIGEM_TARGET target, ULONG depth);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,82 @@
+#include "ComboMatcher.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit, value must be non-zero
+static int lowestBit(uint64_t value)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return (int)index;
+#elif defined(_MSC_VER)
+  unsigned long index;
+  if (_BitScanForward(&index, (unsigned long)value))
+    return (int)index;
+  _BitScanForward(&index, (unsigned long)(value >> 32));
+  return (int)index + 32;
+#else
+  return __builtin_ctzll(value);
+#endif
+}
+
+int ComboMatcher::Add(const ButtonCombo& combo)
+{
+  if (!combo.buttons || (combo.buttons & combo.excluded) || combos_.size() >= COMBO_MAX)
+    return -1;
+
+  int index = (int)combos_.size();
+  combos_.push_back(combo);
+
+  uint32_t used = combo.buttons | combo.excluded;
+  for (int bit = 0; bit < 32; bit++)
+    if (used & (1u << bit))
+      combos_by_button_[bit] |= 1ull << index;
+
+  // might already be held if buttons are down while combinations are being changed
+  if ((state_ & used) == combo.buttons)
+    held_ |= 1ull << index;
+
+  return index;
+}
+
+void ComboMatcher::Clear()
+{
+  combos_.clear();
+  for (auto& combos : combos_by_button_)
+    combos = 0;
+  held_ = 0;
+}
+
+void ComboMatcher::Update(uint32_t state, uint64_t& pressed, uint64_t& released)
+{
+  pressed = 0;
+  released = 0;
+
+  uint32_t changed = state ^ state_;
+  state_ = state;
+  if (!changed)
+    return;
+
+  // Only combinations that use one of the changed buttons can have changed
+  uint64_t candidates = 0;
+  for (; changed; changed &= changed - 1)
+    candidates |= combos_by_button_[lowestBit(changed)];
+
+  for (; candidates; candidates &= candidates - 1)
+  {
+    int index = lowestBit(candidates);
+    auto& combo = combos_[index];
+    uint64_t mask = 1ull << index;
+    bool held = (state & (combo.buttons | combo.excluded)) == combo.buttons;
+
+    if (held && !(held_ & mask))
+      pressed |= mask;
+    else if (!held && (held_ & mask))
+      released |= mask;
+
+    held_ = held ? (held_ | mask) : (held_ & ~mask);
+  }
+}
@@ -0,0 +1,50 @@
+#pragma once
+// Matches button combinations (chords) against the digital button state of each report
+// Portable like XboxTranslator, nothing in here depends on Windows
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define COMBO_MAX           64
+
+// When a combination's action happens
+#define COMBO_HOLD          0 // every report while the combination is held
+#define COMBO_PRESS         1 // once, on the report the combination becomes held
+#define COMBO_RELEASE       2 // once, on the report the combination stops being held
+
+struct ButtonCombo {
+  uint32_t buttons; // XUSB_GAMEPAD_* bits (incl. XUSB_GAMEPAD_LT/RT) that all have to be held
+  uint32_t excluded; // bits that must NOT be held for the combination to match
+  int mode; // COMBO_*
+
+  bool operator==(const ButtonCombo& other) const
+  {
+    return buttons == other.buttons && excluded == other.excluded && mode == other.mode;
+  }
+  bool operator!=(const ButtonCombo& other) const { return !(*this == other); }
+};
+
+// Combinations are only re-checked when one of the buttons they use changes state,
+// so reports where nothing changed cost the same no matter how many combinations are added
+class ComboMatcher
+{
+  std::vector<ButtonCombo> combos_;
+  uint64_t combos_by_button_[32] = { 0 }; // bitmask of combos that use each state bit
+
+  uint32_t state_ = 0;
+  uint64_t held_ = 0; // bitmask of combos that are currently held
+
+public:
+  // Returns index of the new combination, or -1 if it's invalid/COMBO_MAX has been reached
+  int Add(const ButtonCombo& combo);
+  void Clear();
+
+  const ButtonCombo& Combo(int index) const { return combos_[index]; }
+  size_t Count() const { return combos_.size(); }
+
+  // Checks combinations against the new button state, pressed/released are set to the combinations that changed state
+  void Update(uint32_t state, uint64_t& pressed, uint64_t& released);
+
+  uint64_t Held() const { return held_; }
+};
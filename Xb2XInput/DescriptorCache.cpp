@@ -0,0 +1,220 @@
+#include "DescriptorCache.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+// Each entry is a line of tab-separated fields, in this order
+enum {
+  FIELD_KEY,
+  FIELD_BCD_DEVICE,
+  FIELD_NUM_CONFIGURATIONS,
+  FIELD_PRODUCT_INDEX,
+  FIELD_VENDOR_INDEX,
+  FIELD_SERIAL_INDEX,
+  FIELD_IFACE_NUM,
+  FIELD_IFACE_SETTING_NUM,
+  FIELD_ENDPOINT_IN,
+  FIELD_ENDPOINT_OUT,
+  FIELD_LANGID,
+  FIELD_PRODUCT,
+  FIELD_VENDOR,
+  FIELD_COUNT
+};
+
+static std::string clean(std::string text)
+{
+  // strings come from the controller, they can't be allowed to break up the line
+  for (auto& c : text)
+    if (c == '\t' || c == '\r' || c == '\n')
+      c = '?';
+  return text;
+}
+
+std::string DescriptorCache::Key(uint16_t vendor_id, uint16_t product_id, uint64_t port_key)
+{
+  char key[64];
+  snprintf(key, sizeof(key), "%04x:%04x@%016llx", vendor_id, product_id, (unsigned long long)port_key);
+  return key;
+}
+
+bool DescriptorCache::Load(const std::string& path)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  path_ = path;
+  entries_.clear();
+  store_count_ = 0;
+  dirty_ = false;
+
+  std::ifstream file(path);
+  if (!file.is_open())
+    return false;
+
+  std::string line;
+  if (!std::getline(file, line) || line != DESCRIPTOR_CACHE_HEADER)
+    return false;
+
+  // oldest entry is written first, so they come back in the same order
+  while (std::getline(file, line))
+  {
+    std::vector<std::string> fields;
+    std::stringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, '\t'))
+      fields.push_back(field);
+    if (line.length() && line.back() == '\t')
+      fields.push_back("");
+
+    if (fields.size() != FIELD_COUNT || !fields[FIELD_KEY].length())
+      continue;
+
+    auto number = [&fields](int index) { return (unsigned)strtoul(fields[index].c_str(), nullptr, 10); };
+
+    Entry entry;
+    auto& descriptor = entry.descriptor;
+    descriptor.bcd_device = (uint16_t)number(FIELD_BCD_DEVICE);
+    descriptor.num_configurations = (uint8_t)number(FIELD_NUM_CONFIGURATIONS);
+    descriptor.product_index = (uint8_t)number(FIELD_PRODUCT_INDEX);
+    descriptor.vendor_index = (uint8_t)number(FIELD_VENDOR_INDEX);
+    descriptor.serial_index = (uint8_t)number(FIELD_SERIAL_INDEX);
+    descriptor.iface_num = (uint8_t)number(FIELD_IFACE_NUM);
+    descriptor.iface_setting_num = (uint8_t)number(FIELD_IFACE_SETTING_NUM);
+    descriptor.endpoint_in = (uint8_t)number(FIELD_ENDPOINT_IN);
+    descriptor.endpoint_out = (uint8_t)number(FIELD_ENDPOINT_OUT);
+    descriptor.langid = (uint16_t)number(FIELD_LANGID);
+    descriptor.product = fields[FIELD_PRODUCT];
+    descriptor.vendor = fields[FIELD_VENDOR];
+    entry.stored = ++store_count_;
+    entries_[fields[FIELD_KEY]] = entry;
+  }
+
+  dropOldest();
+  return true;
+}
+
+bool DescriptorCache::Save()
+{
+  std::lock_guard<std::mutex> save_guard(save_mutex_);
+
+  // copied out so controllers being brought up don't have to wait on the file
+  std::vector<std::pair<std::string, Entry>> entries;
+  std::string path;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (!dirty_ || !path_.length())
+      return true;
+
+    entries.assign(entries_.begin(), entries_.end());
+    path = path_;
+    dirty_ = false;
+  }
+
+  std::sort(entries.begin(), entries.end(), [](const std::pair<std::string, Entry>& a, const std::pair<std::string, Entry>& b)
+  {
+    return a.second.stored < b.second.stored;
+  });
+
+  auto failed = [this]()
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    dirty_ = true;
+    return false;
+  };
+
+  // Written to a temp file first like SettingsJournal, so a half-written cache never gets loaded
+  auto temp_path = path + ".tmp";
+  {
+    std::ofstream file(temp_path, std::ios::trunc);
+    if (!file.is_open())
+      return failed();
+
+    file << DESCRIPTOR_CACHE_HEADER << "\n";
+    for (auto& entry : entries)
+    {
+      auto& descriptor = entry.second.descriptor;
+      file << entry.first << "\t" << descriptor.bcd_device << "\t" << (unsigned)descriptor.num_configurations << "\t" <<
+        (unsigned)descriptor.product_index << "\t" << (unsigned)descriptor.vendor_index << "\t" << (unsigned)descriptor.serial_index << "\t" <<
+        (unsigned)descriptor.iface_num << "\t" << (unsigned)descriptor.iface_setting_num << "\t" <<
+        (unsigned)descriptor.endpoint_in << "\t" << (unsigned)descriptor.endpoint_out << "\t" << descriptor.langid << "\t" <<
+        clean(descriptor.product) << "\t" << clean(descriptor.vendor) << "\n";
+    }
+
+    file.close();
+    if (file.fail())
+      return failed();
+  }
+
+#ifdef _WIN32
+  if (!MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    return failed();
+#else
+  if (std::rename(temp_path.c_str(), path.c_str()) != 0)
+    return failed();
+#endif
+  return true;
+}
+
+bool DescriptorCache::Find(const std::string& key, const CachedDescriptor& device, CachedDescriptor& cached)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end())
+    return false;
+
+  // firmware update or a different model that happens to share the VID/PID, has to be probed again
+  if (!it->second.descriptor.SameDevice(device))
+  {
+    entries_.erase(it);
+    dirty_ = true;
+    return false;
+  }
+
+  cached = it->second.descriptor;
+  return true;
+}
+
+void DescriptorCache::Store(const std::string& key, const CachedDescriptor& descriptor)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto& entry = entries_[key];
+  entry.stored = ++store_count_;
+
+  // stored every time a controller is brought up, only needs writing out if something's actually changed
+  if (entry.descriptor == descriptor)
+    return;
+
+  entry.descriptor = descriptor;
+  dirty_ = true;
+  dropOldest();
+}
+
+void DescriptorCache::Remove(const std::string& key)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (entries_.erase(key))
+    dirty_ = true;
+}
+
+void DescriptorCache::dropOldest()
+{
+  // mutex_ must be held
+  while (entries_.size() > DESCRIPTOR_CACHE_MAX_ENTRIES)
+  {
+    auto oldest = entries_.begin();
+    for (auto it = entries_.begin(); it != entries_.end(); it++)
+      if (it->second.stored < oldest->second.stored)
+        oldest = it;
+
+    entries_.erase(oldest);
+    dirty_ = true;
+  }
+}
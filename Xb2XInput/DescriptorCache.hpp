@@ -0,0 +1,86 @@
+#pragma once
+// On-disk cache of what bring-up found out about each controller (interface, endpoints, USB strings), so a controller
+// that's been seen on a port before can skip probing its descriptors when it's plugged back in or Xb2XInput starts up
+// Entries are keyed by VID/PID & port path, & only used while the device descriptor still matches the one they were made from
+// The serial no. isn't stored (or keyed on), it's always read from the controller since it's the only thing that tells
+// apart two pads of the same model that have used the same port, & per-controller settings are keyed on it
+// Portable like XboxTranslator, only the final rename depends on the OS
+
+#include <cstdint>
+#include <string>
+#include <mutex>
+#include <unordered_map>
+
+// First line of the cache file, a file without it is ignored (& replaced on the next save)
+#define DESCRIPTOR_CACHE_HEADER       "Xb2XInput descriptor cache v2"
+
+// Most entries kept, the least recently stored are dropped past this (eg. pads that have been on lots of different ports)
+#define DESCRIPTOR_CACHE_MAX_ENTRIES  256
+
+struct CachedDescriptor {
+  // copied from the device descriptor, an entry is only used if these still match
+  uint16_t bcd_device = 0;
+  uint8_t num_configurations = 0;
+  uint8_t product_index = 0;
+  uint8_t vendor_index = 0;
+  uint8_t serial_index = 0;
+
+  // found by bring-up
+  uint8_t iface_num = 0;
+  uint8_t iface_setting_num = 0;
+  uint8_t endpoint_in = 0;
+  uint8_t endpoint_out = 0;
+  uint16_t langid = 0;
+  std::string product;
+  std::string vendor;
+
+  // true if both were made from the same device descriptor
+  bool SameDevice(const CachedDescriptor& other) const
+  {
+    return bcd_device == other.bcd_device && num_configurations == other.num_configurations &&
+      product_index == other.product_index && vendor_index == other.vendor_index && serial_index == other.serial_index;
+  }
+
+  bool operator==(const CachedDescriptor& other) const
+  {
+    return SameDevice(other) && iface_num == other.iface_num && iface_setting_num == other.iface_setting_num &&
+      endpoint_in == other.endpoint_in && endpoint_out == other.endpoint_out && langid == other.langid &&
+      product == other.product && vendor == other.vendor;
+  }
+  bool operator!=(const CachedDescriptor& other) const { return !(*this == other); }
+};
+
+class DescriptorCache
+{
+  struct Entry {
+    CachedDescriptor descriptor;
+    uint64_t stored; // Store count when it was last stored, for dropping the oldest
+  };
+
+  std::unordered_map<std::string, Entry> entries_;
+  std::string path_;
+  uint64_t store_count_ = 0;
+  bool dirty_ = false;
+  std::mutex mutex_;
+  std::mutex save_mutex_; // only one Save at a time, held while the file is being written
+
+  void dropOldest();
+
+public:
+  // Key for a controller, port_key is its bus & port path (see XboxController::PortKey)
+  static std::string Key(uint16_t vendor_id, uint16_t product_id, uint64_t port_key);
+
+  // Replaces the cache with the contents of path & remembers it for Save, returns false if it couldn't be read (cache is left empty)
+  bool Load(const std::string& path);
+
+  // Writes the cache out if it's changed since it was loaded/saved, returns false if it couldn't be written
+  bool Save();
+
+  // Gets the entry for key if it was made from the same device descriptor as device, a stale entry is dropped
+  bool Find(const std::string& key, const CachedDescriptor& device, CachedDescriptor& cached);
+
+  void Store(const std::string& key, const CachedDescriptor& descriptor);
+  void Remove(const std::string& key);
+
+  size_t Size() { std::lock_guard<std::mutex> guard(mutex_); return entries_.size(); }
+};
@@ -0,0 +1,184 @@
+#pragma once
+// Works out which USB devices are new since the last scan, so each scan only has to look at those instead of the whole bus
+// Scans are woken as soon as something changes (libusb hotplug callback, WM_DEVICECHANGE), polling every
+// DEVICE_SCAN_POLL_MS is only a fallback in case a change gets missed
+// Device just has to be comparable (XboxController uses libusb_device*, kept referenced so a pointer is never reused
+// for a different device while it's known)
+// Portable like XboxTranslator, nothing in here depends on Windows or libusb
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <condition_variable>
+
+#include "ParallelFor.hpp"
+#include "SlotRegistry.hpp"
+
+#define DEVICE_SCAN_POLL_MS   1500
+
+// Key for where a USB device is plugged in (its bus & port path), for finding what's already using that port in O(1)
+// Top bit set so it can't match a pointer-based key, then the bus & up to 6 port numbers
+// (USB allows 7 tiers of hubs, anything that deep just doesn't get a key & returns 0)
+inline uint64_t UsbPortKey(uint8_t bus, const uint8_t* ports, int num_ports)
+{
+  if (num_ports < 0 || num_ports > 6)
+    return 0;
+
+  uint64_t key = 0x8000000000000000ull | ((uint64_t)bus << 48);
+  for (int i = 0; i < num_ports; i++)
+    key |= (uint64_t)ports[i] << (i * 8);
+  return key;
+}
+
+// True if one of controllers is already plugged into bus/ports, so OpenDevice can leave a device it's already handling
+// alone (most likely replugged before the old one was noticed going away)
+// Controllers are indexed by their UsbPortKey, paths too many hubs deep to have a key are compared against
+// ports_of(controller) for every controller instead; controllers has to be pinned
+template <typename T, typename PortsOf>
+bool UsbPortInUse(SlotRegistry<T>& controllers, uint8_t bus, const uint8_t* ports, int num_ports, PortsOf ports_of)
+{
+  auto port_key = UsbPortKey(bus, ports, num_ports);
+  if (port_key)
+    return controllers.Find(port_key) != nullptr;
+
+  bool in_use = false;
+  controllers.ForEach([&](RegistryId, T& controller)
+  {
+    auto& controller_ports = ports_of(controller);
+    if (controller_ports.size() == (size_t)num_ports && std::equal(controller_ports.begin(), controller_ports.end(), ports))
+      in_use = true;
+  });
+  return in_use;
+}
+
+template <typename Device>
+class DeviceScanner
+{
+  std::vector<Device> known_; // sorted
+  std::vector<Device> forgotten_; // Forget calls made while a scan was running, dropped from its results once it's done
+  bool scanning_ = false;
+  std::mutex mutex_;
+  std::condition_variable woken_;
+  bool pending_ = false;
+  uint64_t scans_ = 0;
+  uint64_t checked_ = 0;
+
+public:
+  // Calls check(device) for every device in current that wasn't in the last scan, returns how many were checked
+  // check returns true once it's done with the device (handled or not interesting), false to check it again next scan
+  // (eg. it couldn't be opened yet)
+  template <typename Check>
+  size_t Scan(const std::vector<Device>& current, Check check)
+  {
+    std::vector<Device> known;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      known.swap(known_);
+      scanning_ = true;
+    }
+
+    // anything that's gone is forgotten, so it gets checked again if it comes back
+    std::vector<Device> next;
+    size_t checked = 0;
+    for (auto& device : current)
+    {
+      if (std::binary_search(known.begin(), known.end(), device))
+      {
+        next.push_back(device);
+        continue;
+      }
+
+      checked++;
+      if (check(device))
+        next.push_back(device);
+    }
+    std::sort(next.begin(), next.end());
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (auto& device : forgotten_)
+    {
+      auto it = std::lower_bound(next.begin(), next.end(), device);
+      if (it != next.end() && *it == device)
+        next.erase(it);
+    }
+    forgotten_.clear();
+    scanning_ = false;
+
+    known_.swap(next);
+    scans_++;
+    checked_ += checked;
+    return checked;
+  }
+
+  // Has device checked again by the next scan, for when one that check was done with couldn't be used after all
+  // (or a controller using it was dropped while it's still plugged in), safe to call while another thread is scanning
+  void Forget(const Device& device)
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto it = std::lower_bound(known_.begin(), known_.end(), device);
+    if (it != known_.end() && *it == device)
+      known_.erase(it);
+
+    if (scanning_)
+      forgotten_.push_back(device);
+  }
+
+  // Makes the next Wait return straight away, safe to call from any thread (eg. a hotplug callback)
+  void Wake()
+  {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      pending_ = true;
+    }
+    woken_.notify_all();
+  }
+
+  // Waits until Wake is called or timeout_ms passes, returns true if it was woken
+  bool Wait(int timeout_ms)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool woken = woken_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this]() { return pending_; });
+    pending_ = false;
+    return woken;
+  }
+
+  // Forgets every known device, so they all get checked by the next scan
+  void Reset()
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    known_.clear();
+  }
+
+  size_t Known() { std::lock_guard<std::mutex> guard(mutex_); return known_.size(); }
+  uint64_t Scans() { std::lock_guard<std::mutex> guard(mutex_); return scans_; }
+  uint64_t Checked() { std::lock_guard<std::mutex> guard(mutex_); return checked_; }
+};
+
+// One pass of OpenDevice: scans current for new devices, brings up every one check picked out all at once, then adds them
+// check(device, found) works like Scan's check, but also pushes anything worth bringing up onto found (Pending needs a
+// device member, the rest is up to the caller)
+// bring_up(pending) runs on up to max_threads threads & returns false if it failed, add(pending) then runs for each one
+// that came up, in the order they were found, & returns false if it couldn't be added
+// Anything that failed either step is forgotten, so the next scan checks it again; returns how many were added
+template <typename Pending, typename Device, typename Check, typename BringUp, typename Add>
+int AttachNewDevices(DeviceScanner<Device>& scanner, const std::vector<Device>& current, size_t max_threads,
+  Check check, BringUp bring_up, Add add)
+{
+  std::vector<Pending> found;
+  scanner.Scan(current, [&](const Device& device) { return check(device, found); });
+
+  std::vector<char> ready(found.size(), 0);
+  ParallelFor(found.size(), max_threads, [&](size_t i) { ready[i] = bring_up(found[i]); });
+
+  int added = 0;
+  for (size_t i = 0; i < found.size(); i++)
+  {
+    if (ready[i] && add(found[i]))
+      added++;
+    else
+      scanner.Forget(found[i].device);
+  }
+  return added;
+}
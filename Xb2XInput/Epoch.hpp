@@ -0,0 +1,67 @@
+#pragma once
+// Epoch-based reclamation: readers pin the epoch while they use shared objects, writers unlink an object & then
+// call Synchronize, once that returns no reader can still be using it so it's safe to free
+// Readers are counted in one of two epochs, Synchronize flips the epoch so new readers don't hold up the wait
+// Used by Snapshot & SlotRegistry, portable like XboxTranslator
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+class Epoch
+{
+  std::atomic<uint32_t> epoch_{ 0 };
+  std::atomic<int> readers_[2];
+
+public:
+  class Guard
+  {
+    Epoch* epoch_;
+    uint32_t parity_;
+
+  public:
+    explicit Guard(Epoch* epoch) : epoch_(epoch)
+    {
+      parity_ = epoch_->epoch_.load() & 1;
+      epoch_->readers_[parity_]++;
+    }
+
+    Guard(Guard&& other) : epoch_(other.epoch_), parity_(other.parity_)
+    {
+      other.epoch_ = nullptr;
+    }
+
+    ~Guard()
+    {
+      if (epoch_)
+        epoch_->readers_[parity_]--;
+    }
+
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+  };
+
+  Epoch()
+  {
+    readers_[0] = 0;
+    readers_[1] = 0;
+  }
+
+  Epoch(const Epoch&) = delete;
+  Epoch& operator=(const Epoch&) = delete;
+
+  // Guard shouldn't be kept around for longer than needed as it holds up writers
+  // (& must not be alive while the same thread calls Synchronize, that would wait on itself forever)
+  Guard Enter() { return Guard(this); }
+
+  // Waits until every reader that entered before this was called has left
+  void Synchronize()
+  {
+    for (int i = 0; i < 2; i++)
+    {
+      uint32_t parity = epoch_.fetch_add(1) & 1;
+      while (readers_[parity].load())
+        std::this_thread::yield();
+    }
+  }
+};
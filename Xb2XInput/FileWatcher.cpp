@@ -0,0 +1,105 @@
+#include "FileWatcher.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+FileWatcher::~FileWatcher()
+{
+  Stop();
+}
+
+bool FileWatcher::Start(const std::string& path, std::function<void()> callback)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (thread_.joinable())
+    return false;
+
+  path_ = path;
+  callback_ = callback;
+  contents_hash_ = HashFile(path);
+  stopping_ = false;
+  thread_ = std::thread(&FileWatcher::run, this);
+  return true;
+}
+
+void FileWatcher::Stop()
+{
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (!thread_.joinable())
+      return;
+    stopping_ = true;
+  }
+
+  stop_.notify_all();
+  thread_.join();
+}
+
+size_t FileWatcher::HashFile(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open())
+    return 0;
+
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return std::hash<std::string>()(contents.str());
+}
+
+bool FileWatcher::wait(int timeout_ms)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  return !stop_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return stopping_; });
+}
+
+void FileWatcher::run()
+{
+#ifdef _WIN32
+  // only whole directories can be watched, changes to other files in it will wake us up too
+  auto directory = path_.substr(0, path_.find_last_of("\\/") + 1);
+  HANDLE notification = FindFirstChangeNotificationA(directory.length() ? directory.c_str() : ".", FALSE,
+    FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+#endif
+
+  while (true)
+  {
+#ifdef _WIN32
+    if (notification != INVALID_HANDLE_VALUE)
+    {
+      // wake up every so often anyway to check if we're stopping
+      if (WaitForSingleObject(notification, FILE_WATCHER_POLL_MS) != WAIT_OBJECT_0)
+      {
+        if (!wait(0))
+          break;
+        continue;
+      }
+      FindNextChangeNotification(notification);
+    }
+    else
+#endif
+    if (!wait(FILE_WATCHER_POLL_MS))
+      break;
+
+    if (!wait(FILE_WATCHER_SETTLE_MS))
+      break;
+
+    auto hash = HashFile(path_);
+    if (!hash || hash == contents_hash_)
+      continue;
+
+    contents_hash_ = hash;
+    callback_();
+  }
+
+#ifdef _WIN32
+  if (notification != INVALID_HANDLE_VALUE)
+    FindCloseChangeNotification(notification);
+#endif
+}
@@ -0,0 +1,39 @@
+#pragma once
+// Watches a file for changes on a background thread, calling back once its contents have changed & settled
+// Uses directory change notifications on Windows, elsewhere it just polls the file every FILE_WATCHER_POLL_MS
+// (contents are compared either way, notifications only wake it up sooner)
+
+#include <string>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+#define FILE_WATCHER_POLL_MS      500
+
+// editors can write files in a few steps, wait this long after a change before reading it
+#define FILE_WATCHER_SETTLE_MS    100
+
+class FileWatcher
+{
+  std::string path_;
+  std::function<void()> callback_;
+  size_t contents_hash_ = 0;
+  std::mutex mutex_;
+  std::condition_variable stop_;
+  std::thread thread_;
+  bool stopping_ = false;
+
+  void run();
+  bool wait(int timeout_ms); // returns false if stopping
+
+public:
+  ~FileWatcher();
+
+  // Starts watching path, callback is ran from the watcher thread
+  bool Start(const std::string& path, std::function<void()> callback);
+  void Stop();
+
+  // Hash of the contents of path, 0 if it couldn't be read
+  static size_t HashFile(const std::string& path);
+};
@@ -0,0 +1,113 @@
+#include "IniDocument.hpp"
+
+#include <cctype>
+#include <fstream>
+
+static std::string trim(const std::string& text)
+{
+  auto start = text.find_first_not_of(" \t\r");
+  if (start == std::string::npos)
+    return "";
+  auto end = text.find_last_not_of(" \t\r");
+  return text.substr(start, end - start + 1);
+}
+
+std::string IniDocument::Lower(std::string text)
+{
+  for (auto& c : text)
+    c = (char)::tolower((unsigned char)c);
+  return text;
+}
+
+bool IniDocument::Load(const std::string& path)
+{
+  std::ifstream file(path);
+  if (!file.is_open())
+  {
+    Clear();
+    return false;
+  }
+
+  Parse(file);
+  return true;
+}
+
+void IniDocument::Parse(std::istream& stream)
+{
+  std::unordered_map<std::string, Section> sections;
+  Section* section = nullptr;
+
+  std::string line;
+  bool first = true;
+  while (std::getline(stream, line))
+  {
+    // skip UTF-8 BOM
+    if (first && line.compare(0, 3, "\xEF\xBB\xBF") == 0)
+      line = line.substr(3);
+    first = false;
+
+    auto text = trim(line);
+    if (!text.length() || text[0] == ';')
+      continue;
+
+    if (text[0] == '[')
+    {
+      auto end = text.find(']');
+      if (end == std::string::npos)
+        continue;
+
+      // sections that appear more than once get merged, keys from the earliest one win
+      section = &sections[Lower(trim(text.substr(1, end - 1)))];
+      continue;
+    }
+
+    auto equals = text.find('=');
+    if (!section || equals == std::string::npos)
+      continue;
+
+    auto key = Lower(trim(text.substr(0, equals)));
+    auto value = trim(text.substr(equals + 1));
+    if (value.length() >= 2 && (value[0] == '"' || value[0] == '\'') && value.back() == value[0])
+      value = value.substr(1, value.length() - 2);
+
+    if (key.length() && !section->count(key))
+      (*section)[key] = value;
+  }
+
+  std::lock_guard<std::mutex> guard(mutex_);
+  sections_.swap(sections);
+}
+
+void IniDocument::Clear()
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  sections_.clear();
+}
+
+bool IniDocument::Get(const std::string& section, const std::string& key, std::string& value) const
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+
+  auto section_iter = sections_.find(Lower(section));
+  if (section_iter == sections_.end())
+    return false;
+
+  auto iter = section_iter->second.find(Lower(key));
+  if (iter == section_iter->second.end())
+    return false;
+
+  value = iter->second;
+  return true;
+}
+
+bool IniDocument::HasSection(const std::string& section) const
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  return sections_.count(Lower(section)) > 0;
+}
+
+void IniDocument::Set(const std::string& section, const std::string& key, const std::string& value)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  sections_[Lower(section)][Lower(key)] = value;
+}
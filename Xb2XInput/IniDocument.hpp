@@ -0,0 +1,33 @@
+#pragma once
+// In-memory copy of Xb2XInput.ini, parsed in a single pass so settings can be looked up without re-reading the file
+// Follows the same rules as GetPrivateProfileString: section & key names are case-insensitive, whitespace around
+// keys/values is ignored, values in matching quotes have them removed, & the first of any duplicate keys is used
+// Portable like XboxTranslator, so it can be tested off Windows
+
+#include <string>
+#include <istream>
+#include <mutex>
+#include <unordered_map>
+
+class IniDocument
+{
+  typedef std::unordered_map<std::string, std::string> Section;
+  std::unordered_map<std::string, Section> sections_; // lowercase section name -> lowercase key -> value
+  mutable std::mutex mutex_;
+
+public:
+  // Replaces the document with the contents of path, returns false if it couldn't be read (document is left empty)
+  bool Load(const std::string& path);
+  void Parse(std::istream& stream);
+  void Clear();
+
+  // Gets the value of key in section, returns false if it isn't set
+  bool Get(const std::string& section, const std::string& key, std::string& value) const;
+  bool HasSection(const std::string& section) const;
+
+  // Changes value of key in section, only in memory (see SettingsJournal for writing changes out)
+  void Set(const std::string& section, const std::string& key, const std::string& value);
+
+  // Lowercases text, for looking up sections/keys
+  static std::string Lower(std::string text);
+};
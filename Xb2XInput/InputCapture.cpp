@@ -0,0 +1,205 @@
+#include "InputCapture.hpp"
+#include "XboxTranslator.hpp"
+
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+bool CaptureWriter::Open(const char* path)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (open_)
+    return false;
+
+  file_.rdbuf()->pubsetbuf(buffer_, sizeof(buffer_));
+  file_.open(path, std::ios::binary | std::ios::trunc);
+  if (!file_.is_open())
+    return false;
+
+  CaptureHeader header = { 0 };
+  header.magic = CAPTURE_MAGIC;
+  header.version = CAPTURE_VERSION;
+  header.record_size = sizeof(CaptureRecord);
+  file_.write((const char*)&header, sizeof(header));
+
+  start_ = std::chrono::steady_clock::now();
+  open_ = true;
+  return true;
+}
+
+void CaptureWriter::Close()
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (!open_)
+    return;
+
+  open_ = false;
+  file_.close();
+}
+
+void CaptureWriter::Write(CaptureRecord& record)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (!open_)
+    return;
+
+  record.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_).count();
+  file_.write((const char*)&record, sizeof(record));
+}
+
+void CaptureWriter::WriteInput(RegistryId controller, const XboxInputReport& report)
+{
+  if (!open_)
+    return;
+
+  CaptureRecord record;
+  memset(&record, 0, sizeof(record));
+  record.controller = (uint8_t)REGISTRY_ID_SLOT(controller);
+  record.type = CAPTURE_RECORD_INPUT;
+  record.input = report;
+  Write(record);
+}
+
+void CaptureWriter::WriteRumble(RegistryId controller, BYTE large_motor, BYTE small_motor, BYTE led_number)
+{
+  if (!open_)
+    return;
+
+  CaptureRecord record;
+  memset(&record, 0, sizeof(record));
+  record.controller = (uint8_t)REGISTRY_ID_SLOT(controller);
+  record.type = CAPTURE_RECORD_RUMBLE;
+  record.rumble.bLargeMotor = large_motor;
+  record.rumble.bSmallMotor = small_motor;
+  record.rumble.bLedNumber = led_number;
+  Write(record);
+}
+
+bool CaptureReader::Open(const char* path)
+{
+  Close();
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || (uint64_t)size.QuadPart < sizeof(CaptureHeader) || (uint64_t)size.QuadPart > SIZE_MAX)
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  // mapping keeps the file open, so the handle can be closed straight away
+  mapping_ = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (!mapping_)
+    return false;
+
+  view_ = (const uint8_t*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+  if (!view_)
+  {
+    Close();
+    return false;
+  }
+  view_size_ = (size_t)size.QuadPart;
+#else
+  int file = open(path, O_RDONLY);
+  if (file < 0)
+    return false;
+
+  struct stat info;
+  if (fstat(file, &info) != 0 || (uint64_t)info.st_size < sizeof(CaptureHeader) || (uint64_t)info.st_size > SIZE_MAX)
+  {
+    close(file);
+    return false;
+  }
+
+  void* view = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);
+  if (view == MAP_FAILED)
+    return false;
+
+  view_ = (const uint8_t*)view;
+  view_size_ = (size_t)info.st_size;
+#endif
+
+  auto& header = *(const CaptureHeader*)view_;
+  if (header.magic != CAPTURE_MAGIC || header.version != CAPTURE_VERSION || header.record_size != sizeof(CaptureRecord))
+  {
+    Close();
+    return false;
+  }
+
+  // ignore any partially-written record at the end (eg. if Xb2XInput was killed mid-capture)
+  count_ = (view_size_ - sizeof(CaptureHeader)) / sizeof(CaptureRecord);
+  return true;
+}
+
+void CaptureReader::Close()
+{
+#ifdef _WIN32
+  if (view_)
+    UnmapViewOfFile(view_);
+  if (mapping_)
+    CloseHandle(mapping_);
+  mapping_ = nullptr;
+#else
+  if (view_)
+    munmap((void*)view_, view_size_);
+#endif
+
+  view_ = nullptr;
+  view_size_ = 0;
+  count_ = 0;
+}
+
+size_t ReplayCapture(const CaptureReader& capture, const UserSettings& settings, bool realtime,
+  const ReplayOutputFn& output, const ReplayRumbleFn& rumble)
+{
+  std::unordered_map<int, XboxTranslator> translators;
+  XUSB_REPORT report;
+  size_t count = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (auto& record : capture.Records())
+  {
+    if (realtime)
+      std::this_thread::sleep_until(start + std::chrono::microseconds(record.timestamp_us));
+
+    if (record.type == CAPTURE_RECORD_RUMBLE)
+    {
+      if (rumble)
+        rumble(record.controller, record.rumble);
+      continue;
+    }
+
+    if (record.type != CAPTURE_RECORD_INPUT || record.input.bSize != sizeof(XboxInputReport))
+      continue;
+
+    auto iter = translators.find(record.controller);
+    if (iter == translators.end())
+    {
+      iter = translators.emplace(record.controller, XboxTranslator()).first;
+      iter->second.SetSettings(settings);
+    }
+
+    // capture timestamps stand in for the current time, so turbo/macros play out the same as they were recorded
+    iter->second.Translate(record.input, &report, record.timestamp_us);
+    count++;
+
+    if (output)
+      output(record.controller, report);
+  }
+
+  return count;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "XboxTypes.hpp"
+#include "SlotRegistry.hpp"
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+
+// Capture files store the raw reports sent by each controller & the rumble events sent to it, so they can be replayed later
+// File is a CaptureHeader followed by fixed-size CaptureRecords in the order they were received,
+// records are 32 bytes/aligned so the file can be memory-mapped & indexed directly
+#define CAPTURE_MAGIC               0x43324258 // 'XB2C'
+#define CAPTURE_VERSION             1
+
+#define CAPTURE_RECORD_INPUT        1
+#define CAPTURE_RECORD_RUMBLE       2
+
+#pragma pack(push, 1)
+struct CaptureHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t record_size;
+  uint64_t reserved;
+};
+
+struct CaptureRumble {
+  BYTE bLargeMotor;
+  BYTE bSmallMotor;
+  BYTE bLedNumber;
+};
+
+struct CaptureRecord {
+  uint64_t timestamp_us; // time since capture was started
+  uint8_t controller; // registry slot of the controller this record belongs to, see REGISTRY_ID_SLOT
+  uint8_t type; // CAPTURE_RECORD_*
+
+  union {
+    XboxInputReport input;
+    CaptureRumble rumble;
+    uint8_t raw[22];
+  };
+};
+#pragma pack(pop)
+
+static_assert(sizeof(CaptureHeader) == 16, "CaptureHeader size changed!");
+static_assert(sizeof(CaptureRecord) == 32, "CaptureRecord size changed!");
+
+class CaptureWriter
+{
+  std::ofstream file_;
+  std::mutex mutex_;
+  std::atomic<bool> open_{ false };
+  std::chrono::steady_clock::time_point start_;
+  char buffer_[0x10000];
+
+  void Write(CaptureRecord& record);
+
+public:
+  ~CaptureWriter() { Close(); }
+
+  bool Open(const char* path);
+  void Close();
+  bool IsOpen() const { return open_; }
+
+  // controller is its RegistryId rather than its ViGEm index, which isn't known until its target has been added
+  void WriteInput(RegistryId controller, const XboxInputReport& report);
+  void WriteRumble(RegistryId controller, BYTE large_motor, BYTE small_motor, BYTE led_number);
+};
+
+// Records of an open capture, only valid until its CaptureReader is closed
+struct CaptureRecords {
+  const CaptureRecord* first;
+  const CaptureRecord* last;
+
+  const CaptureRecord* begin() const { return first; }
+  const CaptureRecord* end() const { return last; }
+  size_t size() const { return last - first; }
+  bool empty() const { return first == last; }
+  const CaptureRecord& operator[](size_t index) const { return first[index]; }
+};
+
+// Memory-maps a capture file & reads records straight out of the mapping, so large captures don't need reading in first
+class CaptureReader
+{
+  const uint8_t* view_ = nullptr;
+  size_t view_size_ = 0;
+#ifdef _WIN32
+  HANDLE mapping_ = nullptr;
+#endif
+  size_t count_ = 0;
+
+public:
+  CaptureReader() {}
+  ~CaptureReader() { Close(); }
+  CaptureReader(const CaptureReader&) = delete;
+  CaptureReader& operator=(const CaptureReader&) = delete;
+
+  // Maps in a capture file, returns false if the file is missing or isn't a valid capture
+  bool Open(const char* path);
+  void Close();
+
+  CaptureRecords Records() const
+  {
+    auto records = (const CaptureRecord*)(view_ + sizeof(CaptureHeader));
+    return view_ ? CaptureRecords{ records, records + count_ } : CaptureRecords{ nullptr, nullptr };
+  }
+};
+
+typedef std::function<void(int controller, const XUSB_REPORT& report)> ReplayOutputFn;
+typedef std::function<void(int controller, const CaptureRumble& rumble)> ReplayRumbleFn;
+
+// Feeds each captured input report through a XboxTranslator for its controller (using the given settings)
+// If realtime is set the reports are handed out at their recorded times, otherwise they're replayed as fast as possible
+// Returns number of input reports that were replayed
+size_t ReplayCapture(const CaptureReader& capture, const UserSettings& settings, bool realtime,
+  const ReplayOutputFn& output, const ReplayRumbleFn& rumble = nullptr);
@@ -0,0 +1,37 @@
+#include "InputTransfers.hpp"
+
+bool InputTransferSet::Start()
+{
+  stopping_ = false;
+
+  for (int i = 0; i < count_; i++)
+  {
+    if (!backend_->PrepareTransfer(i))
+      return false;
+
+    // counted before submitting, it can complete before SubmitTransfer even returns
+    pending_++;
+    if (backend_->SubmitTransfer(i) < 0)
+    {
+      pending_--;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void InputTransferSet::Stop()
+{
+  stopping_ = true;
+
+  for (int i = 0; i < count_; i++)
+    backend_->CancelTransfer(i);
+
+  // wait for the cancelled transfers to call back before freeing them
+  while (pending_ > 0)
+    backend_->HandleTransferEvents(100);
+
+  for (int i = 0; i < count_; i++)
+    backend_->FreeTransfer(i);
+}
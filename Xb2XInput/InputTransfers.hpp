@@ -0,0 +1,92 @@
+#pragma once
+// Keeps a fixed set of input transfers in-flight on a controller, resubmitting each one as it completes
+// The transfers themselves belong to an InputTransferBackend (libusb for XboxController, a simulated device in tests/),
+// this only does the accounting: how many are still pending, when to stop resubmitting, & waiting for them all to call back
+// Completed is called from the backend's event handling, Start/Stop from the thread that handles events for the controller
+// Portable like XboxTranslator, nothing in here depends on Windows
+
+#include <atomic>
+
+// How a transfer finished, mapped from the backend's own status (eg. LIBUSB_TRANSFER_*)
+enum InputTransferStatus {
+  INPUT_TRANSFER_COMPLETED,
+  INPUT_TRANSFER_ERROR, // timeout/stall/etc, transfer gets submitted again
+  INPUT_TRANSFER_NO_DEVICE,
+  INPUT_TRANSFER_CANCELLED,
+};
+
+class InputTransferBackend
+{
+public:
+  virtual ~InputTransferBackend() {}
+
+  // Allocates transfer index if needed & fills it in ready for SubmitTransfer, returns false if it couldn't be allocated
+  virtual bool PrepareTransfer(int index) = 0;
+
+  // Returns 0 if submitted, or a negative error code
+  virtual int SubmitTransfer(int index) = 0;
+
+  // Asks for an in-flight transfer to be cancelled, it still calls back (with INPUT_TRANSFER_CANCELLED or however it finished)
+  virtual void CancelTransfer(int index) = 0;
+
+  // Only called once the transfer isn't in-flight any more
+  virtual void FreeTransfer(int index) = 0;
+
+  // Dispatches completed transfers to InputTransferSet::Completed, waiting up to timeout_ms for one
+  virtual void HandleTransferEvents(int timeout_ms) = 0;
+};
+
+class InputTransferSet
+{
+  InputTransferBackend* backend_;
+  int count_;
+  std::atomic<int> pending_{ 0 };
+  std::atomic<bool> stopping_{ false };
+  std::atomic<bool> disconnected_{ false };
+
+public:
+  InputTransferSet(InputTransferBackend* backend, int count) : backend_(backend), count_(count) {}
+
+  // Submits all count transfers, returns false if one couldn't be (any submitted before it are left in-flight)
+  bool Start();
+
+  // Cancels every in-flight transfer & waits for them all to call back, then frees them
+  // Completed won't process or resubmit anything once this has been called
+  void Stop();
+
+  // Called by the backend when transfer index finishes, process is called for completed transfers
+  // & returns false if the report couldn't be handled (same as the device going away)
+  // The transfer is then resubmitted, unless it was cancelled, the device is gone or Stop has been called
+  template <typename Process>
+  void Completed(int index, InputTransferStatus status, Process process)
+  {
+    switch (status)
+    {
+    case INPUT_TRANSFER_COMPLETED:
+      if (!stopping_ && !disconnected_ && !process())
+        disconnected_ = true;
+      break;
+    case INPUT_TRANSFER_NO_DEVICE:
+      disconnected_ = true;
+      break;
+    case INPUT_TRANSFER_CANCELLED:
+      pending_--;
+      return;
+    default:
+      // timeout/stall/error, just try again
+      break;
+    }
+
+    // resubmit so there's always count transfers waiting on the controller
+    if (!stopping_ && !disconnected_ && backend_->SubmitTransfer(index) == 0)
+      return;
+
+    pending_--;
+  }
+
+  // Transfers that haven't called back for the last time yet
+  int Pending() const { return pending_; }
+
+  // True once a transfer found the device gone or process failed, nothing gets resubmitted after that
+  bool Disconnected() const { return disconnected_; }
+};
@@ -26,7 +26,7 @@ SOFTWARE.
 #pragma once
 
 //
-// TODO: this is... not optimal. Improve in the future.
+// Serials are handed out by SerialAllocator, so only serials that conflict with another client get probed.
 // 
 #define VIGEM_TARGETS_MAX   USHRT_MAX
 
@@ -38,6 +38,11 @@ typedef struct _VIGEM_CLIENT_T
 {
     HANDLE hBusDevice;
 
+    //
+    // Serials of the targets plugged in through this connection, so adding a target doesn't have to probe for one.
+    // 
+    SerialAllocator* Serials;
+
 } VIGEM_CLIENT;
 
 //
@@ -53,6 +58,25 @@ typedef enum _VIGEM_TARGET_STATE
 
 
 
+//
+// Max number of fire-and-forget report submissions a target can have outstanding.
+// 
+#define VIGEM_SUBMIT_QUEUE_MAX  8
+
+//
+// A preallocated report submission, owned by a target & reused for every report sent through it.
+// 
+typedef struct _VIGEM_SUBMIT_SLOT
+{
+    OVERLAPPED Overlapped;
+
+    union
+    {
+        XUSB_SUBMIT_REPORT Xusb;
+        DS4_SUBMIT_REPORT Ds4;
+    } Report;
+} VIGEM_SUBMIT_SLOT;
+
 //
 // Represents a virtual gamepad object.
 // 
@@ -69,4 +93,21 @@ typedef struct _VIGEM_TARGET_T
 	bool closingNotificationThreads;
 	HANDLE cancelNotificationThreadEvent;
 	std::unique_ptr<std::vector<std::thread>> notificationThreadList;
+
+    //
+    // Signalled while the target is plugged in, notification workers registered before then wait on it.
+    // 
+    HANDLE PluggedEvent;
+
+    //
+    // Preallocated I/O context, every request made for this target goes through it (serialized by IoLock).
+    // 
+    SRWLOCK IoLock;
+    HANDLE IoEvent;
+
+    //
+    // Fire-and-forget report submissions, only used once enabled by vigem_target_set_submit_queue (see SubmitRing).
+    // 
+    HANDLE SubmitDevice;
+    SubmitRing<VIGEM_SUBMIT_SLOT, VIGEM_SUBMIT_QUEUE_MAX> Submits;
 } VIGEM_TARGET;
@@ -0,0 +1,110 @@
+#include "MacroPlayer.hpp"
+
+void MacroPlayer::SetTurbo(uint32_t buttons, int rate)
+{
+  // only digital buttons can be turbo'd
+  turbo_buttons_ = rate > 0 ? (buttons & 0xFFFF) : 0;
+  turbo_half_us_ = rate > 0 ? 500000 / rate : 0;
+  turbo_held_ = false;
+}
+
+int MacroPlayer::AddMacro(const Macro& macro)
+{
+  macros_.push_back(macro);
+  return (int)macros_.size() - 1;
+}
+
+void MacroPlayer::ClearMacros()
+{
+  macros_.clear();
+  playing_count_ = 0;
+}
+
+void MacroPlayer::Start(int macro, uint64_t now_us)
+{
+  if (macro < 0 || macro >= (int)macros_.size() || macros_[macro].empty())
+    return;
+
+  // restart it if it's already playing, otherwise replace the oldest if there's no room
+  int index = 0;
+  while (index < playing_count_ && playing_[index].macro != macro)
+    index++;
+
+  if (index == playing_count_)
+  {
+    if (playing_count_ < MACRO_MAX_PLAYING)
+      playing_count_++;
+    else
+    {
+      for (int i = 1; i < playing_count_; i++)
+        playing_[i - 1] = playing_[i];
+      index = playing_count_ - 1;
+    }
+  }
+
+  playing_[index].macro = macro;
+  playing_[index].step = 0;
+  playing_[index].step_end_us = now_us + macros_[macro][0].duration_ms * 1000ull;
+}
+
+uint64_t MacroPlayer::Apply(XUSB_REPORT& gamepad, uint64_t now_us)
+{
+  uint64_t next = 0;
+  auto updateNext = [&next](uint64_t time)
+  {
+    if (!next || time < next)
+      next = time;
+  };
+
+  // Turbo: held turbo buttons are released every other turbo_half_us_, starting from when they were pressed
+  uint32_t turbo = gamepad.wButtons & turbo_buttons_;
+  if (!turbo)
+    turbo_held_ = false;
+  else
+  {
+    if (!turbo_held_)
+    {
+      turbo_held_ = true;
+      turbo_start_us_ = now_us;
+    }
+
+    uint64_t phase = (now_us - turbo_start_us_) / turbo_half_us_;
+    if (phase & 1)
+      gamepad.wButtons &= ~((USHORT)turbo);
+
+    updateNext(turbo_start_us_ + (phase + 1) * turbo_half_us_);
+  }
+
+  // Macros: buttons of each playing macros current step are added on top of the report
+  uint32_t output = 0;
+  for (int i = 0; i < playing_count_;)
+  {
+    auto& playing = playing_[i];
+    auto& macro = macros_[playing.macro];
+    while (playing.step < macro.size() && now_us >= playing.step_end_us)
+    {
+      playing.step++;
+      if (playing.step < macro.size())
+        playing.step_end_us += macro[playing.step].duration_ms * 1000ull;
+    }
+
+    if (playing.step >= macro.size())
+    {
+      // finished, move the last one into its place
+      playing_[i] = playing_[--playing_count_];
+      continue;
+    }
+
+    output |= macro[playing.step].buttons;
+    updateNext(playing.step_end_us);
+    i++;
+  }
+
+  gamepad.wButtons |= (USHORT)(output & ~(XUSB_GAMEPAD_LT | XUSB_GAMEPAD_RT));
+  if (output & XUSB_GAMEPAD_LT)
+    gamepad.bLeftTrigger = 255;
+  if (output & XUSB_GAMEPAD_RT)
+    gamepad.bRightTrigger = 255;
+
+  return next;
+}
@@ -0,0 +1,57 @@
+#pragma once
+// Turbo buttons & macro playback, applied to a controllers translated report based on the current time
+// Apply returns when the output will next change, so the caller can schedule an update for then (see TimerWheel)
+// Portable like XboxTranslator, nothing in here depends on Windows
+
+#include "XboxTypes.hpp"
+#include <vector>
+
+#define MACRO_MAX_PLAYING     4
+
+// How long buttons are held for by press/release combinations without their own macro timing
+#define MACRO_DEFAULT_STEP_MS 50
+
+struct MacroStep {
+  uint32_t buttons; // XUSB_GAMEPAD_* bits (incl. XUSB_GAMEPAD_LT/RT) to hold during this step, 0 to pause
+  uint32_t duration_ms;
+
+  bool operator==(const MacroStep& other) const { return buttons == other.buttons && duration_ms == other.duration_ms; }
+  bool operator!=(const MacroStep& other) const { return !(*this == other); }
+};
+
+typedef std::vector<MacroStep> Macro;
+
+class MacroPlayer
+{
+  struct Playing {
+    int macro;
+    size_t step;
+    uint64_t step_end_us;
+  };
+
+  std::vector<Macro> macros_;
+  Playing playing_[MACRO_MAX_PLAYING];
+  int playing_count_ = 0;
+
+  uint32_t turbo_buttons_ = 0;
+  uint64_t turbo_half_us_ = 0; // how long turbo buttons stay pressed/released for
+  uint64_t turbo_start_us_ = 0;
+  bool turbo_held_ = false;
+
+public:
+  // rate is number of presses per second
+  void SetTurbo(uint32_t buttons, int rate);
+
+  int AddMacro(const Macro& macro);
+  void ClearMacros();
+
+  // Starts playing macro from the beginning, restarting it if it was already playing
+  void Start(int macro, uint64_t now_us);
+
+  // true if Apply could change the output, ie. turbo is set or a macro is playing
+  bool Active() const { return turbo_buttons_ || playing_count_; }
+
+  // Applies turbo & any playing macros to gamepad as of now_us
+  // Returns the time the output will next change, or 0 if it won't change without a new report
+  uint64_t Apply(XUSB_REPORT& gamepad, uint64_t now_us);
+};
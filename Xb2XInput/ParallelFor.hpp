@@ -0,0 +1,32 @@
+#pragma once
+// Runs a loop's iterations across a few threads, used to bring up several newly plugged-in controllers at once since
+// each one mostly waits on blocking USB requests
+// Threads are only started for the duration of the call, there's nothing left running afterwards
+// Portable like XboxTranslator, nothing in here depends on Windows
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Calls fn(i) for every i in [0, count) on up to max_threads threads (including the calling one), returns once they've all finished
+// Iterations are handed out in order as threads become free, so a slow one doesn't hold up the rest
+template <typename Fn>
+void ParallelFor(size_t count, size_t max_threads, Fn fn)
+{
+  std::atomic<size_t> next{ 0 };
+  auto worker = [&]()
+  {
+    for (size_t i = next++; i < count; i = next++)
+      fn(i);
+  };
+
+  size_t threads = count < max_threads ? count : max_threads;
+  std::vector<std::thread> helpers;
+  for (size_t i = 1; i < threads; i++)
+    helpers.emplace_back(worker);
+
+  worker();
+
+  for (auto& helper : helpers)
+    helper.join();
+}
@@ -0,0 +1,149 @@
+#include "ReportBatcher.hpp"
+#include <chrono>
+
+static uint64_t nowUs()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ReportBatcher::~ReportBatcher()
+{
+  Stop();
+}
+
+void ReportBatcher::Start(uint64_t tick_us, BatchSubmitFn submit)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (thread_.joinable() || !tick_us || !submit)
+    return;
+
+  tick_us_ = tick_us;
+  submit_ = submit;
+  stopping_ = false;
+  thread_ = std::thread(&ReportBatcher::run, this);
+}
+
+void ReportBatcher::Stop()
+{
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (!thread_.joinable())
+      return;
+    stopping_ = true;
+  }
+
+  posted_.notify_all();
+  thread_.join();
+
+  Flush();
+}
+
+void ReportBatcher::Post(int slot, void* target, const XUSB_REPORT& report)
+{
+  if (slot < 0 || slot >= BATCH_MAX_TARGETS)
+    return;
+
+  bool wake = false;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto& entry = entries_[slot];
+    if (entry.dirty)
+      stats_.replaced++;
+    else
+    {
+      entry.dirty = true;
+      wake = !dirty_count_++;
+    }
+    entry.target = target;
+    entry.report = report;
+  }
+
+  // submitter only needs waking for the first report of a tick, it's already waiting on the tick for any others
+  if (wake)
+    posted_.notify_one();
+}
+
+void ReportBatcher::Remove(int slot)
+{
+  if (slot < 0 || slot >= BATCH_MAX_TARGETS)
+    return;
+
+  std::lock_guard<std::mutex> pass_guard(pass_mutex_);
+  std::lock_guard<std::mutex> guard(mutex_);
+  auto& entry = entries_[slot];
+  if (entry.dirty)
+    dirty_count_--;
+  entry.dirty = false;
+  entry.target = nullptr;
+}
+
+size_t ReportBatcher::Flush()
+{
+  return send(nowUs());
+}
+
+void ReportBatcher::run()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_)
+  {
+    // nothing to send, sleep until something's posted instead of waking up every tick
+    posted_.wait(lock, [this]() { return stopping_ || dirty_count_ > 0; });
+    if (stopping_)
+      break;
+
+    // ticks are aligned to the clock rather than to whichever report came in first
+    uint64_t tick = (nowUs() / tick_us_ + 1) * tick_us_;
+    auto tick_time = std::chrono::steady_clock::time_point(std::chrono::microseconds(tick));
+    if (posted_.wait_until(lock, tick_time, [this]() { return stopping_; }))
+      break;
+
+    lock.unlock();
+    send(tick);
+    lock.lock();
+  }
+}
+
+size_t ReportBatcher::send(uint64_t tick_start_us)
+{
+  struct Pending {
+    void* target;
+    XUSB_REPORT report;
+  };
+  Pending pending[BATCH_MAX_TARGETS];
+  size_t count = 0;
+
+  // reports are copied out so controllers can keep posting while they're being sent
+  std::lock_guard<std::mutex> pass_guard(pass_mutex_);
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (!submit_)
+      return 0;
+
+    for (auto& entry : entries_)
+    {
+      if (!entry.dirty)
+        continue;
+      entry.dirty = false;
+      pending[count++] = { entry.target, entry.report };
+    }
+    dirty_count_ = 0;
+  }
+
+  if (!count)
+    return 0;
+
+  uint64_t start = nowUs();
+  for (size_t i = 0; i < count; i++)
+    submit_(pending[i].target, pending[i].report);
+  uint64_t spread = nowUs() - start;
+
+  std::lock_guard<std::mutex> guard(mutex_);
+  stats_.ticks++;
+  stats_.reports += count;
+  stats_.spread_total_us += spread;
+  if (spread > stats_.spread_max_us)
+    stats_.spread_max_us = spread;
+  stats_.late_total_us += start > tick_start_us ? start - tick_start_us : 0;
+  return count;
+}
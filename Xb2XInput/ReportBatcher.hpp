@@ -0,0 +1,71 @@
+#pragma once
+// Sends every virtual controllers newest report together once per tick, from a single submitter thread
+// Controllers Post reports as they translate them, the submitter wakes on the next tick boundary & sends everything that
+// changed back-to-back, so inputs from the same tick reach the bus together no matter when each controller's USB report came in
+// Only the newest report of each target is kept, posting again before its tick replaces the older one
+// Portable like XboxTranslator, nothing in here depends on Windows
+
+#include "XboxTypes.hpp"
+
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#define BATCH_MAX_TARGETS  64 // same as REGISTRY_SLOTS, XboxController posts to the slot of its RegistryId
+
+typedef void (*BatchSubmitFn)(void* target, const XUSB_REPORT& report);
+
+struct BatchStats {
+  uint64_t ticks = 0;           // ticks that had anything to send
+  uint64_t reports = 0;         // reports sent
+  uint64_t replaced = 0;        // reports replaced by a newer one before their tick came
+  uint64_t spread_total_us = 0; // start of the first submit to the end of the last, summed over every tick
+  uint64_t spread_max_us = 0;
+  uint64_t late_total_us = 0;   // how long after the tick boundary the first submit started, summed over every tick
+};
+
+class ReportBatcher
+{
+  struct Entry {
+    void* target = nullptr;
+    XUSB_REPORT report;
+    bool dirty = false;
+  };
+
+  Entry entries_[BATCH_MAX_TARGETS];
+  int dirty_count_ = 0;
+  std::mutex mutex_;
+  std::mutex pass_mutex_; // held while reports are being sent, so Remove can wait for them
+  std::condition_variable posted_;
+  std::thread thread_;
+  bool stopping_ = false;
+  uint64_t tick_us_ = 0;
+  BatchSubmitFn submit_ = nullptr;
+  BatchStats stats_;
+
+  void run();
+  size_t send(uint64_t tick_start_us);
+
+public:
+  ~ReportBatcher();
+
+  // Starts the submitter thread, reports are sent by submit on every tick_us boundary
+  void Start(uint64_t tick_us, BatchSubmitFn submit);
+
+  // Sends anything still posted & stops the submitter thread
+  void Stop();
+
+  bool Running() { return thread_.joinable(); }
+
+  // Queues report to be sent to target on the next tick, slot identifies the sender (0 - BATCH_MAX_TARGETS-1)
+  void Post(int slot, void* target, const XUSB_REPORT& report);
+
+  // Drops anything queued for slot, waiting for it to be sent first if it's being sent right now
+  // Once this returns the slot's target won't be used again (until something else is posted to the slot)
+  void Remove(int slot);
+
+  // Sends everything posted so far right now, returns how many reports were sent
+  size_t Flush();
+
+  BatchStats Stats() { std::lock_guard<std::mutex> guard(mutex_); return stats_; }
+};
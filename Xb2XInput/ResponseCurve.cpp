@@ -0,0 +1,156 @@
+#include "ResponseCurve.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+// Reads a number from text at pos, moving pos past it
+static bool readNumber(const std::string& text, size_t& pos, float& value)
+{
+  const char* start = text.c_str() + pos;
+  char* end = nullptr;
+  value = (float)strtod(start, &end);
+  if (end == start)
+    return false;
+
+  pos += end - start;
+  return true;
+}
+
+static bool parseCurvePoints(const std::string& text, std::vector<std::pair<float, float>>& points)
+{
+  points.clear();
+
+  // points are "input:output" percentages, seperated by commas/spaces
+  size_t pos = 0;
+  while (pos < text.length())
+  {
+    if (isspace((unsigned char)text[pos]) || text[pos] == ',')
+    {
+      pos++;
+      continue;
+    }
+
+    float input, output;
+    if (!readNumber(text, pos, input) || pos >= text.length() || text[pos] != ':')
+      return false;
+    pos++;
+    if (!readNumber(text, pos, output))
+      return false;
+
+    points.push_back(std::make_pair(std::min(std::max(input, 0.f), 100.f) / 100.f, std::min(std::max(output, 0.f), 100.f) / 100.f));
+  }
+
+  if (points.size() < 2)
+    return false;
+
+  std::sort(points.begin(), points.end());
+  return true;
+}
+
+bool ParseResponseCurve(const std::string& text, ResponseCurve& curve)
+{
+  std::string name;
+  size_t pos = 0;
+  while (pos < text.length() && isspace((unsigned char)text[pos]))
+    pos++;
+  // names start with a letter, so custom points can start with a negative number (clamped to 0 below)
+  if (pos < text.length() && isalpha((unsigned char)text[pos]))
+  {
+    while (pos < text.length() && (isalpha((unsigned char)text[pos]) || text[pos] == '-'))
+      name += (char)tolower((unsigned char)text[pos++]);
+  }
+
+  if (!name.length())
+  {
+    std::vector<std::pair<float, float>> points;
+    if (!parseCurvePoints(text, points))
+      return false;
+
+    curve.type = RESPONSE_CURVE_CUSTOM;
+    curve.points = points;
+    return true;
+  }
+
+  int type;
+  if (name == "linear")
+    type = RESPONSE_CURVE_LINEAR;
+  else if (name == "exponential" || name == "exp")
+    type = RESPONSE_CURVE_EXPONENTIAL;
+  else if (name == "scurve" || name == "s-curve")
+    type = RESPONSE_CURVE_SCURVE;
+  else
+    return false;
+
+  // exponent is optional
+  float exponent = curve.exponent;
+  while (pos < text.length() && isspace((unsigned char)text[pos]))
+    pos++;
+  if (pos < text.length() && (!readNumber(text, pos, exponent) || exponent <= 0))
+    return false;
+
+  // nothing else is allowed after it
+  while (pos < text.length() && isspace((unsigned char)text[pos]))
+    pos++;
+  if (pos < text.length())
+    return false;
+
+  curve.type = type;
+  curve.exponent = exponent;
+  return true;
+}
+
+int EvaluateResponseCurve(const ResponseCurve& curve, int value, int max)
+{
+  if (value <= 0)
+    return 0;
+
+  // Outer deadzone: scale so the end of the axis reaches max before it's fully pressed
+  int range = max - std::min(std::max(curve.outer_deadzone, 0), max - 1);
+  double input = std::min((double)value / range, 1.0);
+
+  double output = input;
+  switch (curve.type)
+  {
+  case RESPONSE_CURVE_EXPONENTIAL:
+    output = pow(input, curve.exponent);
+    break;
+  case RESPONSE_CURVE_SCURVE:
+  {
+    // slow near the center & end, fast through the middle
+    double low = pow(input, curve.exponent);
+    double high = pow(1.0 - input, curve.exponent);
+    output = low / (low + high);
+    break;
+  }
+  case RESPONSE_CURVE_CUSTOM:
+  {
+    auto& points = curve.points;
+    if (points.size() < 2)
+      break;
+
+    if (input <= points.front().first)
+      output = points.front().second;
+    else if (input >= points.back().first)
+      output = points.back().second;
+    else
+    {
+      size_t i = 1;
+      while (points[i].first < input)
+        i++;
+
+      auto& a = points[i - 1];
+      auto& b = points[i];
+      double span = b.first - a.first;
+      output = span > 0 ? a.second + (b.second - a.second) * (input - a.first) / span : b.second;
+    }
+    break;
+  }
+  }
+
+  // Anti-deadzone: output starts from anti_deadzone instead of 0
+  double anti = std::min(std::max(curve.anti_deadzone, 0), max) / (double)max;
+  output = anti + (1.0 - anti) * output;
+
+  return std::min((int)(output * max + 0.5), max);
+}
@@ -0,0 +1,44 @@
+#pragma once
+// Response curves for sticks & triggers, evaluated once per settings change into XboxTranslator's lookup tables
+// Portable like XboxTranslator, nothing in here depends on Windows
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#define RESPONSE_CURVE_LINEAR         0
+#define RESPONSE_CURVE_EXPONENTIAL    1
+#define RESPONSE_CURVE_SCURVE         2
+#define RESPONSE_CURVE_CUSTOM         3
+
+// indexes into UserSettings::curves
+#define CURVE_LEFT_STICK              0
+#define CURVE_RIGHT_STICK             1
+#define CURVE_LEFT_TRIGGER            2
+#define CURVE_RIGHT_TRIGGER           3
+#define CURVE_COUNT                   4
+
+struct ResponseCurve {
+  int type = RESPONSE_CURVE_LINEAR;
+  float exponent = 2.0f; // used by exponential & scurve
+  std::vector<std::pair<float, float>> points; // custom curve input:output points (0 - 1), sorted by input
+
+  int outer_deadzone = 0; // amount of travel at the end of the axis that counts as fully pressed
+  int anti_deadzone = 0; // smallest output once the axis leaves the (inner) deadzone, for games with their own deadzone
+
+  bool IsLinear() const { return type == RESPONSE_CURVE_LINEAR && !outer_deadzone && !anti_deadzone; }
+
+  bool operator==(const ResponseCurve& other) const
+  {
+    return type == other.type && exponent == other.exponent && points == other.points &&
+      outer_deadzone == other.outer_deadzone && anti_deadzone == other.anti_deadzone;
+  }
+  bool operator!=(const ResponseCurve& other) const { return !(*this == other); }
+};
+
+// Parses curve type from INI, eg. "linear", "exponential 2.5", "scurve 3" or custom points as percentages, "0:0, 50:25, 100:100"
+// Only changes the curve type/exponent/points, returns false (leaving curve untouched) if text isn't valid
+bool ParseResponseCurve(const std::string& text, ResponseCurve& curve);
+
+// Returns curve output for an axis value between 0 and max (max being the full range of that axis, 32767 or 255)
+int EvaluateResponseCurve(const ResponseCurve& curve, int value, int max);
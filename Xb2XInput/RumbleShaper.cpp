@@ -0,0 +1,57 @@
+#include "RumbleShaper.hpp"
+
+bool RumbleShaper::Push(uint8_t large_motor, uint8_t small_motor)
+{
+  stats_.received++;
+
+  if (has_pending_)
+  {
+    if (pending_large_ == large_motor && pending_small_ == small_motor)
+    {
+      stats_.merged++;
+      return false;
+    }
+
+    // replaced before it got sent
+    stats_.merged++;
+    has_pending_ = false;
+  }
+
+  // back to what the controller already has (or is being sent right now), nothing to do
+  if (has_sent_ && sent_large_ == large_motor && sent_small_ == small_motor)
+  {
+    stats_.merged++;
+    return false;
+  }
+
+  pending_large_ = large_motor;
+  pending_small_ = small_motor;
+  has_pending_ = true;
+  return true;
+}
+
+bool RumbleShaper::Take(uint64_t now_us, uint8_t& large_motor, uint8_t& small_motor)
+{
+  if (!has_pending_ || now_us < NextSendTime())
+    return false;
+
+  large_motor = sent_large_ = pending_large_;
+  small_motor = sent_small_ = pending_small_;
+  has_sent_ = true;
+  sent_us_ = now_us;
+  has_pending_ = false;
+  stats_.sent++;
+  return true;
+}
+
+void RumbleShaper::Retry(uint8_t large_motor, uint8_t small_motor)
+{
+  // don't know what the controller has now, so the next update can't be dropped as a duplicate
+  has_sent_ = false;
+  if (has_pending_)
+    return;
+
+  pending_large_ = large_motor;
+  pending_small_ = small_motor;
+  has_pending_ = true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+// Shapes the stream of rumble updates a game sends before they go out to the controller
+// Updates that don't change anything are dropped, bursts are merged so only the newest value gets sent,
+// and each controller gets at most one report per RUMBLE_MIN_INTERVAL_US
+// Not thread-safe, XboxController guards it with its rumble_mutex_
+// Portable like XboxTranslator, nothing in here depends on Windows
+
+#include <cstdint>
+
+// 125 reports/sec, faster than any game changes rumble in a way anyone could feel
+#define RUMBLE_MIN_INTERVAL_US  8000
+
+struct RumbleStats {
+  uint64_t received = 0; // updates pushed
+  uint64_t merged = 0;   // updates that were dropped as duplicates or replaced by a newer one before being sent
+  uint64_t sent = 0;     // updates taken to be sent
+};
+
+class RumbleShaper
+{
+  uint64_t min_interval_us_;
+
+  uint8_t pending_large_ = 0;
+  uint8_t pending_small_ = 0;
+  bool has_pending_ = false;
+
+  uint8_t sent_large_ = 0;
+  uint8_t sent_small_ = 0;
+  bool has_sent_ = false; // false until something's been sent, or after it failed to send
+  uint64_t sent_us_ = 0;
+
+  RumbleStats stats_;
+
+public:
+  explicit RumbleShaper(uint64_t min_interval_us = RUMBLE_MIN_INTERVAL_US) : min_interval_us_(min_interval_us) {}
+
+  // Queues a new motor state, returns false if it didn't change anything & was dropped
+  bool Push(uint8_t large_motor, uint8_t small_motor);
+
+  // true if there's something waiting to be sent
+  bool Pending() const { return has_pending_; }
+
+  // Earliest time the pending update can be sent
+  uint64_t NextSendTime() const { return has_sent_ ? sent_us_ + min_interval_us_ : 0; }
+
+  // If there's an update pending & it can be sent at now_us, returns true & moves it into large_motor/small_motor
+  bool Take(uint64_t now_us, uint8_t& large_motor, uint8_t& small_motor);
+
+  // Puts back an update that failed to send, unless something newer has been pushed since
+  void Retry(uint8_t large_motor, uint8_t small_motor);
+
+  const RumbleStats& Stats() const { return stats_; }
+};
@@ -0,0 +1,54 @@
+#include "SerialAllocator.hpp"
+
+SerialAllocator::SerialAllocator(uint32_t max_serial) : max_serial_(max_serial)
+{
+  // bit n is serial n, serial 0 is never used
+  owned_.resize(max_serial / 64 + 1);
+  conflicts_.resize(max_serial / 64 + 1);
+}
+
+void SerialAllocator::setBit(std::vector<uint64_t>& bits, uint32_t serial, bool value)
+{
+  if (value)
+    bits[serial / 64] |= 1ull << (serial % 64);
+  else
+    bits[serial / 64] &= ~(1ull << (serial % 64));
+}
+
+uint32_t SerialAllocator::findFree()
+{
+  for (size_t word = 0; word < owned_.size(); word++)
+  {
+    uint64_t used = owned_[word] | conflicts_[word];
+    if (!word)
+      used |= 1; // serial 0
+    if (used == ~0ull)
+      continue;
+
+    uint32_t bit = 0;
+    while (used & (1ull << bit))
+      bit++;
+
+    uint32_t serial = (uint32_t)(word * 64 + bit);
+    return serial <= max_serial_ ? serial : 0;
+  }
+  return 0;
+}
+
+void SerialAllocator::Release(uint32_t serial)
+{
+  if (!serial || serial > max_serial_)
+    return;
+
+  // whatever it conflicted with before can't still be using it, we just had it plugged in ourselves
+  std::lock_guard<std::mutex> guard(mutex_);
+  setBit(owned_, serial, false);
+  setBit(conflicts_, serial, false);
+}
+
+void SerialAllocator::Reset()
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  owned_.assign(owned_.size(), 0);
+  conflicts_.assign(conflicts_.size(), 0);
+}
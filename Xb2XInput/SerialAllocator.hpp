@@ -0,0 +1,72 @@
+#pragma once
+// Hands out serial numbers for ViGEm targets, instead of probing the bus from serial 1 for every target added
+// Serials this client has plugged in are tracked here, as are ones that turned out to be taken by something else
+// (another ViGEm client), so Allocate normally gets a free serial on its first try & only probes further on a conflict
+// Thread-safe, the plug function is called without any lock held so targets can be added in parallel
+// Portable like XboxTranslator, nothing in here depends on Windows
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class SerialAllocator
+{
+  std::mutex mutex_;
+  uint32_t max_serial_;
+  std::vector<uint64_t> owned_;     // serials plugged in (or being plugged in) by us
+  std::vector<uint64_t> conflicts_; // serials that were taken when we tried them
+  uint64_t attempts_ = 0;
+
+  // Lowest serial that isn't owned or known to conflict, 0 if there aren't any
+  uint32_t findFree();
+
+  static void setBit(std::vector<uint64_t>& bits, uint32_t serial, bool value);
+
+public:
+  explicit SerialAllocator(uint32_t max_serial);
+
+  // Tries plug(serial) with free serials until it returns true, returns the serial that got plugged in or 0 if none could be
+  // If every serial has conflicted, the ones that did get tried again once in case they've been freed since
+  template <typename PlugFn>
+  uint32_t Allocate(PlugFn plug)
+  {
+    bool retried = false;
+    while (true)
+    {
+      uint32_t serial;
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        serial = findFree();
+        if (!serial)
+        {
+          if (retried)
+            return 0;
+
+          retried = true;
+          conflicts_.assign(conflicts_.size(), 0);
+          continue;
+        }
+
+        // reserved while it's being plugged in, so a parallel Allocate can't try it too
+        setBit(owned_, serial, true);
+        attempts_++;
+      }
+
+      if (plug(serial))
+        return serial;
+
+      std::lock_guard<std::mutex> guard(mutex_);
+      setBit(owned_, serial, false);
+      setBit(conflicts_, serial, true);
+    }
+  }
+
+  // Makes serial available again once its target has been unplugged, including if it was marked as conflicting
+  void Release(uint32_t serial);
+
+  // Forgets about every serial, eg. after the bus connection was closed (which unplugs all of our targets)
+  void Reset();
+
+  // Number of times a plug function has been called
+  uint64_t Attempts() { std::lock_guard<std::mutex> guard(mutex_); return attempts_; }
+};
@@ -0,0 +1,260 @@
+#include "SettingsJournal.hpp"
+
+#include <cctype>
+#include <fstream>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cstdio>
+#endif
+
+static std::string toLower(std::string text)
+{
+  for (auto& c : text)
+    c = (char)::tolower((unsigned char)c);
+  return text;
+}
+
+static std::string trim(const std::string& text)
+{
+  auto start = text.find_first_not_of(" \t");
+  if (start == std::string::npos)
+    return "";
+  auto end = text.find_last_not_of(" \t");
+  return text.substr(start, end - start + 1);
+}
+
+static std::string changeKey(const std::string& section, const std::string& key)
+{
+  return toLower(section) + "\n" + toLower(key);
+}
+
+SettingsJournal::~SettingsJournal()
+{
+  Close();
+}
+
+void SettingsJournal::Open(const std::string& path)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (thread_.joinable())
+    return;
+
+  path_ = path;
+  stopping_ = false;
+  thread_ = std::thread(&SettingsJournal::run, this);
+}
+
+void SettingsJournal::Close()
+{
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (!thread_.joinable())
+      return;
+    stopping_ = true;
+  }
+
+  changed_.notify_all();
+  thread_.join();
+
+  Flush();
+}
+
+void SettingsJournal::Set(const std::string& section, const std::string& key, const std::string& value)
+{
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto now = std::chrono::steady_clock::now();
+    if (pending_.empty())
+      first_change_ = now;
+    last_change_ = now;
+    write_failed_ = false;
+
+    Change change = { section, key, value };
+    pending_[changeKey(section, key)] = change;
+  }
+
+  changed_.notify_all();
+}
+
+bool SettingsJournal::Flush()
+{
+  std::lock_guard<std::mutex> write_guard(write_mutex_);
+
+  std::map<std::string, Change> changes;
+  std::string path;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (pending_.empty())
+      return true;
+
+    changes.swap(pending_);
+    path = path_;
+  }
+
+  bool ret = writeChanges(path, changes);
+
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (ret)
+    writes_++;
+  else
+  {
+    // put them back, anything Set while writing is newer & stays as it is (and gets the writer to try again)
+    if (pending_.empty())
+    {
+      first_change_ = last_change_ = std::chrono::steady_clock::now();
+      write_failed_ = true;
+    }
+    pending_.insert(changes.begin(), changes.end());
+  }
+  return ret;
+}
+
+void SettingsJournal::run()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true)
+  {
+    // after a failed write the changes wait for another Set, rather than retrying on a read-only INI over & over
+    changed_.wait(lock, [this] { return stopping_ || (!pending_.empty() && !write_failed_); });
+    if (stopping_)
+      return;
+
+    // wait for changes to settle, Close writes anything left when stopping
+    while (!stopping_)
+    {
+      auto deadline = last_change_ + std::chrono::milliseconds(SETTINGS_JOURNAL_DELAY_MS);
+      auto max_deadline = first_change_ + std::chrono::milliseconds(SETTINGS_JOURNAL_MAX_DELAY_MS);
+      if (max_deadline < deadline)
+        deadline = max_deadline;
+
+      if (std::chrono::steady_clock::now() >= deadline)
+        break;
+      changed_.wait_until(lock, deadline);
+    }
+    if (stopping_)
+      return;
+
+    lock.unlock();
+    Flush();
+    lock.lock();
+  }
+}
+
+bool SettingsJournal::writeChanges(const std::string& path, const std::map<std::string, Change>& changes)
+{
+  std::vector<std::string> lines;
+  {
+    std::ifstream file(path);
+    if (file.is_open())
+    {
+      // read-only INI means the user doesn't want settings changed, same as WritePrivateProfileString failing on it
+      if (!std::ofstream(path, std::ios::app).is_open())
+        return false;
+
+      std::string line;
+      while (std::getline(file, line))
+      {
+        if (line.length() && line.back() == '\r')
+          line.pop_back();
+        lines.push_back(line);
+      }
+    }
+  }
+
+  // Rewrite the lines of any keys that already exist, others get added to the end of their section
+  std::map<std::string, bool> written;
+  std::vector<std::string> output;
+  std::string section; // lowercase
+  size_t section_end = 0; // position in output after the last non-empty line of section
+
+  auto addMissing = [&]()
+  {
+    std::vector<std::string> added;
+    for (auto& change : changes)
+      if (!written[change.first] && toLower(change.second.section) == section)
+      {
+        added.push_back(change.second.key + "=" + change.second.value);
+        written[change.first] = true;
+      }
+    output.insert(output.begin() + section_end, added.begin(), added.end());
+  };
+
+  bool in_section = false;
+  for (auto& line : lines)
+  {
+    auto text = trim(line);
+    if (text.length() && text[0] == '[' && text.find(']') != std::string::npos)
+    {
+      if (in_section)
+        addMissing();
+
+      section = toLower(trim(text.substr(1, text.find(']') - 1)));
+      in_section = true;
+      output.push_back(line);
+      section_end = output.size();
+      continue;
+    }
+
+    auto equals = line.find('=');
+    if (in_section && equals != std::string::npos && text[0] != ';')
+    {
+      auto name = section + "\n" + toLower(trim(line.substr(0, equals)));
+      auto iter = changes.find(name);
+      if (iter != changes.end() && !written[name])
+      {
+        // keep the existing "key = value" spacing
+        bool spaced = equals + 1 < line.length() && line[equals + 1] == ' ';
+        output.push_back(line.substr(0, equals + 1) + (spaced ? " " : "") + iter->second.value);
+        written[name] = true;
+        section_end = output.size();
+        continue;
+      }
+    }
+
+    output.push_back(line);
+    if (text.length())
+      section_end = output.size();
+  }
+  if (in_section)
+    addMissing();
+
+  // Sections that don't exist yet go at the end of the file
+  for (auto& change : changes)
+  {
+    if (written[change.first])
+      continue;
+
+    if (output.size() && output.back().length())
+      output.push_back("");
+    output.push_back("[" + change.second.section + "]");
+    section = toLower(change.second.section);
+    section_end = output.size();
+    addMissing();
+  }
+
+  // Write everything out to a temp file first, so the INI is never left half-written if we're killed during it
+  auto temp_path = path + ".tmp";
+  {
+    std::ofstream file(temp_path, std::ios::trunc);
+    if (!file.is_open())
+      return false;
+
+    for (auto& line : output)
+      file << line << "\n";
+
+    file.close();
+    if (file.fail())
+      return false;
+  }
+
+#ifdef _WIN32
+  return MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+#else
+  return std::rename(temp_path.c_str(), path.c_str()) == 0;
+#endif
+}
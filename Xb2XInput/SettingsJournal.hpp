@@ -0,0 +1,62 @@
+#pragma once
+// Write-behind journal for INI settings changes
+// Set only queues the change & returns straight away, a background thread waits for changes to settle & then writes
+// everything that's queued in one go, to a temp file that gets renamed over the INI so it's never left half-written
+// Portable like XboxTranslator, only the final rename depends on the OS
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+// Changes are written once nothing has changed for SETTINGS_JOURNAL_DELAY_MS,
+// or SETTINGS_JOURNAL_MAX_DELAY_MS after the first queued change if they keep on coming (eg. holding a deadzone combo)
+#define SETTINGS_JOURNAL_DELAY_MS      500
+#define SETTINGS_JOURNAL_MAX_DELAY_MS  2000
+
+class SettingsJournal
+{
+  struct Change {
+    std::string section;
+    std::string key;
+    std::string value;
+  };
+
+  std::string path_;
+  std::map<std::string, Change> pending_; // keyed by lowercase "section\nkey", INI names are case-insensitive
+  std::chrono::steady_clock::time_point first_change_;
+  std::chrono::steady_clock::time_point last_change_;
+  std::mutex mutex_;
+  std::mutex write_mutex_; // only one write at a time, held while the file is being written
+  std::condition_variable changed_;
+  std::thread thread_;
+  bool stopping_ = false;
+  bool write_failed_ = false; // last write failed, changes are kept for the next Set/Flush to try again
+  int writes_ = 0;
+
+  void run();
+
+  // Applies changes to the INI at path, returns false if it couldn't be written (eg. it's read-only)
+  static bool writeChanges(const std::string& path, const std::map<std::string, Change>& changes);
+
+public:
+  ~SettingsJournal();
+
+  // Starts the writer thread, changes are written to path
+  void Open(const std::string& path);
+
+  // Writes anything still queued & stops the writer thread
+  void Close();
+
+  // Queues setting to be written, later calls for the same setting replace the earlier value
+  void Set(const std::string& section, const std::string& key, const std::string& value);
+
+  // Writes anything that's queued right now, returns false if the file couldn't be written
+  // Changes that failed to write stay queued, they're retried with the next change or Flush instead of being lost
+  bool Flush();
+
+  // Number of times the file has been written
+  int Writes() { std::lock_guard<std::mutex> guard(mutex_); return writes_; }
+};
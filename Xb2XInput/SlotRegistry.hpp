@@ -0,0 +1,256 @@
+#pragma once
+// Fixed-size registry of objects (eg. the connected XboxControllers) that can be looked up & iterated without locking
+// Each object lives in a slot for as long as it's registered & is referred to by a RegistryId, which includes the slots
+// generation so an ID for a removed object never finds whatever took its slot afterwards
+// Objects can also be given uint64_t keys (eg. their ViGEm target) for O(1) lookups, the index is an open-addressed
+// table that readers probe without locking
+// Readers have to Pin the registry while using anything they got from it, Remove waits for them before handing the
+// object back to be freed (see Epoch)
+// Writers (Add/Remove/SetKey/RemoveKey) are serialized by the registry, readers never block them & vice versa
+// Portable like XboxTranslator, nothing in here depends on Windows
+
+#include "Epoch.hpp"
+#include <memory>
+#include <mutex>
+
+#define REGISTRY_SLOTS        64  // max 256, slot number is the low 8 bits of a RegistryId
+#define REGISTRY_INDEX_SIZE   256 // must be a power of 2, & comfortably more than the number of keys that'll be set
+
+// (generation << 8) | slot, 0 is never a valid ID
+typedef uint32_t RegistryId;
+
+#define REGISTRY_ID_SLOT(id)  ((id) & 0xFF)
+
+template <typename T>
+class SlotRegistry
+{
+  // index keys 0 & UINT64_MAX mark empty & removed entries, so can't be used by callers
+  static const uint64_t kEmptyKey = 0;
+  static const uint64_t kRemovedKey = UINT64_MAX;
+
+  struct Slot {
+    std::atomic<T*> item{ nullptr };
+    std::atomic<RegistryId> id{ 0 };
+    uint32_t generation = 0;
+  };
+
+  struct IndexEntry {
+    std::atomic<uint64_t> key{ kEmptyKey };
+    std::atomic<RegistryId> id{ 0 };
+  };
+
+  Slot slots_[REGISTRY_SLOTS];
+  IndexEntry index_[REGISTRY_INDEX_SIZE];
+  std::atomic<size_t> count_{ 0 };
+  std::mutex write_mutex_; // writers only, readers never touch it
+  Epoch epoch_;
+
+  // Item in slot & its ID, or nullptr if it's empty
+  // id is checked on both sides of loading item, so the two can't come from different objects if the slot is reused
+  static T* loadSlot(Slot& slot, RegistryId& id)
+  {
+    id = slot.id.load();
+    T* item = slot.item.load();
+    if (!id || !item || slot.id.load() != id)
+      return nullptr;
+    return item;
+  }
+
+  static size_t indexHash(uint64_t key)
+  {
+    return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (REGISTRY_INDEX_SIZE - 1);
+  }
+
+  // Entry key is stored in, or -1 if it isn't, only called by writers
+  int findEntry(uint64_t key)
+  {
+    size_t pos = indexHash(key);
+    for (size_t i = 0; i < REGISTRY_INDEX_SIZE; i++, pos = (pos + 1) & (REGISTRY_INDEX_SIZE - 1))
+    {
+      uint64_t entry_key = index_[pos].key.load();
+      if (entry_key == key)
+        return (int)pos;
+      if (entry_key == kEmptyKey)
+        break;
+    }
+    return -1;
+  }
+
+  void removeEntry(size_t pos)
+  {
+    index_[pos].key = kRemovedKey;
+
+    // Removed entries can only go back to being empty once nothing past them could be part of a probe chain,
+    // otherwise a reader probing for a key further along would stop early & miss it
+    while (index_[(pos + 1) & (REGISTRY_INDEX_SIZE - 1)].key.load() == kEmptyKey &&
+      index_[pos].key.load() == kRemovedKey)
+    {
+      index_[pos].key = kEmptyKey;
+      pos = (pos - 1) & (REGISTRY_INDEX_SIZE - 1);
+    }
+  }
+
+public:
+  typedef Epoch::Guard Guard;
+
+  SlotRegistry() = default;
+  SlotRegistry(const SlotRegistry&) = delete;
+  SlotRegistry& operator=(const SlotRegistry&) = delete;
+
+  ~SlotRegistry()
+  {
+    for (auto& slot : slots_)
+      delete slot.item.load();
+  }
+
+  // Has to be kept alive while using anything got from Get/Find/ForEach, shouldn't be held for long as it holds up
+  // Remove (& must not be alive while the same thread calls Remove, that would wait on itself forever)
+  Guard Pin() { return epoch_.Enter(); }
+
+  // Registers item, returns its ID, or 0 if every slot is taken (item is freed)
+  RegistryId Add(std::unique_ptr<T> item)
+  {
+    std::lock_guard<std::mutex> guard(write_mutex_);
+    for (int i = 0; i < REGISTRY_SLOTS; i++)
+    {
+      auto& slot = slots_[i];
+      if (slot.item.load())
+        continue;
+
+      // generation 0 is skipped so that no ID is 0
+      slot.generation = (slot.generation + 1) & 0xFFFFFF;
+      if (!slot.generation)
+        slot.generation = 1;
+
+      RegistryId id = (slot.generation << 8) | i;
+      slot.id = id;
+      slot.item = item.release();
+      count_++;
+      return id;
+    }
+    return 0;
+  }
+
+  // Unregisters id & any keys set for it, then waits until no reader can still be using it
+  // Returns the item so the caller can finish cleaning it up, or nullptr if id isn't registered
+  std::unique_ptr<T> Remove(RegistryId id)
+  {
+    T* item = nullptr;
+    {
+      std::lock_guard<std::mutex> guard(write_mutex_);
+      auto& slot = slots_[REGISTRY_ID_SLOT(id) % REGISTRY_SLOTS];
+      if (!id || slot.id.load() != id || !slot.item.load())
+        return nullptr;
+
+      for (size_t i = 0; i < REGISTRY_INDEX_SIZE; i++)
+      {
+        uint64_t key = index_[i].key.load();
+        if (key != kEmptyKey && key != kRemovedKey && index_[i].id.load() == id)
+          removeEntry(i);
+      }
+
+      slot.id = 0;
+      item = slot.item.exchange(nullptr);
+      count_--;
+    }
+
+    epoch_.Synchronize();
+    return std::unique_ptr<T>(item);
+  }
+
+  // Item registered as id, or nullptr if it's been removed, registry must be pinned
+  T* Get(RegistryId id)
+  {
+    RegistryId slot_id;
+    T* item = loadSlot(slots_[REGISTRY_ID_SLOT(id) % REGISTRY_SLOTS], slot_id);
+    return slot_id == id ? item : nullptr;
+  }
+
+  // Makes key (anything but 0 & UINT64_MAX) find id, replacing whatever it found before
+  // Returns false if id isn't registered or the index is full
+  bool SetKey(uint64_t key, RegistryId id)
+  {
+    if (key == kEmptyKey || key == kRemovedKey)
+      return false;
+
+    std::lock_guard<std::mutex> guard(write_mutex_);
+    auto& slot = slots_[REGISTRY_ID_SLOT(id) % REGISTRY_SLOTS];
+    if (!id || slot.id.load() != id)
+      return false;
+
+    int existing = findEntry(key);
+    if (existing >= 0)
+    {
+      index_[existing].id = id;
+      return true;
+    }
+
+    size_t pos = indexHash(key);
+    for (size_t i = 0; i < REGISTRY_INDEX_SIZE; i++, pos = (pos + 1) & (REGISTRY_INDEX_SIZE - 1))
+    {
+      uint64_t entry_key = index_[pos].key.load();
+      if (entry_key == kEmptyKey || entry_key == kRemovedKey)
+      {
+        // id before key, so a reader that sees the key also sees its id
+        index_[pos].id = id;
+        index_[pos].key = key;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void RemoveKey(uint64_t key)
+  {
+    if (key == kEmptyKey || key == kRemovedKey)
+      return;
+
+    std::lock_guard<std::mutex> guard(write_mutex_);
+    int pos = findEntry(key);
+    if (pos >= 0)
+      removeEntry(pos);
+  }
+
+  // Item that key was set for, or nullptr if there isn't one, registry must be pinned
+  T* Find(uint64_t key)
+  {
+    if (key == kEmptyKey || key == kRemovedKey)
+      return nullptr;
+
+    size_t pos = indexHash(key);
+    for (size_t i = 0; i < REGISTRY_INDEX_SIZE; i++, pos = (pos + 1) & (REGISTRY_INDEX_SIZE - 1))
+    {
+      uint64_t entry_key = index_[pos].key.load();
+      if (entry_key == kEmptyKey)
+        break;
+      if (entry_key != key)
+        continue;
+
+      RegistryId id = index_[pos].id.load();
+
+      // entry could have been removed & reused for another key while we were reading it
+      if (index_[pos].key.load() != key)
+        break;
+
+      // id might be stale if its object was removed, Get makes sure it isn't
+      return Get(id);
+    }
+    return nullptr;
+  }
+
+  // Calls fn(RegistryId, T&) for every registered item, in slot order, registry must be pinned
+  // Items added or removed during the call may or may not be included
+  template <typename Fn>
+  void ForEach(Fn fn)
+  {
+    for (auto& slot : slots_)
+    {
+      RegistryId id;
+      T* item = loadSlot(slot, id);
+      if (item)
+        fn(id, *item);
+    }
+  }
+
+  size_t Count() { return count_.load(); }
+};
@@ -0,0 +1,89 @@
+#pragma once
+// Immutable, versioned snapshots of a value that's read far more often than it's changed (eg. a controllers UserSettings)
+// Readers never lock or allocate, they just pin the current snapshot for as long as their Reader is alive
+// Writers build a new snapshot, swap it in, then wait for any readers that might still see the old one before freeing it
+// Portable like XboxTranslator, nothing in here depends on Windows
+
+#include "Epoch.hpp"
+#include <mutex>
+
+template <typename T>
+class Snapshot
+{
+  struct Node {
+    T value;
+    uint64_t version;
+  };
+
+  std::atomic<Node*> current_;
+  Epoch epoch_;
+  std::mutex write_mutex_; // writers only, readers never touch it
+  uint64_t version_ = 0;
+
+  uint64_t replace(const T& value)
+  {
+    Node* node = new Node{ value, ++version_ };
+    Node* old = current_.exchange(node);
+    epoch_.Synchronize();
+    delete old;
+    return node->version;
+  }
+
+public:
+  class Reader
+  {
+    Epoch::Guard guard_;
+    const Node* node_;
+
+  public:
+    explicit Reader(Snapshot* snapshot) : guard_(snapshot->epoch_.Enter()), node_(snapshot->current_.load())
+    {
+    }
+
+    Reader(Reader&& other) : guard_(std::move(other.guard_)), node_(other.node_)
+    {
+    }
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    const T& operator*() const { return node_->value; }
+    const T* operator->() const { return &node_->value; }
+
+    // Changes every time a new snapshot is published, can be used to tell if a cached copy is out of date
+    uint64_t Version() const { return node_->version; }
+  };
+
+  Snapshot() : current_(new Node{ T(), 0 })
+  {
+  }
+
+  ~Snapshot()
+  {
+    delete current_.load();
+  }
+
+  Snapshot(const Snapshot&) = delete;
+  Snapshot& operator=(const Snapshot&) = delete;
+
+  // Pins the current snapshot, Reader shouldn't be kept around for longer than needed as it holds up writers
+  // (& must not be alive while the same thread calls Publish/Update, that would wait on itself forever)
+  Reader Read() { return Reader(this); }
+
+  // Replaces the snapshot with value, returns its version
+  uint64_t Publish(const T& value)
+  {
+    std::lock_guard<std::mutex> guard(write_mutex_);
+    return replace(value);
+  }
+
+  // Replaces the snapshot with a copy of the current one changed by fn(T&), returns its version
+  template <typename Fn>
+  uint64_t Update(Fn fn)
+  {
+    std::lock_guard<std::mutex> guard(write_mutex_);
+    T value = current_.load()->value;
+    fn(value);
+    return replace(value);
+  }
+};
@@ -0,0 +1,94 @@
+#pragma once
+// Ring of preallocated fire-and-forget submissions (eg. a ViGEm target's report submissions), cycled through in order
+// Once every slot is in flight the next submission waits for the oldest one first, so there's never more than
+// Depth() outstanding, & a slot is never reused while the driver could still be reading from it
+// Not thread-safe, callers serialize access (ViGEmClient.cpp holds the target's IoLock)
+// All zeroes is a valid empty ring with submissions turned off, so it can live in memset structs like VIGEM_TARGET
+// Portable like XboxTranslator, nothing in here depends on Windows
+
+#include <cstddef>
+#include <cstdint>
+
+template <typename Slot, size_t MaxDepth>
+class SubmitRing
+{
+  Slot slots_[MaxDepth];
+  bool pending_[MaxDepth]; // submitted & not waited for yet
+  size_t depth_;
+  size_t next_;
+  uint64_t full_waits_; // times Next had to wait for a slot that was still in flight
+
+public:
+  // Slot at index, for setting up/freeing whatever the slots own (eg. their OVERLAPPED events)
+  Slot& At(size_t index) { return slots_[index]; }
+
+  // Number of slots being cycled through, 0 if submissions aren't using the ring
+  size_t Depth() const { return depth_; }
+
+  // Number of slots in flight right now
+  size_t Pending() const
+  {
+    size_t pending = 0;
+    for (size_t i = 0; i < MaxDepth; i++)
+      pending += pending_[i] ? 1 : 0;
+    return pending;
+  }
+
+  uint64_t FullWaits() const { return full_waits_; }
+
+  // Waits for every slot in flight with wait(Slot&), which returns false if that submission failed
+  // Returns false if any of them did
+  template <typename WaitFn>
+  bool Drain(WaitFn wait)
+  {
+    bool ok = true;
+    for (size_t i = 0; i < MaxDepth; i++)
+    {
+      if (!pending_[i])
+        continue;
+      pending_[i] = false;
+      if (!wait(slots_[i]))
+        ok = false;
+    }
+    return ok;
+  }
+
+  // Drains the ring & then cycles through the first depth slots from now on, 0 turns the ring off
+  // Returns false (leaving it untouched) if depth is more than MaxDepth
+  template <typename WaitFn>
+  bool SetDepth(size_t depth, WaitFn wait)
+  {
+    if (depth > MaxDepth)
+      return false;
+
+    Drain(wait);
+    depth_ = depth;
+    next_ = 0;
+    return true;
+  }
+
+  // Slot for the next submission, Depth() must be more than 0
+  // If it's still in flight from Depth() submissions ago it's waited for first, failed is set if wait says that earlier
+  // submission failed (so the error can be returned by whichever call finds out about it)
+  template <typename WaitFn>
+  Slot& Next(WaitFn wait, bool& failed)
+  {
+    size_t index = next_;
+    next_ = (next_ + 1) % depth_;
+
+    failed = false;
+    if (pending_[index])
+    {
+      pending_[index] = false;
+      full_waits_++;
+      failed = !wait(slots_[index]);
+    }
+    return slots_[index];
+  }
+
+  // Marks slot (from Next) as in flight, only once its submission has actually been started
+  void Submitted(Slot& slot)
+  {
+    pending_[&slot - slots_] = true;
+  }
+};
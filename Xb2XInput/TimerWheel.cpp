@@ -0,0 +1,137 @@
+#include "TimerWheel.hpp"
+#include <chrono>
+
+uint64_t TimerWheel::Now()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TimerWheel::Schedule(uint64_t deadline_us, TimerCallback callback, void* context)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+
+  // Only Advance moves tick_, a timer goes in the slot for its own tick so a nearer one scheduled afterwards still runs first
+  // A deadline that's already passed goes in the current tick, the next Advance always looks at that
+  uint64_t tick = deadline_us / TIMER_WHEEL_TICK_US;
+  if (tick < tick_)
+    tick = tick_;
+
+  int slot = (int)(tick % TIMER_WHEEL_SLOTS);
+  Timer timer = { deadline_us, callback, context };
+  slots_[slot].push_back(timer);
+  occupied_[slot / 64] |= 1ull << (slot % 64);
+  count_++;
+}
+
+void TimerWheel::Cancel(void* context)
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+
+  for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++)
+  {
+    auto& timers = slots_[slot];
+    for (size_t i = 0; i < timers.size();)
+    {
+      if (timers[i].context != context)
+      {
+        i++;
+        continue;
+      }
+
+      timers[i] = timers.back();
+      timers.pop_back();
+      count_--;
+    }
+
+    if (timers.empty())
+      occupied_[slot / 64] &= ~(1ull << (slot % 64));
+  }
+}
+
+size_t TimerWheel::Advance(uint64_t now_us)
+{
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+
+    expired_.clear();
+    uint64_t now_tick = now_us / TIMER_WHEEL_TICK_US;
+    if (count_ && now_tick >= tick_)
+    {
+      // no point going round the wheel more than once
+      uint64_t first = tick_;
+      if (now_tick - first >= TIMER_WHEEL_SLOTS)
+        first = now_tick - TIMER_WHEEL_SLOTS + 1;
+
+      for (uint64_t tick = first; tick <= now_tick; tick++)
+      {
+        int slot = (int)(tick % TIMER_WHEEL_SLOTS);
+        if (!(occupied_[slot / 64] & (1ull << (slot % 64))))
+          continue;
+
+        // slot can also hold timers for later trips around the wheel, those are left alone
+        auto& timers = slots_[slot];
+        for (size_t i = 0; i < timers.size();)
+        {
+          if (timers[i].deadline_us > now_us)
+          {
+            i++;
+            continue;
+          }
+
+          expired_.push_back(timers[i]);
+          timers[i] = timers.back();
+          timers.pop_back();
+          count_--;
+        }
+
+        if (timers.empty())
+          occupied_[slot / 64] &= ~(1ull << (slot % 64));
+      }
+    }
+
+    // current tick isn't finished yet, may still have timers due later in it
+    if (now_tick > tick_)
+      tick_ = now_tick;
+  }
+
+  for (auto& timer : expired_)
+    timer.callback(timer.context, now_us);
+
+  return expired_.size();
+}
+
+uint64_t TimerWheel::NextDeadline()
+{
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (!count_)
+    return UINT64_MAX;
+
+  // find first slot with a timer due in it, starting from the current tick
+  // (slots can also hold timers for later trips around the wheel, earliest of those is used if nothing is due before then)
+  uint64_t later = UINT64_MAX;
+  for (uint64_t offset = 0; offset < TIMER_WHEEL_SLOTS; offset++)
+  {
+    uint64_t tick = tick_ + offset;
+    int slot = (int)(tick % TIMER_WHEEL_SLOTS);
+    uint64_t word = occupied_[slot / 64] >> (slot % 64);
+    if (!word)
+    {
+      offset += 63 - (slot % 64); // rest of this word is empty
+      continue;
+    }
+    if (!(word & 1))
+      continue;
+
+    uint64_t deadline = UINT64_MAX;
+    for (auto& timer : slots_[slot])
+      if (timer.deadline_us < deadline)
+        deadline = timer.deadline_us;
+
+    if (deadline < (tick + 1) * TIMER_WHEEL_TICK_US)
+      return deadline;
+    if (deadline < later)
+      later = deadline;
+  }
+
+  return later;
+}
@@ -0,0 +1,50 @@
+#pragma once
+// Hashed timer wheel, used to update controllers between input reports (turbo, macros) without any extra threads
+// Timers are bucketed by TIMER_WHEEL_TICK_US, so scheduling & expiring a timer is O(1) no matter how many are pending
+// Portable like XboxTranslator, nothing in here depends on Windows
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#define TIMER_WHEEL_SLOTS     256
+#define TIMER_WHEEL_TICK_US   1000
+
+typedef void (*TimerCallback)(void* context, uint64_t now_us);
+
+class TimerWheel
+{
+  struct Timer {
+    uint64_t deadline_us;
+    TimerCallback callback;
+    void* context;
+  };
+
+  std::mutex mutex_;
+  std::vector<Timer> slots_[TIMER_WHEEL_SLOTS];
+  uint64_t occupied_[TIMER_WHEEL_SLOTS / 64] = { 0 }; // bitmap of non-empty slots
+  uint64_t tick_ = 0; // oldest tick that might still have timers waiting
+  size_t count_ = 0;
+
+  std::vector<Timer> expired_;
+
+public:
+  // Current time in microseconds, same clock that deadlines should use
+  static uint64_t Now();
+
+  // Timers with deadlines that have already passed run on the next Advance
+  void Schedule(uint64_t deadline_us, TimerCallback callback, void* context);
+
+  // Removes every pending timer for context
+  void Cancel(void* context);
+
+  // Runs every timer with a deadline <= now_us, returns how many ran
+  // Callbacks are ran without the wheel locked, so they can schedule new timers
+  // Should only be called from a single thread (XboxController calls it from the USB update thread)
+  size_t Advance(uint64_t now_us);
+
+  // Earliest deadline of the pending timers, or UINT64_MAX if none are pending
+  uint64_t NextDeadline();
+
+  size_t Count() { return count_; }
+};
@@ -0,0 +1,1317 @@
+#include "TranslatorBenchmark.hpp"
+#include "XboxTranslator.hpp"
+#include "TimerWheel.hpp"
+#include "Snapshot.hpp"
+#include "RumbleShaper.hpp"
+#include "SerialAllocator.hpp"
+#include "ReportBatcher.hpp"
+#include "WarmPool.hpp"
+#include "DeviceScanner.hpp"
+#include "ParallelFor.hpp"
+#include "DescriptorCache.hpp"
+#include "SlotRegistry.hpp"
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <cfloat>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <deque>
+#include <functional>
+
+// Each stage is timed BENCHMARK_RUNS times & the fastest run is kept, runs loop over the capture for at least BENCHMARK_RUN_MS
+#define BENCHMARK_RUNS        5
+#define BENCHMARK_RUN_MS      20
+
+// Timer wheel CPU cost is measured over TIMER_BENCHMARK_COUNT timers spread over TIMER_BENCHMARK_SPREAD_US of virtual time,
+// lateness over TIMER_LATENESS_COUNT real timers (every ~2ms, like a 250Hz turbo)
+#define TIMER_BENCHMARK_COUNT     10000
+#define TIMER_BENCHMARK_SPREAD_US 1000000
+#define TIMER_LATENESS_COUNT      250
+
+// How long RunSnapshotBenchmark replays the capture for while settings are being changed
+#define SNAPSHOT_STRESS_MS        250
+
+// RunRumbleBenchmark floods a simulated controller with an update every RUMBLE_FLOOD_INTERVAL_US for RUMBLE_FLOOD_US,
+// each report takes RUMBLE_BUS_TRANSFER_US to get sent (a 1ms interrupt OUT transfer, stretched to make bursts pile up)
+#define RUMBLE_FLOOD_INTERVAL_US  100
+#define RUMBLE_FLOOD_US           2000000
+#define RUMBLE_BUS_TRANSFER_US    2000
+
+// RunAttachBenchmark plugs targets into a fake ViGEm bus that already has VIGEM_BENCHMARK_FOREIGN targets from another
+// client & VIGEM_BENCHMARK_OWNED of ours, then unplugs/replugs one of ours VIGEM_BENCHMARK_CYCLES times
+// Each plug attempt on the fake bus costs VIGEM_BENCHMARK_IOCTL_US, roughly what a real IOCTL_VIGEM_PLUGIN_TARGET round-trip takes
+#define VIGEM_BENCHMARK_FOREIGN   16
+#define VIGEM_BENCHMARK_OWNED     32
+#define VIGEM_BENCHMARK_CYCLES    200
+#define VIGEM_BENCHMARK_IOCTL_US  20
+#define VIGEM_BENCHMARK_SERIALS   65535
+
+// RunTargetPoolBenchmark attaches VIGEM_POOL_BENCHMARK_ATTACHES controllers, VIGEM_POOL_BENCHMARK_BURST at a time
+// Making a target costs VIGEM_POOL_BENCHMARK_CREATE_US (alloc, events, submit queue) plus starting its notification thread,
+// plugging it in VIGEM_BENCHMARK_IOCTL_US
+#define VIGEM_POOL_BENCHMARK_SIZE     2
+#define VIGEM_POOL_BENCHMARK_ATTACHES 200
+#define VIGEM_POOL_BENCHMARK_BURST    2
+#define VIGEM_POOL_BENCHMARK_CREATE_US 50
+
+// RunHotplugBenchmark plugs HOTPLUG_BENCHMARK_PLUGS devices into a simulated bus that already has HOTPLUG_BENCHMARK_DEVICES,
+// one every HOTPLUG_BENCHMARK_GAP_MS, with a thread scanning it the way USBCheckThread does
+// Checking a device (reading its descriptor & port numbers) costs HOTPLUG_BENCHMARK_CHECK_US, the poll interval is
+// scaled down from DEVICE_SCAN_POLL_MS to HOTPLUG_BENCHMARK_POLL_MS so the benchmark doesn't take minutes
+#define HOTPLUG_BENCHMARK_DEVICES   32
+#define HOTPLUG_BENCHMARK_PLUGS     20
+#define HOTPLUG_BENCHMARK_GAP_MS    13
+#define HOTPLUG_BENCHMARK_CHECK_US  10
+#define HOTPLUG_BENCHMARK_POLL_MS   100
+
+// RunBringUpBenchmark brings up simulated controllers one after another & in parallel (on up to BRINGUP_BENCHMARK_THREADS,
+// same as ATTACH_MAX_THREADS), controller i waits on USB for BRINGUP_BENCHMARK_MS + (i % 4) * BRINGUP_BENCHMARK_STEP_MS
+#define BRINGUP_BENCHMARK_THREADS   8
+#define BRINGUP_BENCHMARK_MS        10
+#define BRINGUP_BENCHMARK_STEP_MS   5
+
+// RunDescriptorCacheBenchmark starts up with DESCRIPTOR_BENCHMARK_PADS simulated slow third-party pads, each control transfer
+// they answer takes DESCRIPTOR_BENCHMARK_TRANSFER_MS, first with nothing cached & then with the cache written by the first run
+// The cache file is written to DESCRIPTOR_BENCHMARK_PATH in the working directory & removed afterwards
+#define DESCRIPTOR_BENCHMARK_PADS         4
+#define DESCRIPTOR_BENCHMARK_TRANSFER_MS  8
+#define DESCRIPTOR_BENCHMARK_PATH         "Xb2XInput-benchmark.cache"
+
+// RunPortIndexBenchmark checks every device on a simulated bus of PORT_INDEX_BENCHMARK_DEVICES against a full registry of
+// controllers (1 in every PORT_INDEX_BENCHMARK_DEVICES / REGISTRY_SLOTS devices), like OpenDevice does on each scan
+// Devices are spread over PORT_INDEX_BENCHMARK_BUSES buses, bus n being behind n - 1 tiers of hubs so paths go up to 6 ports deep
+#define PORT_INDEX_BENCHMARK_DEVICES  512
+#define PORT_INDEX_BENCHMARK_BUSES    4
+#define PORT_INDEX_BENCHMARK_PASSES   50
+
+// RunBatchBenchmark runs pads that each get a new report every BATCH_BENCHMARK_INTERVAL_US (an 8ms bInterval pad polled
+// at 4ms), spread evenly over the interval like real pads that were plugged in at different times, for BATCH_BENCHMARK_MS
+// Reports are batched every BATCH_BENCHMARK_TICK_US & each submit costs BATCH_BENCHMARK_SUBMIT_US, about what queueing
+// an overlapped ViGEm update takes
+#define BATCH_BENCHMARK_INTERVAL_US 4000
+#define BATCH_BENCHMARK_MS          250
+#define BATCH_BENCHMARK_TICK_US     1000
+#define BATCH_BENCHMARK_SUBMIT_US   5
+
+struct BenchmarkVariant {
+  const char* name;
+  bool remap;
+  bool deadzone;
+};
+
+static const BenchmarkVariant variants[] =
+{
+  { "remap_off-deadzone_zero", false, false },
+  { "remap_off-deadzone_set", false, true },
+  { "remap_on-deadzone_zero", true, false },
+  { "remap_on-deadzone_set", true, true },
+};
+
+// written to after each run so the compiler can't throw away the work being timed
+volatile uint32_t benchmark_sink;
+
+static UserSettings VariantSettings(const BenchmarkVariant& variant)
+{
+  UserSettings settings;
+  settings.guide_enabled = true;
+  settings.vibration_enabled = true;
+
+  if (variant.deadzone)
+  {
+    settings.deadzone.sThumbL = 4000;
+    settings.deadzone.sThumbR = 4000;
+    settings.deadzone.bLeftTrigger = 30;
+    settings.deadzone.bRightTrigger = 30;
+
+    // curves are part of the same shaping as deadzones, so they're only set in deadzone_set variants
+    ParseResponseCurve("exponential 2", settings.curves[CURVE_LEFT_STICK]);
+    ParseResponseCurve("0:0, 50:25, 80:70, 100:100", settings.curves[CURVE_RIGHT_STICK]);
+    ParseResponseCurve("scurve 2", settings.curves[CURVE_LEFT_TRIGGER]);
+    settings.curves[CURVE_RIGHT_TRIGGER].anti_deadzone = 40;
+  }
+
+  // same remappings as the example Xb2XInput.ini
+  settings.remap_enabled = variant.remap;
+  if (variant.remap)
+  {
+    settings.button_remap[XUSB_GAMEPAD_A] = XUSB_GAMEPAD_B | XUSB_GAMEPAD_START;
+    settings.button_remap[XUSB_GAMEPAD_B] = XUSB_GAMEPAD_A;
+    settings.button_remap[XUSB_GAMEPAD_X] = XUSB_GAMEPAD_Y;
+    settings.button_remap[XUSB_GAMEPAD_Y] = XUSB_GAMEPAD_X;
+    settings.button_remap[XUSB_GAMEPAD_START] = XUSB_GAMEPAD_BACK;
+    settings.button_remap[XUSB_GAMEPAD_BACK] = XUSB_GAMEPAD_START;
+    settings.button_remap[XUSB_GAMEPAD_LEFT_THUMB] = XUSB_GAMEPAD_RIGHT_THUMB;
+    settings.button_remap[XUSB_GAMEPAD_RIGHT_THUMB] = XUSB_GAMEPAD_LEFT_THUMB;
+    settings.button_remap[XUSB_GAMEPAD_LEFT_SHOULDER] = XUSB_GAMEPAD_RIGHT_SHOULDER;
+    settings.button_remap[XUSB_GAMEPAD_RIGHT_SHOULDER] = XUSB_GAMEPAD_LEFT_SHOULDER;
+    settings.button_remap[XUSB_GAMEPAD_DPAD_UP] = XUSB_GAMEPAD_DPAD_DOWN;
+    settings.button_remap[XUSB_GAMEPAD_DPAD_DOWN] = XUSB_GAMEPAD_DPAD_UP;
+    settings.button_remap[XUSB_GAMEPAD_DPAD_LEFT] = XUSB_GAMEPAD_DPAD_RIGHT;
+    settings.button_remap[XUSB_GAMEPAD_DPAD_RIGHT] = XUSB_GAMEPAD_DPAD_LEFT;
+
+    settings.turbo_buttons = XUSB_GAMEPAD_A | XUSB_GAMEPAD_X;
+    settings.turbo_rate = 10;
+  }
+
+  return settings;
+}
+
+// Runs stage over every report, starting from the gamepad state that the earlier stages left for that report
+// Returns fastest ns/report out of BENCHMARK_RUNS runs
+template <typename StageFn>
+static double TimeStage(const std::vector<XboxInputReport>& inputs, const std::vector<XUSB_REPORT>& before, StageFn stage)
+{
+  double best = DBL_MAX;
+  uint32_t checksum = 0;
+
+  for (int run = 0; run < BENCHMARK_RUNS; run++)
+  {
+    size_t count = 0;
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::steady_clock::duration::zero();
+    do
+    {
+      for (size_t i = 0; i < inputs.size(); i++)
+      {
+        XUSB_REPORT gamepad = before[i];
+        stage(inputs[i], gamepad);
+        checksum += gamepad.wButtons + gamepad.bLeftTrigger + gamepad.bRightTrigger + gamepad.sThumbLX + gamepad.sThumbRY;
+      }
+      count += inputs.size();
+      elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(BENCHMARK_RUN_MS));
+
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / count;
+    if (ns < best)
+      best = ns;
+  }
+
+  benchmark_sink = checksum;
+  return best;
+}
+
+std::vector<BenchmarkResult> RunTranslatorBenchmark(const CaptureReader& capture)
+{
+  std::vector<BenchmarkResult> results;
+
+  std::vector<XboxInputReport> inputs;
+  std::vector<uint64_t> timestamps;
+  for (auto& record : capture.Records())
+    if (record.type == CAPTURE_RECORD_INPUT && record.input.bSize == sizeof(XboxInputReport))
+    {
+      inputs.push_back(record.input);
+      timestamps.push_back(record.timestamp_us);
+    }
+
+  // stages that need the time can find it from the position of input in inputs
+  auto timestamp = [&inputs, &timestamps](const XboxInputReport& input) { return timestamps[&input - inputs.data()]; };
+
+  if (!inputs.size())
+    return results;
+
+  for (auto& variant : variants)
+  {
+    auto settings = VariantSettings(variant);
+
+    // Gamepad state before each stage, so stages can be timed without the cost of the ones before them
+    std::vector<XUSB_REPORT> before_buttons(inputs.size()), before_triggers(inputs.size()), before_remap(inputs.size()),
+      before_combos(inputs.size()), before_sticks(inputs.size()), before_curves(inputs.size()), before_output_combos(inputs.size()),
+      before_timed(inputs.size());
+    {
+      XboxTranslator translator;
+      translator.SetSettings(settings);
+      for (size_t i = 0; i < inputs.size(); i++)
+      {
+        XUSB_REPORT gamepad;
+        memset(&gamepad, 0, sizeof(gamepad));
+        before_buttons[i] = gamepad;
+        translator.ConvertButtons(inputs[i], gamepad);
+        before_triggers[i] = gamepad;
+        translator.ApplyTriggerDeadzones(inputs[i], gamepad);
+        before_remap[i] = gamepad;
+        translator.ApplyRemap(gamepad);
+        before_combos[i] = gamepad;
+        translator.CheckDeadzoneCombos(inputs[i]);
+        before_sticks[i] = gamepad;
+        translator.ApplyStickDeadzones(inputs[i], gamepad);
+        before_curves[i] = gamepad;
+        translator.ApplyResponseCurves(gamepad);
+        before_output_combos[i] = gamepad;
+        translator.ApplyOutputCombos(gamepad, timestamps[i]);
+        before_timed[i] = gamepad;
+      }
+    }
+
+    XboxTranslator translator;
+    auto add = [&](const char* stage, double ns)
+    {
+      BenchmarkResult result;
+      result.stage = stage;
+      result.variant = variant.name;
+      result.ns_per_report = ns;
+      results.push_back(result);
+    };
+
+    // cost of the benchmark loop itself, gets taken off every other stage
+    double overhead = TimeStage(inputs, before_buttons, [](const XboxInputReport&, XUSB_REPORT&) {});
+    add("overhead", overhead);
+
+    auto addStage = [&](const char* stage, double ns)
+    {
+      add(stage, ns > overhead ? ns - overhead : 0);
+    };
+
+    translator.SetSettings(settings);
+    addStage("buttons", TimeStage(inputs, before_buttons,
+      [&translator](const XboxInputReport& input, XUSB_REPORT& gamepad) { translator.ConvertButtons(input, gamepad); }));
+
+    translator.SetSettings(settings);
+    addStage("trigger_deadzone", TimeStage(inputs, before_triggers,
+      [&translator](const XboxInputReport& input, XUSB_REPORT& gamepad) { translator.ApplyTriggerDeadzones(input, gamepad); }));
+
+    translator.SetSettings(settings);
+    addStage("remap", TimeStage(inputs, before_remap,
+      [&translator](const XboxInputReport&, XUSB_REPORT& gamepad) { translator.ApplyRemap(gamepad); }));
+
+    translator.SetSettings(settings);
+    addStage("deadzone_combos", TimeStage(inputs, before_combos,
+      [&translator](const XboxInputReport& input, XUSB_REPORT&) { translator.CheckDeadzoneCombos(input); }));
+
+    translator.SetSettings(settings);
+    addStage("stick_deadzone", TimeStage(inputs, before_sticks,
+      [&translator](const XboxInputReport& input, XUSB_REPORT& gamepad) { translator.ApplyStickDeadzones(input, gamepad); }));
+
+    // old polar-coordinate version, to compare stick_deadzone against
+    addStage("stick_deadzone_reference", TimeStage(inputs, before_sticks,
+      [&settings](const XboxInputReport& input, XUSB_REPORT& gamepad)
+      {
+        XboxTranslator::deadZoneCalc(&gamepad.sThumbLX, &gamepad.sThumbLY, input.Gamepad.sThumbLX, input.Gamepad.sThumbLY, settings.deadzone.sThumbL, SHRT_MAX);
+        XboxTranslator::deadZoneCalc(&gamepad.sThumbRX, &gamepad.sThumbRY, input.Gamepad.sThumbRX, input.Gamepad.sThumbRY, settings.deadzone.sThumbR, SHRT_MAX);
+      }));
+
+    translator.SetSettings(settings);
+    addStage("response_curves", TimeStage(inputs, before_curves,
+      [&translator](const XboxInputReport&, XUSB_REPORT& gamepad) { translator.ApplyResponseCurves(gamepad); }));
+
+    translator.SetSettings(settings);
+    addStage("output_combos", TimeStage(inputs, before_output_combos,
+      [&](const XboxInputReport& input, XUSB_REPORT& gamepad) { translator.ApplyOutputCombos(gamepad, timestamp(input)); }));
+
+    translator.SetSettings(settings);
+    addStage("timed_output", TimeStage(inputs, before_timed,
+      [&](const XboxInputReport& input, XUSB_REPORT& gamepad) { translator.ApplyTimedOutput(gamepad, timestamp(input)); }));
+
+    translator.SetSettings(settings);
+    addStage("translate", TimeStage(inputs, before_buttons,
+      [&](const XboxInputReport& input, XUSB_REPORT& gamepad) { translator.Translate(input, &gamepad, timestamp(input)); }));
+  }
+
+  RunTimerBenchmark(results);
+  return results;
+}
+
+static void OnBenchmarkTimer(void* context, uint64_t now_us)
+{
+  // context is the timers deadline, lateness gets summed up in timer_lateness
+  uint64_t deadline = (uint64_t)(uintptr_t)context;
+  uint64_t late_ns = now_us > deadline ? (now_us - deadline) * 1000 : 0;
+  benchmark_sink += (uint32_t)late_ns;
+}
+
+void RunTimerBenchmark(std::vector<BenchmarkResult>& results)
+{
+  auto add = [&results](const char* stage, double ns)
+  {
+    BenchmarkResult result;
+    result.stage = stage;
+    result.variant = "wheel";
+    result.ns_per_report = ns;
+    results.push_back(result);
+  };
+
+  // CPU cost of scheduling & firing each timer, virtual time so this doesn't depend on the system timer
+  {
+    double best = DBL_MAX;
+    for (int run = 0; run < BENCHMARK_RUNS; run++)
+    {
+      TimerWheel wheel;
+      uint64_t base = TIMER_BENCHMARK_SPREAD_US;
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < TIMER_BENCHMARK_COUNT; i++)
+      {
+        uint64_t deadline = base + (uint64_t)i * 7919 % TIMER_BENCHMARK_SPREAD_US;
+        wheel.Schedule(deadline, OnBenchmarkTimer, (void*)(uintptr_t)deadline);
+      }
+      for (uint64_t now = base; wheel.Count(); now += TIMER_WHEEL_TICK_US)
+        wheel.Advance(now);
+      auto elapsed = std::chrono::steady_clock::now() - start;
+
+      double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / TIMER_BENCHMARK_COUNT;
+      if (ns < best)
+        best = ns;
+    }
+    add("timer_wheel", best);
+  }
+
+  // How late timers fire when waiting on them the same way the USB update thread does
+  {
+    TimerWheel wheel;
+    uint64_t total_ns = 0, max_ns = 0;
+    uint64_t deadline = TimerWheel::Now();
+    for (int i = 0; i < TIMER_LATENESS_COUNT; i++)
+    {
+      deadline += 1500 + (i % 4) * 250;
+      wheel.Schedule(deadline, OnBenchmarkTimer, (void*)(uintptr_t)deadline);
+
+      std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::microseconds(wheel.NextDeadline())));
+      uint64_t now;
+      while (!wheel.Advance(now = TimerWheel::Now()))
+        std::this_thread::yield();
+
+      uint64_t late_ns = (now - deadline) * 1000;
+      total_ns += late_ns;
+      if (late_ns > max_ns)
+        max_ns = late_ns;
+    }
+    add("timer_lateness_avg", (double)total_ns / TIMER_LATENESS_COUNT);
+    add("timer_lateness_max", (double)max_ns);
+  }
+}
+
+// Settings the stress writer publishes for step
+static void StressSettings(UserSettings& settings, int step)
+{
+  step %= 8000;
+  settings.deadzone.sThumbL = step;
+  settings.deadzone.sThumbR = step;
+  settings.guide_enabled = (step & 1) != 0;
+  settings.remap_enabled = (step & 1) != 0;
+  settings.turbo_rate = step % 100 + 1;
+}
+
+void RunSnapshotBenchmark(const CaptureReader& capture, std::vector<BenchmarkResult>& results)
+{
+  std::vector<XboxInputReport> inputs;
+  for (auto& record : capture.Records())
+    if (record.type == CAPTURE_RECORD_INPUT && record.input.bSize == sizeof(XboxInputReport))
+      inputs.push_back(record.input);
+
+  if (!inputs.size())
+    return;
+
+  auto add = [&results](const char* stage, double ns)
+  {
+    BenchmarkResult result;
+    result.stage = stage;
+    result.variant = "snapshot";
+    result.ns_per_report = ns;
+    results.push_back(result);
+  };
+
+  Snapshot<UserSettings> settings;
+  settings.Update([](UserSettings& value) { StressSettings(value, 0); });
+
+  // cost of pinning the settings when nothing else is touching them
+  {
+    uint64_t version = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < inputs.size() * 16; i++)
+      version += settings.Read().Version();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    benchmark_sink = (uint32_t)version;
+    add("settings_read", (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / (inputs.size() * 16));
+  }
+
+  // Replay the capture the same way XboxController::processInput does, while another thread toggles settings as fast as it can
+  std::atomic<bool> stop{ false };
+  std::atomic<int> writes{ 0 };
+  std::thread writer([&]()
+  {
+    for (int step = 1; !stop; step++)
+    {
+      settings.Update([step](UserSettings& value) { StressSettings(value, step); });
+      writes++;
+    }
+  });
+
+  XboxTranslator translator;
+  uint64_t translator_version = 0;
+  size_t count = 0;
+  XUSB_REPORT gamepad;
+  auto start = std::chrono::steady_clock::now();
+  auto elapsed = std::chrono::steady_clock::duration::zero();
+  do
+  {
+    for (auto& input : inputs)
+    {
+      {
+        auto current = settings.Read();
+        if (current.Version() != translator_version)
+        {
+          translator.SetSettings(*current);
+          translator_version = current.Version();
+        }
+      }
+
+      translator.Translate(input, &gamepad);
+    }
+    count += inputs.size();
+    elapsed = std::chrono::steady_clock::now() - start;
+  } while (elapsed < std::chrono::milliseconds(SNAPSHOT_STRESS_MS));
+
+  stop = true;
+  writer.join();
+
+  double elapsed_ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+  add("settings_stress", elapsed_ns / count);
+  add("settings_stress_write", writes ? elapsed_ns / writes : 0);
+}
+
+// Fake ViGEm bus, plugging in a serial that's already taken fails like the real one does
+struct FakeVigemBus {
+  std::vector<bool> plugged = std::vector<bool>(VIGEM_BENCHMARK_SERIALS + 1);
+  uint64_t ioctls = 0;
+
+  bool Plug(uint32_t serial)
+  {
+    ioctls++;
+    auto start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < std::chrono::microseconds(VIGEM_BENCHMARK_IOCTL_US))
+      ;
+
+    if (plugged[serial])
+      return false;
+    plugged[serial] = true;
+    return true;
+  }
+};
+
+void RunAttachBenchmark(std::vector<BenchmarkResult>& results)
+{
+  auto add = [&results](const char* stage, const char* variant, double ns)
+  {
+    BenchmarkResult result;
+    result.stage = stage;
+    result.variant = variant;
+    result.ns_per_report = ns;
+    results.push_back(result);
+  };
+
+  for (int allocated = 0; allocated < 2; allocated++)
+  {
+    FakeVigemBus bus;
+    SerialAllocator allocator(VIGEM_BENCHMARK_SERIALS);
+
+    // how vigem_target_add found a serial before SerialAllocator, probing from 1 every time
+    auto plugLinear = [&bus]()
+    {
+      for (uint32_t serial = 1; serial <= VIGEM_BENCHMARK_SERIALS; serial++)
+        if (bus.Plug(serial))
+          return serial;
+      return 0u;
+    };
+
+    auto plug = [&]()
+    {
+      return allocated ? allocator.Allocate([&bus](uint32_t serial) { return bus.Plug(serial); }) : plugLinear();
+    };
+
+    // another client (eg. DS4Windows) got to the bus first & took the lowest serials
+    for (uint32_t serial = 1; serial <= VIGEM_BENCHMARK_FOREIGN; serial++)
+      bus.plugged[serial] = true;
+
+    std::vector<uint32_t> owned;
+    for (int i = 0; i < VIGEM_BENCHMARK_OWNED; i++)
+      owned.push_back(plug());
+
+    // controllers reconnecting, each unplug/replug picks a different one of ours
+    uint64_t ioctls_before = bus.ioctls;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < VIGEM_BENCHMARK_CYCLES; i++)
+    {
+      auto& serial = owned[(i * 7) % owned.size()];
+      bus.plugged[serial] = false;
+      allocator.Release(serial);
+      serial = plug();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    const char* variant = allocated ? "allocator" : "linear";
+    add("vigem_attach", variant, (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / VIGEM_BENCHMARK_CYCLES);
+
+    // plug IOCTLs per attach, x1000 so it reads as a whole number in the ns field
+    add("vigem_attach_ioctls", variant, (double)(bus.ioctls - ioctls_before) * 1000 / VIGEM_BENCHMARK_CYCLES);
+  }
+}
+
+static void BenchmarkSpin(uint64_t us)
+{
+  auto start = std::chrono::steady_clock::now();
+  while (std::chrono::steady_clock::now() - start < std::chrono::microseconds(us))
+    ;
+}
+
+// Fake ViGEm target for RunTargetPoolBenchmark, with a notification thread that waits for it to be plugged in like the real one
+struct FakePoolTarget {
+  std::mutex mutex;
+  std::condition_variable changed;
+  bool plugged = false;
+  bool closing = false;
+  std::thread notification;
+
+  FakePoolTarget()
+  {
+    BenchmarkSpin(VIGEM_POOL_BENCHMARK_CREATE_US);
+    notification = std::thread([this]()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [this]() { return plugged || closing; });
+    });
+  }
+
+  ~FakePoolTarget()
+  {
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      closing = true;
+    }
+    changed.notify_all();
+    notification.join();
+  }
+
+  void Plug()
+  {
+    BenchmarkSpin(VIGEM_BENCHMARK_IOCTL_US);
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      plugged = true;
+    }
+    changed.notify_all();
+  }
+};
+
+void RunTargetPoolBenchmark(std::vector<BenchmarkResult>& results)
+{
+  auto add = [&results](const char* stage, const std::string& variant, double ns)
+  {
+    BenchmarkResult result;
+    result.stage = stage;
+    result.variant = variant;
+    result.ns_per_report = ns;
+    results.push_back(result);
+  };
+
+  for (int pooled = 0; pooled < 2; pooled++)
+  {
+    WarmPool<FakePoolTarget*> pool;
+    if (pooled)
+      pool.Start(VIGEM_POOL_BENCHMARK_SIZE, []() { return new FakePoolTarget(); }, [](FakePoolTarget* target) { delete target; });
+
+    // time spent on the update thread getting each controller a target, the way XboxController::attachTarget does
+    std::vector<FakePoolTarget*> attached;
+    uint64_t total_ns = 0, max_ns = 0;
+    for (int i = 0; i < VIGEM_POOL_BENCHMARK_ATTACHES; i++)
+    {
+      // pads get plugged in a few at a time, with the pool given a chance to refill in between
+      if (pooled && !(i % VIGEM_POOL_BENCHMARK_BURST))
+        while (pool.Ready() < VIGEM_POOL_BENCHMARK_SIZE)
+          std::this_thread::yield();
+
+      // plugging in costs the same either way, so only getting the target ready is timed
+      auto start = std::chrono::steady_clock::now();
+      auto target = pooled ? pool.Take() : nullptr;
+      if (!target)
+        target = new FakePoolTarget();
+      uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+      target->Plug();
+
+      total_ns += ns;
+      if (ns > max_ns)
+        max_ns = ns;
+      attached.push_back(target);
+    }
+
+    for (auto target : attached)
+      delete target;
+    pool.Stop();
+
+    const char* variant = pooled ? "pooled" : "cold";
+    add("vigem_attach_prepared_avg", variant, (double)total_ns / VIGEM_POOL_BENCHMARK_ATTACHES);
+    add("vigem_attach_prepared_max", variant, (double)max_ns);
+
+    // share of attaches that found the pool empty, x1000
+    auto stats = pool.Stats();
+    add("vigem_attach_pool_misses", variant, pooled ? (double)stats.missed * 1000 / VIGEM_POOL_BENCHMARK_ATTACHES : 1000);
+  }
+}
+
+// Simulated USB bus for RunHotplugBenchmark, devices are just IDs
+struct FakeUsbBus {
+  std::mutex mutex;
+  std::vector<uint64_t> devices;
+  uint64_t next_id = 1;
+
+  std::vector<uint64_t> List()
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    return devices;
+  }
+
+  uint64_t Plug()
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    devices.push_back(next_id);
+    return next_id++;
+  }
+};
+
+void RunHotplugBenchmark(std::vector<BenchmarkResult>& results)
+{
+  auto add = [&results](const char* stage, const char* variant, double ns)
+  {
+    BenchmarkResult result;
+    result.stage = stage;
+    result.variant = variant;
+    result.ns_per_report = ns;
+    results.push_back(result);
+  };
+
+  typedef std::chrono::steady_clock::time_point TimePoint;
+
+  // CPU cost of one scan pass over a bus that hasn't changed, checking every device (like OpenDevice used to) vs. diffing
+  for (int diffing = 0; diffing < 2; diffing++)
+  {
+    FakeUsbBus bus;
+    for (int i = 0; i < HOTPLUG_BENCHMARK_DEVICES; i++)
+      bus.Plug();
+
+    DeviceScanner<uint64_t> scanner;
+    const int passes = 200;
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; pass++)
+    {
+      if (!diffing)
+        scanner.Reset();
+      scanner.Scan(bus.List(), [](uint64_t) { BenchmarkSpin(HOTPLUG_BENCHMARK_CHECK_US); return true; });
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    add("device_scan", diffing ? "diff" : "full", (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / passes);
+  }
+
+  // Time from a device being plugged in until the scan thread has checked it, woken by hotplug events or only polling
+  for (int hotplug = 0; hotplug < 2; hotplug++)
+  {
+    FakeUsbBus bus;
+    for (int i = 0; i < HOTPLUG_BENCHMARK_DEVICES; i++)
+      bus.Plug();
+
+    DeviceScanner<uint64_t> scanner;
+    std::mutex times_mutex;
+    std::vector<TimePoint> plugged(HOTPLUG_BENCHMARK_DEVICES + HOTPLUG_BENCHMARK_PLUGS + 1);
+    std::vector<TimePoint> attached(plugged.size());
+    std::atomic<bool> stopping{ false };
+
+    std::thread scan_thread([&]()
+    {
+      while (!stopping)
+      {
+        scanner.Scan(bus.List(), [&](uint64_t device)
+        {
+          BenchmarkSpin(HOTPLUG_BENCHMARK_CHECK_US);
+          std::lock_guard<std::mutex> guard(times_mutex);
+          attached[device] = std::chrono::steady_clock::now();
+          return true;
+        });
+        scanner.Wait(HOTPLUG_BENCHMARK_POLL_MS);
+      }
+    });
+
+    // let it pick up everything that was already plugged in first
+    std::this_thread::sleep_for(std::chrono::milliseconds(HOTPLUG_BENCHMARK_POLL_MS / 2));
+
+    std::vector<uint64_t> plugs;
+    for (int i = 0; i < HOTPLUG_BENCHMARK_PLUGS; i++)
+    {
+      std::this_thread::sleep_for(std::chrono::milliseconds(HOTPLUG_BENCHMARK_GAP_MS));
+      {
+        std::lock_guard<std::mutex> guard(times_mutex);
+        plugged[bus.next_id] = std::chrono::steady_clock::now();
+      }
+      plugs.push_back(bus.Plug());
+      if (hotplug)
+        scanner.Wake();
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(HOTPLUG_BENCHMARK_POLL_MS * 2));
+    stopping = true;
+    scanner.Wake();
+    scan_thread.join();
+
+    uint64_t total_ns = 0, max_ns = 0;
+    for (auto device : plugs)
+    {
+      // never attached counts as the whole time the benchmark waited
+      auto end = attached[device] == TimePoint() ? std::chrono::steady_clock::now() : attached[device];
+      uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(end - plugged[device]).count();
+      total_ns += ns;
+      if (ns > max_ns)
+        max_ns = ns;
+    }
+
+    const char* variant = hotplug ? "hotplug" : "poll";
+    add("device_attach_latency_avg", variant, (double)total_ns / HOTPLUG_BENCHMARK_PLUGS);
+    add("device_attach_latency_max", variant, (double)max_ns);
+  }
+}
+
+void RunBringUpBenchmark(std::vector<BenchmarkResult>& results)
+{
+  auto add = [&results](const char* stage, const std::string& variant, double ns)
+  {
+    BenchmarkResult result;
+    result.stage = stage;
+    result.variant = variant;
+    result.ns_per_report = ns;
+    results.push_back(result);
+  };
+
+  // open/claim/descriptors are blocking control transfers, so a controller being brought up is mostly just waiting
+  auto bringUp = [](size_t i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(BRINGUP_BENCHMARK_MS + (i % 4) * BRINGUP_BENCHMARK_STEP_MS));
+  };
+
+  static const int pad_counts[] = { 1, 4, 8, 16 };
+  for (int pads : pad_counts)
+  {
+    std::string count = std::to_string(pads) + "_pads";
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < pads; i++)
+      bringUp(i);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    add("device_bringup", "serial-" + count, (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+
+    start = std::chrono::steady_clock::now();
+    ParallelFor(pads, BRINGUP_BENCHMARK_THREADS, bringUp);
+    elapsed = std::chrono::steady_clock::now() - start;
+    add("device_bringup", "parallel-" + count, (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  }
+}
+
+void RunDescriptorCacheBenchmark(std::vector<BenchmarkResult>& results)
+{
+  auto add = [&results](const char* stage, const std::string& variant, double ns)
+  {
+    BenchmarkResult result;
+    result.stage = stage;
+    result.variant = variant;
+    result.ns_per_report = ns;
+    results.push_back(result);
+  };
+
+  // what each pad would answer, same model on different ports
+  std::vector<CachedDescriptor> pads(DESCRIPTOR_BENCHMARK_PADS);
+  std::vector<std::string> keys(DESCRIPTOR_BENCHMARK_PADS);
+  for (int i = 0; i < DESCRIPTOR_BENCHMARK_PADS; i++)
+  {
+    auto& pad = pads[i];
+    pad.bcd_device = 0x0100;
+    pad.num_configurations = 1;
+    pad.product_index = 2;
+    pad.vendor_index = 1;
+    pad.serial_index = 3;
+    pad.endpoint_in = 0x81;
+    pad.endpoint_out = 0x02;
+    pad.langid = 0x0409;
+    pad.product = "Controller S";
+    pad.vendor = "Third Party Co."; // spaces have to survive being written out
+    keys[i] = DescriptorCache::Key(0x045E, 0x0289, 0x8000000000000000ull | (1ull << 48) | (uint64_t)(i + 1));
+  }
+
+  auto transfer = []()
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(DESCRIPTOR_BENCHMARK_TRANSFER_MS));
+  };
+
+  auto elapsedNs = [](std::chrono::steady_clock::time_point start)
+  {
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  };
+
+  std::remove(DESCRIPTOR_BENCHMARK_PATH);
+
+  std::string count = std::to_string(DESCRIPTOR_BENCHMARK_PADS) + "_pads";
+
+  // Nothing cached: config descriptor before input can start, then language ID & 3 strings before the pad has a name
+  {
+    DescriptorCache cache;
+    cache.Load(DESCRIPTOR_BENCHMARK_PATH);
+
+    double input_ns = 0, named_ns = 0;
+    for (int i = 0; i < DESCRIPTOR_BENCHMARK_PADS; i++)
+    {
+      auto start = std::chrono::steady_clock::now();
+      CachedDescriptor cached;
+      cache.Find(keys[i], pads[i], cached);
+      transfer();
+      input_ns += elapsedNs(start);
+
+      for (int j = 0; j < 4; j++)
+        transfer();
+      cache.Store(keys[i], pads[i]);
+      named_ns += elapsedNs(start);
+    }
+
+    cache.Save();
+
+    add("descriptor_startup_input", count + "-probe", input_ns);
+    add("descriptor_startup_named", count + "-probe", named_ns);
+  }
+
+  // Cached: input & names straight away, only the serial no. gets read again
+  {
+    DescriptorCache cache;
+    auto start = std::chrono::steady_clock::now();
+    cache.Load(DESCRIPTOR_BENCHMARK_PATH);
+    add("descriptor_cache_load", count, elapsedNs(start));
+
+    double named_ns = 0, checked_ns = 0;
+    for (int i = 0; i < DESCRIPTOR_BENCHMARK_PADS; i++)
+    {
+      start = std::chrono::steady_clock::now();
+      CachedDescriptor cached;
+      cache.Find(keys[i], pads[i], cached);
+      named_ns += elapsedNs(start);
+
+      transfer();
+      cache.Store(keys[i], cached);
+      checked_ns += elapsedNs(start);
+    }
+
+    add("descriptor_startup_input", count + "-cached", named_ns);
+    add("descriptor_startup_named", count + "-cached", named_ns);
+    add("descriptor_startup_serial_checked", count + "-cached", checked_ns);
+  }
+
+  std::remove(DESCRIPTOR_BENCHMARK_PATH);
+}
+
+// Simulated USB device/controller for RunPortIndexBenchmark, just where it's plugged in
+struct FakePortDevice {
+  uint8_t bus;
+  std::vector<uint8_t> ports;
+};
+
+void RunPortIndexBenchmark(std::vector<BenchmarkResult>& results)
+{
+  auto add = [&results](const char* stage, const std::string& variant, double ns)
+  {
+    BenchmarkResult result;
+    result.stage = stage;
+    result.variant = variant;
+    result.ns_per_report = ns;
+    results.push_back(result);
+  };
+
+  // every device gets its own path: hubs for its bus, then its number on that bus as base-7 digits (ports 1-7)
+  std::vector<FakePortDevice> devices(PORT_INDEX_BENCHMARK_DEVICES);
+  for (int i = 0; i < PORT_INDEX_BENCHMARK_DEVICES; i++)
+  {
+    auto& device = devices[i];
+    device.bus = (uint8_t)(1 + i % PORT_INDEX_BENCHMARK_BUSES);
+    device.ports.assign(device.bus - 1, 1);
+    int number = i / PORT_INDEX_BENCHMARK_BUSES;
+    do
+    {
+      device.ports.push_back((uint8_t)(1 + number % 7));
+      number /= 7;
+    } while (number);
+  }
+
+  SlotRegistry<FakePortDevice> controllers;
+  const int spacing = PORT_INDEX_BENCHMARK_DEVICES / REGISTRY_SLOTS;
+  for (int i = 0; i < PORT_INDEX_BENCHMARK_DEVICES; i += spacing)
+  {
+    auto& device = devices[i];
+    auto id = controllers.Add(std::unique_ptr<FakePortDevice>(new FakePortDevice(device)));
+    controllers.SetKey(UsbPortKey(device.bus, device.ports.data(), (int)device.ports.size()), id);
+  }
+
+  // how OpenDevice used to check, comparing every controller's port path
+  auto scanned = [&controllers](const FakePortDevice& device)
+  {
+    bool exists = false;
+    auto pin = controllers.Pin();
+    controllers.ForEach([&](RegistryId, FakePortDevice& controller)
+    {
+      if (controller.bus == device.bus && controller.ports == device.ports)
+        exists = true;
+    });
+    return exists;
+  };
+
+  // how OpenDevice checks now (UsbPortInUse), through the port path index
+  auto indexed = [&controllers](const FakePortDevice& device)
+  {
+    auto pin = controllers.Pin();
+    return UsbPortInUse(controllers, device.bus, device.ports.data(), (int)device.ports.size(),
+      [](FakePortDevice& controller) -> const std::vector<uint8_t>& { return controller.ports; });
+  };
+
+  std::string count = std::to_string(PORT_INDEX_BENCHMARK_DEVICES) + "_devices";
+  auto timePass = [&](const char* variant, const std::function<bool(const FakePortDevice&)>& exists)
+  {
+    size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < PORT_INDEX_BENCHMARK_PASSES; pass++)
+      for (auto& device : devices)
+        found += exists(device);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    benchmark_sink = (uint32_t)found;
+
+    add("port_index_pass", count + "-" + variant,
+      (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / PORT_INDEX_BENCHMARK_PASSES);
+  };
+  timePass("scan", scanned);
+  timePass("indexed", indexed);
+}
+
+// Fake virtual controller for RunBatchBenchmark, remembers the last report it was sent
+struct FakeBatchTarget {
+  std::atomic<uint32_t> received{ 0 };
+  std::atomic<uint16_t> last{ 0 };
+};
+
+static void FakeBatchSubmit(void* target, const XUSB_REPORT& report)
+{
+  BenchmarkSpin(BATCH_BENCHMARK_SUBMIT_US);
+
+  auto* fake = (FakeBatchTarget*)target;
+  fake->last = report.wButtons;
+  fake->received++;
+}
+
+void RunBatchBenchmark(std::vector<BenchmarkResult>& results)
+{
+  auto add = [&results](const char* stage, const std::string& variant, double ns)
+  {
+    BenchmarkResult result;
+    result.stage = stage;
+    result.variant = variant;
+    result.ns_per_report = ns;
+    results.push_back(result);
+  };
+
+  static const int pad_counts[] = { 4, 16, BATCH_MAX_TARGETS };
+  for (int pads : pad_counts)
+  {
+    std::vector<FakeBatchTarget> targets(pads);
+    ReportBatcher batcher;
+    batcher.Start(BATCH_BENCHMARK_TICK_US, FakeBatchSubmit);
+
+    // without batching each report would be sent the moment it's posted, so a frame's spread is first to last post
+    uint64_t direct_spread_total_us = 0, direct_spread_max_us = 0, frames = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    auto elapsedUs = [&start]()
+    {
+      return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    for (uint64_t frame = 0; frame * BATCH_BENCHMARK_INTERVAL_US < BATCH_BENCHMARK_MS * 1000ull; frame++)
+    {
+      uint64_t first_us = 0, last_us = 0;
+      for (int pad = 0; pad < pads; pad++)
+      {
+        uint64_t post_us = frame * BATCH_BENCHMARK_INTERVAL_US + (uint64_t)pad * BATCH_BENCHMARK_INTERVAL_US / pads;
+        while (elapsedUs() < post_us)
+          ;
+
+        XUSB_REPORT report = { 0 };
+        report.wButtons = (USHORT)(frame + 1);
+        uint64_t now_us = elapsedUs();
+        batcher.Post(pad, &targets[pad], report);
+
+        if (!pad)
+          first_us = now_us;
+        last_us = now_us;
+      }
+
+      uint64_t spread = last_us - first_us;
+      direct_spread_total_us += spread;
+      if (spread > direct_spread_max_us)
+        direct_spread_max_us = spread;
+      frames++;
+    }
+
+    batcher.Stop();
+    auto stats = batcher.Stats();
+
+    std::string count = std::to_string(pads) + "_pads";
+    add("batch_spread_avg", count + "-direct", frames ? (double)direct_spread_total_us * 1000 / frames : 0);
+    add("batch_spread_max", count + "-direct", (double)direct_spread_max_us * 1000);
+    add("batch_spread_avg", count + "-batched", stats.ticks ? (double)stats.spread_total_us * 1000 / stats.ticks : 0);
+    add("batch_spread_max", count + "-batched", (double)stats.spread_max_us * 1000);
+
+    // how long after each tick boundary the submitter got going
+    add("batch_tick_late_avg", count + "-batched", stats.ticks ? (double)stats.late_total_us * 1000 / stats.ticks : 0);
+  }
+}
+
+// Motor speeds a flooding game sends for update i, changes every few updates with duplicates in between
+static void FloodRumble(uint64_t i, uint8_t& large_motor, uint8_t& small_motor)
+{
+  large_motor = (uint8_t)((i / 7) * 37);
+  small_motor = (i / 13) & 1 ? 255 : 0;
+  if ((i / 2000) & 1)
+    large_motor = small_motor = 0; // stretches of nothing but duplicates
+}
+
+void RunRumbleBenchmark(std::vector<BenchmarkResult>& results)
+{
+  auto add = [&results](const char* stage, double ns)
+  {
+    BenchmarkResult result;
+    result.stage = stage;
+    result.variant = "flood";
+    result.ns_per_report = ns;
+    results.push_back(result);
+  };
+
+  const uint64_t count = RUMBLE_FLOOD_US / RUMBLE_FLOOD_INTERVAL_US;
+
+  // CPU cost of pushing each update & taking whatever's due
+  {
+    double best = DBL_MAX;
+    for (int run = 0; run < BENCHMARK_RUNS; run++)
+    {
+      RumbleShaper shaper;
+      uint8_t large_motor, small_motor;
+      auto start = std::chrono::steady_clock::now();
+      for (uint64_t i = 0; i < count; i++)
+      {
+        FloodRumble(i, large_motor, small_motor);
+        shaper.Push(large_motor, small_motor);
+        shaper.Take(i * RUMBLE_FLOOD_INTERVAL_US, large_motor, small_motor);
+      }
+      auto elapsed = std::chrono::steady_clock::now() - start;
+      benchmark_sink = (uint32_t)shaper.Stats().sent;
+
+      double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / count;
+      if (ns < best)
+        best = ns;
+    }
+    add("rumble_shaper", best);
+  }
+
+  // Simulated bus in virtual time, driven the same way XboxController drives its rumble transfer:
+  // one transfer in-flight at most, the next is taken when it completes, or when the shaper's timer is due
+  // Latency of an update is how long until the controller has that update (or a newer one) applied
+  struct Waiting {
+    uint64_t index;
+    uint64_t time_us;
+  };
+  std::deque<Waiting> waiting;
+
+  RumbleShaper shaper;
+  bool in_flight = false;
+  uint64_t in_flight_index = 0, in_flight_done_us = 0;
+  uint8_t in_flight_large = 0, in_flight_small = 0;
+  uint8_t controller_large = 0, controller_small = 0;
+  uint8_t newest_large = 0, newest_small = 0;
+  uint64_t newest_index = 0;
+  uint64_t total_latency_us = 0, max_latency_us = 0, latency_count = 0;
+
+  auto satisfy = [&](uint64_t index, uint64_t now_us)
+  {
+    while (waiting.size() && waiting.front().index <= index)
+    {
+      uint64_t latency = now_us - waiting.front().time_us;
+      total_latency_us += latency;
+      latency_count++;
+      if (latency > max_latency_us)
+        max_latency_us = latency;
+      waiting.pop_front();
+    }
+  };
+
+  auto submit = [&](uint64_t now_us)
+  {
+    if (in_flight || !shaper.Take(now_us, in_flight_large, in_flight_small))
+      return;
+
+    in_flight = true;
+    in_flight_index = newest_index;
+    in_flight_done_us = now_us + RUMBLE_BUS_TRANSFER_US;
+  };
+
+  uint64_t next_update = 0;
+  uint64_t now = 0;
+  while (next_update < count || in_flight || shaper.Pending())
+  {
+    // next thing to happen: an update from the game, the transfer completing, or the shaper allowing the next send
+    uint64_t update_us = next_update < count ? next_update * RUMBLE_FLOOD_INTERVAL_US : UINT64_MAX;
+    uint64_t done_us = in_flight ? in_flight_done_us : UINT64_MAX;
+    uint64_t timer_us = !in_flight && shaper.Pending() ? shaper.NextSendTime() : UINT64_MAX;
+    now = update_us;
+    if (done_us < now)
+      now = done_us;
+    if (timer_us < now)
+      now = timer_us;
+
+    if (now == done_us)
+    {
+      in_flight = false;
+      controller_large = in_flight_large;
+      controller_small = in_flight_small;
+
+      // once nothing's pending & the controller matches the newest update, everything sent so far is applied
+      if (!shaper.Pending() && controller_large == newest_large && controller_small == newest_small)
+        satisfy(newest_index, now);
+      else
+        satisfy(in_flight_index, now);
+    }
+
+    if (now == update_us)
+    {
+      FloodRumble(next_update, newest_large, newest_small);
+      newest_index = next_update++;
+      waiting.push_back({ newest_index, now });
+
+      // dropped as a duplicate of what the controller already has, nothing to wait for
+      if (!shaper.Push(newest_large, newest_small) && !shaper.Pending() && !in_flight &&
+        controller_large == newest_large && controller_small == newest_small)
+        satisfy(newest_index, now);
+    }
+
+    submit(now);
+  }
+
+  auto& stats = shaper.Stats();
+
+  add("rumble_latency_avg", latency_count ? (double)total_latency_us * 1000 / latency_count : 0);
+  add("rumble_latency_max", (double)max_latency_us * 1000);
+
+  // bus time used per update received, shows how much of the flood got merged away
+  add("rumble_bus_time", stats.received ? (double)stats.sent * RUMBLE_BUS_TRANSFER_US * 1000 / stats.received : 0);
+}
+
+void RunComponentBenchmarks(const CaptureReader& capture, std::vector<BenchmarkResult>& results)
+{
+  RunSnapshotBenchmark(capture, results);
+  RunAttachBenchmark(results);
+  RunTargetPoolBenchmark(results);
+  RunHotplugBenchmark(results);
+  RunBringUpBenchmark(results);
+  RunRumbleBenchmark(results);
+  RunBatchBenchmark(results);
+  RunDescriptorCacheBenchmark(results);
+  RunPortIndexBenchmark(results);
+}
+
+// Finds "key": in line & returns position of the value after it, or std::string::npos
+static size_t FindJsonValue(const std::string& line, const char* key)
+{
+  auto pos = line.find("\"" + std::string(key) + "\":");
+  if (pos == std::string::npos)
+    return pos;
+
+  pos += strlen(key) + 3;
+  while (pos < line.length() && line[pos] == ' ')
+    pos++;
+  return pos;
+}
+
+static bool ReadJsonString(const std::string& line, const char* key, std::string& value)
+{
+  auto pos = FindJsonValue(line, key);
+  if (pos == std::string::npos || pos >= line.length() || line[pos] != '"')
+    return false;
+
+  auto end = line.find('"', pos + 1);
+  if (end == std::string::npos)
+    return false;
+
+  value = line.substr(pos + 1, end - pos - 1);
+  return true;
+}
+
+static bool ReadJsonNumber(const std::string& line, const char* key, double& value)
+{
+  auto pos = FindJsonValue(line, key);
+  if (pos == std::string::npos)
+    return false;
+
+  char* end = nullptr;
+  value = strtod(line.c_str() + pos, &end);
+  return end != line.c_str() + pos;
+}
+
+bool LoadBenchmarkBaseline(const char* path, std::vector<BenchmarkResult>& results)
+{
+  std::ifstream file(path);
+  if (!file.is_open())
+    return false;
+
+  // WriteBenchmarkResults writes each result on its own line, so there's no need for a full JSON parser here
+  std::string line;
+  while (std::getline(file, line))
+  {
+    std::string stage, variant;
+    double ns;
+    if (!ReadJsonString(line, "stage", stage) || !ReadJsonString(line, "variant", variant) || !ReadJsonNumber(line, "ns_per_report", ns))
+      continue;
+
+    for (auto& result : results)
+      if (result.stage == stage && result.variant == variant)
+        result.baseline_ns_per_report = ns;
+  }
+
+  return true;
+}
+
+int WriteBenchmarkResults(const char* path, const std::vector<BenchmarkResult>& results, double threshold_pct)
+{
+  std::ofstream file(path, std::ios::trunc);
+  int regressions = 0;
+
+  file << std::fixed << std::setprecision(3);
+  file << "{" << std::endl;
+  file << "  \"results\": [" << std::endl;
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    auto& result = results[i];
+    file << "    { \"stage\": \"" << result.stage << "\", \"variant\": \"" << result.variant << "\", \"ns_per_report\": " << result.ns_per_report;
+
+    if (result.baseline_ns_per_report >= 0)
+    {
+      double change_pct = 0;
+      if (result.baseline_ns_per_report > 0)
+        change_pct = (result.ns_per_report - result.baseline_ns_per_report) / result.baseline_ns_per_report * 100.0;
+
+      // timer lateness & contended snapshot writes mostly depend on the OS scheduler, too noisy to count as a regression
+      bool regressed = change_pct > threshold_pct && result.stage != "overhead" && result.stage.compare(0, 14, "timer_lateness") &&
+        result.stage != "settings_stress_write";
+      if (regressed)
+        regressions++;
+
+      file << ", \"baseline_ns_per_report\": " << result.baseline_ns_per_report << ", \"change_pct\": " << change_pct
+        << ", \"regressed\": " << (regressed ? "true" : "false");
+    }
+
+    file << " }" << (i + 1 < results.size() ? "," : "") << std::endl;
+  }
+  file << "  ]," << std::endl;
+  file << "  \"regressions\": " << regressions << std::endl;
+  file << "}" << std::endl;
+
+  return regressions;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "InputCapture.hpp"
+
+#include <string>
+#include <vector>
+
+// Stages that get slower than their baseline by more than this are counted as regressed, smaller changes are most likely noise
+#define BENCHMARK_REGRESSION_THRESHOLD_PCT  10.0
+
+struct BenchmarkResult {
+  std::string stage;
+  std::string variant; // which settings were used, eg. "remap_on-deadzone_zero"
+  double ns_per_report = 0;
+  double baseline_ns_per_report = -1; // < 0 if there's no baseline for this result
+};
+
+// Times each XboxTranslator stage (and the full Translate) over every input report in the capture,
+// once for each combination of remap on/off & deadzones zero/non-zero
+std::vector<BenchmarkResult> RunTranslatorBenchmark(const CaptureReader& capture);
+
+// Times the TimerWheel used for turbo/macros, both CPU cost per timer & how late timers fire, appended to results
+void RunTimerBenchmark(std::vector<BenchmarkResult>& results);
+
+// Times replaying capture through a translator that picks up settings from a Snapshot (like XboxController does),
+// while another thread keeps changing them, results get appended to results
+void RunSnapshotBenchmark(const CaptureReader& capture, std::vector<BenchmarkResult>& results);
+
+// Floods a RumbleShaper on a simulated bus & measures how long updates take to reach the controller, appended to results
+void RunRumbleBenchmark(std::vector<BenchmarkResult>& results);
+
+// Times adding ViGEm targets to a fake bus that already has dozens of targets on it, with & without SerialAllocator
+// Results (per attach, & number of plug attempts x1000) are appended to results
+void RunAttachBenchmark(std::vector<BenchmarkResult>& results);
+
+// Times how long attaching a controller spends getting a ViGEm target ready, with targets made on the spot vs. taken from a
+// WarmPool, results are appended to results
+void RunTargetPoolBenchmark(std::vector<BenchmarkResult>& results);
+
+// Plugs devices into a simulated USB bus while a thread scans it like USBCheckThread, results (how long until each new device
+// was picked up, woken by hotplug events vs. polling only, & the CPU cost of each scan) are appended to results
+void RunHotplugBenchmark(std::vector<BenchmarkResult>& results);
+
+// Times bringing up a batch of simulated controllers one at a time vs. in parallel like OpenDevice, total time for the
+// whole batch is appended to results
+void RunBringUpBenchmark(std::vector<BenchmarkResult>& results);
+
+// Posts reports from dozens of simulated pads (each at its own point in their polling interval) to a ReportBatcher,
+// results compare how far apart each frame's first & last reports get sent with & without batching
+void RunBatchBenchmark(std::vector<BenchmarkResult>& results);
+
+// Starts up with simulated slow pads through a DescriptorCache, without & then with their descriptors cached on disk,
+// results compare how long until they're sending input & have a name
+void RunDescriptorCacheBenchmark(std::vector<BenchmarkResult>& results);
+
+// Checks every device on a simulated bus with hundreds of devices for an existing controller on its port, by looking
+// through every controller vs. the registry's port path index, results compare the time each takes per scan
+void RunPortIndexBenchmark(std::vector<BenchmarkResult>& results);
+
+// Runs every benchmark above after RunTranslatorBenchmark (snapshot, attach, hotplug, etc.), appended to results
+// Both -benchmark & xb2x_bench (tools/Benchmark.cpp) run the stages through this, so they always run the same ones
+void RunComponentBenchmarks(const CaptureReader& capture, std::vector<BenchmarkResult>& results);
+
+// Reads in a results file written by WriteBenchmarkResults & fills in baseline_ns_per_report of any matching results
+bool LoadBenchmarkBaseline(const char* path, std::vector<BenchmarkResult>& results);
+
+// Writes results as JSON, returns the number of results that got slower than their baseline by more than threshold_pct
+int WriteBenchmarkResults(const char* path, const std::vector<BenchmarkResult>& results, double threshold_pct);
@@ -51,6 +51,8 @@ SOFTWARE.
 //
 // Internal
 // 
+#include "SerialAllocator.hpp"
+#include "SubmitRing.hpp"
 #include "Internal.h"
 
 
@@ -92,6 +94,9 @@ public:
 	}
 
 	virtual void ProcessNotificationRequest(PVIGEM_CLIENT client, PVIGEM_TARGET target) = 0;
+
+	// (Re-)initializes the request for the target with serialNo, workers registered before their target was plugged in only know it afterwards
+	virtual void Init(ULONG serialNo) = 0;
 };
 
 class NotificationRequestPayloadX360 : public NotificationRequestPayload
@@ -100,7 +105,12 @@ public:
 	NotificationRequestPayloadX360(ULONG _serialNo) : NotificationRequestPayload(sizeof(XUSB_REQUEST_NOTIFICATION), IOCTL_XUSB_REQUEST_NOTIFICATION)
 	{
 		// Let base class to allocate required buffer size, but initialize it here with a correct type of initialization function
-		XUSB_REQUEST_NOTIFICATION_INIT((PXUSB_REQUEST_NOTIFICATION)lpPayloadBuffer, _serialNo);
+		Init(_serialNo);
+	}
+
+	void Init(ULONG serialNo) override
+	{
+		XUSB_REQUEST_NOTIFICATION_INIT((PXUSB_REQUEST_NOTIFICATION)lpPayloadBuffer, serialNo);
 	}
 
 	void ProcessNotificationRequest(PVIGEM_CLIENT client, PVIGEM_TARGET target) override
@@ -120,7 +130,12 @@ public:
 	NotificationRequestPayloadDS4(ULONG _serialNo) : NotificationRequestPayload(sizeof(DS4_REQUEST_NOTIFICATION), IOCTL_DS4_REQUEST_NOTIFICATION)
 	{
 		// Let base class to allocate required buffer size, but initialize it here with a correct type of initialization function
-		DS4_REQUEST_NOTIFICATION_INIT((PDS4_REQUEST_NOTIFICATION)lpPayloadBuffer, _serialNo);
+		Init(_serialNo);
+	}
+
+	void Init(ULONG serialNo) override
+	{
+		DS4_REQUEST_NOTIFICATION_INIT((PDS4_REQUEST_NOTIFICATION)lpPayloadBuffer, serialNo);
 	}
 
 	void ProcessNotificationRequest(PVIGEM_CLIENT client, PVIGEM_TARGET target) override
@@ -153,9 +168,128 @@ PVIGEM_TARGET FORCEINLINE VIGEM_TARGET_ALLOC_INIT(
     target->State = VIGEM_TARGET_INITIALIZED;
     target->Type = Type;
 	target->notificationThreadList = nullptr;
+
+    InitializeSRWLock(&target->IoLock);
+    target->IoEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    target->PluggedEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+
+    if (!target->IoEvent || !target->PluggedEvent)
+    {
+        if (target->IoEvent)
+            CloseHandle(target->IoEvent);
+        if (target->PluggedEvent)
+            CloseHandle(target->PluggedEvent);
+        free(target);
+        return nullptr;
+    }
+
     return target;
 }
 
+//
+// Sends an IOCTL through the target's preallocated I/O context & waits for it to complete.
+// Returns the result of GetOverlappedResult, with GetLastError() left as it set it.
+// 
+static BOOL vigem_target_ioctl(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    DWORD ioControlCode,
+    LPVOID inBuffer,
+    DWORD inBufferSize,
+    LPVOID outBuffer,
+    DWORD outBufferSize
+)
+{
+    AcquireSRWLockExclusive(&target->IoLock);
+
+    DWORD transferred = 0;
+    OVERLAPPED lOverlapped = { 0 };
+    lOverlapped.hEvent = target->IoEvent;
+
+    DeviceIoControl(
+        vigem->hBusDevice,
+        ioControlCode,
+        inBuffer,
+        inBufferSize,
+        outBuffer,
+        outBufferSize,
+        &transferred,
+        &lOverlapped
+    );
+
+    const auto result = GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE);
+    const auto error = GetLastError();
+
+    ReleaseSRWLockExclusive(&target->IoLock);
+
+    SetLastError(error);
+    return result;
+}
+
+//
+// Returns a function that waits for one of target's in-flight submissions to complete, for SubmitRing.
+// It returns false if the driver failed that submission, GetLastError says why.
+// Caller must hold the target's IoLock.
+// 
+static auto vigem_target_wait_submit(PVIGEM_TARGET target)
+{
+    return [target](VIGEM_SUBMIT_SLOT& slot)
+    {
+        DWORD transferred = 0;
+        return GetOverlappedResult(target->SubmitDevice, &slot.Overlapped, &transferred, TRUE) != FALSE;
+    };
+}
+
+//
+// Sends a report without waiting for the driver to finish with it, reusing the next preallocated slot.
+// If every slot is still in-flight this waits for the oldest one, so at most the ring's depth are ever outstanding.
+// Errors from earlier reports are returned by whichever later call finds out about them.
+// 
+static VIGEM_ERROR vigem_target_submit(
+    PVIGEM_CLIENT vigem,
+    PVIGEM_TARGET target,
+    DWORD ioControlCode,
+    const void* report,
+    DWORD reportSize
+)
+{
+    auto error = VIGEM_ERROR_NONE;
+
+    AcquireSRWLockExclusive(&target->IoLock);
+
+    bool failed = false;
+    const auto slot = &target->Submits.Next(vigem_target_wait_submit(target), failed);
+
+    if (failed && GetLastError() == ERROR_ACCESS_DENIED)
+        error = VIGEM_ERROR_INVALID_TARGET;
+
+    const auto hEvent = slot->Overlapped.hEvent;
+    memset(&slot->Overlapped, 0, sizeof(OVERLAPPED));
+    slot->Overlapped.hEvent = hEvent;
+
+    memcpy(&slot->Report, report, reportSize);
+    target->SubmitDevice = vigem->hBusDevice;
+
+    DWORD transferred = 0;
+    if (DeviceIoControl(
+        vigem->hBusDevice,
+        ioControlCode,
+        &slot->Report,
+        reportSize,
+        nullptr,
+        0,
+        &transferred,
+        &slot->Overlapped
+    ) || GetLastError() == ERROR_IO_PENDING)
+        target->Submits.Submitted(*slot);
+    else if (GetLastError() == ERROR_ACCESS_DENIED)
+        error = VIGEM_ERROR_INVALID_TARGET;
+
+    ReleaseSRWLockExclusive(&target->IoLock);
+
+    return error;
+}
+
 
 LONG WINAPI vigem_internal_exception_handler(struct _EXCEPTION_POINTERS* apExceptionInfo)
 {
@@ -211,14 +345,18 @@ PVIGEM_CLIENT vigem_alloc()
 
     RtlZeroMemory(driver, sizeof(VIGEM_CLIENT));
     driver->hBusDevice = INVALID_HANDLE_VALUE;
+    driver->Serials = new SerialAllocator(VIGEM_TARGETS_MAX);
 
     return driver;
 }
 
 void vigem_free(PVIGEM_CLIENT vigem)
 {
-    if (vigem)
-        free(vigem);
+    if (!vigem)
+        return;
+
+    delete vigem->Serials;
+    free(vigem);
 }
 
 VIGEM_ERROR vigem_connect(PVIGEM_CLIENT vigem)
@@ -344,8 +482,13 @@ void vigem_disconnect(PVIGEM_CLIENT vigem)
     {
         CloseHandle(vigem->hBusDevice);
 
+        // closing the bus handle unplugs every target we added, so all of their serials are free again
+        const auto serials = vigem->Serials;
+        serials->Reset();
+
         RtlZeroMemory(vigem, sizeof(VIGEM_CLIENT));
         vigem->hBusDevice = INVALID_HANDLE_VALUE;
+        vigem->Serials = serials;
     }
 }
 
@@ -377,8 +520,80 @@ PVIGEM_TARGET vigem_target_ds4_alloc(void)
 
 void vigem_target_free(PVIGEM_TARGET target)
 {
-	if (target)
-		free(target);
+	if (!target)
+		return;
+
+    AcquireSRWLockExclusive(&target->IoLock);
+    target->Submits.Drain(vigem_target_wait_submit(target));
+    ReleaseSRWLockExclusive(&target->IoLock);
+
+    for (ULONG i = 0; i < VIGEM_SUBMIT_QUEUE_MAX; i++)
+        if (target->Submits.At(i).Overlapped.hEvent)
+            CloseHandle(target->Submits.At(i).Overlapped.hEvent);
+
+    if (target->IoEvent)
+        CloseHandle(target->IoEvent);
+
+    if (target->PluggedEvent)
+        CloseHandle(target->PluggedEvent);
+
+	free(target);
+}
+
+VIGEM_ERROR vigem_target_set_submit_queue(PVIGEM_TARGET target, ULONG depth)
+{
+    if (!target)
+        return VIGEM_ERROR_INVALID_TARGET;
+
+    if (depth > VIGEM_SUBMIT_QUEUE_MAX)
+        return VIGEM_ERROR_INVALID_PARAMETER;
+
+    auto error = VIGEM_ERROR_NONE;
+
+    AcquireSRWLockExclusive(&target->IoLock);
+
+    target->Submits.Drain(vigem_target_wait_submit(target));
+
+    for (ULONG i = 0; i < depth; i++)
+    {
+        auto& slot = target->Submits.At(i);
+        if (!slot.Overlapped.hEvent)
+            slot.Overlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+
+        if (!slot.Overlapped.hEvent)
+        {
+            error = VIGEM_ERROR_INVALID_PARAMETER;
+            depth = 0;
+            break;
+        }
+    }
+
+    target->Submits.SetDepth(depth, vigem_target_wait_submit(target));
+
+    ReleaseSRWLockExclusive(&target->IoLock);
+
+    return error;
+}
+
+//
+// Plugs target in with the first free serial the client's allocator gives out, returns FALSE if there aren't any.
+// 
+static BOOL vigem_target_plugin(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
+{
+    const auto serial = vigem->Serials->Allocate([vigem, target](uint32_t serial)
+    {
+        VIGEM_PLUGIN_TARGET plugin;
+        VIGEM_PLUGIN_TARGET_INIT(&plugin, serial, target->Type);
+
+        plugin.VendorId = target->VendorId;
+        plugin.ProductId = target->ProductId;
+
+        return vigem_target_ioctl(vigem, target, IOCTL_VIGEM_PLUGIN_TARGET, &plugin, plugin.Size, nullptr, 0) != 0;
+    });
+
+    target->SerialNo = serial;
+
+    return serial != 0;
 }
 
 VIGEM_ERROR vigem_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
@@ -398,41 +613,13 @@ VIGEM_ERROR vigem_target_add(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
     if (target->State == VIGEM_TARGET_CONNECTED)
         return VIGEM_ERROR_ALREADY_CONNECTED;
 
-    DWORD transferred = 0;
-    VIGEM_PLUGIN_TARGET plugin;
-    OVERLAPPED lOverlapped = { 0 };
-    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    if (!vigem_target_plugin(vigem, target))
+        return VIGEM_ERROR_NO_FREE_SLOT;
 
-    for (target->SerialNo = 1; target->SerialNo <= VIGEM_TARGETS_MAX; target->SerialNo++)
-    {
-        VIGEM_PLUGIN_TARGET_INIT(&plugin, target->SerialNo, target->Type);
-
-        plugin.VendorId = target->VendorId;
-        plugin.ProductId = target->ProductId;
+    target->State = VIGEM_TARGET_CONNECTED;
+    SetEvent(target->PluggedEvent);
 
-        DeviceIoControl(
-            vigem->hBusDevice,
-            IOCTL_VIGEM_PLUGIN_TARGET,
-            &plugin,
-            plugin.Size,
-            nullptr,
-            0,
-            &transferred,
-            &lOverlapped
-        );
-
-        if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) != 0)
-        {
-            target->State = VIGEM_TARGET_CONNECTED;
-            CloseHandle(lOverlapped.hEvent);
-
-            return VIGEM_ERROR_NONE;
-        }
-    }
-
-    CloseHandle(lOverlapped.hEvent);
-
-    return VIGEM_ERROR_NO_FREE_SLOT;
+    return VIGEM_ERROR_NONE;
 }
 
 VIGEM_ERROR vigem_target_add_async(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PFN_VIGEM_TARGET_ADD_RESULT result)
@@ -457,42 +644,16 @@ VIGEM_ERROR vigem_target_add_async(PVIGEM_CLIENT vigem, PVIGEM_TARGET target, PF
         PVIGEM_CLIENT _Client,
         PFN_VIGEM_TARGET_ADD_RESULT _Result)
     {
-        DWORD transferred = 0;
-        VIGEM_PLUGIN_TARGET plugin;
-        OVERLAPPED lOverlapped = { 0 };
-        lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-
-        for (_Target->SerialNo = 1; _Target->SerialNo <= VIGEM_TARGETS_MAX; _Target->SerialNo++)
+        if (vigem_target_plugin(_Client, _Target))
         {
-            VIGEM_PLUGIN_TARGET_INIT(&plugin, _Target->SerialNo, _Target->Type);
-
-            plugin.VendorId = _Target->VendorId;
-            plugin.ProductId = _Target->ProductId;
-
-            DeviceIoControl(
-                _Client->hBusDevice,
-                IOCTL_VIGEM_PLUGIN_TARGET,
-                &plugin,
-                plugin.Size,
-                nullptr,
-                0,
-                &transferred,
-                &lOverlapped
-            );
-
-            if (GetOverlappedResult(_Client->hBusDevice, &lOverlapped, &transferred, TRUE) != 0)
-            {
-                _Target->State = VIGEM_TARGET_CONNECTED;
-                CloseHandle(lOverlapped.hEvent);
-
-                if (_Result)
-                    _Result(_Client, _Target, VIGEM_ERROR_NONE);
-
-                return;
-            }
-        }
+            _Target->State = VIGEM_TARGET_CONNECTED;
+            SetEvent(_Target->PluggedEvent);
 
-        CloseHandle(lOverlapped.hEvent);
+            if (_Result)
+                _Result(_Client, _Target, VIGEM_ERROR_NONE);
+
+            return;
+        }
 
         if (_Result)
             _Result(_Client, _Target, VIGEM_ERROR_NO_FREE_SLOT);
@@ -521,34 +682,23 @@ VIGEM_ERROR vigem_target_remove(PVIGEM_CLIENT vigem, PVIGEM_TARGET target)
     if (target->State != VIGEM_TARGET_CONNECTED)
         return VIGEM_ERROR_TARGET_NOT_PLUGGED_IN;
 
-    DWORD transfered = 0;
-    VIGEM_UNPLUG_TARGET unplug;
-    OVERLAPPED lOverlapped = { 0 };
-    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+    // any reports still in-flight have to be done with before the target goes away
+    AcquireSRWLockExclusive(&target->IoLock);
+    target->Submits.Drain(vigem_target_wait_submit(target));
+    ReleaseSRWLockExclusive(&target->IoLock);
 
+    VIGEM_UNPLUG_TARGET unplug;
     VIGEM_UNPLUG_TARGET_INIT(&unplug, target->SerialNo);
 
-    DeviceIoControl(
-        vigem->hBusDevice,
-        IOCTL_VIGEM_UNPLUG_TARGET,
-        &unplug,
-        unplug.Size,
-        nullptr,
-        0,
-        &transfered,
-        &lOverlapped
-    );
-
-    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transfered, TRUE) != 0)
+    if (vigem_target_ioctl(vigem, target, IOCTL_VIGEM_UNPLUG_TARGET, &unplug, unplug.Size, nullptr, 0) != 0)
     {
         target->State = VIGEM_TARGET_DISCONNECTED;
-        CloseHandle(lOverlapped.hEvent);
+        ResetEvent(target->PluggedEvent);
+        vigem->Serials->Release(target->SerialNo);
 
         return VIGEM_ERROR_NONE;
     }
 
-    CloseHandle(lOverlapped.hEvent);
-
     return VIGEM_ERROR_REMOVAL_FAILED;
 }
 
@@ -575,6 +725,18 @@ void vigem_notification_thread_worker(
 	int currentOverlappedIdx;
 	int futureOverlappedIdx;
 
+	// Workers registered before their target was plugged in (eg. kept warm in a pool) wait here until it is, or until they're cancelled
+	waitObjects[0] = target->cancelNotificationThreadEvent;
+	waitObjects[1] = target->PluggedEvent;
+	if (WaitForMultipleObjects(2, waitObjects, FALSE, INFINITE) != (WAIT_OBJECT_0 + 1))
+	{
+		pNotificationRequestPayload.reset();
+		return;
+	}
+
+	for (auto& payload : *pNotificationRequestPayload)
+		payload->Init(target->SerialNo);
+
 	memset(lOverlapped, 0, sizeof(lOverlapped));
 	for(idx = 0; idx < NOTIFICATION_OVERLAPPED_QUEUE_SIZE; idx++)
 		lOverlapped[idx].hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
@@ -670,7 +832,10 @@ VIGEM_ERROR vigem_target_x360_register_notification(
     if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
         return VIGEM_ERROR_BUS_NOT_FOUND;
 
-    if (target->SerialNo == 0 || notification == nullptr)
+    //
+    // Targets that haven't been plugged in yet are fine too, their worker waits until they are.
+    // 
+    if ((target->SerialNo == 0 && target->State != VIGEM_TARGET_INITIALIZED) || notification == nullptr)
         return VIGEM_ERROR_INVALID_TARGET;
 
     if (target->Notification == reinterpret_cast<FARPROC>(notification))
@@ -716,7 +881,10 @@ VIGEM_ERROR vigem_target_ds4_register_notification(
     if (vigem->hBusDevice == INVALID_HANDLE_VALUE)
         return VIGEM_ERROR_BUS_NOT_FOUND;
 
-    if (target->SerialNo == 0 || notification == nullptr)
+    //
+    // Targets that haven't been plugged in yet are fine too, their worker waits until they are.
+    // 
+    if ((target->SerialNo == 0 && target->State != VIGEM_TARGET_INITIALIZED) || notification == nullptr)
         return VIGEM_ERROR_INVALID_TARGET;
 
     if (target->Notification == reinterpret_cast<FARPROC>(notification))
@@ -812,37 +980,20 @@ VIGEM_ERROR vigem_target_x360_update(
     if (target->SerialNo == 0)
         return VIGEM_ERROR_INVALID_TARGET;
 
-    DWORD transferred = 0;
-    OVERLAPPED lOverlapped = { 0 };
-    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-
     XUSB_SUBMIT_REPORT xsr;
     XUSB_SUBMIT_REPORT_INIT(&xsr, target->SerialNo);
 
     xsr.Report = report;
 
-    DeviceIoControl(
-        vigem->hBusDevice,
-        IOCTL_XUSB_SUBMIT_REPORT,
-        &xsr,
-        xsr.Size,
-        nullptr,
-        0,
-        &transferred,
-        &lOverlapped
-    );
+    if (target->Submits.Depth())
+        return vigem_target_submit(vigem, target, IOCTL_XUSB_SUBMIT_REPORT, &xsr, xsr.Size);
 
-    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
+    if (vigem_target_ioctl(vigem, target, IOCTL_XUSB_SUBMIT_REPORT, &xsr, xsr.Size, nullptr, 0) == 0)
     {
         if (GetLastError() == ERROR_ACCESS_DENIED)
-        {
-            CloseHandle(lOverlapped.hEvent);
             return VIGEM_ERROR_INVALID_TARGET;
-        }
     }
 
-    CloseHandle(lOverlapped.hEvent);
-
     return VIGEM_ERROR_NONE;
 }
 
@@ -864,37 +1015,20 @@ VIGEM_ERROR vigem_target_ds4_update(
     if (target->SerialNo == 0)
         return VIGEM_ERROR_INVALID_TARGET;
 
-    DWORD transferred = 0;
-    OVERLAPPED lOverlapped = { 0 };
-    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-
     DS4_SUBMIT_REPORT dsr;
     DS4_SUBMIT_REPORT_INIT(&dsr, target->SerialNo);
 
     dsr.Report = report;
 
-    DeviceIoControl(
-        vigem->hBusDevice,
-        IOCTL_DS4_SUBMIT_REPORT,
-        &dsr,
-        dsr.Size,
-        nullptr,
-        0,
-        &transferred,
-        &lOverlapped
-    );
+    if (target->Submits.Depth())
+        return vigem_target_submit(vigem, target, IOCTL_DS4_SUBMIT_REPORT, &dsr, dsr.Size);
 
-    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
+    if (vigem_target_ioctl(vigem, target, IOCTL_DS4_SUBMIT_REPORT, &dsr, dsr.Size, nullptr, 0) == 0)
     {
         if (GetLastError() == ERROR_ACCESS_DENIED)
-        {
-            CloseHandle(lOverlapped.hEvent);
             return VIGEM_ERROR_INVALID_TARGET;
-        }
     }
 
-    CloseHandle(lOverlapped.hEvent);
-
     return VIGEM_ERROR_NONE;
 }
 
@@ -934,43 +1068,20 @@ VIGEM_ERROR vigem_target_x360_get_user_index(
 	if (!index)
 		return VIGEM_ERROR_INVALID_PARAMETER;
 
-    DWORD transferred = 0;
-    OVERLAPPED lOverlapped = { 0 };
-    lOverlapped.hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
-
     XUSB_GET_USER_INDEX gui;
     XUSB_GET_USER_INDEX_INIT(&gui, target->SerialNo);
 
-    DeviceIoControl(
-        vigem->hBusDevice,
-        IOCTL_XUSB_GET_USER_INDEX,
-        &gui,
-        gui.Size,
-        &gui,
-        gui.Size,
-        &transferred,
-        &lOverlapped
-    );
-
-    if (GetOverlappedResult(vigem->hBusDevice, &lOverlapped, &transferred, TRUE) == 0)
+    if (vigem_target_ioctl(vigem, target, IOCTL_XUSB_GET_USER_INDEX, &gui, gui.Size, &gui, gui.Size) == 0)
     {
         const auto error = GetLastError();
 
         if (error == ERROR_ACCESS_DENIED)
-        {
-            CloseHandle(lOverlapped.hEvent);
             return VIGEM_ERROR_INVALID_TARGET;
-        }
 
         if (error == ERROR_INVALID_DEVICE_OBJECT_PARAMETER)
-        {
-            CloseHandle(lOverlapped.hEvent);
             return VIGEM_ERROR_XUSB_USERINDEX_OUT_OF_RANGE;
-        }
     }
 
-    CloseHandle(lOverlapped.hEvent);
-
     *index = gui.UserIndex;
 
     return VIGEM_ERROR_NONE;
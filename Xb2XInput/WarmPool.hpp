@@ -0,0 +1,135 @@
+#pragma once
+// Keeps a few ready-made objects (eg. ViGEm targets) around so whatever needs one can take it without waiting on it being made
+// A background thread creates them & tops the pool back up whenever one is taken, Take itself never blocks on creation
+// Portable like XboxTranslator, nothing in here depends on Windows
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+
+// how long the refill thread waits before trying again after create fails (eg. the ViGEm bus went away)
+#define WARM_POOL_RETRY_MS         1000
+
+// how long the refill thread waits after something's been taken, so it isn't competing for the CPU with whatever took it
+#define WARM_POOL_REFILL_DELAY_MS  5
+
+struct WarmPoolStats {
+  uint64_t created = 0; // made by the refill thread
+  uint64_t taken = 0;   // handed out ready-made
+  uint64_t missed = 0;  // Take found the pool empty
+};
+
+template <typename T>
+class WarmPool
+{
+  std::function<T()> create_;      // returns T() if it failed
+  std::function<void(T)> destroy_; // frees anything still in the pool once it's stopped
+  std::vector<T> ready_;
+  size_t size_ = 0;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::thread thread_;
+  bool stopping_ = false;
+  WarmPoolStats stats_;
+
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_)
+    {
+      bool full = ready_.size() >= size_;
+      changed_.wait(lock, [this]() { return stopping_ || ready_.size() < size_; });
+      if (stopping_)
+        break;
+
+      if (full)
+        changed_.wait_for(lock, std::chrono::milliseconds(WARM_POOL_REFILL_DELAY_MS), [this]() { return stopping_; });
+      if (stopping_)
+        break;
+
+      lock.unlock();
+      T item = create_();
+      lock.lock();
+
+      if (!item)
+      {
+        changed_.wait_for(lock, std::chrono::milliseconds(WARM_POOL_RETRY_MS), [this]() { return stopping_; });
+        continue;
+      }
+
+      ready_.push_back(item);
+      stats_.created++;
+    }
+  }
+
+public:
+  WarmPool() = default;
+  WarmPool(const WarmPool&) = delete;
+  WarmPool& operator=(const WarmPool&) = delete;
+
+  ~WarmPool()
+  {
+    Stop();
+  }
+
+  // Starts the refill thread, which keeps size objects ready
+  void Start(size_t size, std::function<T()> create, std::function<void(T)> destroy)
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (thread_.joinable())
+      return;
+
+    size_ = size;
+    create_ = create;
+    destroy_ = destroy;
+    stopping_ = false;
+    thread_ = std::thread(&WarmPool::run, this);
+  }
+
+  // Stops the refill thread & destroys everything that wasn't taken
+  void Stop()
+  {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (!thread_.joinable())
+        return;
+      stopping_ = true;
+    }
+
+    changed_.notify_all();
+    thread_.join();
+
+    for (auto& item : ready_)
+      destroy_(item);
+    ready_.clear();
+  }
+
+  // Oldest ready object, or T() if there aren't any right now (caller should create its own)
+  T Take()
+  {
+    T item = T();
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (ready_.empty())
+      {
+        stats_.missed++;
+        return item;
+      }
+
+      item = ready_.front();
+      ready_.erase(ready_.begin());
+      stats_.taken++;
+    }
+
+    changed_.notify_all();
+    return item;
+  }
+
+  size_t Ready() { std::lock_guard<std::mutex> guard(mutex_); return ready_.size(); }
+
+  WarmPoolStats Stats() { std::lock_guard<std::mutex> guard(mutex_); return stats_; }
+};
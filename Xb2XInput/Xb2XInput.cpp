@@ -1,27 +1,28 @@
 #include "stdafx.hpp"
 #include "resource.h"
+#include <mmsystem.h>
+#include <dbt.h>
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include <mutex>
 #include <sstream>
 #include "XboxController.hpp"
+#include "TranslatorBenchmark.hpp"
 
 // how many times to check the USB device each second, must be 1000 or lower, higher value = higher CPU usage
 // 144 seems a good value, i don't really know anyone that uses a higher refresh rate than that...
+// (only used for controllers without an interrupt IN endpoint, others are handled as soon as their reports arrive)
 // TODO: make this configurable?
 const int poll_rate = 144;
 
 int poll_ms = (1000 / min(1000, poll_rate));
 
-// Analog Stick and Trigger Deadzone Adjustment Enabled
-bool deadzoneCombinationEnabled = true;
-
 // Path of our config INI, based on EXE path
 char ini_path[4096];
 
-// button bitmask for guide combination
-int combo_guideButton = 0;
+// Parsed copy of the INI, read in once at startup
+IniDocument ini_settings;
 
 WCHAR title[256];
 bool usb_end = false;
@@ -124,13 +125,17 @@ bool StartupDeleteEntry()
 #define ID_TRAY_CONTROLLER 5006
 #define ID_TRAY_DEADZONE 5100
 
-// lower 12 bits are controller index into XboxController::controllers_
+// lower 12 bits are controller index into tray_controllers
 #define ID_CONTROLLER_GUIDEBTN  0x2000
 #define ID_CONTROLLER_VIBRATION 0x4000
 #define ID_CONTROLLER_REMAP     0x8000
 
 WCHAR tray_text[128];
 
+// registry IDs of the controllers in the last context menu, so a menu item picked after its controller was
+// disconnected (or replaced by another one) doesn't change the wrong controller
+RegistryId tray_controllers[REGISTRY_SLOTS];
+
 HWND hwnd;
 HINSTANCE instance;
 
@@ -160,60 +165,86 @@ void SysTrayShowContextMenu()
 
   HMENU hPopMenu = CreatePopupMenu();
   InsertMenu(hPopMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING | MF_GRAYED, ID_TRAY_NAME, tray_text);
-  auto& pads = XboxController::GetControllers();
-  wchar_t ctl_text[128];
-  int i = 0;
-  for (auto& controller : pads)
-  {
-    auto hControllerMenu = CreatePopupMenu();
-    InsertMenu(hControllerMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING |
-      (controller.VibrationEnabled() ? MF_CHECKED : MF_UNCHECKED), ID_CONTROLLER_VIBRATION + i, L"Enable vibration/rumble");
 
-    InsertMenu(hControllerMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING |
-      (controller.GuideEnabled() ? MF_CHECKED : MF_UNCHECKED), ID_CONTROLLER_GUIDEBTN + i, L"Enable guide button combination");
-    if (combo_guideButton)
+  // only pinned while the menu is being built, TrackPopupMenu below can take as long as the user wants
+  {
+    auto& pads = XboxController::Controllers();
+    auto pin = pads.Pin();
+    wchar_t ctl_text[128];
+    int i = 0;
+    pads.ForEach([&](RegistryId id, XboxController& controller)
     {
-      std::string PrintButtonCombination(int combo); // implemented below
+      if (i >= REGISTRY_SLOTS)
+        return;
 
-      auto combo = "- Combination: " + PrintButtonCombination(combo_guideButton);
-      InsertMenuA(hControllerMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING | MF_GRAYED, ID_TRAY_SEP, combo.c_str());
-    }
+      tray_controllers[i] = id;
+      auto hControllerMenu = CreatePopupMenu();
+      InsertMenu(hControllerMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING |
+        (controller.VibrationEnabled() ? MF_CHECKED : MF_UNCHECKED), ID_CONTROLLER_VIBRATION + i, L"Enable vibration/rumble");
 
-    InsertMenu(hControllerMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING |
-      (controller.RemapEnabled() ? MF_CHECKED : MF_UNCHECKED), ID_CONTROLLER_REMAP + i, L"Enable button remappings");
+      InsertMenu(hControllerMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING |
+        (controller.GuideEnabled() ? MF_CHECKED : MF_UNCHECKED), ID_CONTROLLER_GUIDEBTN + i, L"Enable guide button combination");
+      if (combo_guideButton)
+      {
+        std::string PrintButtonCombination(int combo); // implemented below
 
-    auto remapCount = "- " + std::to_string(controller.Settings().button_remap.size()) + " buttons remapped";
-    InsertMenuA(hControllerMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING | MF_GRAYED, ID_TRAY_SEP, remapCount.c_str());
+        auto combo = "- Combination: " + PrintButtonCombination(combo_guideButton);
+        InsertMenuA(hControllerMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING | MF_GRAYED, ID_TRAY_SEP, combo.c_str());
+      }
 
-    InsertMenu(hControllerMenu, 0xFFFFFFFF, MF_SEPARATOR, ID_TRAY_SEP, L"SEP");
+      InsertMenu(hControllerMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING |
+        (controller.RemapEnabled() ? MF_CHECKED : MF_UNCHECKED), ID_CONTROLLER_REMAP + i, L"Enable button remappings");
 
-    // Insert current deadzone adjustments into context menu
-    auto dz = controller.GetDeadzone();
-    swprintf_s(ctl_text, L"Deadzone: LS(%d) RS(%d) LT(%d) RT(%d)", dz.sThumbL, dz.sThumbR, dz.bLeftTrigger, dz.bRightTrigger);
-    InsertMenu(hControllerMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING | MF_GRAYED, ID_TRAY_DEADZONE + i, ctl_text);
+      auto remapCount = "- " + std::to_string(controller.Settings().button_remap.size()) + " buttons remapped";
+      InsertMenuA(hControllerMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING | MF_GRAYED, ID_TRAY_SEP, remapCount.c_str());
 
-    const char* usb_productname = controller.GetProductName();
-    std::string productname;
-    if (strlen(usb_productname) > 0)
-      productname = std::string(" (") + std::string(usb_productname) + std::string(")");
+      auto rumble = controller.GetRumbleStats();
+      auto rumbleCount = "- Rumble: " + std::to_string(rumble.received) + " updates, " + std::to_string(rumble.merged) +
+        " merged, " + std::to_string(rumble.sent) + " sent";
+      InsertMenuA(hControllerMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING | MF_GRAYED, ID_TRAY_SEP, rumbleCount.c_str());
 
-    auto serialNo = controller.GetSerialNo();
-    if(strlen(serialNo))
-      swprintf_s(ctl_text, L"%d: %04X:%04X%S (#%S)", controller.GetControllerIndex(),
-        controller.GetVendorId(), controller.GetProductId(), productname.c_str(), serialNo);
-    else
-      swprintf_s(ctl_text, L"%d: %04X:%04X%S", controller.GetControllerIndex(),
-      controller.GetVendorId(), controller.GetProductId(), productname.c_str());
+      InsertMenu(hControllerMenu, 0xFFFFFFFF, MF_SEPARATOR, ID_TRAY_SEP, L"SEP");
 
-    InsertMenu(hPopMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING | MF_POPUP, (UINT_PTR)hControllerMenu, ctl_text);
-    i++;
+      // Insert current deadzone adjustments into context menu
+      auto dz = controller.GetDeadzone();
+      swprintf_s(ctl_text, L"Deadzone: LS(%d) RS(%d) LT(%d) RT(%d)", dz.sThumbL, dz.sThumbR, dz.bLeftTrigger, dz.bRightTrigger);
+      InsertMenu(hControllerMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING | MF_GRAYED, ID_TRAY_DEADZONE + i, ctl_text);
+
+      auto usb_productname = controller.GetProductName();
+      std::string productname;
+      if (usb_productname.length() > 0)
+        productname = std::string(" (") + usb_productname + std::string(")");
+
+      auto serialNo = controller.GetSerialNo();
+      if(serialNo.length())
+        swprintf_s(ctl_text, L"%d: %04X:%04X%S (#%S)", controller.GetControllerIndex(),
+          controller.GetVendorId(), controller.GetProductId(), productname.c_str(), serialNo.c_str());
+      else
+        swprintf_s(ctl_text, L"%d: %04X:%04X%S", controller.GetControllerIndex(),
+        controller.GetVendorId(), controller.GetProductId(), productname.c_str());
+
+      InsertMenu(hPopMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING | MF_POPUP, (UINT_PTR)hControllerMenu, ctl_text);
+      i++;
+    });
   }
   InsertMenu(hPopMenu, 0xFFFFFFFF, MF_SEPARATOR, ID_TRAY_SEP, L"SEP");
   InsertMenu(hPopMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING |
     (deadzoneCombinationEnabled ? MF_CHECKED : MF_UNCHECKED), ID_TRAY_DEADZONE, L"Enable Deadzone Adjustment:");
   InsertMenu(hPopMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING | MF_GRAYED | MF_UNCHECKED, ID_TRAY_DEADZONE, L"  - Analog Stick (LT+RT+(LS/RS)+DPAD Up/Dn)");
   InsertMenu(hPopMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING | MF_GRAYED | MF_UNCHECKED, ID_TRAY_DEADZONE, L"  - Trigger ((LT/RT)+LS+RS+DPAD Up/Dn)");
-  
+
+  // how far apart the first & last controller of each batch were sent
+  auto batch_tick = XboxController::GetBatchTick();
+  if (batch_tick)
+  {
+    auto batch = XboxController::GetBatchStats();
+    wchar_t batch_text[128];
+    swprintf_s(batch_text, L"Batched reports (%dms): spread %lluus avg, %lluus max", batch_tick,
+      batch.ticks ? batch.spread_total_us / batch.ticks : 0, batch.spread_max_us);
+    InsertMenu(hPopMenu, 0xFFFFFFFF, MF_SEPARATOR, ID_TRAY_SEP, L"SEP");
+    InsertMenu(hPopMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING | MF_GRAYED, ID_TRAY_SEP, batch_text);
+  }
+
   InsertMenu(hPopMenu, 0xFFFFFFFF, MF_SEPARATOR, ID_TRAY_SEP, L"SEP");
   InsertMenu(hPopMenu, 0xFFFFFFFF, MF_BYPOSITION | MF_STRING |
     (StartupIsSet() ? MF_CHECKED : MF_UNCHECKED), ID_TRAY_STARTUP, L"Run on startup");
@@ -236,6 +267,18 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
   case WM_CREATE:
     // register the "TaskbarCreated" window message, gets used if the systray icon needs to be recreated (eg explorer.exe crashed)
     taskbarCreatedMsg = RegisterWindowMessageW(TEXT("TaskbarCreated"));
+
+    // get told whenever any device is plugged in, so USBCheckThread can look for new controllers right away
+    {
+      DEV_BROADCAST_DEVICEINTERFACE filter = { 0 };
+      filter.dbcc_size = sizeof(filter);
+      filter.dbcc_devicetype = DBT_DEVTYP_DEVICEINTERFACE;
+      RegisterDeviceNotification(hWnd, &filter, DEVICE_NOTIFY_WINDOW_HANDLE | DEVICE_NOTIFY_ALL_INTERFACE_CLASSES);
+    }
+    break;
+  case WM_DEVICECHANGE:
+    if (wParam == DBT_DEVICEARRIVAL || wParam == DBT_DEVNODES_CHANGED)
+      XboxController::DevicesChanged();
     break;
   case WM_COMMAND:
     wmId = LOWORD(wParam);
@@ -243,16 +286,17 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
     if (wmId & ID_CONTROLLER_GUIDEBTN || wmId & ID_CONTROLLER_VIBRATION || wmId & ID_CONTROLLER_REMAP)
     {
       auto controllerId = wmId & 0xFFF;
-      auto& pads = XboxController::GetControllers();
-      if (pads.size() > controllerId)
+      auto& pads = XboxController::Controllers();
+      auto pin = pads.Pin();
+      auto controller = controllerId < REGISTRY_SLOTS ? pads.Get(tray_controllers[controllerId]) : nullptr;
+      if (controller)
       {
-        auto& controller = pads[controllerId];
         if (wmId & ID_CONTROLLER_GUIDEBTN)
-          controller.GuideEnabled(!controller.GuideEnabled());
+          controller->GuideEnabled(!controller->GuideEnabled());
         if (wmId & ID_CONTROLLER_VIBRATION)
-          controller.VibrationEnabled(!controller.VibrationEnabled());
+          controller->VibrationEnabled(!controller->VibrationEnabled());
         if (wmId & ID_CONTROLLER_REMAP)
-          controller.RemapEnabled(!controller.RemapEnabled());
+          controller->RemapEnabled(!controller->RemapEnabled());
       }
     }
     else
@@ -303,20 +347,29 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 #pragma region USB check/update threads
 void USBDeviceChanged(const XboxController& controller, bool added)
 {
-  auto& controllers = XboxController::GetControllers();
-  int num = (int)controllers.size();
+  auto& controllers = XboxController::Controllers();
+  int num = (int)controllers.Count();
   if (!added)
-    num--; // controller is only removed from controllers vector after this function gets called, so minus 1 from the count.
+    num--; // controller is only removed from the registry after this function gets called, so minus 1 from the count.
 
+  // only 1 controller left, find the one that isn't being removed & get info for it
+  auto pin = controllers.Pin();
+  const XboxController* remaining = nullptr;
   if (num == 1)
+    controllers.ForEach([&](RegistryId id, XboxController& other)
+    {
+      if (!remaining && (added || &other != &controller))
+        remaining = &other;
+    });
+
+  if (remaining)
   {
-    // only 1 controller left in vector, get info for that controller
-    auto& controller = controllers[0];
+    auto& controller = *remaining;
 
-    const char* usb_productname = controller.GetProductName();
+    auto usb_productname = controller.GetProductName();
     std::string productname;
-    if (strlen(usb_productname) > 0)
-      productname = std::string(" (") + std::string(usb_productname) + std::string(")");
+    if (usb_productname.length() > 0)
+      productname = std::string(" (") + usb_productname + std::string(")");
 
     // only 1 controller, set hover text to display info about it, but context-menu text should just display the count
     swprintf_s(notifyIconData.szTip, L"Xb2XInput - active with controller %04X:%04X%S",
@@ -344,7 +397,7 @@ void USBDeviceChanged(const XboxController& controller, bool added)
   wcscpy_s(notifyIconData.szInfoTitle, title);
 
   swprintf_s(notifyIconData.szInfo, L"%s controller %04X:%04X (%S)", added ? L"Connected" : L"Disconnected",
-    controller.GetVendorId(), controller.GetProductId(), controller.GetProductName());
+    controller.GetVendorId(), controller.GetProductId(), controller.GetProductName().c_str());
 
   Shell_NotifyIcon(NIM_MODIFY, &notifyIconData);
 }
@@ -357,7 +410,9 @@ void USBCheckThread()
       return;
 
     XboxController::OpenDevice();
-    Sleep(1500);
+
+    // returns early when a device gets plugged in, otherwise polls in case that was missed
+    XboxController::WaitForDeviceChange();
   }
 }
 
@@ -368,11 +423,16 @@ void USBUpdateThread()
     if (usb_end)
       return;
 
-    if (XboxController::GetControllers().size() <= 0)
+    if (XboxController::Controllers().Count() <= 0)
       Sleep(500); // sleep for a bit so we don't hammer the CPU
 
     XboxController::UpdateAll();
-    Sleep(poll_ms);
+
+    // wait for & translate any input reports, returns early as soon as one is handled
+    XboxController::HandleEvents(poll_ms);
+
+    // update any controllers with turbo/macros that are due to change
+    XboxController::RunTimers();
   }
 }
 #pragma endregion
@@ -410,7 +470,9 @@ std::unordered_map<std::string, int> xinput_buttons =
   { "BACK", XUSB_GAMEPAD_BACK },
 
   { "WHITE", XUSB_GAMEPAD_LEFT_SHOULDER },
-  { "BLACK", XUSB_GAMEPAD_RIGHT_SHOULDER }
+  { "BLACK", XUSB_GAMEPAD_RIGHT_SHOULDER },
+
+  { "GUIDE", XUSB_GAMEPAD_GUIDE }
 };
 
 std::string PrintButtonCombination(int combo)
@@ -461,6 +523,116 @@ int ParseButtonCombination(const char* combo)
   return retval;
 }
 
+// Parses the macro side of a Combo* setting, eg. "A:100, 50, B + X:200"
+// each comma-seperated step is buttons to hold, optionally followed by :milliseconds, or just milliseconds for a pause
+bool ParseMacro(const std::string& text, Macro& macro)
+{
+  macro.clear();
+
+  std::stringstream stream(text);
+  std::string step_text;
+  while (std::getline(stream, step_text, ','))
+  {
+    MacroStep step = { 0, MACRO_DEFAULT_STEP_MS };
+
+    auto colon = step_text.find(':');
+    auto buttons = step_text.substr(0, colon);
+    if (buttons.find_first_not_of(" \t0123456789") == std::string::npos)
+    {
+      // pause, just a duration
+      if (colon != std::string::npos)
+        return false;
+      step.duration_ms = strtoul(buttons.c_str(), nullptr, 10);
+    }
+    else
+    {
+      step.buttons = ParseButtonCombination(buttons.c_str());
+      if (!step.buttons)
+        return false;
+      if (colon != std::string::npos)
+        step.duration_ms = strtoul(step_text.c_str() + colon + 1, nullptr, 10);
+    }
+
+    if (!step.duration_ms)
+      return false;
+    macro.push_back(step);
+  }
+
+  return macro.size() > 0;
+}
+
+// Parses a Combo* setting, eg. "press Back + A -> Guide" or "press Back + B -> A:100, 50, A:100"
+bool ParseComboBinding(const std::string& text, ComboBinding& binding)
+{
+  auto arrow = text.find("->");
+  if (arrow == std::string::npos)
+    return false;
+
+  auto combo = text.substr(0, arrow);
+
+  // optional mode before the combination, defaults to hold
+  std::string mode;
+  size_t pos = combo.find_first_not_of(" \t");
+  while (pos < combo.length() && isalpha(combo[pos]))
+    mode += ::tolower(combo[pos++]);
+
+  binding.combo.mode = COMBO_HOLD;
+  if (mode == "press")
+    binding.combo.mode = COMBO_PRESS;
+  else if (mode == "release")
+    binding.combo.mode = COMBO_RELEASE;
+  if (mode == "hold" || binding.combo.mode != COMBO_HOLD)
+    combo = combo.substr(pos);
+
+  binding.combo.buttons = ParseButtonCombination(combo.c_str());
+  binding.combo.excluded = 0;
+  binding.output = 0;
+  binding.macro.clear();
+
+  auto output = text.substr(arrow + 2);
+  if (output.find_first_of(",:") == std::string::npos)
+    binding.output = ParseButtonCombination(output.c_str());
+  else
+  {
+    // macros can only be played by press/release combinations
+    if (!ParseMacro(output, binding.macro))
+      return false;
+    if (binding.combo.mode == COMBO_HOLD)
+      binding.combo.mode = COMBO_PRESS;
+  }
+
+  return binding.combo.buttons && (binding.output || binding.macro.size());
+}
+
+// Benchmarks the translation of each report in capture_path & writes results to output_path
+// Returns number of stages that regressed vs. baseline_path (if set), or -1 on failure
+int RunBenchmark(const std::string& capture_path, const std::string& output_path, const std::string& baseline_path)
+{
+  CaptureReader capture;
+  if (!capture.Open(capture_path.c_str()))
+  {
+    OutputDebugStringA("RunBenchmark: failed to read capture file!\n");
+    return -1;
+  }
+
+  // timer_lateness results need the 1ms system timer, same as XboxController::Initialize sets
+  timeBeginPeriod(1);
+  auto results = RunTranslatorBenchmark(capture);
+  timeEndPeriod(1);
+  if (!results.size())
+  {
+    OutputDebugStringA("RunBenchmark: capture doesn't contain any input reports!\n");
+    return -1;
+  }
+
+  RunComponentBenchmarks(capture, results);
+
+  if (baseline_path.length() && !LoadBenchmarkBaseline(baseline_path.c_str(), results))
+    OutputDebugStringA("RunBenchmark: failed to read baseline results!\n");
+
+  return WriteBenchmarkResults(output_path.c_str(), results, BENCHMARK_REGRESSION_THRESHOLD_PCT);
+}
+
 int APIENTRY _tWinMain(_In_ HINSTANCE hInstance,
   _In_opt_ HINSTANCE hPrevInstance,
   _In_ LPTSTR    lpCmdLine,
@@ -473,24 +645,78 @@ int APIENTRY _tWinMain(_In_ HINSTANCE hInstance,
   ini_path[len - 1] = 'i';
 
   // Read in & parse any button combinations from our INI
-  char* guideComboDefault = "LT + RT + LS + RS";
-  char guideCombo[256];
-
-  int ret = GetPrivateProfileStringA("Combinations", "GuideButton", guideComboDefault, guideCombo, 256, ini_path);
+  const char* guideComboDefault = "LT + RT + LS + RS";
+  std::string guideCombo = guideComboDefault;
 
   // Write out to INI & create it for us if it doesn't exist
-  if (GetFileAttributesA(ini_path) == -1)
-    WritePrivateProfileStringA("Combinations", "GuideButton", guideCombo, ini_path);
+  if (!ini_settings.Load(ini_path))
+    WritePrivateProfileStringA("Combinations", "GuideButton", guideComboDefault, ini_path);
+  else
+    ini_settings.Get("Combinations", "GuideButton", guideCombo);
 
-  combo_guideButton = ParseButtonCombination(guideCombo);
+  combo_guideButton = ParseButtonCombination(guideCombo.c_str());
+
+  // Extra combinations, read in order until one is missing
+  for (int i = 1; i <= COMBO_MAX; i++)
+  {
+    std::string comboText;
+    if (!ini_settings.Get("Combinations", "Combo" + std::to_string(i), comboText) || !comboText.length())
+      break;
+
+    ComboBinding binding;
+    if (ParseComboBinding(comboText, binding))
+      combo_bindings.push_back(binding);
+  }
 
   instance = hInstance;
   wcscpy_s(title, L"Xb2XInput");
   swprintf_s(tray_text, L"Xb2XInput - waiting for controller");
 
+  // Command-line options:
+  //   -capture <file>    record every controllers input reports & rumble events into <file>
+  //   -replay <file>     play a capture back into virtual controllers at its recorded speed, then exit
+  //   -benchmark <file>  time each stage of the report translation over a capture, then exit
+  //   -output <file>     where to write -benchmark results (default benchmark.json)
+  //   -baseline <file>   results from an earlier -benchmark run to compare against, exit code is the number of stages that got slower
+  std::string capture_path, replay_path, benchmark_path, baseline_path;
+  std::string output_path = "benchmark.json";
+
+  int argc = 0;
+  auto argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+  for (int i = 1; argv && i + 1 < argc; i += 2)
+  {
+    char value[4096];
+    WideCharToMultiByte(CP_ACP, 0, argv[i + 1], -1, value, sizeof(value), NULL, NULL);
+
+    if (!wcscmp(argv[i], L"-capture"))
+      capture_path = value;
+    else if (!wcscmp(argv[i], L"-replay"))
+      replay_path = value;
+    else if (!wcscmp(argv[i], L"-benchmark"))
+      benchmark_path = value;
+    else if (!wcscmp(argv[i], L"-output"))
+      output_path = value;
+    else if (!wcscmp(argv[i], L"-baseline"))
+      baseline_path = value;
+  }
+  LocalFree(argv);
+
+  if (benchmark_path.length())
+    return RunBenchmark(benchmark_path, output_path, baseline_path);
+
   if (!XboxController::Initialize(title))
     return 1;
 
+  if (replay_path.length())
+  {
+    int ret = XboxController::Replay(replay_path.c_str(), true);
+    XboxController::Close();
+    return ret;
+  }
+
+  if (capture_path.length() && !XboxController::StartCapture(capture_path.c_str()))
+    MessageBox(NULL, L"Failed to create capture file!", title, MB_OK);
+
   // Start our USB threads
   check_thread = std::thread(USBCheckThread);
   update_thread = std::thread(USBUpdateThread);
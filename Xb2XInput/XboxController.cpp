@@ -1,9 +1,8 @@
 #include "stdafx.hpp"
 #include "XboxController.hpp"
+#include <mmsystem.h>
 #include <vector>
 #include <mutex>
-#include <sstream>
-#include <iomanip>
 
 std::vector<std::pair<int, int>> xbox_devices =
 {
@@ -52,32 +51,18 @@ std::vector<std::pair<int, int>> xbox_devices =
 };
 
 UserSettings defaults_;
+std::mutex defaults_mutex_; // defaults_ can be changed by ReloadSettings while a controller is being added
 
 // Xb2XInput.cpp externs
 void USBDeviceChanged(const XboxController& controller, bool added);
 extern char ini_path[4096];
+extern IniDocument ini_settings;
 extern int poll_ms;
 
-extern int combo_guideButton;
-extern int combo_deadzoneIncrease;
-extern int combo_deadzoneDecrease;
-
-// Hacky defines to help with remap stuff
-#define XUSB_GAMEPAD_Start XUSB_GAMEPAD_START
-#define XUSB_GAMEPAD_Back XUSB_GAMEPAD_BACK
-#define XUSB_GAMEPAD_LS XUSB_GAMEPAD_LEFT_THUMB
-#define XUSB_GAMEPAD_RS XUSB_GAMEPAD_RIGHT_THUMB
-#define XUSB_GAMEPAD_White XUSB_GAMEPAD_LEFT_SHOULDER
-#define XUSB_GAMEPAD_Black XUSB_GAMEPAD_RIGHT_SHOULDER
-
-#define XUSB_GAMEPAD_DpadUp XUSB_GAMEPAD_DPAD_UP
-#define XUSB_GAMEPAD_DpadDown XUSB_GAMEPAD_DPAD_DOWN
-#define XUSB_GAMEPAD_DpadLeft XUSB_GAMEPAD_DPAD_LEFT
-#define XUSB_GAMEPAD_DpadRight XUSB_GAMEPAD_DPAD_RIGHT
-
 void dbgprintf(const char* format, ...)
 {
-  static char buffer[256];
+  // not static, controllers can be brought up on several threads at once
+  char buffer[256];
   va_list args;
   va_start(args, format);
   vsprintf_s(buffer, format, args);
@@ -86,66 +71,173 @@ void dbgprintf(const char* format, ...)
 }
 
 PVIGEM_CLIENT vigem;
-std::vector<XboxController> controllers_;
+
+// controllers can be read from any thread without locking, controller_mutex_ is held by whatever adds/removes them
+// (& by the USB update thread while it updates them, so they can't be closed out from under it)
+SlotRegistry<XboxController> controllers_;
 std::mutex controller_mutex_;
-std::mutex usb_mutex_;
 std::mutex vigem_alloc_mutex_;
 
-libusb_device_handle* XboxController::OpenDevice()
+// records controller input/rumble if Xb2XInput was started with -capture
+CaptureWriter capture_;
+
+// turbo/macro updates between input reports, ran by the USB update thread
+TimerWheel timers_;
+
+// sends every controllers reports together once per tick if [Options] BatchReportsMs is set, otherwise unused
+ReportBatcher batcher_;
+int batch_tick_ms_ = 0;
+
+// ViGEm targets made ahead of time by a background thread, so attaching a controller only has to plug one in
+WarmPool<PVIGEM_TARGET> target_pool_;
+
+// USB devices OpenDevice has already looked at, so it only has to check new ones
+// scanned_devices_ is the device list from the last scan, kept around so none of the known devices get freed (& their
+// libusb_device* reused for something new) until they're gone from the bus
+DeviceScanner<libusb_device*> device_scanner_;
+libusb_device** scanned_devices_ = nullptr;
+
+// INI changes get written by this in the background, so the USB update thread/tray never wait on file I/O
+SettingsJournal settings_journal_;
+
+// reloads settings whenever the INI gets changed
+FileWatcher settings_watcher_;
+
+// what bring-up found out about controllers seen before, kept next to the INI as Xb2XInput.cache
+DescriptorCache descriptor_cache_;
+
+int XboxController::OpenDevice()
 {
-  libusb_device_handle* ret = nullptr;
   libusb_device **devs;
-  libusb_device_descriptor desc;
   uint8_t usb_ports[32];
 
+  // controllers cache their descriptors once their strings have been read, written out here since this isn't the USB update thread
+  descriptor_cache_.Save();
+
   auto num_devices = libusb_get_device_list(NULL, &devs);
-  for (int i = 0; i < num_devices; i++)
+  if (num_devices < 0)
+    return 0;
+
+  // Every new controller on the bus gets added in one go (eg. a hub full of them plugged in at once)
+  struct NewDevice {
+    libusb_device* device;
+    std::vector<uint8_t> ports;
+    std::unique_ptr<XboxController> controller;
+  };
+
+  // only devices that weren't on the bus last time get checked, returning false has it checked again next time
+  // Bring-up (open, claim, descriptors, settings) is mostly waiting on the controller, so they're all brought up at once
+  // & take about as long as the slowest one, anything that fails is checked again by the next scan
+  std::vector<libusb_device*> current(devs, devs + num_devices);
+  int added_count = AttachNewDevices<NewDevice>(device_scanner_, current, ATTACH_MAX_THREADS,
+    [&](libusb_device* device, std::vector<NewDevice>& new_devices)
   {
-    libusb_get_device_descriptor(devs[i], &desc);
+    libusb_device_descriptor desc;
+    if (libusb_get_device_descriptor(device, &desc) != 0)
+      return false;
 
     bool found = false;
-    for (auto device : xbox_devices)
+    for (auto xbox_device : xbox_devices)
     {
-      if (desc.idVendor == device.first && desc.idProduct == device.second)
+      if (desc.idVendor == xbox_device.first && desc.idProduct == xbox_device.second)
       {
         found = true;
         break;
       }
     }
     if (!found)
-      continue;
+      return true;
 
     // check if we're already handling this device
     // (have to check USB port info since libusb_claim_interface doesn't seem to work...)
-    bool exists = false;
-    int num_ports = libusb_get_port_numbers(devs[i], (uint8_t*)&usb_ports, 32);
-    for (auto& controller : controllers_)
+    // if we are it's most likely been replugged before we noticed the old one going away, so look at it again next time
+    int num_ports = libusb_get_port_numbers(device, usb_ports, sizeof(usb_ports));
+    if (num_ports < 0)
+      num_ports = 0;
+
+    // controllers are indexed by port path when they're added (& unindexed when removed), so this doesn't have to look
+    // through every controller for every device on the bus
     {
-      auto& cnt_ports = controller.usb_ports_;
-      if (cnt_ports.size() == num_ports && !memcmp(cnt_ports.data(), &usb_ports, cnt_ports.size()))
-      {
-        exists = true;
-        break;
-      }
+      auto pin = controllers_.Pin();
+      if (UsbPortInUse(controllers_, libusb_get_bus_number(device), usb_ports, num_ports,
+        [](XboxController& controller) -> const std::vector<uint8_t>& { return controller.usb_ports_; }))
+        return false;
     }
-    if (exists)
-      continue;
 
-    // open USB device by libusb_device* returned from device list
-    if (libusb_open(devs[i],&ret))
-      continue;
+    // brought up below, forgotten again if that fails
+    NewDevice new_device;
+    new_device.device = device;
+    new_device.ports.assign(usb_ports, usb_ports + num_ports);
+    new_devices.push_back(std::move(new_device));
+    return true;
+  },
+  [](NewDevice& new_device)
+  {
+    libusb_device_handle* handle = nullptr;
+    if (libusb_open(new_device.device, &handle))
+      return false;
 
-    auto controller = XboxController(ret, (uint8_t*)&usb_ports, num_ports);
+    new_device.controller = std::make_unique<XboxController>(handle, new_device.ports.data(), (int)new_device.ports.size());
+    return true;
+  },
+  [](NewDevice& new_device)
+  {
+    auto handle = new_device.controller->usb_handle_;
     std::lock_guard<std::mutex> guard(controller_mutex_);
 
-    controllers_.push_back(controller);
+    // controller stays at the same address for as long as it's registered
+    auto added = new_device.controller.get();
+    added->id_ = controllers_.Add(std::move(new_device.controller));
+    if (!added->id_)
+    {
+      // no free slots, controller has already been freed
+      libusb_close(handle);
+      return false;
+    }
+    controllers_.SetKey(added->port_key_, added->id_);
+
+    USBDeviceChanged(*added, true);
+    return true;
+  });
+
+  // list keeps the known devices referenced until the next scan has its own
+  if (scanned_devices_)
+    libusb_free_device_list(scanned_devices_, 1);
+  scanned_devices_ = devs;
+
+  return added_count;
+}
+
+void XboxController::DevicesChanged()
+{
+  device_scanner_.Wake();
+}
 
-    USBDeviceChanged(controller, true);
+void XboxController::WaitForDeviceChange()
+{
+  device_scanner_.Wait(DEVICE_SCAN_POLL_MS);
+}
 
-    return ret;
+int LIBUSB_CALL XboxController::OnHotplug(libusb_context* ctx, libusb_device* device, libusb_hotplug_event event, void* user_data)
+{
+  if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED)
+  {
+    // opening it is left to the check thread, callbacks shouldn't do any I/O
+    device_scanner_.Wake();
+    return 0;
   }
 
-  return ret;
+  // Runs on the USB update thread (inside HandleEvents), so the controller can be flagged the same way a failed transfer
+  // would, UpdateAll then removes it
+  uint8_t ports[7];
+  int num_ports = libusb_get_port_numbers(device, ports, sizeof(ports));
+
+  auto pin = controllers_.Pin();
+  auto controller = controllers_.Find(PortKey(libusb_get_bus_number(device), ports, num_ports));
+  if (controller && libusb_get_device(controller->usb_handle_) == device)
+    controller->disconnected_ = controller->unplugged_ = true;
+
+  return 0;
 }
 
 UserSettings XboxController::LoadSettings(const std::string& ini_key, const UserSettings& defaults)
@@ -153,20 +245,37 @@ UserSettings XboxController::LoadSettings(const std::string& ini_key, const User
   UserSettings ret;
 
   ret.guide_enabled = GetSettingBool("EnableGuide", defaults.guide_enabled, ini_key);
-
-  if (ret.guide_enabled == defaults.guide_enabled) // write setting to ini if this == default, in case it didn't already exist
-    SetSetting("EnableGuide", ret.guide_enabled ? "true" : "false", ini_key);
-
   ret.vibration_enabled = GetSettingBool("EnableVibration", defaults.vibration_enabled, ini_key);
 
-  if (ret.vibration_enabled == defaults.vibration_enabled) // write setting to ini if this == default, in case it didn't already exist
-    SetSetting("EnableVibration", ret.vibration_enabled ? "true" : "false", ini_key); // write setting to ini if this == default, in case it didn't already exist
-
   ret.deadzone.sThumbL = min(max(GetSettingInt("DeadzoneLeftStick", defaults.deadzone.sThumbL, ini_key), 0), SHRT_MAX);
   ret.deadzone.sThumbR = min(max(GetSettingInt("DeadzoneRightStick", defaults.deadzone.sThumbR, ini_key), 0), SHRT_MAX);
   ret.deadzone.bLeftTrigger = min(max(GetSettingInt("DeadzoneLeftTrigger", defaults.deadzone.bLeftTrigger, ini_key), 0), 0xFF);
   ret.deadzone.bRightTrigger = min(max(GetSettingInt("DeadzoneRightTrigger", defaults.deadzone.bRightTrigger, ini_key), 0), 0xFF);
 
+  // Response curves, Curve* is the curve type, (Outer|Anti)Deadzone* are in the same units as Deadzone*
+  static const char* curve_names[CURVE_COUNT] = { "LeftStick", "RightStick", "LeftTrigger", "RightTrigger" };
+  for (int i = 0; i < CURVE_COUNT; i++)
+  {
+    int curve_max = i < CURVE_LEFT_TRIGGER ? SHRT_MAX : 0xFF;
+    ret.curves[i] = defaults.curves[i];
+
+    auto curve = GetSettingString(std::string("Curve") + curve_names[i], "", ini_key);
+    if (curve.length() && !ParseResponseCurve(curve, ret.curves[i]))
+      dbgprintf("LoadSettings: [%s] Curve%s \"%s\" isn't a valid curve, ignoring\n", ini_key.c_str(), curve_names[i], curve.c_str());
+
+    ret.curves[i].outer_deadzone = min(max(GetSettingInt(std::string("OuterDeadzone") + curve_names[i], defaults.curves[i].outer_deadzone, ini_key), 0), curve_max);
+    ret.curves[i].anti_deadzone = min(max(GetSettingInt(std::string("AntiDeadzone") + curve_names[i], defaults.curves[i].anti_deadzone, ini_key), 0), curve_max);
+  }
+
+  int ParseButtonCombination(const char* combo); // Xb2XInput.cpp
+
+  // Turbo, buttons are a combination like Remap* settings
+  ret.turbo_buttons = defaults.turbo_buttons;
+  auto turbo = GetSettingString("TurboButtons", "", ini_key);
+  if (turbo.length())
+    ret.turbo_buttons = ParseButtonCombination(turbo.c_str());
+  ret.turbo_rate = min(max(GetSettingInt("TurboRate", defaults.turbo_rate, ini_key), 1), 100);
+
   ret.button_remap.clear();
   if (defaults.remap_enabled)
     ret.button_remap = defaults.button_remap;
@@ -177,8 +286,6 @@ UserSettings XboxController::LoadSettings(const std::string& ini_key, const User
   {
     std::string remap;
 
-    int ParseButtonCombination(const char* combo); // Xb2XInput.cpp
-
     // TODO: if RemapEnable, should we SetSetting for all of these so INI is populated with the proper Remap* settings?
 #define LoadMap(btn) \
     remap = GetSettingString("Remap" #btn, "", ini_key); \
@@ -212,19 +319,101 @@ UserSettings XboxController::LoadSettings(const std::string& ini_key, const User
   return ret;
 }
 
+UserSettings XboxController::loadDefaultSettings()
+{
+  UserSettings defaults;
+  defaults.guide_enabled = true;
+  defaults.vibration_enabled = true;
+  defaults.deadzone = { 0 };
+  defaults.remap_enabled = false;
+
+  return LoadSettings("Default", defaults);
+}
+
+UserSettings XboxController::loadControllerSettings()
+{
+  UserSettings settings;
+  {
+    std::lock_guard<std::mutex> guard(defaults_mutex_);
+    settings = defaults_;
+  }
+
+  // [serial] inherits from [VID:PID] which inherits from [Default]
+  if (GetSerialNo().length())
+  {
+    char vidpid[16];
+    sprintf_s(vidpid, "%04x:%04x", usb_desc_.idVendor, usb_desc_.idProduct);
+    if (ini_settings.HasSection(vidpid))
+      settings = LoadSettings(vidpid, settings);
+  }
+
+  return LoadSettings(iniKey(), settings);
+}
+
+void XboxController::reloadSettings()
+{
+  // called by ReloadSettings & once the serial no. has been read, which can be on different threads
+  std::lock_guard<std::mutex> guard(loaded_settings_mutex_);
+  auto settings = loadControllerSettings();
+  if (settings == loaded_settings_)
+    return;
+
+  loaded_settings_ = settings;
+  settings_.Publish(settings);
+}
+
+std::string XboxController::iniKey() const
+{
+  // Use serial no. as INI key if controller has one, else VID/PID
+  auto serial = GetSerialNo();
+  if (serial.length())
+    return serial;
+
+  char vidpid[16];
+  sprintf_s(vidpid, "%04x:%04x", usb_desc_.idVendor, usb_desc_.idProduct);
+  return vidpid;
+}
+
+void XboxController::ReloadSettings()
+{
+  // Runs on the settings watcher thread once the INI has changed
+  // anything we haven't written yet needs to be in the INI first, otherwise reloading would undo it
+  settings_journal_.Flush();
+  ini_settings.Load(ini_path);
+
+  auto defaults = loadDefaultSettings();
+  {
+    std::lock_guard<std::mutex> guard(defaults_mutex_);
+    defaults_ = defaults;
+  }
+
+  // Each controller picks up its new settings before translating its next report
+  auto pin = controllers_.Pin();
+  controllers_.ForEach([](RegistryId id, XboxController& controller)
+  {
+    controller.reloadSettings();
+  });
+
+  dbgprintf(__FUNCTION__ ": reloaded %s", ini_path);
+}
+
 bool XboxController::Initialize(WCHAR* app_title)
 {
   static bool inited = false;
   if (inited)
     return true;
 
-  // Load default INI settings
-  defaults_.guide_enabled = true;
-  defaults_.vibration_enabled = true;
-  defaults_.deadzone = { 0 };
-  defaults_.remap_enabled = false;
+  settings_journal_.Open(ini_path);
 
-  defaults_ = LoadSettings("Default", defaults_);
+  std::string cache_path = ini_path;
+  descriptor_cache_.Load(cache_path.substr(0, cache_path.rfind('.')) + ".cache");
+
+  defaults_ = loadDefaultSettings();
+  settings_watcher_.Start(ini_path, XboxController::ReloadSettings);
+
+  // turbo/macro timers are only as accurate as the system timer, default 15.6ms is far too coarse for them
+  // (same goes for the batch submitter's ticks)
+  timeBeginPeriod(1);
 
   // Init libusb & ViGEm
   auto ret = libusb_init(NULL);
@@ -234,6 +423,13 @@ bool XboxController::Initialize(WCHAR* app_title)
     return false;
   }
 
+  // Where libusb supports hotplug events new devices wake up the check thread straight away, otherwise it relies on
+  // DevicesChanged being called (WM_DEVICECHANGE on Windows), with a poll every DEVICE_SCAN_POLL_MS in case both miss it
+  if (libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG))
+    libusb_hotplug_register_callback(NULL,
+      (libusb_hotplug_event)(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT), LIBUSB_HOTPLUG_NO_FLAGS,
+      LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY, LIBUSB_HOTPLUG_MATCH_ANY, XboxController::OnHotplug, nullptr, nullptr);
+
   vigem = vigem_alloc();
   const auto retval = vigem_connect(vigem);
   if (!vigem || !VIGEM_SUCCESS(retval))
@@ -244,6 +440,16 @@ bool XboxController::Initialize(WCHAR* app_title)
     return false;
   }
 
+  target_pool_.Start(VIGEM_TARGET_POOL_SIZE, XboxController::CreateTarget, XboxController::FreeTarget);
+
+  // Batched reports: every controllers newest report gets sent together on each tick, so local multiplayer inputs
+  // that happened at the same time reach games together, at the cost of up to a tick of extra latency
+  std::string batch_ms;
+  if (ini_settings.Get("Options", "BatchReportsMs", batch_ms))
+    batch_tick_ms_ = min(max(atoi(batch_ms.c_str()), 0), 100);
+  if (batch_tick_ms_)
+    batcher_.Start(batch_tick_ms_ * 1000ull, XboxController::OnBatchSubmit);
+
   inited = true;
   return true;
 }
@@ -251,67 +457,244 @@ bool XboxController::Initialize(WCHAR* app_title)
 void XboxController::UpdateAll()
 {
   std::lock_guard<std::mutex> guard(controller_mutex_);
-  auto iter = controllers_.begin();
-  while (iter != controllers_.end())
+
+  std::vector<RegistryId> disconnected;
+  {
+    auto pin = controllers_.Pin();
+    controllers_.ForEach([&disconnected](RegistryId id, XboxController& controller)
+    {
+      if (!controller.update())
+        disconnected.push_back(id);
+    });
+  }
+
+  for (auto id : disconnected)
   {
-    if (!iter->update())
     {
-      USBDeviceChanged(*iter, false);
+      auto pin = controllers_.Pin();
+      USBDeviceChanged(*controllers_.Get(id), false);
+    }
 
-      libusb_close(iter->usb_handle_);
+    // waits for any UI/notification threads that might still be using it
+    auto controller = controllers_.Remove(id);
 
-      std::lock_guard<std::mutex> vigem_guard(vigem_alloc_mutex_);
-      vigem_target_x360_unregister_notification(iter->target_);
-      vigem_target_remove(vigem, iter->target_);
-      vigem_target_free(iter->target_);
+    // make sure no transfers/timers are still referencing the controller before it gets freed
+    controller->StopTransfers();
+    timers_.Cancel(controller.get());
 
-      iter = controllers_.erase(iter);
+    // dropped while it's still plugged in (eg. bad reports, transfers couldn't be started), the scanner thinks it's
+    // done with the device so it has to be told to look at it again, otherwise it'd stay unused until it's replugged
+    if (!controller->unplugged_)
+    {
+      device_scanner_.Forget(libusb_get_device(controller->usb_handle_));
+      device_scanner_.Wake();
+    }
+    libusb_close(controller->usb_handle_);
+
+    // anything it's still got waiting to be batched can't be sent once the target's gone
+    batcher_.Remove(REGISTRY_ID_SLOT(id));
+
+    std::lock_guard<std::mutex> vigem_guard(vigem_alloc_mutex_);
+    if (controller->target_)
+    {
+      vigem_target_x360_unregister_notification(controller->target_);
+      vigem_target_remove(vigem, controller->target_);
+      vigem_target_free(controller->target_);
     }
-    else
-      ++iter;
   }
 }
 
+void XboxController::HandleEvents(int timeout_ms)
+{
+  // Dispatches any completed transfers to their callbacks, waiting up to timeout_ms for one to complete
+  // (or until the next turbo/macro timer is due, so RunTimers can handle it on time)
+  uint64_t timeout_us = timeout_ms * 1000ull;
+  uint64_t deadline = timers_.NextDeadline();
+  if (deadline != UINT64_MAX)
+  {
+    uint64_t now = TimerWheel::Now();
+    timeout_us = deadline <= now ? 0 : min(timeout_us, deadline - now);
+  }
+
+  timeval tv = { (long)(timeout_us / 1000000), (long)(timeout_us % 1000000) };
+  libusb_handle_events_timeout_completed(NULL, &tv, NULL);
+}
+
+void XboxController::RunTimers()
+{
+  // controller_mutex_ makes sure the controllers aren't being removed while their timers run
+  std::lock_guard<std::mutex> guard(controller_mutex_);
+  timers_.Advance(TimerWheel::Now());
+}
+
 void XboxController::Close()
 {
   std::lock_guard<std::mutex> guard(controller_mutex_);
-  std::lock_guard<std::mutex> vigem_guard(vigem_alloc_mutex_);
 
-  for (auto& controller : controllers_)
+  // sends out anything still batched, while the targets are still around to send it to
+  batcher_.Stop();
+
+  std::vector<RegistryId> ids;
+  {
+    auto pin = controllers_.Pin();
+    controllers_.ForEach([&ids](RegistryId id, XboxController& controller) { ids.push_back(id); });
+  }
+
+  for (auto id : ids)
   {
-    vigem_target_x360_unregister_notification(controller.target_);
-    vigem_target_remove(vigem, controller.target_);
-    vigem_target_free(controller.target_);
+    auto controller = controllers_.Remove(id);
+    controller->StopTransfers();
+    timers_.Cancel(controller.get());
+
+    std::lock_guard<std::mutex> vigem_guard(vigem_alloc_mutex_);
+    if (controller->target_)
+    {
+      vigem_target_x360_unregister_notification(controller->target_);
+      vigem_target_remove(vigem, controller->target_);
+      vigem_target_free(controller->target_);
+    }
   }
-  controllers_.clear();
+
+  // targets nobody took never got plugged in, they just need freeing
+  target_pool_.Stop();
+
+  descriptor_cache_.Save();
 
   vigem_free(vigem);
+
+  capture_.Close();
+  settings_watcher_.Stop();
+  settings_journal_.Close();
+  timeEndPeriod(1);
+}
+
+bool XboxController::StartCapture(const char* path)
+{
+  return capture_.Open(path);
+}
+
+int XboxController::Replay(const char* path, bool realtime)
+{
+  CaptureReader capture;
+  if (!capture.Open(path))
+  {
+    dbgprintf(__FUNCTION__ ": failed to read capture file %s", path);
+    return 1;
+  }
+
+  // Create a virtual controller for each controller in the capture as its first report comes in
+  std::unordered_map<int, PVIGEM_TARGET> targets;
+  UserSettings defaults;
+  {
+    std::lock_guard<std::mutex> guard(defaults_mutex_);
+    defaults = defaults_;
+  }
+
+  auto count = ReplayCapture(capture, defaults, realtime, [&targets](int controller, const XUSB_REPORT& report)
+  {
+    if (!targets.count(controller))
+    {
+      auto target = vigem_target_x360_alloc();
+      if (!VIGEM_SUCCESS(vigem_target_add(vigem, target)))
+      {
+        vigem_target_free(target);
+        target = nullptr;
+      }
+      targets[controller] = target;
+    }
+
+    auto target = targets[controller];
+    if (target)
+      vigem_target_x360_update(vigem, target, report);
+  });
+
+  for (auto& target : targets)
+  {
+    if (!target.second)
+      continue;
+
+    vigem_target_remove(vigem, target.second);
+    vigem_target_free(target.second);
+  }
+
+  dbgprintf(__FUNCTION__ ": replayed %d reports from %s", (int)count, path);
+  return 0;
 }
 
-std::vector<XboxController>& XboxController::GetControllers()
+SlotRegistry<XboxController>& XboxController::Controllers()
 {
   return controllers_;
 }
 
-XboxController::XboxController(libusb_device_handle* handle, uint8_t* usb_ports, int num_ports) : usb_handle_(handle) {
-  usb_productname_[0] = 0;
-  usb_vendorname_[0] = 0;
-  usb_serialno_[0] = 0;
+int XboxController::GetBatchTick()
+{
+  return batcher_.Running() ? batch_tick_ms_ : 0;
+}
+
+BatchStats XboxController::GetBatchStats()
+{
+  return batcher_.Stats();
+}
 
-  usb_ports_.resize(num_ports);
-  memcpy(usb_ports_.data(), usb_ports, num_ports);
+XboxController::XboxController(libusb_device_handle* handle, uint8_t* usb_ports, int num_ports) : usb_handle_(handle) {
+  usb_ports_.assign(usb_ports, usb_ports + num_ports);
 
   // try getting USB product info
   auto* dev = libusb_get_device(handle);
   if (!dev)
     return;
 
+  port_key_ = PortKey(libusb_get_bus_number(dev), usb_ports, num_ports);
+
   if (libusb_get_device_descriptor(dev, &usb_desc_) != 0)
     return;
 
+  // a controller that's been on this port before can skip straight to claiming its interface
+  CachedDescriptor cached;
+  if (port_key_)
+    descriptor_key_ = DescriptorCache::Key(usb_desc_.idVendor, usb_desc_.idProduct, port_key_);
+  if (descriptor_key_.length() && descriptor_cache_.Find(descriptor_key_, describe(), cached))
+  {
+    usb_iface_num_ = cached.iface_num;
+    usb_iface_setting_num_ = cached.iface_setting_num;
+    endpoint_in_ = cached.endpoint_in;
+    endpoint_out_ = cached.endpoint_out;
+    string_langid_ = cached.langid;
+    usb_productname_ = cached.product;
+    usb_vendorname_ = cached.vendor;
+
+    // serial no. isn't cached, it's what tells apart different controllers of the same model on this port, so it's
+    // always read from the controller itself (the other strings are skipped)
+    string_step_ = STRING_SERIAL;
+  }
+  else
+    findEndpoints(dev);
+
+  // if we have interrupt endpoints then we have to claim the interface & set altsetting in order to use them
+  if (endpoint_in_ || endpoint_out_)
+  {
+    libusb_claim_interface(handle, usb_iface_num_);
+    libusb_set_interface_alt_setting(handle, usb_iface_num_, usb_iface_setting_num_);
+  }
+
+  // USB strings are left until input has started (see requestStrings), settings are loaded by VID/PID until then
+
+  // Read in INI settings for this controller
+  loaded_settings_ = loadControllerSettings();
+  settings_version_ = settings_.Publish(loaded_settings_);
+  translator_.SetSettings(loaded_settings_);
+
+  usb_product_ = usb_desc_.idProduct;
+  usb_vendor_ = usb_desc_.idVendor;
+}
+
+void XboxController::findEndpoints(libusb_device* dev)
+{
   // try finding interrupt/bulk endpoints
   struct libusb_config_descriptor *conf_desc;
-  libusb_get_config_descriptor(dev, 0, &conf_desc);
+  if (libusb_get_config_descriptor(dev, 0, &conf_desc) != 0)
+    return;
+
   int nb_ifaces = conf_desc->bNumInterfaces;
   for (int i = 0; i < nb_ifaces; i++)
   {
@@ -342,129 +725,398 @@ XboxController::XboxController(libusb_device_handle* handle, uint8_t* usb_ports,
     }
   }
   libusb_free_config_descriptor(conf_desc);
+}
+
+// XboxController::describe: descriptor_cache_ entry for this controller, with whatever's been found out so far
+CachedDescriptor XboxController::describe() const
+{
+  CachedDescriptor descriptor;
+  descriptor.bcd_device = usb_desc_.bcdDevice;
+  descriptor.num_configurations = usb_desc_.bNumConfigurations;
+  descriptor.product_index = usb_desc_.iProduct;
+  descriptor.vendor_index = usb_desc_.iManufacturer;
+  descriptor.serial_index = usb_desc_.iSerialNumber;
+  descriptor.iface_num = (uint8_t)usb_iface_num_;
+  descriptor.iface_setting_num = (uint8_t)usb_iface_setting_num_;
+  descriptor.endpoint_in = endpoint_in_;
+  descriptor.endpoint_out = endpoint_out_;
+  descriptor.langid = string_langid_;
+
+  std::lock_guard<std::mutex> guard(strings_mutex_);
+  descriptor.product = usb_productname_;
+  descriptor.vendor = usb_vendorname_;
+  return descriptor;
+}
+
+XboxController::~XboxController()
+{
+  closing_ = true;
+  active_ = false;
+
+  StopTransfers();
+}
+
+bool XboxController::StartTransfers()
+{
+  return input_transfers_.Start();
+}
+
+bool XboxController::PrepareTransfer(int index)
+{
+  if (!input_usb_transfers_[index])
+    input_usb_transfers_[index] = libusb_alloc_transfer(0);
+
+  if (!input_usb_transfers_[index])
+    return false;
+
+  // no timeout, transfer will complete once the controller has a report for us
+  libusb_fill_interrupt_transfer(input_usb_transfers_[index], usb_handle_, endpoint_in_,
+    (unsigned char*)&input_buffers_[index], sizeof(XboxInputReport), XboxController::OnInputTransfer, this, 0);
+  return true;
+}
+
+int XboxController::SubmitTransfer(int index)
+{
+  auto ret = libusb_submit_transfer(input_usb_transfers_[index]);
+  if (ret < 0)
+    dbgprintf(__FUNCTION__ ": failed to submit input transfer (code %d)", ret);
+  return ret;
+}
+
+void XboxController::CancelTransfer(int index)
+{
+  if (input_usb_transfers_[index])
+    libusb_cancel_transfer(input_usb_transfers_[index]);
+}
+
+void XboxController::FreeTransfer(int index)
+{
+  if (input_usb_transfers_[index])
+    libusb_free_transfer(input_usb_transfers_[index]);
+  input_usb_transfers_[index] = nullptr;
+}
+
+void XboxController::StopTransfers()
+{
+  closing_ = true;
+
+  // waits for the input transfers to finish calling back, rumble/strings can't send anything new now closing_ is set
+  input_transfers_.Stop();
 
-  // if we have interrupt endpoints then we have to claim the interface & set altsetting in order to use them
-  if (endpoint_in_ || endpoint_out_)
   {
-    libusb_claim_interface(handle, usb_iface_num_);
-    libusb_set_interface_alt_setting(handle, usb_iface_num_, usb_iface_setting_num_);
+    // closing_ stops submitRumble from sending anything new once we've got the lock
+    std::lock_guard<std::mutex> guard(rumble_mutex_);
+    if (rumble_in_flight_)
+      libusb_cancel_transfer(rumble_transfer_);
   }
 
-  libusb_get_string_descriptor_ascii(handle, usb_desc_.iProduct, (unsigned char*)usb_productname_, sizeof(usb_productname_));
-  libusb_get_string_descriptor_ascii(handle, usb_desc_.iManufacturer, (unsigned char*)usb_vendorname_, sizeof(usb_vendorname_));
-  libusb_get_string_descriptor_ascii(handle, usb_desc_.iSerialNumber, (unsigned char*)usb_serialno_, sizeof(usb_serialno_));
+  if (string_in_flight_)
+    libusb_cancel_transfer(string_transfer_);
 
-  // Use serial no. as INI key if controller has one, else VID/PID
-  std::stringstream ss;
-  if (strlen(usb_serialno_))
-    ss << usb_serialno_;
-  else
+  // wait for the cancelled transfers to call back before freeing them
+  while (rumble_in_flight_ || string_in_flight_)
+    HandleEvents(100);
+
+  if (rumble_transfer_)
+    libusb_free_transfer(rumble_transfer_);
+  rumble_transfer_ = nullptr;
+
+  if (string_transfer_)
+    libusb_free_transfer(string_transfer_);
+  string_transfer_ = nullptr;
+}
+
+void LIBUSB_CALL XboxController::OnInputTransfer(libusb_transfer* transfer)
+{
+  auto* controller = (XboxController*)transfer->user_data;
+
+  int index = 0;
+  while (index < INPUT_TRANSFER_COUNT - 1 && controller->input_usb_transfers_[index] != transfer)
+    index++;
+
+  InputTransferStatus status = INPUT_TRANSFER_ERROR;
+  switch (transfer->status)
   {
-    ss << std::setfill('0') << std::setw(4) <<
-      std::hex << usb_desc_.idVendor;
-    ss << ':';
-    ss << std::setfill('0') << std::setw(4) <<
-      std::hex << usb_desc_.idProduct;
+  case LIBUSB_TRANSFER_COMPLETED:
+    status = INPUT_TRANSFER_COMPLETED;
+    break;
+  case LIBUSB_TRANSFER_NO_DEVICE:
+    status = INPUT_TRANSFER_NO_DEVICE;
+    controller->disconnected_ = controller->unplugged_ = true;
+    break;
+  case LIBUSB_TRANSFER_CANCELLED:
+    status = INPUT_TRANSFER_CANCELLED;
+    break;
   }
 
-  ini_key_ = ss.str();
+  controller->input_transfers_.Completed(index, status, [controller, transfer]() {
+    if (controller->closing_ || controller->disconnected_)
+      return false;
 
-  // Read in INI settings for this controller
-  settings_ = LoadSettings(ini_key_, defaults_);
+    memset(&controller->input_prev_, 0, sizeof(XboxInputReport));
+    memcpy(&controller->input_prev_, transfer->buffer, min(transfer->actual_length, (int)sizeof(XboxInputReport)));
 
-  usb_product_ = usb_desc_.idProduct;
-  usb_vendor_ = usb_desc_.idVendor;
+    if (!controller->processInput())
+    {
+      controller->disconnected_ = true;
+      return false;
+    }
+    return true;
+  });
 }
 
-XboxController::~XboxController()
+void XboxController::requestStrings()
 {
-  closing_ = true;
-  active_ = false;
+  // Called by update once input has started, strings are then read one at a time by OnStringTransfer
+  if (strings_requested_)
+    return;
+  strings_requested_ = true;
+
+  if (!fetchString())
+    stringsFetched();
 }
 
-void CALLBACK XboxController::OnVigemNotification(PVIGEM_CLIENT Client, PVIGEM_TARGET Target, UCHAR LargeMotor, UCHAR SmallMotor, UCHAR LedNumber)
+// XboxController::fetchString: requests the next descriptor the controller has from string_step_ onwards, returns false once there's none left
+bool XboxController::fetchString()
 {
-  for (auto& controller : controllers_)
+  const uint8_t indexes[STRING_COUNT] = { 0, usb_desc_.iProduct, usb_desc_.iManufacturer, usb_desc_.iSerialNumber };
+
+  for (; string_step_ < STRING_COUNT; string_step_++)
   {
-    if (controller.target_ != Target)
+    // index 0 is the language ID list, for the rest it means the controller doesn't have that string
+    if (string_step_ != STRING_LANGID && !indexes[string_step_])
       continue;
 
-    if (!controller.settings_.vibration_enabled)
-      LargeMotor = SmallMotor = 0;
+    if (closing_ || disconnected_)
+      return false;
+
+    if (!string_transfer_)
+      string_transfer_ = libusb_alloc_transfer(0);
+    if (!string_transfer_)
+      return false;
 
-    memset(&controller.output_prev_, 0, sizeof(XboxOutputReport));
-    controller.output_prev_.bSize = sizeof(XboxOutputReport);
-    controller.output_prev_.Rumble.wLeftMotorSpeed = _byteswap_ushort(LargeMotor); // why do these need to be byteswapped???
-    controller.output_prev_.Rumble.wRightMotorSpeed = _byteswap_ushort(SmallMotor);
+    libusb_fill_control_setup(string_buffer_, LIBUSB_ENDPOINT_IN, LIBUSB_REQUEST_GET_DESCRIPTOR,
+      (LIBUSB_DT_STRING << 8) | indexes[string_step_], string_langid_, sizeof(string_buffer_) - LIBUSB_CONTROL_SETUP_SIZE);
+    libusb_fill_control_transfer(string_transfer_, usb_handle_, string_buffer_,
+      XboxController::OnStringTransfer, this, STRING_TRANSFER_TIMEOUT_MS);
 
+    string_in_flight_ = true;
+    auto ret = libusb_submit_transfer(string_transfer_);
+    if (ret < 0)
     {
-      std::lock_guard<std::mutex> guard(usb_mutex_);
-      libusb_control_transfer(controller.usb_handle_, LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE,
-        HID_SET_REPORT, (HID_REPORT_TYPE_OUTPUT << 8) | 0x00, 0, (unsigned char*)&controller.output_prev_, sizeof(XboxOutputReport), 1000);
+      string_in_flight_ = false;
+      dbgprintf(__FUNCTION__ ": failed to submit string transfer (code %d)", ret);
+      return false;
     }
-
-    break;
+    return true;
   }
+
+  return false;
 }
 
-int XboxController::GetUserIndex() {
-  if (vigem && target_)
+void XboxController::stringsFetched()
+{
+  if (closing_)
+    return;
+
+  // settings were loaded by VID/PID until now, a controller with a serial no. might have its own
+  reloadSettings();
+
+  // only cached once everything's been read, anything that failed gets probed again next time
+  if (descriptor_key_.length() && string_step_ >= STRING_COUNT && !strings_failed_ && !disconnected_)
+    descriptor_cache_.Store(descriptor_key_, describe());
+}
+
+void LIBUSB_CALL XboxController::OnStringTransfer(libusb_transfer* transfer)
+{
+  auto* controller = (XboxController*)transfer->user_data;
+  controller->string_in_flight_ = false;
+
+  switch (transfer->status)
   {
-    ULONG idx = 0;
-    if (VIGEM_SUCCESS(vigem_target_x360_get_user_index(vigem, target_, &idx)))
-      return idx;
+  case LIBUSB_TRANSFER_COMPLETED:
+  {
+    // string descriptors are UTF-16LE, anything outside ASCII becomes '?' like libusb_get_string_descriptor_ascii
+    auto* data = libusb_control_transfer_get_data(transfer);
+    int length = transfer->actual_length;
+    if (length >= 2 && data[1] == LIBUSB_DT_STRING)
+      length = min(length, (int)data[0]);
+    else
+      length = 0;
+
+    if (controller->string_step_ == STRING_LANGID)
+    {
+      if (length < 4)
+      {
+        // no languages, so no strings either
+        controller->string_step_ = STRING_COUNT;
+        break;
+      }
+      controller->string_langid_ = data[2] | (data[3] << 8);
+      break;
+    }
+
+    std::string string;
+    for (int i = 2; i + 1 < length; i += 2)
+      string += (data[i + 1] || (data[i] & 0x80)) ? '?' : (char)data[i];
+
+    std::string* strings[STRING_COUNT] = { nullptr, &controller->usb_productname_, &controller->usb_vendorname_, &controller->usb_serialno_ };
+    std::lock_guard<std::mutex> guard(controller->strings_mutex_);
+    *strings[controller->string_step_] = string;
+    break;
   }
-  return -1;
+  case LIBUSB_TRANSFER_NO_DEVICE:
+    controller->disconnected_ = controller->unplugged_ = true;
+    return;
+  case LIBUSB_TRANSFER_CANCELLED:
+    return;
+  default:
+    // timeout/stall/error, that string is left as it is (or all of them if it was the language ID)
+    dbgprintf(__FUNCTION__ ": string descriptor %d failed (status %d)", controller->string_step_, transfer->status);
+    controller->strings_failed_ = true;
+    if (controller->string_step_ == STRING_LANGID)
+      controller->string_step_ = STRING_COUNT;
+    break;
+  }
+
+  if (controller->string_step_ < STRING_COUNT)
+    controller->string_step_++;
+  if (!controller->fetchString())
+    controller->stringsFetched();
+}
+
+void XboxController::queueRumble(UCHAR large_motor, UCHAR small_motor)
+{
+  // Called from the ViGEm notification thread, never waits on the device
+  // if a rumble transfer is already in-flight the shaper holds onto the newest update, which gets sent once it completes
+  std::lock_guard<std::mutex> guard(rumble_mutex_);
+  if (!rumble_shaper_.Push(large_motor, small_motor))
+    return;
+
+  // woken so the USB update thread doesn't sleep through the timer for this, if submitRumble had to set one
+  if (!rumble_in_flight_ && !submitRumble() && rumble_timer_)
+    libusb_interrupt_event_handler(NULL);
 }
 
-int XboxController::deadZoneCalc(short *x_out, short *y_out, short x, short y, short deadzone, short sickzone){
-  // Returns 0 if in deadzone, 1 in sickzone, 2 if passthrough. 
+bool XboxController::submitRumble()
+{
+  // rumble_mutex_ must be held, returns true if a transfer was submitted
+  if (closing_ || disconnected_ || !rumble_shaper_.Pending())
+    return false;
 
-  // Protect from NULL input pointers (used for 1-D deadzone)
-  short dummyvar;
-  if (!x_out){
-    x_out = &dummyvar;
+  if (!rumble_shaper_.Take(TimerWheel::Now(), rumble_sending_[0], rumble_sending_[1]))
+  {
+    // sent one too recently, try again once the shaper allows it
+    auto next = rumble_shaper_.NextSendTime();
+    if (!rumble_timer_ || next < rumble_timer_)
+    {
+      rumble_timer_ = next;
+      timers_.Schedule(next, XboxController::OnRumbleTimer, this);
+    }
+    return false;
   }
-  if (!y_out){
-    y_out = &dummyvar;
+
+  if (!rumble_transfer_)
+    rumble_transfer_ = libusb_alloc_transfer(0);
+  if (!rumble_transfer_)
+  {
+    rumble_shaper_.Retry(rumble_sending_[0], rumble_sending_[1]);
+    return false;
   }
 
-  short status;
-  
-  // If no deadzone, pass directly through.
-  if (deadzone == 0){
-    *x_out = x;
-    *y_out = y;
-    return 2;
-  } 
+  XboxOutputReport report;
+  memset(&report, 0, sizeof(XboxOutputReport));
+  report.bSize = sizeof(XboxOutputReport);
+  report.Rumble.wLeftMotorSpeed = _byteswap_ushort(rumble_sending_[0]); // why do these need to be byteswapped???
+  report.Rumble.wRightMotorSpeed = _byteswap_ushort(rumble_sending_[1]);
 
-  // convert to polar coordinates
-  int r_in = sqrt(pow(x,2)+pow(y,2));
-  short r_sign = (y >= 0 ? 1 : -1); // For negative Y-axis cartesian coordinates 
-  float theta = acos((float)x/fmax(1.0,r_in));
-  int r_out;
+  if (endpoint_out_)
+  {
+    memcpy(rumble_buffer_, &report, sizeof(XboxOutputReport));
+    libusb_fill_interrupt_transfer(rumble_transfer_, usb_handle_, endpoint_out_, rumble_buffer_, sizeof(XboxOutputReport),
+      XboxController::OnRumbleTransfer, this, RUMBLE_TRANSFER_TIMEOUT_MS);
+  }
+  else
+  {
+    libusb_fill_control_setup(rumble_buffer_, LIBUSB_ENDPOINT_OUT | LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE,
+      HID_SET_REPORT, (HID_REPORT_TYPE_OUTPUT << 8) | 0x00, 0, sizeof(XboxOutputReport));
+    memcpy(rumble_buffer_ + LIBUSB_CONTROL_SETUP_SIZE, &report, sizeof(XboxOutputReport));
+    libusb_fill_control_transfer(rumble_transfer_, usb_handle_, rumble_buffer_,
+      XboxController::OnRumbleTransfer, this, RUMBLE_TRANSFER_TIMEOUT_MS);
+  }
 
-  // Return origin if in Deadzone 
-  if (r_in < deadzone){
-    status = 0;
-    r_out = 0;
+  auto ret = libusb_submit_transfer(rumble_transfer_);
+  if (ret < 0)
+  {
+    dbgprintf(__FUNCTION__ ": failed to submit rumble transfer (code %d)", ret);
+    rumble_shaper_.Retry(rumble_sending_[0], rumble_sending_[1]);
+    return false;
   }
 
-  // Scale to full range over "sickzone" for precision near deadzone
-  // this way output doesn't jump from 0,0 to deadzone limit.
-  else if (r_in < sickzone){ 
-    status = 1;
-    r_out = (float)(r_in - deadzone) / (float)(sickzone - deadzone) * sickzone;
-  } else {
-    status = 2;
-    r_out = r_in;
+  rumble_in_flight_ = true;
+  return true;
+}
+
+void XboxController::OnRumbleTimer(void* context, uint64_t now_us)
+{
+  auto* controller = (XboxController*)context;
+
+  std::lock_guard<std::mutex> guard(controller->rumble_mutex_);
+  controller->rumble_timer_ = 0;
+  if (!controller->rumble_in_flight_)
+    controller->submitRumble();
+}
+
+void LIBUSB_CALL XboxController::OnRumbleTransfer(libusb_transfer* transfer)
+{
+  auto* controller = (XboxController*)transfer->user_data;
+
+  std::lock_guard<std::mutex> guard(controller->rumble_mutex_);
+  controller->rumble_in_flight_ = false;
+
+  switch (transfer->status)
+  {
+  case LIBUSB_TRANSFER_COMPLETED:
+    break;
+  case LIBUSB_TRANSFER_NO_DEVICE:
+    controller->disconnected_ = controller->unplugged_ = true;
+    return;
+  case LIBUSB_TRANSFER_CANCELLED:
+    return;
+  default:
+    // timeout/stall/error, try sending it again unless there's something newer to send instead
+    controller->rumble_shaper_.Retry(controller->rumble_sending_[0], controller->rumble_sending_[1]);
+    break;
   }
 
-  // Convert back to cartesian coordinates for x,y output
-  *x_out = r_out*cos(theta);
-  *y_out = r_sign*r_out*sin(theta);
+  // send whatever came in while this one was in-flight
+  controller->submitRumble();
+}
+
+void CALLBACK XboxController::OnVigemNotification(PVIGEM_CLIENT Client, PVIGEM_TARGET Target, UCHAR LargeMotor, UCHAR SmallMotor, UCHAR LedNumber)
+{
+  // pinned so the controller can't be freed while we're sending to it, UpdateAll waits for us before closing it
+  auto pin = controllers_.Pin();
+  auto controller = controllers_.Find(TargetKey(Target));
+  if (!controller)
+    return;
+
+  capture_.WriteRumble(controller->GetId(), LargeMotor, SmallMotor, LedNumber);
 
-  return status;
+  if (!controller->settings_.Read()->vibration_enabled)
+    LargeMotor = SmallMotor = 0;
+
+  controller->queueRumble(LargeMotor, SmallMotor);
+}
+
+int XboxController::GetUserIndex() {
+  if (vigem && target_)
+  {
+    ULONG idx = 0;
+    if (VIGEM_SUCCESS(vigem_target_x360_get_user_index(vigem, target_, &idx)))
+      return idx;
+  }
+  return -1;
 }
 
 // XboxController::Update: returns false if controller disconnected
@@ -472,281 +1124,239 @@ bool XboxController::update()
 {
   if (!active_)
   {
-    while (true)
-    {
-      if (closing_)
-        return true;
-
-      std::lock_guard<std::mutex> vigem_guard(vigem_alloc_mutex_);
-      target_ = vigem_target_x360_alloc();
-      auto ret = vigem_target_add(vigem, target_);
-      if (VIGEM_SUCCESS(ret))
-      {
-        vigem_target_x360_register_notification(vigem, target_, XboxController::OnVigemNotification);
-        active_ = true;
-        break;
-      }
+    if (closing_)
+      return true;
 
-      // failed to create ViGEm target, retry next update
+    // failed to create ViGEm target, retry next update
+    if (!attachTarget())
       return true;
-    }
   }
 
   if (closing_)
     return true;
 
-  memset(&input_prev_, 0, sizeof(XboxInputReport));
-  int length = 0;
-  int ret = -1;
+  if (disconnected_)
+    return false;
 
   // if we have interrupt endpoints use those for better compatibility, otherwise fallback to control transfers
   if (endpoint_in_)
   {
-    extern int poll_ms;
-    ret = libusb_interrupt_transfer(usb_handle_, endpoint_in_, (unsigned char*)&input_prev_, sizeof(XboxInputReport), &length, poll_ms);
-    if (ret < 0)
-      return true; // No input available atm
-  }
-  else
-  {
-    std::lock_guard<std::mutex> guard(usb_mutex_);
-    ret = libusb_control_transfer(usb_handle_, LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE,
-      HID_GET_REPORT, (HID_REPORT_TYPE_INPUT << 8) | 0x00, 0, (unsigned char*)&input_prev_, sizeof(XboxInputReport), 1000);
-
-    if (ret < 0)
+    // reports get handled by OnInputTransfer as they arrive, just need to make sure transfers are in-flight
+    if (!input_started_)
     {
-      dbgprintf(__FUNCTION__ ": libusb control transfer failed (code %d)", ret);
-      return false;
+      input_started_ = true;
+      if (!StartTransfers())
+        return false;
+
+      // input's already on its way, the controller can answer these in between
+      requestStrings();
     }
+    return true;
   }
 
-  if (input_prev_.bSize != sizeof(XboxInputReport))
+  // control transfers are blocking, only poll them at poll_ms rate
+  auto now = std::chrono::steady_clock::now();
+  if (now - poll_time_ < std::chrono::milliseconds(poll_ms))
+    return true;
+  poll_time_ = now;
+
+  memset(&input_prev_, 0, sizeof(XboxInputReport));
+
+  int ret = libusb_control_transfer(usb_handle_, LIBUSB_ENDPOINT_IN | LIBUSB_REQUEST_TYPE_CLASS | LIBUSB_RECIPIENT_INTERFACE,
+    HID_GET_REPORT, (HID_REPORT_TYPE_INPUT << 8) | 0x00, 0, (unsigned char*)&input_prev_, sizeof(XboxInputReport), 1000);
+
+  if (ret < 0)
   {
-    dbgprintf(__FUNCTION__ ": controller returned invalid report size %d (expected %d)", input_prev_.bSize, sizeof(XboxInputReport));
+    dbgprintf(__FUNCTION__ ": libusb control transfer failed (code %d)", ret);
+    unplugged_ = ret == LIBUSB_ERROR_NO_DEVICE;
     return false;
   }
 
-  memset(&gamepad_, 0, sizeof(XUSB_REPORT));
-
-  // Copy over digital buttons
-  gamepad_.wButtons = input_prev_.Gamepad.wButtons;
-
-  // Convert analog buttons to digital
-  gamepad_.wButtons |= input_prev_.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_A] ? XUSB_GAMEPAD_A : 0;
-  gamepad_.wButtons |= input_prev_.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_B] ? XUSB_GAMEPAD_B : 0;
-  gamepad_.wButtons |= input_prev_.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_X] ? XUSB_GAMEPAD_X : 0;
-  gamepad_.wButtons |= input_prev_.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_Y] ? XUSB_GAMEPAD_Y : 0;
-  gamepad_.wButtons |= input_prev_.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_WHITE] ? XUSB_GAMEPAD_LEFT_SHOULDER : 0;
-  gamepad_.wButtons |= input_prev_.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_BLACK] ? XUSB_GAMEPAD_RIGHT_SHOULDER : 0;
+  if (!processInput())
+    return false;
 
-  // Trigger Deadzone Calculations
-  short triggerbuf;
-  deadZoneCalc(&triggerbuf, NULL, input_prev_.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER], 0, settings_.deadzone.bLeftTrigger, 0xFF);
-  gamepad_.bLeftTrigger = triggerbuf;
-  deadZoneCalc(&triggerbuf, NULL, input_prev_.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER], 0, settings_.deadzone.bRightTrigger, 0xFF);
-  gamepad_.bRightTrigger = triggerbuf;
+  requestStrings();
+  return true;
+}
 
-  if (settings_.remap_enabled && settings_.button_remap.size())
-  {
-    auto buttons = gamepad_.wButtons;
-    gamepad_.wButtons = 0;
+// XboxController::attachTarget: plugs in a ViGEm target for this controller, returns false if it couldn't be
+bool XboxController::attachTarget()
+{
+  // a target from the pool is already set up, only needs plugging in (target_ is kept from a previous failed try)
+  if (!target_)
+    target_ = target_pool_.Take();
+  if (!target_)
+    target_ = CreateTarget();
+  if (!target_)
+    return false;
 
-    auto leftTrig = gamepad_.bLeftTrigger;
-    auto rightTrig = gamepad_.bRightTrigger;
+  // notifications find us by target, so it has to be mapped before it's plugged in & any can come in
+  controllers_.SetKey(TargetKey(target_), id_);
 
-    // TODO: could probably change this into a loop over XUSB_BUTTON enum instead of a macro?
-#define LoadMap(btn) \
-    if (buttons & XUSB_GAMEPAD_##btn) \
-    { \
-      auto remap = (int)XUSB_GAMEPAD_##btn; \
-      if (settings_.button_remap.count(XUSB_GAMEPAD_##btn)) \
-        remap = settings_.button_remap[XUSB_GAMEPAD_##btn]; \
-      gamepad_.wButtons |= (remap & ~(XUSB_GAMEPAD_LT | XUSB_GAMEPAD_RT)); \
-      if (remap & XUSB_GAMEPAD_LT) \
-        gamepad_.bLeftTrigger = 255; \
-      if (remap & XUSB_GAMEPAD_RT) \
-        gamepad_.bRightTrigger = 255; \
-    }
+  std::lock_guard<std::mutex> vigem_guard(vigem_alloc_mutex_);
+  if (!VIGEM_SUCCESS(vigem_target_add(vigem, target_)))
+    return false;
 
-    LoadMap(A);
-    LoadMap(B);
-    LoadMap(X);
-    LoadMap(Y);
-    LoadMap(Start);
-    LoadMap(Back);
-    LoadMap(LS);
-    LoadMap(RS);
-    LoadMap(Black);
-    LoadMap(White);
-    LoadMap(DpadUp);
-    LoadMap(DpadDown);
-    LoadMap(DpadLeft);
-    LoadMap(DpadRight);
-#undef LoadMap
+  active_ = true;
+  return true;
+}
 
-    if (leftTrig >= 8)
-    {
-      if (settings_.button_remap.count(XUSB_GAMEPAD_LT))
-      {
-        gamepad_.bLeftTrigger = 0;
+PVIGEM_TARGET XboxController::CreateTarget()
+{
+  // Everything short of plugging it in, a plugged-in target shows up in games as a connected controller
+  auto target = vigem_target_x360_alloc();
+  if (!target)
+    return nullptr;
 
-        auto remap = settings_.button_remap[XUSB_GAMEPAD_LT];
-        gamepad_.wButtons |= (remap & ~(XUSB_GAMEPAD_LT | XUSB_GAMEPAD_RT));
+  vigem_target_set_submit_queue(target, VIGEM_SUBMIT_QUEUE_DEPTH);
 
-        if (remap & XUSB_GAMEPAD_LT)
-          gamepad_.bLeftTrigger = leftTrig;
+  // notification worker thread starts right away, but waits until the target's plugged in before asking ViGEm for anything
+  if (!VIGEM_SUCCESS(vigem_target_x360_register_notification(vigem, target, XboxController::OnVigemNotification)))
+  {
+    vigem_target_free(target);
+    return nullptr;
+  }
 
-        if (remap & XUSB_GAMEPAD_RT)
-          gamepad_.bRightTrigger = leftTrig;
-      }
-    }
+  return target;
+}
 
-    if (rightTrig >= 8)
-    {
-      if (settings_.button_remap.count(XUSB_GAMEPAD_RT))
-      {
-        gamepad_.bRightTrigger = 0;
+void XboxController::FreeTarget(PVIGEM_TARGET target)
+{
+  vigem_target_x360_unregister_notification(target);
+  vigem_target_free(target);
+}
 
-        auto remap = settings_.button_remap[XUSB_GAMEPAD_RT];
-        gamepad_.wButtons |= (remap & ~(XUSB_GAMEPAD_LT | XUSB_GAMEPAD_RT));
+// XboxController::processInput: translates input_prev_ & sends it to the ViGEm target, returns false if report was invalid
+bool XboxController::processInput()
+{
+  if (input_prev_.bSize != sizeof(XboxInputReport))
+  {
+    dbgprintf(__FUNCTION__ ": controller returned invalid report size %d (expected %d)", input_prev_.bSize, sizeof(XboxInputReport));
+    return false;
+  }
 
-        if (remap & XUSB_GAMEPAD_LT)
-          gamepad_.bLeftTrigger = rightTrig;
+  capture_.WriteInput(GetId(), input_prev_);
 
-        if (remap & XUSB_GAMEPAD_RT)
-          gamepad_.bRightTrigger = rightTrig;
-      }
+  // settings changed since the last report (tray/reload) are picked up in between reports, so the translator never sees them change mid-report
+  {
+    auto settings = settings_.Read();
+    if (settings.Version() != settings_version_)
+    {
+      translator_.SetSettings(*settings);
+      settings_version_ = settings.Version();
     }
   }
 
-  // Secret Deadzone Adjustment Combinations: 
-  extern bool deadzoneCombinationEnabled; 
-  if(deadzoneCombinationEnabled){
+  translator_.Translate(input_prev_, &gamepad_, TimerWheel::Now());
 
-    // Analog Stick Deadzone Adjustment: LT + RT + (LS | RS) + D-Pad Up/Down
-    if ((input_prev_.Gamepad.wButtons & OGXINPUT_GAMEPAD_LEFT_THUMB) ^ (input_prev_.Gamepad.wButtons & OGXINPUT_GAMEPAD_RIGHT_THUMB) && // // (LS XOR RS) AND
-    ((input_prev_.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] >= 0x8) && (input_prev_.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER] >= 0x8)) &&  // Left and Right Trigger AND
-    (input_prev_.Gamepad.wButtons & (OGXINPUT_GAMEPAD_DPAD_UP | OGXINPUT_GAMEPAD_DPAD_DOWN))) // Direction to change deadzone
-    {
-      // wait for previous deadzone adjustment button release
-      if (!settings_.deadzone.hold){
-        short adjustment = (input_prev_.Gamepad.wButtons & OGXINPUT_GAMEPAD_DPAD_UP ? 500 : -500);
-
-        if (input_prev_.Gamepad.wButtons & OGXINPUT_GAMEPAD_LEFT_THUMB){
-          settings_.deadzone.sThumbL = min(max(settings_.deadzone.sThumbL+adjustment,0), SHRT_MAX);
-        } 
-        if (input_prev_.Gamepad.wButtons & OGXINPUT_GAMEPAD_RIGHT_THUMB){
-          settings_.deadzone.sThumbR = min(max(settings_.deadzone.sThumbR+adjustment,0), SHRT_MAX);
-        }
+  if (translator_.DeadzoneChanged())
+  {
+    // publish it for the tray, translator will get it back next report
+    auto deadzone = translator_.Settings().deadzone;
+    settings_.Update([&deadzone](UserSettings& settings) { settings.deadzone = deadzone; });
+    SaveDeadzones();
+  }
 
-        SaveDeadzones();
+  // Write gamepad to virtual XInput device
+  submitReport();
 
-        // wait for button release
-        settings_.deadzone.hold = true;
-      }
+  scheduleTimer();
+  return true;
+}
 
-    // Trigger Deadzone Adjustment: (LT | RT) + LS + RS + D-Pad Up/Down
-    } else if ((input_prev_.Gamepad.wButtons & OGXINPUT_GAMEPAD_LEFT_THUMB) && (input_prev_.Gamepad.wButtons & OGXINPUT_GAMEPAD_RIGHT_THUMB) && // // (LS && RS) AND
-    ((input_prev_.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] >= 0x8) ^ (input_prev_.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER] >= 0x8)) &&  // Left XOR Right Trigger AND
-    (input_prev_.Gamepad.wButtons & (OGXINPUT_GAMEPAD_DPAD_UP | OGXINPUT_GAMEPAD_DPAD_DOWN))) // Direction to change deadzone
-    {
-      if(!settings_.deadzone.hold){
-        short adjustment = (input_prev_.Gamepad.wButtons & OGXINPUT_GAMEPAD_DPAD_UP ? 15 : -15);
-        
-        if (input_prev_.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER]){
-          settings_.deadzone.bLeftTrigger = min(max(settings_.deadzone.bLeftTrigger+adjustment,0), 0xFF);
-        }
-        if (input_prev_.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER]){
-          settings_.deadzone.bRightTrigger = min(max(settings_.deadzone.bRightTrigger+adjustment,0), 0xFF);
-        }
-        
-        SaveDeadzones();
+void XboxController::submitReport()
+{
+  if (batcher_.Running())
+    batcher_.Post(REGISTRY_ID_SLOT(id_), target_, gamepad_);
+  else
+    vigem_target_x360_update(vigem, target_, gamepad_);
+}
 
-        // wait for button release
-        settings_.deadzone.hold = true;
-      }
-    } else {
-      // reset button release
-      settings_.deadzone.hold = false;
-    }
-  }
+void XboxController::OnBatchSubmit(void* target, const XUSB_REPORT& report)
+{
+  // runs on the batcher's thread, UpdateAll removes a controller from the batcher before freeing its target
+  vigem_target_x360_update(vigem, (PVIGEM_TARGET)target, report);
+}
 
-  // Analog Stick Deadzone Calculations
-  deadZoneCalc(&gamepad_.sThumbLX, &gamepad_.sThumbLY, input_prev_.Gamepad.sThumbLX, input_prev_.Gamepad.sThumbLY, settings_.deadzone.sThumbL, SHRT_MAX);
-  deadZoneCalc(&gamepad_.sThumbRX, &gamepad_.sThumbRY, input_prev_.Gamepad.sThumbRX, input_prev_.Gamepad.sThumbRY, settings_.deadzone.sThumbR, SHRT_MAX);
+void XboxController::scheduleTimer()
+{
+  // timers that end up firing later than needed just refresh the output again, so only need to add one if it's earlier
+  auto deadline = translator_.NextDeadline();
+  if (!deadline || (timer_deadline_ && timer_deadline_ <= deadline))
+    return;
 
-  // Create a 'digital' bitfield so we can test combinations against LT/RT
-  int digitalPressed = gamepad_.wButtons;
-  if (gamepad_.bLeftTrigger >= 0x8)
-    digitalPressed |= XUSB_GAMEPAD_LT;
-  if (gamepad_.bRightTrigger >= 0x8)
-    digitalPressed |= XUSB_GAMEPAD_RT;
+  timer_deadline_ = deadline;
+  timers_.Schedule(deadline, XboxController::OnTimer, this);
+}
 
-  // Secret guide combination
-  if (settings_.guide_enabled && combo_guideButton && (digitalPressed & combo_guideButton) == combo_guideButton)
-  {
-    gamepad_.wButtons |= XUSB_GAMEPAD_GUIDE;
+void XboxController::OnTimer(void* context, uint64_t now_us)
+{
+  auto* controller = (XboxController*)context;
+  controller->timer_deadline_ = 0;
+  if (controller->closing_ || controller->disconnected_ || !controller->active_)
+    return;
 
-    // Clear combination from the emulated pad, don't want it to interfere with anything
-    gamepad_.wButtons &= ~((USHORT)combo_guideButton);
-    if (combo_guideButton & XUSB_GAMEPAD_LT)
-      gamepad_.bLeftTrigger = 0;
-    if (combo_guideButton & XUSB_GAMEPAD_RT)
-      gamepad_.bRightTrigger = 0;
+  // only need to tell ViGEm if turbo/macros actually changed something
+  XUSB_REPORT gamepad = controller->gamepad_;
+  if (controller->translator_.RefreshTimedOutput(now_us, &gamepad) && memcmp(&gamepad, &controller->gamepad_, sizeof(XUSB_REPORT)))
+  {
+    controller->gamepad_ = gamepad;
+    controller->submitReport();
   }
 
-  // Write gamepad to virtual XInput device
-  vigem_target_x360_update(vigem, target_, gamepad_);
-
-  return true;
+  controller->scheduleTimer();
 }
 
 void XboxController::GuideEnabled(bool value)
 {
-  settings_.guide_enabled = value;
-  SetSetting("EnableGuide", value ? "true" : "false", ini_key_);
+  settings_.Update([value](UserSettings& settings) { settings.guide_enabled = value; });
+  SetSetting("EnableGuide", value ? "true" : "false", iniKey());
 }
 
 void XboxController::VibrationEnabled(bool value)
 {
-  settings_.vibration_enabled = value;
-  SetSetting("EnableVibration", value ? "true" : "false", ini_key_);
+  settings_.Update([value](UserSettings& settings) { settings.vibration_enabled = value; });
+  SetSetting("EnableVibration", value ? "true" : "false", iniKey());
 }
 
 void XboxController::RemapEnabled(bool value)
 {
-  settings_.remap_enabled = value;
-  SetSetting("RemapEnable", value ? "true" : "false", ini_key_);
+  settings_.Update([value](UserSettings& settings) { settings.remap_enabled = value; });
+  SetSetting("RemapEnable", value ? "true" : "false", iniKey());
 }
 
 void XboxController::SaveDeadzones()
 {
-  // WritePrivateProfile can only write strings, bleh
-  if (settings_.deadzone.sThumbL)
-    SetSetting("DeadzoneLeftStick", std::to_string(settings_.deadzone.sThumbL), ini_key_);
+  // only queues the changes (see SettingsJournal), INI settings are all strings
+  if (translator_.Settings().deadzone.sThumbL)
+    SetSetting("DeadzoneLeftStick", std::to_string(translator_.Settings().deadzone.sThumbL), iniKey());
 
-  if (settings_.deadzone.sThumbR)
-    SetSetting("DeadzoneRightStick", std::to_string(settings_.deadzone.sThumbR), ini_key_);
+  if (translator_.Settings().deadzone.sThumbR)
+    SetSetting("DeadzoneRightStick", std::to_string(translator_.Settings().deadzone.sThumbR), iniKey());
 
-  if (settings_.deadzone.bLeftTrigger)
-    SetSetting("DeadzoneLeftTrigger", std::to_string(settings_.deadzone.bLeftTrigger), ini_key_);
+  if (translator_.Settings().deadzone.bLeftTrigger)
+    SetSetting("DeadzoneLeftTrigger", std::to_string(translator_.Settings().deadzone.bLeftTrigger), iniKey());
 
-  if (settings_.deadzone.bRightTrigger)
-    SetSetting("DeadzoneRightTrigger", std::to_string(settings_.deadzone.bRightTrigger), ini_key_);
+  if (translator_.Settings().deadzone.bRightTrigger)
+    SetSetting("DeadzoneRightTrigger", std::to_string(translator_.Settings().deadzone.bRightTrigger), iniKey());
 }
 
 int XboxController::GetSettingInt(const std::string& setting, int default_val, const std::string& ini_key)
 {
-  return GetPrivateProfileIntA(ini_key.c_str(), setting.c_str(), default_val, ini_path);
+  std::string value;
+  if (!ini_settings.Get(ini_key, setting, value) || !value.length())
+    return default_val;
+
+  return strtol(value.c_str(), nullptr, 10);
 }
 
 std::string XboxController::GetSettingString(const std::string& setting, const std::string& default_val, const std::string& ini_key)
 {
-  char result[256];
-
-  GetPrivateProfileStringA(ini_key.c_str(), setting.c_str(), default_val.c_str(), result, 256, ini_path);
+  std::string value;
+  if (!ini_settings.Get(ini_key, setting, value))
+    return default_val;
 
-  return result;
+  return value;
 }
 
 bool XboxController::GetSettingBool(const std::string& setting, bool default_val, const std::string& ini_key)
@@ -757,7 +1367,9 @@ bool XboxController::GetSettingBool(const std::string& setting, bool default_val
 
 void XboxController::SetSetting(const std::string& setting, const std::string& value, const std::string& ini_key)
 {
-  WritePrivateProfileStringA(ini_key.c_str(), setting.c_str(), value.c_str(), ini_path);
+  // in-memory copy is updated straight away, file gets written in the background
+  ini_settings.Set(ini_key, setting, value);
+  settings_journal_.Set(ini_key, setting, value);
 }
 
 
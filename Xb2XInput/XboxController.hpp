@@ -2,97 +2,65 @@
 #include "ViGEm/Client.h"
 #include "ViGEm/Util.h"
 #include <libusb.h>
+#include "XboxTypes.hpp"
+#include "XboxTranslator.hpp"
+#include "InputCapture.hpp"
+#include "TimerWheel.hpp"
+#include "SettingsJournal.hpp"
+#include "IniDocument.hpp"
+#include "FileWatcher.hpp"
+#include "Snapshot.hpp"
+#include "SlotRegistry.hpp"
+#include "RumbleShaper.hpp"
+#include "ReportBatcher.hpp"
+#include "WarmPool.hpp"
+#include "DeviceScanner.hpp"
+#include "ParallelFor.hpp"
+#include "DescriptorCache.hpp"
+#include "InputTransfers.hpp"
 
 #include <vector>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <unordered_map>
 
-// original xbox XINPUT definitions from https://github.com/paralin/hl2sdk/blob/master/common/xbox/xboxstubs.h
-
-// digital button bitmasks
-#define OGXINPUT_GAMEPAD_DPAD_UP           0x0001
-#define OGXINPUT_GAMEPAD_DPAD_DOWN         0x0002
-#define OGXINPUT_GAMEPAD_DPAD_LEFT         0x0004
-#define OGXINPUT_GAMEPAD_DPAD_RIGHT        0x0008
-#define OGXINPUT_GAMEPAD_START             0x0010
-#define OGXINPUT_GAMEPAD_BACK              0x0020
-#define OGXINPUT_GAMEPAD_LEFT_THUMB        0x0040
-#define OGXINPUT_GAMEPAD_RIGHT_THUMB       0x0080
-
-// analog button indexes
-#define OGXINPUT_GAMEPAD_A                0
-#define OGXINPUT_GAMEPAD_B                1
-#define OGXINPUT_GAMEPAD_X                2
-#define OGXINPUT_GAMEPAD_Y                3
-#define OGXINPUT_GAMEPAD_BLACK            4
-#define OGXINPUT_GAMEPAD_WHITE            5
-#define OGXINPUT_GAMEPAD_LEFT_TRIGGER     6
-#define OGXINPUT_GAMEPAD_RIGHT_TRIGGER    7
-
-// Used for button combination parsing/checking
-// See Xb2XInput.cpp -> xinput_buttons map
-#define XUSB_GAMEPAD_LT (XUSB_GAMEPAD_Y << 1)
-#define XUSB_GAMEPAD_RT (XUSB_GAMEPAD_Y << 2)
-
-#pragma pack(push, 1)
-typedef struct _OGXINPUT_RUMBLE
-{
-  WORD   wLeftMotorSpeed;
-  WORD   wRightMotorSpeed;
-} OGXINPUT_RUMBLE, *POGXINPUT_RUMBLE;
-
-typedef struct _OGXINPUT_GAMEPAD
-{
-  WORD    wButtons;
-  BYTE    bAnalogButtons[8];
-  short   sThumbLX;
-  short   sThumbLY;
-  short   sThumbRX;
-  short   sThumbRY;
-} OGXINPUT_GAMEPAD, *POGXINPUT_GAMEPAD;
-
-struct XboxInputReport {
-  BYTE bReportId;
-  BYTE bSize;
-
-  OGXINPUT_GAMEPAD Gamepad;
-};
+#define HID_GET_REPORT                0x01
+#define HID_SET_REPORT                0x09
+#define HID_REPORT_TYPE_INPUT         0x01
+#define HID_REPORT_TYPE_OUTPUT        0x02
 
-struct XboxOutputReport {
-  BYTE bReportId;
-  BYTE bSize;
+// Number of interrupt IN transfers kept in-flight for each controller
+// (more than one so the next report can complete while we're still translating the previous one)
+#define INPUT_TRANSFER_COUNT          4
 
-  OGXINPUT_RUMBLE Rumble;
-};
+#define RUMBLE_TRANSFER_TIMEOUT_MS    1000
 
-struct Deadzone {
-  short sThumbL;
-  short sThumbR;
-  BYTE bLeftTrigger;
-  BYTE bRightTrigger;
-  bool hold; 
-};
+#define STRING_TRANSFER_TIMEOUT_MS    1000
 
-struct UserSettings {
-  bool guide_enabled = false;
-  bool vibration_enabled = false;
+// Descriptors requested by fetchString: language ID, then product/vendor/serial strings in that language
+#define STRING_LANGID                 0
+#define STRING_PRODUCT                1
+#define STRING_VENDOR                 2
+#define STRING_SERIAL                 3
+#define STRING_COUNT                  4
 
-  Deadzone deadzone = { 0 };
+// Number of reports each ViGEm target can have in-flight, so sending one never waits on the driver
+#define VIGEM_SUBMIT_QUEUE_DEPTH      4
 
-  std::unordered_map<int, int> button_remap;
-  bool remap_enabled = false;
-};
+// Max number of newly plugged-in controllers brought up at the same time by OpenDevice
+#define ATTACH_MAX_THREADS            8
 
-#pragma pack(pop)
+// Number of ViGEm targets kept ready for new controllers, more than one so a few pads plugged in together all get one
+#define VIGEM_TARGET_POOL_SIZE        2
 
-#define HID_GET_REPORT                0x01
-#define HID_SET_REPORT                0x09
-#define HID_REPORT_TYPE_INPUT         0x01
-#define HID_REPORT_TYPE_OUTPUT        0x02
-
-class XboxController
+class XboxController : private InputTransferBackend
 {
-  std::vector<uint8_t*> usb_ports_;
+  RegistryId id_ = 0; // ID in the controller registry, see Controllers()
+  uint64_t port_key_ = 0; // bus & port path, registry key for the USB port the controller is plugged into
+
+  std::vector<uint8_t> usb_ports_;
   bool active_ = false;
   libusb_device_handle* usb_handle_ = nullptr;
   int usb_product_ = 0;
@@ -101,16 +69,26 @@ class XboxController
   PVIGEM_TARGET target_ = 0;
 
   libusb_device_descriptor usb_desc_;
-  char usb_productname_[128];
-  char usb_vendorname_[128];
-  char usb_serialno_[128];
-  
-  std::string ini_key_; // key-name to use when loading settings from config ini
+
+  // USB strings are read once input is already flowing (a slow controller can take a while to answer them), they're
+  // empty until then unless they came from descriptor_cache_
+  mutable std::mutex strings_mutex_;
+  std::string usb_productname_;
+  std::string usb_vendorname_;
+  std::string usb_serialno_;
+  libusb_transfer* string_transfer_ = nullptr;
+  unsigned char string_buffer_[LIBUSB_CONTROL_SETUP_SIZE + 255];
+  uint16_t string_langid_ = 0;
+  int string_step_ = STRING_LANGID;
+  bool strings_requested_ = false;
+  bool strings_failed_ = false;
+  std::atomic<bool> string_in_flight_{ false };
+
+  std::string descriptor_key_; // descriptor_cache_ key, empty if it can't be cached (port path too deep)
 
   bool closing_ = false;
 
   XboxInputReport input_prev_;
-  XboxOutputReport output_prev_;
   XUSB_REPORT gamepad_;
 
   int usb_iface_num_ = 0;
@@ -118,40 +96,124 @@ class XboxController
   uint8_t endpoint_in_ = 0;
   uint8_t endpoint_out_ = 0;
 
-  int deadZoneCalc(short *x_out, short *y_out, short x, short y, short deadzone, short sickzone);
-
-  UserSettings settings_;
+  // async input transfers, only used if the controller has an interrupt IN endpoint
+  // input_transfers_ keeps them in-flight, the InputTransferBackend methods below give it the libusb transfers
+  libusb_transfer* input_usb_transfers_[INPUT_TRANSFER_COUNT] = { 0 };
+  XboxInputReport input_buffers_[INPUT_TRANSFER_COUNT];
+  InputTransferSet input_transfers_{ this, INPUT_TRANSFER_COUNT };
+  bool input_started_ = false;
+  bool disconnected_ = false;
+  bool unplugged_ = false; // disconnected_ because the device left the bus, rather than it being dropped while plugged in
+
+  // async rumble, sent over the interrupt OUT endpoint if there is one, otherwise as a SET_REPORT control transfer
+  // only one transfer is in-flight at a time, rumble_shaper_ holds onto the newest update until it completes
+  // (or until the shaper allows another one to be sent, rumble_timer_ is when a timer is waiting to send it)
+  std::mutex rumble_mutex_;
+  RumbleShaper rumble_shaper_;
+  libusb_transfer* rumble_transfer_ = nullptr;
+  unsigned char rumble_buffer_[LIBUSB_CONTROL_SETUP_SIZE + sizeof(XboxOutputReport)];
+  uint8_t rumble_sending_[2]; // large/small motor speeds of the in-flight transfer
+  uint64_t rumble_timer_ = 0;
+  std::atomic<bool> rumble_in_flight_{ false };
+
+  // last time a control-transfer-only controller was polled
+  std::chrono::steady_clock::time_point poll_time_;
+
+  XboxTranslator translator_;
+
+  // Current settings, shared by the tray/settings watcher/ViGEm notification threads & picked up by processInput
+  // translator_ has its own copy that only the USB update thread uses, settings_version_ is the version it was copied from
+  Snapshot<UserSettings> settings_;
+  uint64_t settings_version_ = 0;
+
+  // settings last loaded from the INI, only used by the constructor & reloadSettings
+  std::mutex loaded_settings_mutex_;
+  UserSettings loaded_settings_;
+
+  // deadline of the earliest timer we've got waiting for turbo/macro updates, 0 if none
+  uint64_t timer_deadline_ = 0;
 
   bool update();
+  void findEndpoints(libusb_device* dev);
+  CachedDescriptor describe() const;
+  bool attachTarget();
+  bool processInput();
+  void submitReport();
+  static void OnBatchSubmit(void* target, const XUSB_REPORT& report);
+  void scheduleTimer();
+  static void OnTimer(void* context, uint64_t now_us);
+
+  bool StartTransfers();
+  void StopTransfers();
+  static void LIBUSB_CALL OnInputTransfer(libusb_transfer* transfer);
+
+  bool PrepareTransfer(int index) override;
+  int SubmitTransfer(int index) override;
+  void CancelTransfer(int index) override;
+  void FreeTransfer(int index) override;
+  void HandleTransferEvents(int timeout_ms) override { HandleEvents(timeout_ms); }
+
+  void requestStrings();
+  bool fetchString();
+  void stringsFetched();
+  static void LIBUSB_CALL OnStringTransfer(libusb_transfer* transfer);
+
+  void queueRumble(UCHAR large_motor, UCHAR small_motor);
+  bool submitRumble();
+  static void LIBUSB_CALL OnRumbleTransfer(libusb_transfer* transfer);
+  static void OnRumbleTimer(void* context, uint64_t now_us);
+  static int LIBUSB_CALL OnHotplug(libusb_context* ctx, libusb_device* device, libusb_hotplug_event event, void* user_data);
 
   static int GetSettingInt(const std::string& setting, int default_val, const std::string& ini_key);
   static std::string GetSettingString(const std::string& setting, const std::string& default_val, const std::string& ini_key);
   static bool GetSettingBool(const std::string& setting, bool default_val, const std::string& ini_key);
   static void SetSetting(const std::string& setting, const std::string& value, const std::string& ini_key);
 
+  static PVIGEM_TARGET CreateTarget();
+  static void FreeTarget(PVIGEM_TARGET target);
+
+  // Registry keys: ViGEm targets & port paths are both mapped to their controller
+  static uint64_t TargetKey(PVIGEM_TARGET target) { return (uint64_t)(uintptr_t)target; }
+  static uint64_t PortKey(uint8_t bus, const uint8_t* ports, int num_ports) { return UsbPortKey(bus, ports, num_ports); }
+
   static UserSettings LoadSettings(const std::string& ini_key, const UserSettings& defaults);
+  static UserSettings loadDefaultSettings();
+  UserSettings loadControllerSettings();
+  void reloadSettings();
+  static void ReloadSettings();
+  std::string iniKey() const;
   void SaveDeadzones();
 
 public:
-  bool GuideEnabled() { return settings_.guide_enabled; }
+  bool GuideEnabled() { return settings_.Read()->guide_enabled; }
   void GuideEnabled(bool value);
 
-  bool VibrationEnabled() { return settings_.vibration_enabled; }
+  bool VibrationEnabled() { return settings_.Read()->vibration_enabled; }
   void VibrationEnabled(bool value);
 
-  bool RemapEnabled() { return settings_.remap_enabled; }
+  bool RemapEnabled() { return settings_.Read()->remap_enabled; }
   void RemapEnabled(bool value);
 
-  const UserSettings& Settings() { return settings_; }
+  UserSettings Settings() { return *settings_.Read(); }
+
+  RumbleStats GetRumbleStats() { std::lock_guard<std::mutex> guard(rumble_mutex_); return rumble_shaper_.Stats(); }
+
+  // Batched report submission ([Options] BatchReportsMs), returns the tick in ms or 0 if reports are sent straight away
+  static int GetBatchTick();
+  static BatchStats GetBatchStats();
 
   XboxController(libusb_device_handle* handle, uint8_t* usb_ports, int num_ports);
   ~XboxController();
+  XboxController(const XboxController&) = delete;
+  XboxController& operator=(const XboxController&) = delete;
+  RegistryId GetId() const { return id_; }
   int GetProductId() const { return usb_product_; }
   int GetVendorId() const { return usb_vendor_; }
-  const char* GetProductName() const { return usb_productname_; }
-  const char* GetVendorName() const { return usb_vendorname_; }
-  const char* GetSerialNo() const { return usb_serialno_; }
-  Deadzone GetDeadzone() { return settings_.deadzone; }
+  // empty until the controller's strings have been read
+  std::string GetProductName() const { std::lock_guard<std::mutex> guard(strings_mutex_); return usb_productname_; }
+  std::string GetVendorName() const { std::lock_guard<std::mutex> guard(strings_mutex_); return usb_vendorname_; }
+  std::string GetSerialNo() const { std::lock_guard<std::mutex> guard(strings_mutex_); return usb_serialno_; }
+  Deadzone GetDeadzone() { return settings_.Read()->deadzone; }
   
   int GetControllerIndex()
   { 
@@ -164,9 +226,22 @@ public:
 
   static bool Initialize(WCHAR* app_title);
   static void UpdateAll();
+  static void HandleEvents(int timeout_ms);
+  static void RunTimers();
   static void Close();
-  static libusb_device_handle* OpenDevice();
-  static std::vector<XboxController>& GetControllers();
+  static bool StartCapture(const char* path);
+  static int Replay(const char* path, bool realtime);
+  // Adds every new controller that's been plugged in, returns how many were added
+  static int OpenDevice();
+
+  // Wakes up WaitForDeviceChange, called when the OS says a device was plugged in/removed (eg. WM_DEVICECHANGE)
+  static void DevicesChanged();
+
+  // Waits until a device might have been plugged in (DevicesChanged/libusb hotplug event), or DEVICE_SCAN_POLL_MS passes
+  static void WaitForDeviceChange();
+
+  // Every connected controller, UI & notification threads should Pin it while they use any of them
+  static SlotRegistry<XboxController>& Controllers();
 
   static void CALLBACK OnVigemNotification(
     PVIGEM_CLIENT Client,
@@ -0,0 +1,559 @@
+#include "XboxTranslator.hpp"
+#include <cmath>
+#include <climits>
+#include <cstring>
+
+// button bitmask for guide combination
+int combo_guideButton = 0;
+
+// extra combinations from INI
+std::vector<ComboBinding> combo_bindings;
+
+// Analog Stick and Trigger Deadzone Adjustment Enabled
+bool deadzoneCombinationEnabled = true;
+
+static int clampInt(int value, int minimum, int maximum)
+{
+  return value < minimum ? minimum : (value > maximum ? maximum : value);
+}
+
+// floor(sqrt(value)), sqrt is correctly rounded so this is exact for any value below 2^52
+// Kept as the one hardware sqrt instead of an integer square root: a branch-free bit-at-a-time isqrt made
+// StickDeadzones ~4x slower, & StickDeadzones only needs it for sticks outside their deadzone
+static uint32_t isqrt(uint64_t value)
+{
+  return (uint32_t)sqrt((double)value);
+}
+
+int XboxTranslator::deadZoneCalc(short *x_out, short *y_out, short x, short y, short deadzone, short sickzone){
+  // Returns 0 if in deadzone, 1 in sickzone, 2 if passthrough.
+
+  // Protect from NULL input pointers (used for 1-D deadzone)
+  short dummyvar;
+  if (!x_out){
+    x_out = &dummyvar;
+  }
+  if (!y_out){
+    y_out = &dummyvar;
+  }
+
+  short status;
+
+  // If no deadzone, pass directly through.
+  if (deadzone == 0){
+    *x_out = x;
+    *y_out = y;
+    return 2;
+  }
+
+  // convert to polar coordinates
+  int r_in = sqrt(pow(x,2)+pow(y,2));
+  short r_sign = (y >= 0 ? 1 : -1); // For negative Y-axis cartesian coordinates
+  float theta = acos((float)x/fmax(1.0,r_in));
+  int r_out;
+
+  // Return origin if in Deadzone
+  if (r_in < deadzone){
+    status = 0;
+    r_out = 0;
+  }
+
+  // Scale to full range over "sickzone" for precision near deadzone
+  // this way output doesn't jump from 0,0 to deadzone limit.
+  else if (r_in < sickzone){
+    status = 1;
+    r_out = (float)(r_in - deadzone) / (float)(sickzone - deadzone) * sickzone;
+  } else {
+    status = 2;
+    r_out = r_in;
+  }
+
+  // Convert back to cartesian coordinates for x,y output
+  *x_out = r_out*cos(theta);
+  *y_out = r_sign*r_out*sin(theta);
+
+  return status;
+}
+
+void XboxTranslator::StickDeadzones(const short in[4], short out[4], const short deadzone[2])
+{
+  for (int stick = 0; stick < 2; stick++)
+  {
+    int x = in[stick * 2];
+    int y = in[stick * 2 + 1];
+    int dz = deadzone[stick];
+
+    // If no deadzone, pass directly through.
+    if (dz == 0)
+    {
+      out[stick * 2] = (short)x;
+      out[stick * 2 + 1] = (short)y;
+      continue;
+    }
+
+    // deadZoneCalc returns origin if floor(r) < deadzone, same as r^2 < deadzone^2
+    // so sticks at rest never need a sqrt
+    uint32_t r_sq = (uint32_t)(x * x) + (uint32_t)(y * y);
+    if (dz > 0 && r_sq < (uint32_t)(dz * dz))
+    {
+      out[stick * 2] = 0;
+      out[stick * 2 + 1] = 0;
+      continue;
+    }
+
+    // Scale to full range over "sickzone" for precision near deadzone
+    int r_in = (int)isqrt(r_sq);
+    int r_out = r_in;
+    if (r_in < SHRT_MAX)
+      r_out = (int)((int64_t)(r_in - dz) * SHRT_MAX / (SHRT_MAX - dz));
+
+    // Rescale the vector by r_out / r_in instead of converting to polar & back
+    // deadZoneCalc gets Y from sin(acos(x / r_in)) with the truncated r_in, so Y is worked out the same way here
+    // as r_out * sqrt(r_in^2 - x^2) / r_in, all kept inside the sqrt so it's exact in integer math
+    int64_t r_div = r_in > 1 ? r_in : 1;
+    int64_t x_scaled = (int64_t)x * r_out / r_div;
+    uint64_t y_sq = (uint64_t)((int64_t)r_out * r_out) * (uint64_t)(r_div * r_div - (int64_t)x * x) / (uint64_t)(r_div * r_div);
+    int64_t y_scaled = isqrt(y_sq);
+    if (y < 0)
+      y_scaled = -y_scaled;
+
+    out[stick * 2] = (short)clampInt((int)x_scaled, SHRT_MIN, SHRT_MAX);
+    out[stick * 2 + 1] = (short)clampInt((int)y_scaled, SHRT_MIN, SHRT_MAX);
+  }
+}
+
+void XboxTranslator::Translate(const XboxInputReport& input, XUSB_REPORT* output, uint64_t now_us)
+{
+  XUSB_REPORT& gamepad = *output;
+  memset(&gamepad, 0, sizeof(XUSB_REPORT));
+
+  ConvertButtons(input, gamepad);
+  ApplyTriggerDeadzones(input, gamepad);
+  ApplyRemap(gamepad);
+  CheckDeadzoneCombos(input);
+  ApplyStickDeadzones(input, gamepad);
+  ApplyResponseCurves(gamepad);
+  ApplyOutputCombos(gamepad, now_us);
+  ApplyTimedOutput(gamepad, now_us);
+}
+
+void XboxTranslator::ConvertButtons(const XboxInputReport& input, XUSB_REPORT& gamepad)
+{
+  // Copy over digital buttons
+  gamepad.wButtons = input.Gamepad.wButtons;
+
+  // Convert analog buttons to digital
+  gamepad.wButtons |= input.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_A] ? XUSB_GAMEPAD_A : 0;
+  gamepad.wButtons |= input.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_B] ? XUSB_GAMEPAD_B : 0;
+  gamepad.wButtons |= input.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_X] ? XUSB_GAMEPAD_X : 0;
+  gamepad.wButtons |= input.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_Y] ? XUSB_GAMEPAD_Y : 0;
+  gamepad.wButtons |= input.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_WHITE] ? XUSB_GAMEPAD_LEFT_SHOULDER : 0;
+  gamepad.wButtons |= input.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_BLACK] ? XUSB_GAMEPAD_RIGHT_SHOULDER : 0;
+}
+
+void XboxTranslator::updateTriggerTable(int trigger, BYTE deadzone)
+{
+  if (trigger_table_built_[trigger] && trigger_table_deadzone_[trigger] == deadzone)
+    return;
+
+  // Built from deadZoneCalc itself, so results are identical to calling it for every report
+  short triggerbuf;
+  for (int value = 0; value < 256; value++)
+  {
+    deadZoneCalc(&triggerbuf, NULL, value, 0, deadzone, 0xFF);
+    trigger_table_[trigger][value] = (BYTE)triggerbuf;
+  }
+
+  trigger_table_deadzone_[trigger] = deadzone;
+  trigger_table_built_[trigger] = true;
+}
+
+void XboxTranslator::ApplyTriggerDeadzones(const XboxInputReport& input, XUSB_REPORT& gamepad)
+{
+  // Trigger Deadzone Calculations, tables only get rebuilt if the deadzone changed since last report
+  updateTriggerTable(0, settings_.deadzone.bLeftTrigger);
+  updateTriggerTable(1, settings_.deadzone.bRightTrigger);
+
+  gamepad.bLeftTrigger = trigger_table_[0][input.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER]];
+  gamepad.bRightTrigger = trigger_table_[1][input.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER]];
+}
+
+// Extra input_combos_ state bits (past XUSB_GAMEPAD_RT) for a trigger that isn't fully released
+// The trigger combination adjusts every trigger that's pressed at all, not just the ones past the digital threshold
+#define COMBO_LT_NONZERO (XUSB_GAMEPAD_RT << 1)
+#define COMBO_RT_NONZERO (XUSB_GAMEPAD_RT << 2)
+
+// Secret Deadzone Adjustment Combinations, indexes match XboxTranslator::input_combos_
+//   Analog Stick: LT + RT + (LS XOR RS) + D-Pad Up/Down
+//   Trigger: (LT XOR RT) + LS + RS + D-Pad Up/Down, adjusts both triggers if the other one is pressed below the threshold
+// Up takes priority if both Up & Down are held
+struct DeadzoneCombo {
+  ButtonCombo combo;
+  int target; // CURVE_* index of the stick/trigger to adjust
+  int adjustment;
+};
+
+#define STICK_COMBO(thumb, other, target) \
+  { { XUSB_GAMEPAD_LT | XUSB_GAMEPAD_RT | thumb | XUSB_GAMEPAD_DPAD_UP, other, COMBO_PRESS }, target, 500 }, \
+  { { XUSB_GAMEPAD_LT | XUSB_GAMEPAD_RT | thumb | XUSB_GAMEPAD_DPAD_DOWN, other | XUSB_GAMEPAD_DPAD_UP, COMBO_PRESS }, target, -500 }
+
+#define TRIGGER_COMBO(trigger, other, state, target) \
+  { { XUSB_GAMEPAD_LEFT_THUMB | XUSB_GAMEPAD_RIGHT_THUMB | trigger | state | XUSB_GAMEPAD_DPAD_UP, other, COMBO_PRESS }, target, 15 }, \
+  { { XUSB_GAMEPAD_LEFT_THUMB | XUSB_GAMEPAD_RIGHT_THUMB | trigger | state | XUSB_GAMEPAD_DPAD_DOWN, other | XUSB_GAMEPAD_DPAD_UP, COMBO_PRESS }, target, -15 }
+
+static const DeadzoneCombo deadzone_combos[] =
+{
+  STICK_COMBO(XUSB_GAMEPAD_LEFT_THUMB, XUSB_GAMEPAD_RIGHT_THUMB, CURVE_LEFT_STICK),
+  STICK_COMBO(XUSB_GAMEPAD_RIGHT_THUMB, XUSB_GAMEPAD_LEFT_THUMB, CURVE_RIGHT_STICK),
+  TRIGGER_COMBO(XUSB_GAMEPAD_LT, XUSB_GAMEPAD_RT, 0, CURVE_LEFT_TRIGGER),
+  TRIGGER_COMBO(XUSB_GAMEPAD_LT, XUSB_GAMEPAD_RT, COMBO_RT_NONZERO, CURVE_RIGHT_TRIGGER),
+  TRIGGER_COMBO(XUSB_GAMEPAD_RT, XUSB_GAMEPAD_LT, 0, CURVE_RIGHT_TRIGGER),
+  TRIGGER_COMBO(XUSB_GAMEPAD_RT, XUSB_GAMEPAD_LT, COMBO_LT_NONZERO, CURVE_LEFT_TRIGGER),
+};
+
+#undef STICK_COMBO
+#undef TRIGGER_COMBO
+
+XboxTranslator::XboxTranslator()
+{
+  for (auto& adjust : deadzone_combos)
+    input_combos_.Add(adjust.combo);
+
+  compileCombos();
+}
+
+void XboxTranslator::compileCombos()
+{
+  compiled_guide_button_ = combo_guideButton;
+  compiled_bindings_ = combo_bindings;
+
+  output_combos_.Clear();
+  player_.ClearMacros();
+  for (auto& mode : output_combo_modes_)
+    mode = 0;
+
+  guide_combo_ = -1;
+  if (combo_guideButton)
+  {
+    ButtonCombo guide = { (uint32_t)combo_guideButton, 0, COMBO_HOLD };
+    guide_combo_ = output_combos_.Add(guide);
+    if (guide_combo_ >= 0)
+    {
+      output_combo_buttons_[guide_combo_] = XUSB_GAMEPAD_GUIDE;
+      output_combo_macros_[guide_combo_] = -1;
+      output_combo_modes_[COMBO_HOLD] |= 1ull << guide_combo_;
+    }
+  }
+
+  for (auto& binding : combo_bindings)
+  {
+    int index = output_combos_.Add(binding.combo);
+    if (index < 0 || binding.combo.mode < COMBO_HOLD || binding.combo.mode > COMBO_RELEASE)
+      continue;
+
+    output_combo_buttons_[index] = binding.output;
+    output_combo_macros_[index] = -1;
+    if (binding.combo.mode != COMBO_HOLD)
+    {
+      // press/release only fire for a single report, hold their buttons for a while so games can see them
+      Macro macro = binding.macro;
+      if (macro.empty() && binding.output)
+        macro.push_back({ (uint32_t)binding.output, MACRO_DEFAULT_STEP_MS });
+
+      output_combo_buttons_[index] = 0;
+      output_combo_macros_[index] = player_.AddMacro(macro);
+    }
+    output_combo_modes_[binding.combo.mode] |= 1ull << index;
+  }
+}
+
+void XboxTranslator::SetSettings(const UserSettings& settings)
+{
+  // Controllers get every setting republished when any one changes (deadzone combinations, tray toggles...),
+  // so only rebuild what's actually different, recompiling combinations would cut off any macro that's playing
+  bool remap_changed = settings.button_remap != settings_.button_remap;
+  bool curves_changed = false;
+  for (int curve = 0; curve < CURVE_COUNT; curve++)
+    curves_changed |= settings.curves[curve] != settings_.curves[curve];
+  bool turbo_changed = settings.turbo_buttons != settings_.turbo_buttons || settings.turbo_rate != settings_.turbo_rate;
+
+  settings_ = settings;
+  if (remap_changed)
+    compileRemap();
+  if (curves_changed)
+    compileCurves();
+  if (combo_guideButton != compiled_guide_button_ || combo_bindings != compiled_bindings_)
+    compileCombos();
+  if (turbo_changed)
+    player_.SetTurbo(settings_.turbo_buttons, settings_.turbo_rate);
+}
+
+void XboxTranslator::compileRemap()
+{
+  // Buttons that can be remapped, any others (eg. guide) get dropped from the output while remapping is enabled
+  const int remappable = XUSB_GAMEPAD_A | XUSB_GAMEPAD_B | XUSB_GAMEPAD_X | XUSB_GAMEPAD_Y |
+    XUSB_GAMEPAD_START | XUSB_GAMEPAD_BACK | XUSB_GAMEPAD_LEFT_THUMB | XUSB_GAMEPAD_RIGHT_THUMB |
+    XUSB_GAMEPAD_LEFT_SHOULDER | XUSB_GAMEPAD_RIGHT_SHOULDER |
+    XUSB_GAMEPAD_DPAD_UP | XUSB_GAMEPAD_DPAD_DOWN | XUSB_GAMEPAD_DPAD_LEFT | XUSB_GAMEPAD_DPAD_RIGHT;
+
+  // Each table entry is the OR of the remaps for every button set in that byte of wButtons
+  for (int half = 0; half < 2; half++)
+  {
+    for (int value = 0; value < 256; value++)
+    {
+      uint32_t remap = 0;
+      for (int bit = 0; bit < 8; bit++)
+      {
+        int button = (1 << bit) << (half * 8);
+        if (!(value & (1 << bit)) || !(button & remappable))
+          continue;
+
+        auto iter = settings_.button_remap.find(button);
+        remap |= (iter != settings_.button_remap.end()) ? iter->second : button;
+      }
+      remap_table_[half][value] = remap;
+    }
+  }
+
+  auto leftTrigger = settings_.button_remap.find(XUSB_GAMEPAD_LT);
+  trigger_remap_[0] = leftTrigger != settings_.button_remap.end() ? leftTrigger->second : -1;
+  auto rightTrigger = settings_.button_remap.find(XUSB_GAMEPAD_RT);
+  trigger_remap_[1] = rightTrigger != settings_.button_remap.end() ? rightTrigger->second : -1;
+
+  remap_compiled_ = settings_.button_remap.size() > 0;
+}
+
+void XboxTranslator::ApplyRemap(XUSB_REPORT& gamepad)
+{
+  if (!settings_.remap_enabled || !remap_compiled_)
+    return;
+
+  auto leftTrig = gamepad.bLeftTrigger;
+  auto rightTrig = gamepad.bRightTrigger;
+
+  uint32_t remap = remap_table_[0][gamepad.wButtons & 0xFF] | remap_table_[1][gamepad.wButtons >> 8];
+  gamepad.wButtons = (USHORT)(remap & ~(XUSB_GAMEPAD_LT | XUSB_GAMEPAD_RT));
+  if (remap & XUSB_GAMEPAD_LT)
+    gamepad.bLeftTrigger = 255;
+  if (remap & XUSB_GAMEPAD_RT)
+    gamepad.bRightTrigger = 255;
+
+  if (leftTrig >= 8 && trigger_remap_[0] >= 0)
+  {
+    gamepad.bLeftTrigger = 0;
+
+    auto remap = trigger_remap_[0];
+    gamepad.wButtons |= (remap & ~(XUSB_GAMEPAD_LT | XUSB_GAMEPAD_RT));
+
+    if (remap & XUSB_GAMEPAD_LT)
+      gamepad.bLeftTrigger = leftTrig;
+
+    if (remap & XUSB_GAMEPAD_RT)
+      gamepad.bRightTrigger = leftTrig;
+  }
+
+  if (rightTrig >= 8 && trigger_remap_[1] >= 0)
+  {
+    gamepad.bRightTrigger = 0;
+
+    auto remap = trigger_remap_[1];
+    gamepad.wButtons |= (remap & ~(XUSB_GAMEPAD_LT | XUSB_GAMEPAD_RT));
+
+    if (remap & XUSB_GAMEPAD_LT)
+      gamepad.bLeftTrigger = rightTrig;
+
+    if (remap & XUSB_GAMEPAD_RT)
+      gamepad.bRightTrigger = rightTrig;
+  }
+}
+
+void XboxTranslator::CheckDeadzoneCombos(const XboxInputReport& input)
+{
+  // dpad/start/back/thumb bits are the same in OG & XUSB reports, only the triggers need converting
+  uint32_t state = input.Gamepad.wButtons;
+  if (input.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] >= 0x8)
+    state |= XUSB_GAMEPAD_LT;
+  if (input.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER] >= 0x8)
+    state |= XUSB_GAMEPAD_RT;
+  if (input.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER])
+    state |= COMBO_LT_NONZERO;
+  if (input.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER])
+    state |= COMBO_RT_NONZERO;
+
+  // always update the matcher so it doesn't see an old press when combinations get re-enabled
+  // once an adjustment is made, wait for every adjustment combination to be released before making another
+  uint64_t pressed, released;
+  bool waiting_release = input_combos_.Held() != 0;
+  input_combos_.Update(state, pressed, released);
+  if (!deadzoneCombinationEnabled || !pressed || waiting_release)
+    return;
+
+  for (int index = 0; pressed; index++, pressed >>= 1)
+  {
+    if (!(pressed & 1))
+      continue;
+
+    auto& adjust = deadzone_combos[index];
+    switch (adjust.target)
+    {
+    case CURVE_LEFT_STICK:
+      settings_.deadzone.sThumbL = clampInt(settings_.deadzone.sThumbL + adjust.adjustment, 0, SHRT_MAX);
+      break;
+    case CURVE_RIGHT_STICK:
+      settings_.deadzone.sThumbR = clampInt(settings_.deadzone.sThumbR + adjust.adjustment, 0, SHRT_MAX);
+      break;
+    case CURVE_LEFT_TRIGGER:
+      settings_.deadzone.bLeftTrigger = clampInt(settings_.deadzone.bLeftTrigger + adjust.adjustment, 0, 0xFF);
+      break;
+    case CURVE_RIGHT_TRIGGER:
+      settings_.deadzone.bRightTrigger = clampInt(settings_.deadzone.bRightTrigger + adjust.adjustment, 0, 0xFF);
+      break;
+    }
+
+    deadzone_changed_ = true;
+  }
+}
+
+void XboxTranslator::ApplyStickDeadzones(const XboxInputReport& input, XUSB_REPORT& gamepad)
+{
+  // Analog Stick Deadzone Calculations
+  const short sticks[4] = { input.Gamepad.sThumbLX, input.Gamepad.sThumbLY, input.Gamepad.sThumbRX, input.Gamepad.sThumbRY };
+  const short deadzones[2] = { settings_.deadzone.sThumbL, settings_.deadzone.sThumbR };
+  short out[4];
+
+  StickDeadzones(sticks, out, deadzones);
+
+  gamepad.sThumbLX = out[0];
+  gamepad.sThumbLY = out[1];
+  gamepad.sThumbRX = out[2];
+  gamepad.sThumbRY = out[3];
+}
+
+void XboxTranslator::compileCurves()
+{
+  for (int curve = 0; curve < CURVE_COUNT; curve++)
+    curve_enabled_[curve] = !settings_.curves[curve].IsLinear();
+
+  for (int stick = 0; stick < 2; stick++)
+  {
+    if (!curve_enabled_[CURVE_LEFT_STICK + stick])
+      continue;
+
+    for (int i = 0; i <= STICK_CURVE_ENTRIES; i++)
+      stick_curve_table_[stick][i] = (uint16_t)EvaluateResponseCurve(settings_.curves[CURVE_LEFT_STICK + stick],
+        clampInt(i * STICK_CURVE_STEP, 0, SHRT_MAX), SHRT_MAX);
+  }
+
+  for (int trigger = 0; trigger < 2; trigger++)
+  {
+    if (!curve_enabled_[CURVE_LEFT_TRIGGER + trigger])
+      continue;
+
+    for (int value = 0; value < 256; value++)
+      trigger_curve_table_[trigger][value] = (BYTE)EvaluateResponseCurve(settings_.curves[CURVE_LEFT_TRIGGER + trigger], value, 0xFF);
+  }
+}
+
+void XboxTranslator::ApplyResponseCurves(XUSB_REPORT& gamepad)
+{
+  // Sticks: curve is applied to the radius so the stick direction doesn't change
+  // anything past the edge of the circle (corners of square-gated sticks) is passed through as-is
+  short* sticks[2][2] = { { &gamepad.sThumbLX, &gamepad.sThumbLY }, { &gamepad.sThumbRX, &gamepad.sThumbRY } };
+  for (int stick = 0; stick < 2; stick++)
+  {
+    if (!curve_enabled_[CURVE_LEFT_STICK + stick])
+      continue;
+
+    int x = *sticks[stick][0];
+    int y = *sticks[stick][1];
+    uint32_t r_sq = (uint32_t)(x * x) + (uint32_t)(y * y);
+    if (!r_sq)
+      continue;
+
+    int r_in = (int)isqrt(r_sq);
+    if (r_in >= SHRT_MAX)
+      continue;
+
+    // interpolate between the two nearest table entries
+    auto& table = stick_curve_table_[stick];
+    int index = r_in >> STICK_CURVE_SHIFT;
+    int r_out = table[index] + (((table[index + 1] - table[index]) * (r_in & (STICK_CURVE_STEP - 1))) >> STICK_CURVE_SHIFT);
+
+    *sticks[stick][0] = (short)clampInt(x * r_out / r_in, SHRT_MIN, SHRT_MAX);
+    *sticks[stick][1] = (short)clampInt(y * r_out / r_in, SHRT_MIN, SHRT_MAX);
+  }
+
+  if (curve_enabled_[CURVE_LEFT_TRIGGER])
+    gamepad.bLeftTrigger = trigger_curve_table_[0][gamepad.bLeftTrigger];
+  if (curve_enabled_[CURVE_RIGHT_TRIGGER])
+    gamepad.bRightTrigger = trigger_curve_table_[1][gamepad.bRightTrigger];
+}
+
+void XboxTranslator::ApplyOutputCombos(XUSB_REPORT& gamepad, uint64_t now_us)
+{
+  // Create a 'digital' bitfield so we can test combinations against LT/RT
+  uint32_t digitalPressed = gamepad.wButtons;
+  if (gamepad.bLeftTrigger >= 0x8)
+    digitalPressed |= XUSB_GAMEPAD_LT;
+  if (gamepad.bRightTrigger >= 0x8)
+    digitalPressed |= XUSB_GAMEPAD_RT;
+
+  uint64_t pressed, released;
+  output_combos_.Update(digitalPressed, pressed, released);
+
+  uint64_t active = (output_combos_.Held() & output_combo_modes_[COMBO_HOLD]) |
+    (pressed & output_combo_modes_[COMBO_PRESS]) | (released & output_combo_modes_[COMBO_RELEASE]);
+  if (guide_combo_ >= 0 && !settings_.guide_enabled)
+    active &= ~(1ull << guide_combo_);
+  if (!active)
+    return;
+
+  uint32_t clear = 0;
+  uint32_t output = 0;
+  for (int index = 0; active; index++, active >>= 1)
+  {
+    if (!(active & 1))
+      continue;
+
+    // Clear combination from the emulated pad, don't want it to interfere with anything
+    // (release combinations aren't held any more, so there's nothing to clear)
+    auto& combo = output_combos_.Combo(index);
+    if (combo.mode != COMBO_RELEASE)
+      clear |= combo.buttons;
+
+    output |= output_combo_buttons_[index];
+    if (output_combo_macros_[index] >= 0)
+      player_.Start(output_combo_macros_[index], now_us);
+  }
+
+  gamepad.wButtons &= ~((USHORT)clear);
+  if (clear & XUSB_GAMEPAD_LT)
+    gamepad.bLeftTrigger = 0;
+  if (clear & XUSB_GAMEPAD_RT)
+    gamepad.bRightTrigger = 0;
+
+  gamepad.wButtons |= (USHORT)(output & ~(XUSB_GAMEPAD_LT | XUSB_GAMEPAD_RT));
+  if (output & XUSB_GAMEPAD_LT)
+    gamepad.bLeftTrigger = 255;
+  if (output & XUSB_GAMEPAD_RT)
+    gamepad.bRightTrigger = 255;
+}
+
+void XboxTranslator::ApplyTimedOutput(XUSB_REPORT& gamepad, uint64_t now_us)
+{
+  base_report_ = gamepad;
+  next_deadline_ = player_.Active() ? player_.Apply(gamepad, now_us) : 0;
+}
+
+bool XboxTranslator::RefreshTimedOutput(uint64_t now_us, XUSB_REPORT* output)
+{
+  if (!player_.Active())
+  {
+    next_deadline_ = 0;
+    return false;
+  }
+
+  *output = base_report_;
+  next_deadline_ = player_.Apply(*output, now_us);
+  return true;
+}
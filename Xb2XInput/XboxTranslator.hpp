@@ -0,0 +1,128 @@
+#pragma once
+#include "XboxTypes.hpp"
+#include "ComboMatcher.hpp"
+#include "MacroPlayer.hpp"
+#include <climits>
+
+#define STICK_CURVE_SHIFT   5
+#define STICK_CURVE_STEP    (1 << STICK_CURVE_SHIFT)
+#define STICK_CURVE_ENTRIES ((SHRT_MAX + 1) / STICK_CURVE_STEP)
+
+// Extra combination from the INI [Combinations] section, sends output buttons (XUSB_GAMEPAD_*, incl. LT/RT) when matched
+// press/release combinations play macro instead (output is ignored for those)
+struct ComboBinding {
+  ButtonCombo combo;
+  int output;
+  Macro macro;
+
+  bool operator==(const ComboBinding& other) const
+  {
+    return combo == other.combo && output == other.output && macro == other.macro;
+  }
+  bool operator!=(const ComboBinding& other) const { return !(*this == other); }
+};
+
+// Translates Xbox OG input reports into XUSB reports for a single controller
+// (analog->digital buttons, deadzones, remapping & the secret guide/deadzone combinations)
+// Platform-independent, XboxController feeds it reports from libusb & sends the result to ViGEm
+class XboxTranslator
+{
+  UserSettings settings_;
+
+  bool deadzone_changed_ = false;
+
+  // deadZoneCalc results for every trigger value, rebuilt by updateTriggerTable when the trigger deadzones change
+  BYTE trigger_table_[2][256];
+  BYTE trigger_table_deadzone_[2] = { 0 };
+  bool trigger_table_built_[2] = { false };
+
+  void updateTriggerTable(int trigger, BYTE deadzone);
+
+  // button_remap compiled by compileRemap, remap_table_ is indexed by the low/high byte of wButtons
+  // trigger_remap_ is the LT/RT remapping, or -1 if that trigger isn't remapped
+  uint32_t remap_table_[2][256];
+  int trigger_remap_[2] = { -1, -1 };
+  bool remap_compiled_ = false;
+
+  void compileRemap();
+
+  // Response curves compiled by compileCurves, only used for curves that aren't plain linear
+  // Stick tables hold the output radius for every STICK_CURVE_STEP of input radius
+  uint16_t stick_curve_table_[2][STICK_CURVE_ENTRIES + 1];
+  BYTE trigger_curve_table_[2][256];
+  bool curve_enabled_[CURVE_COUNT] = { false };
+
+  void compileCurves();
+
+  // Combinations checked against the controllers own buttons (deadzone adjustment, see deadzone_combos in XboxTranslator.cpp)
+  ComboMatcher input_combos_;
+
+  // Combinations checked against the translated report (GuideButton & combo_bindings), with the buttons each one sends
+  ComboMatcher output_combos_;
+  int output_combo_buttons_[COMBO_MAX];
+  int output_combo_macros_[COMBO_MAX]; // index into player_ macros, or -1 if combo doesn't play one
+  uint64_t output_combo_modes_[3] = { 0 }; // bitmask of output_combos_ using each COMBO_* mode
+  int guide_combo_ = -1;
+
+  // combo_guideButton & combo_bindings as of the last compileCombos, so SetSettings only recompiles when they change
+  int compiled_guide_button_ = 0;
+  std::vector<ComboBinding> compiled_bindings_;
+
+  void compileCombos();
+
+  // Turbo & combination macros, base_report_ is the last translated report before they were applied
+  MacroPlayer player_;
+  XUSB_REPORT base_report_ = { 0 };
+  uint64_t next_deadline_ = 0;
+
+public:
+  XboxTranslator();
+
+  // Reference deadzone implementation (polar coords), only used to build trigger tables & check StickDeadzones against
+  static int deadZoneCalc(short *x_out, short *y_out, short x, short y, short deadzone, short sickzone);
+
+  // Radial deadzone for both sticks (in/out are LX, LY, RX, RY), integer math apart from its square roots, no trig
+  // Matches deadZoneCalc(..., SHRT_MAX) to within 1 LSB for non-negative deadzones
+  static void StickDeadzones(const short in[4], short out[4], const short deadzone[2]);
+
+  // Translates input into output, input report should already be validated by the caller
+  // now_us is the time the report arrived (see TimerWheel::Now), used for turbo/macro timing
+  void Translate(const XboxInputReport& input, XUSB_REPORT* output, uint64_t now_us = 0);
+
+  // Re-applies turbo/macros to the last translated report as of now_us, for updates between input reports
+  // Returns false if they're not in use, output is left untouched then
+  bool RefreshTimedOutput(uint64_t now_us, XUSB_REPORT* output);
+
+  // Time that the output will next change without a new input report (turbo/macros), or 0 if it won't
+  uint64_t NextDeadline() const { return next_deadline_; }
+
+  // Individual stages of Translate, in the order they're ran
+  // (only public so they can be benchmarked separately, see TranslatorBenchmark.cpp)
+  void ConvertButtons(const XboxInputReport& input, XUSB_REPORT& gamepad);
+  void ApplyTriggerDeadzones(const XboxInputReport& input, XUSB_REPORT& gamepad);
+  void ApplyRemap(XUSB_REPORT& gamepad);
+  void CheckDeadzoneCombos(const XboxInputReport& input);
+  void ApplyStickDeadzones(const XboxInputReport& input, XUSB_REPORT& gamepad);
+  void ApplyResponseCurves(XUSB_REPORT& gamepad);
+  void ApplyOutputCombos(XUSB_REPORT& gamepad, uint64_t now_us);
+  void ApplyTimedOutput(XUSB_REPORT& gamepad, uint64_t now_us);
+
+  // Replaces all settings & recompiles whichever of the button remap/response curve/combination tables they affect
+  // Playing macros & held turbo buttons carry on unless the combinations or turbo settings changed
+  void SetSettings(const UserSettings& settings);
+
+  const UserSettings& Settings() const { return settings_; }
+
+  // Returns true if a deadzone combination changed the deadzone since the last call, so it can be saved
+  bool DeadzoneChanged()
+  {
+    bool changed = deadzone_changed_;
+    deadzone_changed_ = false;
+    return changed;
+  }
+};
+
+// Combination settings shared by all controllers, set by Xb2XInput.cpp
+extern int combo_guideButton;
+extern std::vector<ComboBinding> combo_bindings;
+extern bool deadzoneCombinationEnabled;
@@ -0,0 +1,159 @@
+#pragma once
+// Report/settings definitions shared between the Windows app & the portable translation code
+// Nothing in here should depend on libusb/ViGEm client, so it can be built & profiled outside of Windows
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include "ResponseCurve.hpp"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include "ViGEm/Common.h"
+#else
+typedef uint8_t  BYTE;
+typedef uint16_t WORD;
+typedef uint16_t USHORT;
+typedef int16_t  SHORT;
+
+// XUSB definitions from ViGEm/Common.h
+typedef enum _XUSB_BUTTON
+{
+  XUSB_GAMEPAD_DPAD_UP            = 0x0001,
+  XUSB_GAMEPAD_DPAD_DOWN          = 0x0002,
+  XUSB_GAMEPAD_DPAD_LEFT          = 0x0004,
+  XUSB_GAMEPAD_DPAD_RIGHT         = 0x0008,
+  XUSB_GAMEPAD_START              = 0x0010,
+  XUSB_GAMEPAD_BACK               = 0x0020,
+  XUSB_GAMEPAD_LEFT_THUMB         = 0x0040,
+  XUSB_GAMEPAD_RIGHT_THUMB        = 0x0080,
+  XUSB_GAMEPAD_LEFT_SHOULDER      = 0x0100,
+  XUSB_GAMEPAD_RIGHT_SHOULDER     = 0x0200,
+  XUSB_GAMEPAD_GUIDE              = 0x0400,
+  XUSB_GAMEPAD_A                  = 0x1000,
+  XUSB_GAMEPAD_B                  = 0x2000,
+  XUSB_GAMEPAD_X                  = 0x4000,
+  XUSB_GAMEPAD_Y                  = 0x8000
+} XUSB_BUTTON, *PXUSB_BUTTON;
+
+typedef struct _XUSB_REPORT
+{
+  USHORT wButtons;
+  BYTE bLeftTrigger;
+  BYTE bRightTrigger;
+  SHORT sThumbLX;
+  SHORT sThumbLY;
+  SHORT sThumbRX;
+  SHORT sThumbRY;
+} XUSB_REPORT, *PXUSB_REPORT;
+#endif
+
+// original xbox XINPUT definitions from https://github.com/paralin/hl2sdk/blob/master/common/xbox/xboxstubs.h
+
+// digital button bitmasks
+#define OGXINPUT_GAMEPAD_DPAD_UP           0x0001
+#define OGXINPUT_GAMEPAD_DPAD_DOWN         0x0002
+#define OGXINPUT_GAMEPAD_DPAD_LEFT         0x0004
+#define OGXINPUT_GAMEPAD_DPAD_RIGHT        0x0008
+#define OGXINPUT_GAMEPAD_START             0x0010
+#define OGXINPUT_GAMEPAD_BACK              0x0020
+#define OGXINPUT_GAMEPAD_LEFT_THUMB        0x0040
+#define OGXINPUT_GAMEPAD_RIGHT_THUMB       0x0080
+
+// analog button indexes
+#define OGXINPUT_GAMEPAD_A                0
+#define OGXINPUT_GAMEPAD_B                1
+#define OGXINPUT_GAMEPAD_X                2
+#define OGXINPUT_GAMEPAD_Y                3
+#define OGXINPUT_GAMEPAD_BLACK            4
+#define OGXINPUT_GAMEPAD_WHITE            5
+#define OGXINPUT_GAMEPAD_LEFT_TRIGGER     6
+#define OGXINPUT_GAMEPAD_RIGHT_TRIGGER    7
+
+// Used for button combination parsing/checking
+// See Xb2XInput.cpp -> xinput_buttons map
+#define XUSB_GAMEPAD_LT (XUSB_GAMEPAD_Y << 1)
+#define XUSB_GAMEPAD_RT (XUSB_GAMEPAD_Y << 2)
+
+// Hacky defines to help with remap stuff
+#define XUSB_GAMEPAD_Start XUSB_GAMEPAD_START
+#define XUSB_GAMEPAD_Back XUSB_GAMEPAD_BACK
+#define XUSB_GAMEPAD_LS XUSB_GAMEPAD_LEFT_THUMB
+#define XUSB_GAMEPAD_RS XUSB_GAMEPAD_RIGHT_THUMB
+#define XUSB_GAMEPAD_White XUSB_GAMEPAD_LEFT_SHOULDER
+#define XUSB_GAMEPAD_Black XUSB_GAMEPAD_RIGHT_SHOULDER
+
+#define XUSB_GAMEPAD_DpadUp XUSB_GAMEPAD_DPAD_UP
+#define XUSB_GAMEPAD_DpadDown XUSB_GAMEPAD_DPAD_DOWN
+#define XUSB_GAMEPAD_DpadLeft XUSB_GAMEPAD_DPAD_LEFT
+#define XUSB_GAMEPAD_DpadRight XUSB_GAMEPAD_DPAD_RIGHT
+
+#pragma pack(push, 1)
+typedef struct _OGXINPUT_RUMBLE
+{
+  WORD   wLeftMotorSpeed;
+  WORD   wRightMotorSpeed;
+} OGXINPUT_RUMBLE, *POGXINPUT_RUMBLE;
+
+typedef struct _OGXINPUT_GAMEPAD
+{
+  WORD    wButtons;
+  BYTE    bAnalogButtons[8];
+  short   sThumbLX;
+  short   sThumbLY;
+  short   sThumbRX;
+  short   sThumbRY;
+} OGXINPUT_GAMEPAD, *POGXINPUT_GAMEPAD;
+
+struct XboxInputReport {
+  BYTE bReportId;
+  BYTE bSize;
+
+  OGXINPUT_GAMEPAD Gamepad;
+};
+
+struct XboxOutputReport {
+  BYTE bReportId;
+  BYTE bSize;
+
+  OGXINPUT_RUMBLE Rumble;
+};
+
+struct Deadzone {
+  short sThumbL;
+  short sThumbR;
+  BYTE bLeftTrigger;
+  BYTE bRightTrigger;
+};
+
+struct UserSettings {
+  bool guide_enabled = false;
+  bool vibration_enabled = false;
+
+  Deadzone deadzone = { 0 };
+
+  std::unordered_map<int, int> button_remap;
+  bool remap_enabled = false;
+
+  ResponseCurve curves[CURVE_COUNT]; // indexed by CURVE_*
+
+  int turbo_buttons = 0; // XUSB_GAMEPAD_* bits that repeatedly press/release while held
+  int turbo_rate = 10; // turbo presses per second
+
+  bool operator==(const UserSettings& other) const
+  {
+    for (int i = 0; i < CURVE_COUNT; i++)
+      if (curves[i] != other.curves[i])
+        return false;
+
+    return guide_enabled == other.guide_enabled && vibration_enabled == other.vibration_enabled &&
+      !memcmp(&deadzone, &other.deadzone, sizeof(Deadzone)) && button_remap == other.button_remap &&
+      remap_enabled == other.remap_enabled && turbo_buttons == other.turbo_buttons && turbo_rate == other.turbo_rate;
+  }
+  bool operator!=(const UserSettings& other) const { return !(*this == other); }
+};
+
+#pragma pack(pop)
@@ -0,0 +1,247 @@
+#include "Test.hpp"
+#include "InputCapture.hpp"
+#include "XboxTranslator.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+
+// Left in the working directory for the xb2x_replay test (see CMakeLists.txt)
+#define FIXTURE_PATH          "capture_fixture.xb2c"
+#define FIXTURE_CONTROLLERS   2
+#define FIXTURE_REPORTS       100 // per controller
+#define FIXTURE_RUMBLES       10
+
+static XboxInputReport FixtureReport(int controller, int index)
+{
+  XboxInputReport report;
+  memset(&report, 0, sizeof(report));
+  report.bSize = sizeof(XboxInputReport);
+  report.Gamepad.wButtons = (WORD)((index * 7 + controller) & 0xFF);
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_A] = (BYTE)(index & 1 ? 0xFF : 0);
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] = (BYTE)(index * 13);
+  report.Gamepad.sThumbLX = (short)(index * 300 - 15000);
+  report.Gamepad.sThumbRY = (short)(controller ? -index * 250 : index * 250);
+  return report;
+}
+
+// Writes the fixture & checks every record reads back through the mapping in the order it was written
+TEST(WriteAndReadBack)
+{
+  std::unique_ptr<CaptureWriter> writer(new CaptureWriter());
+  CHECK(writer->Open(FIXTURE_PATH));
+  CHECK(writer->IsOpen());
+
+  for (int index = 0; index < FIXTURE_REPORTS; index++)
+  {
+    for (int controller = 0; controller < FIXTURE_CONTROLLERS; controller++)
+      writer->WriteInput(controller, FixtureReport(controller, index));
+
+    if (index % (FIXTURE_REPORTS / FIXTURE_RUMBLES) == 0)
+      writer->WriteRumble(1, (BYTE)index, (BYTE)(255 - index), 2);
+  }
+  writer->Close();
+  CHECK(!writer->IsOpen());
+
+  CaptureReader reader;
+  CHECK(reader.Open(FIXTURE_PATH));
+
+  auto records = reader.Records();
+  CHECK_EQ(records.size(), FIXTURE_REPORTS * FIXTURE_CONTROLLERS + FIXTURE_RUMBLES);
+
+  size_t next = 0;
+  uint64_t last_time = 0;
+  for (int index = 0; index < FIXTURE_REPORTS && next < records.size(); index++)
+  {
+    for (int controller = 0; controller < FIXTURE_CONTROLLERS; controller++)
+    {
+      auto& record = records[next++];
+      auto expected = FixtureReport(controller, index);
+      CHECK_EQ(record.type, CAPTURE_RECORD_INPUT);
+      CHECK_EQ(record.controller, controller);
+      CHECK(!memcmp(&record.input, &expected, sizeof(expected)));
+      CHECK(record.timestamp_us >= last_time);
+      last_time = record.timestamp_us;
+    }
+
+    if (index % (FIXTURE_REPORTS / FIXTURE_RUMBLES) == 0)
+    {
+      auto& record = records[next++];
+      CHECK_EQ(record.type, CAPTURE_RECORD_RUMBLE);
+      CHECK_EQ(record.controller, 1);
+      CHECK_EQ(record.rumble.bLargeMotor, index);
+      CHECK_EQ(record.rumble.bSmallMotor, 255 - index);
+      CHECK_EQ(record.rumble.bLedNumber, 2);
+    }
+  }
+}
+
+TEST(ReplayMatchesTranslate)
+{
+  CaptureReader reader;
+  CHECK(reader.Open(FIXTURE_PATH));
+
+  UserSettings settings;
+  settings.guide_enabled = true;
+  settings.deadzone.sThumbL = 4000;
+  settings.deadzone.bLeftTrigger = 20;
+
+  // each controller gets its own translator, fed its own reports in order
+  XboxTranslator translators[FIXTURE_CONTROLLERS];
+  for (auto& translator : translators)
+    translator.SetSettings(settings);
+
+  int outputs[FIXTURE_CONTROLLERS] = { 0 };
+  int rumbles = 0;
+  int mismatches = 0;
+  auto count = ReplayCapture(reader, settings, false, [&](int controller, const XUSB_REPORT& report)
+  {
+    XUSB_REPORT expected;
+    translators[controller].Translate(FixtureReport(controller, outputs[controller]++), &expected);
+    if (memcmp(&report, &expected, sizeof(expected)))
+      mismatches++;
+  }, [&rumbles](int controller, const CaptureRumble& rumble)
+  {
+    (void)controller;
+    (void)rumble;
+    rumbles++;
+  });
+
+  CHECK_EQ(count, FIXTURE_REPORTS * FIXTURE_CONTROLLERS);
+  CHECK_EQ(outputs[0], FIXTURE_REPORTS);
+  CHECK_EQ(outputs[1], FIXTURE_REPORTS);
+  CHECK_EQ(rumbles, FIXTURE_RUMBLES);
+  CHECK_EQ(mismatches, 0);
+}
+
+// Controllers send input before their ViGEm target is added (index is still -1 then), records have to be tagged with
+// the registry slot they've had since bring-up so the ones from before & after the target went in replay as one pad
+TEST(CapturedBeforeTargetAttached)
+{
+  struct Pad { int target_index = -1; };
+  SlotRegistry<Pad> registry;
+  registry.Remove(registry.Add(std::unique_ptr<Pad>(new Pad()))); // next ID for slot 0 has a generation in it
+  RegistryId pads[2] = { registry.Add(std::unique_ptr<Pad>(new Pad())), registry.Add(std::unique_ptr<Pad>(new Pad())) };
+  CHECK(pads[0] != REGISTRY_ID_SLOT(pads[0]));
+
+  const char* path = "capture_no_target.xb2c";
+  CaptureWriter writer;
+  CHECK(writer.Open(path));
+  for (int index = 0; index < 20; index++)
+  {
+    if (index == 10)
+    {
+      auto guard = registry.Pin();
+      registry.Get(pads[0])->target_index = 1;
+      registry.Get(pads[1])->target_index = 0;
+    }
+    for (int pad = 0; pad < 2; pad++)
+      writer.WriteInput(pads[pad], FixtureReport(pad, index));
+    writer.WriteRumble(pads[1], (BYTE)index, 0, 0);
+  }
+  writer.Close();
+
+  CaptureReader reader;
+  CHECK(reader.Open(path));
+  auto records = reader.Records();
+  CHECK_EQ(records.size(), 60);
+  for (size_t next = 0; next + 3 <= records.size(); next += 3)
+  {
+    CHECK_EQ(records[next].controller, REGISTRY_ID_SLOT(pads[0]));
+    CHECK_EQ(records[next + 1].controller, REGISTRY_ID_SLOT(pads[1]));
+    CHECK_EQ(records[next + 2].controller, REGISTRY_ID_SLOT(pads[1]));
+  }
+
+  UserSettings settings;
+  XboxTranslator translators[2];
+  for (auto& translator : translators)
+    translator.SetSettings(settings);
+
+  int outputs[2] = { 0 };
+  int mismatches = 0, rumbles = 0;
+  auto count = ReplayCapture(reader, settings, false, [&](int controller, const XUSB_REPORT& report)
+  {
+    int pad = controller == (int)REGISTRY_ID_SLOT(pads[0]) ? 0 : 1;
+    CHECK_EQ(controller, REGISTRY_ID_SLOT(pads[pad]));
+
+    XUSB_REPORT expected;
+    translators[pad].Translate(FixtureReport(pad, outputs[pad]++), &expected);
+    if (memcmp(&report, &expected, sizeof(expected)))
+      mismatches++;
+  }, [&](int controller, const CaptureRumble& rumble)
+  {
+    CHECK_EQ(controller, REGISTRY_ID_SLOT(pads[1]));
+    CHECK_EQ(rumble.bLargeMotor, rumbles++);
+  });
+
+  CHECK_EQ(count, 40);
+  CHECK_EQ(outputs[0], 20);
+  CHECK_EQ(outputs[1], 20);
+  CHECK_EQ(rumbles, 20);
+  CHECK_EQ(mismatches, 0);
+
+  reader.Close();
+  remove(path);
+}
+
+TEST(PartialRecordIgnored)
+{
+  const char* path = "capture_partial.xb2c";
+  {
+    std::ifstream in(FIXTURE_PATH, std::ios::binary);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << in.rdbuf();
+    out.write("partial", 7);
+  }
+
+  CaptureReader reader;
+  CHECK(reader.Open(path));
+  CHECK_EQ(reader.Records().size(), FIXTURE_REPORTS * FIXTURE_CONTROLLERS + FIXTURE_RUMBLES);
+
+  // closing unmaps, records are gone afterwards
+  reader.Close();
+  CHECK(reader.Records().empty());
+  remove(path);
+}
+
+TEST(InvalidFilesRejected)
+{
+  CaptureReader reader;
+  CHECK(!reader.Open("capture_missing.xb2c"));
+  CHECK(reader.Records().empty());
+
+  const char* path = "capture_invalid.xb2c";
+
+  // too small for a header
+  {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  }
+  CHECK(!reader.Open(path));
+
+  // wrong magic
+  {
+    CaptureHeader header = { 0 };
+    header.magic = CAPTURE_MAGIC + 1;
+    header.version = CAPTURE_VERSION;
+    header.record_size = sizeof(CaptureRecord);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write((const char*)&header, sizeof(header));
+  }
+  CHECK(!reader.Open(path));
+
+  // header only is a valid, empty capture
+  {
+    CaptureHeader header = { 0 };
+    header.magic = CAPTURE_MAGIC;
+    header.version = CAPTURE_VERSION;
+    header.record_size = sizeof(CaptureRecord);
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write((const char*)&header, sizeof(header));
+  }
+  CHECK(reader.Open(path));
+  CHECK(reader.Records().empty());
+  CHECK_EQ(ReplayCapture(reader, UserSettings(), false, nullptr), 0);
+
+  reader.Close();
+  remove(path);
+}
@@ -0,0 +1,189 @@
+#include "Test.hpp"
+#include "DescriptorCache.hpp"
+#include "DeviceScanner.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+#define CACHE_PATH  "descriptor_cache_test.cache"
+
+// What a third-party pad would answer, same model on every port
+static CachedDescriptor Pad()
+{
+  CachedDescriptor pad;
+  pad.bcd_device = 0x0100;
+  pad.num_configurations = 1;
+  pad.product_index = 2;
+  pad.vendor_index = 1;
+  pad.serial_index = 3;
+  pad.iface_num = 0;
+  pad.iface_setting_num = 1;
+  pad.endpoint_in = 0x81;
+  pad.endpoint_out = 0x02;
+  pad.langid = 0x0409;
+  pad.product = "Controller S";
+  pad.vendor = "Third Party Co."; // spaces have to survive being written out
+  return pad;
+}
+
+// Key for the pad on bus 1, port n
+static std::string PadKey(int n)
+{
+  uint8_t port = (uint8_t)n;
+  return DescriptorCache::Key(0x045E, 0x0289, UsbPortKey(1, &port, 1));
+}
+
+TEST(KeyIncludesIdsAndPort)
+{
+  CHECK(PadKey(1) != PadKey(2));
+  CHECK(DescriptorCache::Key(0x045E, 0x0289, 1) != DescriptorCache::Key(0x045E, 0x0202, 1));
+  CHECK(DescriptorCache::Key(0x045E, 0x0289, 1) != DescriptorCache::Key(0x0738, 0x0289, 1));
+}
+
+TEST(RoundTripsThroughFile)
+{
+  std::remove(CACHE_PATH);
+  {
+    DescriptorCache cache;
+    CHECK(!cache.Load(CACHE_PATH));
+
+    CachedDescriptor cached;
+    CHECK(!cache.Find(PadKey(1), Pad(), cached));
+
+    auto tabbed = Pad();
+    tabbed.product = "Bad\tName\n"; // can't be allowed to break up the line
+    cache.Store(PadKey(1), Pad());
+    cache.Store(PadKey(2), tabbed);
+    CHECK_EQ(cache.Size(), 2);
+    CHECK(cache.Save());
+  }
+
+  DescriptorCache cache;
+  CHECK(cache.Load(CACHE_PATH));
+  CHECK_EQ(cache.Size(), 2);
+
+  CachedDescriptor cached;
+  CHECK(cache.Find(PadKey(1), Pad(), cached));
+  CHECK(cached == Pad());
+  CHECK(cache.Find(PadKey(2), Pad(), cached));
+  CHECK(cached.product == "Bad?Name?");
+  CHECK(cached.vendor == Pad().vendor);
+
+  std::remove(CACHE_PATH);
+}
+
+TEST(StaleEntryDropped)
+{
+  DescriptorCache cache;
+  cache.Store(PadKey(1), Pad());
+
+  // a firmware update changes bcdDevice, entry has to be dropped rather than used
+  auto updated = Pad();
+  updated.bcd_device++;
+  CachedDescriptor cached;
+  CHECK(!cache.Find(PadKey(1), updated, cached));
+  CHECK_EQ(cache.Size(), 0);
+
+  // same for any of the string indexes moving
+  cache.Store(PadKey(1), Pad());
+  updated = Pad();
+  updated.serial_index = 0;
+  CHECK(!cache.Find(PadKey(1), updated, cached));
+  CHECK_EQ(cache.Size(), 0);
+
+  // bring-up results don't have to match, they're what's being looked up
+  cache.Store(PadKey(1), Pad());
+  updated = Pad();
+  updated.endpoint_in = 0;
+  updated.product.clear();
+  CHECK(cache.Find(PadKey(1), updated, cached));
+  CHECK(cached == Pad());
+}
+
+TEST(OtherVersionsIgnored)
+{
+  {
+    std::ofstream file(CACHE_PATH, std::ios::trunc);
+    file << "Xb2XInput descriptor cache v1\n";
+    file << PadKey(1) << "\t256\t1\t2\t1\t3\t0\t1\t129\t2\t1033\tController S\tThird Party Co.\tSN1000\n";
+  }
+
+  DescriptorCache cache;
+  CHECK(!cache.Load(CACHE_PATH));
+  CHECK_EQ(cache.Size(), 0);
+
+  // replaced on the next save
+  cache.Store(PadKey(1), Pad());
+  CHECK(cache.Save());
+  std::ifstream file(CACHE_PATH);
+  std::string header;
+  std::getline(file, header);
+  CHECK(header == DESCRIPTOR_CACHE_HEADER);
+  file.close();
+
+  std::remove(CACHE_PATH);
+}
+
+TEST(MalformedLinesSkipped)
+{
+  {
+    std::ofstream file(CACHE_PATH, std::ios::trunc);
+    file << DESCRIPTOR_CACHE_HEADER << "\n";
+    file << "not an entry\n";
+    file << PadKey(1) << "\t256\t1\n";
+    file << "\t256\t1\t2\t1\t3\t0\t1\t129\t2\t1033\tController S\tThird Party Co.\n"; // no key
+    file << PadKey(2) << "\t256\t1\t2\t1\t3\t0\t1\t129\t2\t1033\tController S\tThird Party Co.\n";
+  }
+
+  DescriptorCache cache;
+  CHECK(cache.Load(CACHE_PATH));
+  CHECK_EQ(cache.Size(), 1);
+
+  CachedDescriptor cached;
+  CHECK(cache.Find(PadKey(2), Pad(), cached));
+  CHECK(cached == Pad());
+
+  std::remove(CACHE_PATH);
+}
+
+TEST(OnlyWrittenWhenChanged)
+{
+  std::remove(CACHE_PATH);
+
+  DescriptorCache cache;
+  cache.Load(CACHE_PATH);
+  CHECK(cache.Save());
+
+  // nothing stored yet, so nothing written
+  CHECK(!std::ifstream(CACHE_PATH).is_open());
+
+  cache.Store(PadKey(1), Pad());
+  CHECK(cache.Save());
+  CHECK(std::ifstream(CACHE_PATH).is_open());
+
+  // storing the same thing again (every bring-up does) doesn't need another write
+  std::remove(CACHE_PATH);
+  cache.Store(PadKey(1), Pad());
+  CHECK(cache.Save());
+  CHECK(!std::ifstream(CACHE_PATH).is_open());
+
+  cache.Remove(PadKey(1));
+  CHECK(cache.Save());
+  CHECK(std::ifstream(CACHE_PATH).is_open());
+
+  std::remove(CACHE_PATH);
+}
+
+TEST(OldestEntriesDropped)
+{
+  DescriptorCache cache;
+  for (int i = 0; i < DESCRIPTOR_CACHE_MAX_ENTRIES + 10; i++)
+    cache.Store(DescriptorCache::Key(0x045E, 0x0289, (uint64_t)i), Pad());
+  CHECK_EQ(cache.Size(), DESCRIPTOR_CACHE_MAX_ENTRIES);
+
+  CachedDescriptor cached;
+  CHECK(!cache.Find(DescriptorCache::Key(0x045E, 0x0289, 0), Pad(), cached));
+  CHECK(!cache.Find(DescriptorCache::Key(0x045E, 0x0289, 9), Pad(), cached));
+  CHECK(cache.Find(DescriptorCache::Key(0x045E, 0x0289, 10), Pad(), cached));
+  CHECK(cache.Find(DescriptorCache::Key(0x045E, 0x0289, DESCRIPTOR_CACHE_MAX_ENTRIES + 9), Pad(), cached));
+}
@@ -0,0 +1,407 @@
+#include "Test.hpp"
+#include "DeviceScanner.hpp"
+
+#include <atomic>
+#include <thread>
+
+// A woken scan has to pick up a new device well inside this, a missed wake would take the full DEVICE_SCAN_POLL_MS
+#define WAKE_TIMEOUT_MS (DEVICE_SCAN_POLL_MS / 3)
+
+#define PLUG_COUNT  10
+#define PLUG_GAP_MS 20
+
+typedef std::chrono::steady_clock Clock;
+
+static long long ElapsedMs(Clock::time_point start)
+{
+  return (long long)std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+}
+
+TEST(OnlyNewDevicesChecked)
+{
+  DeviceScanner<int> scanner;
+  std::vector<int> checked;
+  auto check = [&checked](int device) { checked.push_back(device); return true; };
+
+  CHECK_EQ(scanner.Scan({ 3, 1, 2 }, check), 3);
+  CHECK_EQ(scanner.Known(), 3);
+
+  checked.clear();
+  CHECK_EQ(scanner.Scan({ 1, 2, 3, 4 }, check), 1);
+  CHECK_EQ(checked.size(), 1);
+  CHECK_EQ(checked[0], 4);
+
+  // 2 was unplugged, so it's checked again once it's back
+  checked.clear();
+  CHECK_EQ(scanner.Scan({ 1, 3, 4 }, check), 0);
+  CHECK_EQ(scanner.Known(), 3);
+  CHECK_EQ(scanner.Scan({ 1, 2, 3, 4 }, check), 1);
+  CHECK_EQ(checked.size(), 1);
+  CHECK_EQ(checked[0], 2);
+
+  CHECK_EQ(scanner.Scans(), 4);
+  CHECK_EQ(scanner.Checked(), 5);
+}
+
+TEST(UnfinishedDevicesCheckedAgain)
+{
+  DeviceScanner<int> scanner;
+  int attempts = 0;
+  auto check = [&attempts](int device) { return device != 2 || ++attempts >= 3; };
+
+  scanner.Scan({ 1, 2 }, check);
+  CHECK_EQ(scanner.Known(), 1);
+  scanner.Scan({ 1, 2 }, check);
+  CHECK_EQ(scanner.Known(), 1);
+  scanner.Scan({ 1, 2 }, check);
+  CHECK_EQ(scanner.Known(), 2);
+  CHECK_EQ(attempts, 3);
+
+  CHECK_EQ(scanner.Scan({ 1, 2 }, check), 0);
+  CHECK_EQ(attempts, 3);
+}
+
+TEST(ForgetAndReset)
+{
+  DeviceScanner<int> scanner;
+  auto check = [](int) { return true; };
+
+  scanner.Scan({ 1, 2, 3 }, check);
+  scanner.Forget(2);
+  scanner.Forget(7); // not known, nothing happens
+  CHECK_EQ(scanner.Known(), 2);
+  CHECK_EQ(scanner.Scan({ 1, 2, 3 }, check), 1);
+
+  scanner.Reset();
+  CHECK_EQ(scanner.Known(), 0);
+  CHECK_EQ(scanner.Scan({ 1, 2, 3 }, check), 3);
+}
+
+TEST(WaitTimesOutWithoutWake)
+{
+  DeviceScanner<int> scanner;
+  auto start = Clock::now();
+  CHECK(!scanner.Wait(50));
+  CHECK(ElapsedMs(start) >= 40);
+}
+
+TEST(WakeBeforeWaitIsKept)
+{
+  DeviceScanner<int> scanner;
+  scanner.Wake();
+  auto start = Clock::now();
+  CHECK(scanner.Wait(DEVICE_SCAN_POLL_MS));
+  CHECK(ElapsedMs(start) < WAKE_TIMEOUT_MS);
+
+  // only wakes the one Wait
+  CHECK(!scanner.Wait(10));
+}
+
+// Devices get plugged into a bus while a thread scans it the way USBCheckThread does (Scan, then Wait for up to
+// DEVICE_SCAN_POLL_MS), with each plug followed by Wake like OnHotplug/DevicesChanged do
+// Every device has to be checked long before the poll would have found it
+TEST(WakeLatencyWithScanThread)
+{
+  std::mutex bus_mutex;
+  std::vector<int> bus = { 0 };
+  Clock::time_point plugged[PLUG_COUNT + 1], checked[PLUG_COUNT + 1];
+
+  DeviceScanner<int> scanner;
+  std::atomic<bool> stopping{ false };
+  std::thread scan_thread([&]()
+  {
+    while (!stopping)
+    {
+      std::vector<int> current;
+      {
+        std::lock_guard<std::mutex> guard(bus_mutex);
+        current = bus;
+      }
+      scanner.Scan(current, [&](int device)
+      {
+        checked[device] = Clock::now();
+        return true;
+      });
+      scanner.Wait(DEVICE_SCAN_POLL_MS);
+    }
+  });
+
+  for (int device = 1; device <= PLUG_COUNT; device++)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(PLUG_GAP_MS));
+    {
+      std::lock_guard<std::mutex> guard(bus_mutex);
+      plugged[device] = Clock::now();
+      bus.push_back(device);
+    }
+    scanner.Wake();
+  }
+
+  // long enough for every device to have been checked if the wakes work, too short for a poll to have found them
+  auto deadline = Clock::now() + std::chrono::milliseconds(WAKE_TIMEOUT_MS);
+  while (scanner.Known() < PLUG_COUNT + 1 && Clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  stopping = true;
+  scanner.Wake();
+  scan_thread.join();
+
+  CHECK_EQ(scanner.Known(), PLUG_COUNT + 1);
+  for (int device = 1; device <= PLUG_COUNT; device++)
+  {
+    CHECK(checked[device] != Clock::time_point());
+    if (checked[device] != Clock::time_point())
+      CHECK(std::chrono::duration_cast<std::chrono::milliseconds>(checked[device] - plugged[device]).count() < WAKE_TIMEOUT_MS);
+  }
+}
+
+// Simulated bus for AttachNewDevices: devices under 100 are controllers, bring-up fails for anything in fail_bring_up
+// & adding fails for anything in fail_add, each entry only failing once (like a controller that wasn't ready yet)
+struct SimulatedAttach {
+  struct Pending {
+    int device;
+  };
+
+  std::vector<int> fail_bring_up, fail_add;
+  std::vector<int> checked, added;
+  std::mutex mutex;
+  std::atomic<int> bringing_up{ 0 };
+  int most_at_once = 0;
+
+  static bool takeFailure(std::vector<int>& failures, int device)
+  {
+    auto it = std::find(failures.begin(), failures.end(), device);
+    if (it == failures.end())
+      return false;
+    failures.erase(it);
+    return true;
+  }
+
+  int Attach(DeviceScanner<int>& scanner, const std::vector<int>& bus, size_t max_threads)
+  {
+    return AttachNewDevices<Pending>(scanner, bus, max_threads,
+      [this](int device, std::vector<Pending>& found)
+    {
+      checked.push_back(device);
+      if (device < 100)
+        found.push_back({ device });
+      return true;
+    },
+    [this](Pending& pending)
+    {
+      int running = ++bringing_up;
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      std::lock_guard<std::mutex> guard(mutex);
+      if (running > most_at_once)
+        most_at_once = running;
+      bringing_up--;
+      return !takeFailure(fail_bring_up, pending.device);
+    },
+    [this](Pending& pending)
+    {
+      if (takeFailure(fail_add, pending.device))
+        return false;
+      added.push_back(pending.device);
+      return true;
+    });
+  }
+};
+
+TEST(EveryNewControllerAttached)
+{
+  DeviceScanner<int> scanner;
+  SimulatedAttach sim;
+
+  std::vector<int> bus = { 1, 150, 2, 3, 200, 4 };
+  CHECK_EQ(sim.Attach(scanner, bus, 4), 4);
+  CHECK_EQ(sim.checked.size(), 6);
+  CHECK(sim.added == std::vector<int>({ 1, 2, 3, 4 })); // added in the order they were found
+  CHECK(sim.most_at_once > 1);
+
+  // nothing new, nothing checked or added
+  sim.checked.clear();
+  CHECK_EQ(sim.Attach(scanner, bus, 4), 0);
+  CHECK(sim.checked.empty());
+  CHECK_EQ(sim.added.size(), 4);
+
+  // a hub full of them plugged in at once
+  for (int device = 5; device <= 12; device++)
+    bus.push_back(device);
+  CHECK_EQ(sim.Attach(scanner, bus, 4), 8);
+  CHECK_EQ(sim.checked.size(), 8);
+  CHECK_EQ(sim.added.size(), 12);
+  CHECK_EQ(scanner.Known(), bus.size());
+}
+
+TEST(FailedBringUpCheckedNextScan)
+{
+  DeviceScanner<int> scanner;
+  SimulatedAttach sim;
+  sim.fail_bring_up = { 2 };
+  sim.fail_add = { 3 }; // eg. no free slots
+
+  std::vector<int> bus = { 1, 2, 3, 150 };
+  CHECK_EQ(sim.Attach(scanner, bus, 4), 1);
+  CHECK(sim.added == std::vector<int>({ 1 }));
+  CHECK_EQ(scanner.Known(), 2);
+
+  // only the two that failed are looked at again, & both come up this time
+  sim.checked.clear();
+  CHECK_EQ(sim.Attach(scanner, bus, 4), 2);
+  CHECK(sim.checked == std::vector<int>({ 2, 3 }));
+  CHECK(sim.added == std::vector<int>({ 1, 2, 3 }));
+  CHECK_EQ(scanner.Known(), 4);
+}
+
+// UpdateAll dropping a controller that's still plugged in (bad reports, transfers wouldn't start) forgets its device &
+// wakes the scanner, so it's brought up again straight away instead of sitting unused until it's replugged
+TEST(RemovedControllerRescanned)
+{
+  DeviceScanner<int> scanner;
+  SimulatedAttach sim;
+
+  std::vector<int> bus = { 1, 2, 3 };
+  CHECK_EQ(sim.Attach(scanner, bus, 4), 3);
+
+  scanner.Forget(2);
+  scanner.Wake();
+  CHECK(scanner.Wait(0));
+
+  sim.checked.clear();
+  CHECK_EQ(sim.Attach(scanner, bus, 4), 1);
+  CHECK(sim.checked == std::vector<int>({ 2 }));
+  CHECK(sim.added == std::vector<int>({ 1, 2, 3, 2 }));
+
+  // one that left the bus isn't forgotten, it's just not there next scan, & is checked again if it comes back
+  sim.checked.clear();
+  CHECK_EQ(sim.Attach(scanner, { 1, 2 }, 4), 0);
+  CHECK(sim.checked.empty());
+  CHECK_EQ(sim.Attach(scanner, bus, 4), 1);
+  CHECK(sim.checked == std::vector<int>({ 3 }));
+}
+
+// UpdateAll runs on the USB update thread, so it can forget a device while the scan thread is in the middle of a scan
+TEST(ForgetDuringScanKept)
+{
+  DeviceScanner<int> scanner;
+  scanner.Scan({ 1, 2, 3 }, [](int) { return true; });
+
+  CHECK_EQ(scanner.Scan({ 1, 2, 3, 4 }, [&scanner](int)
+  {
+    scanner.Forget(2);
+    return true;
+  }), 1);
+  CHECK_EQ(scanner.Known(), 3);
+
+  std::vector<int> checked;
+  CHECK_EQ(scanner.Scan({ 1, 2, 3, 4 }, [&checked](int device) { checked.push_back(device); return true; }), 1);
+  CHECK(checked == std::vector<int>({ 2 }));
+
+  // only that scan, later ones aren't affected
+  CHECK_EQ(scanner.Scan({ 1, 2, 3, 4 }, [](int) { return true; }), 0);
+  CHECK_EQ(scanner.Known(), 4);
+}
+
+// Controller registered the way OpenDevice does it, indexed by its port key
+struct PortController {
+  std::vector<uint8_t> ports;
+};
+
+static const std::vector<uint8_t>& PortsOf(PortController& controller)
+{
+  return controller.ports;
+}
+
+static RegistryId AddController(SlotRegistry<PortController>& controllers, uint8_t bus, const std::vector<uint8_t>& ports)
+{
+  auto id = controllers.Add(std::unique_ptr<PortController>(new PortController{ ports }));
+  auto port_key = UsbPortKey(bus, ports.data(), (int)ports.size());
+  if (port_key)
+    controllers.SetKey(port_key, id);
+  return id;
+}
+
+static bool InUse(SlotRegistry<PortController>& controllers, uint8_t bus, const std::vector<uint8_t>& ports)
+{
+  auto pin = controllers.Pin();
+  return UsbPortInUse(controllers, bus, ports.data(), (int)ports.size(), PortsOf);
+}
+
+TEST(PortInUseByKey)
+{
+  SlotRegistry<PortController> controllers;
+  auto id = AddController(controllers, 1, { 2, 3 });
+
+  CHECK(InUse(controllers, 1, { 2, 3 }));
+  CHECK(!InUse(controllers, 2, { 2, 3 })); // same ports on another bus
+  CHECK(!InUse(controllers, 1, { 2 }));
+  CHECK(!InUse(controllers, 1, { 2, 3, 1 }));
+  CHECK(!InUse(controllers, 1, { 3, 2 }));
+
+  // Remove drops its keys, so an unplugged controller's port is free again
+  controllers.Remove(id);
+  CHECK(!InUse(controllers, 1, { 2, 3 }));
+}
+
+// USB allows 7 tiers of hubs, paths that deep don't get a key & have to be compared against every controller
+TEST(PortInUseTooDeepForKey)
+{
+  std::vector<uint8_t> deep = { 1, 2, 3, 4, 5, 6, 7 };
+  CHECK_EQ(UsbPortKey(1, deep.data(), (int)deep.size()), 0);
+
+  SlotRegistry<PortController> controllers;
+  AddController(controllers, 1, { 1, 2, 3, 4, 5, 6 });
+  CHECK(!InUse(controllers, 1, deep));
+
+  auto id = AddController(controllers, 1, deep);
+  CHECK(InUse(controllers, 1, deep));
+  CHECK(!InUse(controllers, 1, { 1, 2, 3, 4, 5, 6, 1 }));
+
+  // the keyed controller on the first 6 ports is still found by key
+  CHECK(InUse(controllers, 1, { 1, 2, 3, 4, 5, 6 }));
+
+  controllers.Remove(id);
+  CHECK(!InUse(controllers, 1, deep));
+}
+
+// Every device on a bus full of hubs, against a registry holding every few of them: the index has to find exactly the
+// ones comparing every controller's path would
+TEST(PortIndexMatchesScanning)
+{
+  struct BusDevice {
+    uint8_t bus;
+    std::vector<uint8_t> ports;
+  };
+
+  // bus n is behind n - 1 hubs, then the device's number as base-7 digits (ports 1-7)
+  std::vector<BusDevice> devices(256);
+  for (size_t i = 0; i < devices.size(); i++)
+  {
+    auto& device = devices[i];
+    device.bus = (uint8_t)(1 + i % 4);
+    device.ports.assign(device.bus - 1, 1);
+    size_t number = i / 4;
+    do
+    {
+      device.ports.push_back((uint8_t)(1 + number % 7));
+      number /= 7;
+    } while (number);
+  }
+
+  SlotRegistry<PortController> controllers;
+  std::vector<size_t> added;
+  for (size_t i = 0; i < devices.size(); i += devices.size() / REGISTRY_SLOTS)
+  {
+    AddController(controllers, devices[i].bus, devices[i].ports);
+    added.push_back(i);
+  }
+
+  size_t found = 0;
+  for (size_t i = 0; i < devices.size(); i++)
+  {
+    bool in_use = InUse(controllers, devices[i].bus, devices[i].ports);
+    CHECK_EQ(in_use, std::find(added.begin(), added.end(), i) != added.end());
+    found += in_use;
+  }
+  CHECK_EQ(found, REGISTRY_SLOTS);
+}
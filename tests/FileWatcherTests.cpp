@@ -0,0 +1,120 @@
+#include "Test.hpp"
+#include "FileWatcher.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+
+#define WATCHED_PATH  "file_watcher_test.ini"
+
+// Longest a change can take to be noticed: a full poll interval, the settle wait, & some leeway for a busy machine
+#define CHANGE_TIMEOUT_MS (FILE_WATCHER_POLL_MS + FILE_WATCHER_SETTLE_MS + 1500)
+
+// Long enough for the watcher to have checked the file a few times
+#define QUIET_MS (FILE_WATCHER_POLL_MS * 3)
+
+struct CallbackCounter {
+  std::mutex mutex;
+  std::condition_variable changed;
+  int count = 0;
+
+  void Fire()
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    count++;
+    changed.notify_all();
+  }
+
+  // Waits up to timeout_ms for the count to reach at least target, returns the count
+  int WaitFor(int target, int timeout_ms)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this, target] { return count >= target; });
+    return count;
+  }
+};
+
+static void WriteIni(const char* contents)
+{
+  std::ofstream file(WATCHED_PATH, std::ios::binary | std::ios::trunc);
+  file << contents;
+}
+
+// Watcher polls outside of Windows, so this runs the polling fallback there
+TEST(CallbackOncePerContentChange)
+{
+  WriteIni("[Default]\nEnableGuide=1\n");
+
+  CallbackCounter counter;
+  FileWatcher watcher;
+  CHECK(watcher.Start(WATCHED_PATH, [&counter] { counter.Fire(); }));
+
+  // starting doesn't count as a change
+  CHECK_EQ(counter.WaitFor(1, QUIET_MS), 0);
+
+  const char* contents[] = {
+    "[Default]\nEnableGuide=0\n",
+    "[Default]\nEnableGuide=0\nDeadzoneLeftStick=7849\n",
+    "[Default]\nEnableGuide=1\n", // back to how it started is still a change
+  };
+
+  int expected = 0;
+  for (auto text : contents)
+  {
+    WriteIni(text);
+    expected++;
+    CHECK_EQ(counter.WaitFor(expected, CHANGE_TIMEOUT_MS), expected);
+
+    // & only once, later polls see the same contents
+    CHECK_EQ(counter.WaitFor(expected + 1, QUIET_MS), expected);
+  }
+
+  // rewriting the same contents (eg. an editor saving without changes) doesn't fire it
+  WriteIni(contents[2]);
+  CHECK_EQ(counter.WaitFor(expected + 1, QUIET_MS), expected);
+
+  watcher.Stop();
+
+  // nothing fires once stopped
+  WriteIni("[Default]\nEnableGuide=0\n");
+  CHECK_EQ(counter.WaitFor(expected + 1, QUIET_MS), expected);
+
+  remove(WATCHED_PATH);
+}
+
+TEST(DeletedFileDoesNotFire)
+{
+  WriteIni("[Default]\n");
+
+  CallbackCounter counter;
+  FileWatcher watcher;
+  CHECK(watcher.Start(WATCHED_PATH, [&counter] { counter.Fire(); }));
+
+  // file being missing for a moment (eg. replaced by rename) isn't a change, only different contents are
+  remove(WATCHED_PATH);
+  CHECK_EQ(counter.WaitFor(1, QUIET_MS), 0);
+
+  WriteIni("[Default]\n");
+  CHECK_EQ(counter.WaitFor(1, QUIET_MS), 0);
+
+  WriteIni("[Default]\nEnableGuide=1\n");
+  CHECK_EQ(counter.WaitFor(1, CHANGE_TIMEOUT_MS), 1);
+
+  watcher.Stop();
+  remove(WATCHED_PATH);
+}
+
+TEST(StartTwiceFails)
+{
+  WriteIni("[Default]\n");
+
+  FileWatcher watcher;
+  CHECK(watcher.Start(WATCHED_PATH, [] {}));
+  CHECK(!watcher.Start(WATCHED_PATH, [] {}));
+  watcher.Stop();
+
+  // can be started again once stopped
+  CHECK(watcher.Start(WATCHED_PATH, [] {}));
+  watcher.Stop();
+  remove(WATCHED_PATH);
+}
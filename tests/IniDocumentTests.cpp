@@ -0,0 +1,189 @@
+#include "Test.hpp"
+#include "IniDocument.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+static void Parse(IniDocument& ini, const char* text)
+{
+  std::istringstream stream(text);
+  ini.Parse(stream);
+}
+
+static std::string GetValue(const IniDocument& ini, const std::string& section, const std::string& key)
+{
+  std::string value = "<unset>";
+  ini.Get(section, key, value);
+  return value;
+}
+
+TEST(NamesCaseInsensitive)
+{
+  IniDocument ini;
+  Parse(ini, "[Default]\nEnableGuide=true\n[045E:0289]\nDeadzoneLeftStick=100\n");
+  CHECK(GetValue(ini, "default", "ENABLEGUIDE") == "true");
+  CHECK(GetValue(ini, "DEFAULT", "enableguide") == "true");
+  CHECK(GetValue(ini, "045e:0289", "deadzoneleftstick") == "100");
+  CHECK(ini.HasSection("DeFaUlT"));
+  CHECK(!ini.HasSection("Missing"));
+
+  // values keep their case
+  Parse(ini, "[Default]\nRemapA=Start + Back\n");
+  CHECK(GetValue(ini, "Default", "RemapA") == "Start + Back");
+}
+
+TEST(WhitespaceAndQuotesRemoved)
+{
+  IniDocument ini;
+  Parse(ini,
+    "  [ Default ]  \r\n"
+    "  EnableGuide  =  true  \r\n"
+    "Quoted=\"  spaced  \"\r\n"
+    "Single='single'\r\n"
+    "Mismatched=\"one'\r\n"
+    "Inner=a \"b\" c\r\n"
+    "Empty=\r\n"
+    "EmptyQuotes=\"\"\r\n"
+    "Equals=a=b\r\n");
+
+  CHECK(GetValue(ini, "Default", "EnableGuide") == "true");
+  CHECK(GetValue(ini, "Default", "Quoted") == "  spaced  ");
+  CHECK(GetValue(ini, "Default", "Single") == "single");
+  CHECK(GetValue(ini, "Default", "Mismatched") == "\"one'");
+  CHECK(GetValue(ini, "Default", "Inner") == "a \"b\" c");
+  CHECK(GetValue(ini, "Default", "Empty") == "");
+  CHECK(GetValue(ini, "Default", "EmptyQuotes") == "");
+  CHECK(GetValue(ini, "Default", "Equals") == "a=b");
+}
+
+TEST(FirstDuplicateWins)
+{
+  IniDocument ini;
+  Parse(ini,
+    "[Default]\n"
+    "EnableGuide=true\n"
+    "enableguide=false\n"
+    "[Options]\n"
+    "BatchReportsMs=4\n"
+    "[default]\n"
+    "EnableGuide=false\n"
+    "EnableVibration=false\n");
+
+  // repeated sections are merged, earliest key still wins
+  CHECK(GetValue(ini, "Default", "EnableGuide") == "true");
+  CHECK(GetValue(ini, "Default", "EnableVibration") == "false");
+  CHECK(GetValue(ini, "Options", "BatchReportsMs") == "4");
+}
+
+TEST(SkippedLines)
+{
+  IniDocument ini;
+  Parse(ini,
+    "\xEF\xBB\xBF" "BeforeSection=1\n"
+    "[Default]\n"
+    "; EnableGuide=false\n"
+    "   ;EnableVibration=false\n"
+    "no equals sign\n"
+    "=no key\n"
+    "[Unclosed\n"
+    "EnableGuide=true\n");
+
+  CHECK(GetValue(ini, "", "BeforeSection") == "<unset>");
+  CHECK(GetValue(ini, "Default", "EnableVibration") == "<unset>");
+  CHECK(GetValue(ini, "Default", "") == "<unset>");
+  CHECK(!ini.HasSection("Unclosed"));
+
+  // unclosed section header is skipped, keys after it stay in the last section
+  CHECK(GetValue(ini, "Default", "EnableGuide") == "true");
+
+  // BOM doesn't end up in the first section name
+  Parse(ini, "\xEF\xBB\xBF[Default]\nEnableGuide=true\n");
+  CHECK(GetValue(ini, "Default", "EnableGuide") == "true");
+}
+
+TEST(ParseReplacesDocument)
+{
+  IniDocument ini;
+  Parse(ini, "[Default]\nEnableGuide=true\n");
+  ini.Set("Default", "EnableVibration", "false");
+
+  Parse(ini, "[Controller1]\nEnableGuide=false\n");
+  CHECK(!ini.HasSection("Default"));
+  CHECK(GetValue(ini, "Controller1", "EnableGuide") == "false");
+
+  // missing file empties it
+  std::remove("ini_document_missing.ini");
+  CHECK(!ini.Load("ini_document_missing.ini"));
+  CHECK(!ini.HasSection("Controller1"));
+
+  {
+    std::ofstream file("ini_document_test.ini", std::ios::trunc);
+    file << "[Default]\nEnableGuide=true\n";
+  }
+  CHECK(ini.Load("ini_document_test.ini"));
+  CHECK(GetValue(ini, "Default", "EnableGuide") == "true");
+  std::remove("ini_document_test.ini");
+}
+
+TEST(SetOverridesAndAdds)
+{
+  IniDocument ini;
+  Parse(ini, "[Default]\nEnableGuide=true\n");
+  ini.Set("DEFAULT", "ENABLEGUIDE", "false");
+  CHECK(GetValue(ini, "Default", "EnableGuide") == "false");
+
+  ini.Set("Controller1", "DeadzoneLeftStick", "7849");
+  CHECK(ini.HasSection("controller1"));
+  CHECK(GetValue(ini, "controller1", "deadzoneleftstick") == "7849");
+}
+
+// The USB update thread reads settings while the UI thread saves deadzones & the file watcher reloads the whole file
+TEST(ConcurrentGetAndSet)
+{
+  IniDocument ini;
+  Parse(ini, "[Default]\nEnableGuide=true\n");
+
+  const int threads = 4;
+  const int iterations = 2000;
+  std::atomic<int> bad_values(0);
+  std::vector<std::thread> workers;
+
+  for (int t = 0; t < threads; t++)
+  {
+    workers.emplace_back([&ini, &bad_values, t]
+    {
+      auto section = "Controller" + std::to_string(t);
+      for (int i = 0; i < iterations; i++)
+      {
+        ini.Set(section, "Deadzone", std::to_string(i));
+
+        // a reload can drop it again straight away, but it can't be anything else
+        std::string value;
+        if (ini.Get(section, "Deadzone", value) && value != std::to_string(i))
+          bad_values++;
+
+        if (ini.Get("Default", "EnableGuide", value) && value != "true")
+          bad_values++;
+      }
+    });
+  }
+
+  workers.emplace_back([&ini]
+  {
+    for (int i = 0; i < iterations / 10; i++)
+    {
+      Parse(ini, "[Default]\nEnableGuide=true\n");
+      ini.HasSection("Controller0");
+    }
+  });
+
+  for (auto& worker : workers)
+    worker.join();
+
+  CHECK_EQ(bad_values.load(), 0);
+  CHECK(GetValue(ini, "Default", "EnableGuide") == "true");
+}
@@ -0,0 +1,215 @@
+#include "Test.hpp"
+#include "InputTransfers.hpp"
+
+#include <deque>
+#include <utility>
+
+// Simulated controller: transfers only finish when the test says so (or when cancelled), & get dispatched to
+// InputTransferSet::Completed by HandleTransferEvents, the same way libusb calls XboxController::OnInputTransfer
+class SimulatedDevice : public InputTransferBackend
+{
+public:
+  InputTransferSet transfers{ this, 4 };
+
+  bool allocated[4] = { false };
+  bool in_flight[4] = { false };
+  int submits = 0;
+  int cancels = 0;
+  int processed = 0;
+
+  int fail_submit_after = -1; // submits left before SubmitTransfer starts failing, -1 to never fail
+  bool process_result = true;
+
+  std::deque<std::pair<int, InputTransferStatus>> finished;
+
+  bool PrepareTransfer(int index) override
+  {
+    allocated[index] = true;
+    return true;
+  }
+
+  int SubmitTransfer(int index) override
+  {
+    CHECK(allocated[index]);
+    CHECK(!in_flight[index]);
+
+    if (fail_submit_after == 0)
+      return -1;
+    if (fail_submit_after > 0)
+      fail_submit_after--;
+
+    in_flight[index] = true;
+    submits++;
+    return 0;
+  }
+
+  void CancelTransfer(int index) override
+  {
+    if (!in_flight[index])
+      return;
+
+    cancels++;
+    Finish(index, INPUT_TRANSFER_CANCELLED);
+  }
+
+  void FreeTransfer(int index) override
+  {
+    CHECK(!in_flight[index]);
+    allocated[index] = false;
+  }
+
+  void HandleTransferEvents(int timeout_ms) override
+  {
+    (void)timeout_ms;
+    DispatchAll();
+  }
+
+  // Transfer finishes on the device, its callback runs on the next HandleTransferEvents
+  void Finish(int index, InputTransferStatus status)
+  {
+    CHECK(in_flight[index]);
+    in_flight[index] = false;
+    finished.push_back(std::make_pair(index, status));
+  }
+
+  void DispatchAll()
+  {
+    while (finished.size())
+    {
+      auto transfer = finished.front();
+      finished.pop_front();
+      transfers.Completed(transfer.first, transfer.second, [this]() { processed++; return process_result; });
+    }
+  }
+
+  int InFlight() const
+  {
+    int count = 0;
+    for (bool flight : in_flight)
+      count += flight ? 1 : 0;
+    return count;
+  }
+};
+
+TEST(StartSubmitsEveryTransfer)
+{
+  SimulatedDevice device;
+  CHECK(device.transfers.Start());
+  CHECK_EQ(device.transfers.Pending(), 4);
+  CHECK_EQ(device.InFlight(), 4);
+  CHECK_EQ(device.submits, 4);
+
+  device.transfers.Stop();
+}
+
+TEST(CompletedTransfersAreResubmitted)
+{
+  SimulatedDevice device;
+  device.transfers.Start();
+
+  for (int i = 0; i < 100; i++)
+  {
+    device.Finish(i % 4, INPUT_TRANSFER_COMPLETED);
+    device.DispatchAll();
+    CHECK_EQ(device.transfers.Pending(), 4);
+    CHECK_EQ(device.InFlight(), 4);
+  }
+  CHECK_EQ(device.processed, 100);
+  CHECK_EQ(device.submits, 104);
+
+  // errors are retried without processing anything
+  device.Finish(2, INPUT_TRANSFER_ERROR);
+  device.DispatchAll();
+  CHECK_EQ(device.processed, 100);
+  CHECK_EQ(device.transfers.Pending(), 4);
+  CHECK(device.in_flight[2]);
+  CHECK(!device.transfers.Disconnected());
+
+  device.transfers.Stop();
+}
+
+TEST(NoDeviceStopsResubmitting)
+{
+  SimulatedDevice device;
+  device.transfers.Start();
+
+  device.Finish(1, INPUT_TRANSFER_NO_DEVICE);
+  device.DispatchAll();
+  CHECK(device.transfers.Disconnected());
+  CHECK_EQ(device.transfers.Pending(), 3);
+  CHECK(!device.in_flight[1]);
+
+  // rest of them complete after the device went away, they're not processed or resubmitted either
+  device.Finish(0, INPUT_TRANSFER_COMPLETED);
+  device.Finish(3, INPUT_TRANSFER_ERROR);
+  device.DispatchAll();
+  CHECK_EQ(device.processed, 0);
+  CHECK_EQ(device.transfers.Pending(), 1);
+  CHECK_EQ(device.InFlight(), 1);
+
+  device.transfers.Stop();
+  CHECK_EQ(device.transfers.Pending(), 0);
+  CHECK_EQ(device.cancels, 1);
+}
+
+TEST(ProcessFailureDisconnects)
+{
+  SimulatedDevice device;
+  device.transfers.Start();
+
+  device.process_result = false;
+  device.Finish(0, INPUT_TRANSFER_COMPLETED);
+  device.DispatchAll();
+  CHECK_EQ(device.processed, 1);
+  CHECK(device.transfers.Disconnected());
+  CHECK_EQ(device.transfers.Pending(), 3);
+
+  device.transfers.Stop();
+  CHECK_EQ(device.transfers.Pending(), 0);
+}
+
+TEST(FailedSubmitIsNotCounted)
+{
+  SimulatedDevice device;
+  device.fail_submit_after = 2;
+  CHECK(!device.transfers.Start());
+  CHECK_EQ(device.transfers.Pending(), 2);
+  CHECK_EQ(device.InFlight(), 2);
+
+  // failing to resubmit drops the transfer from the count
+  device.Finish(0, INPUT_TRANSFER_COMPLETED);
+  device.DispatchAll();
+  CHECK_EQ(device.processed, 1);
+  CHECK_EQ(device.transfers.Pending(), 1);
+
+  device.transfers.Stop();
+  CHECK_EQ(device.transfers.Pending(), 0);
+}
+
+TEST(StopCancelsAndDrains)
+{
+  SimulatedDevice device;
+  device.transfers.Start();
+
+  // one report finished but hasn't been dispatched yet when Stop is called, it's dropped instead of processed/resubmitted
+  device.Finish(3, INPUT_TRANSFER_COMPLETED);
+  device.transfers.Stop();
+
+  CHECK_EQ(device.cancels, 3);
+  CHECK_EQ(device.processed, 0);
+  CHECK_EQ(device.transfers.Pending(), 0);
+  CHECK_EQ(device.InFlight(), 0);
+  CHECK_EQ(device.submits, 4);
+  for (bool allocated : device.allocated)
+    CHECK(!allocated);
+
+  // stopping again (eg. Close then the destructor) has nothing left to wait for
+  device.transfers.Stop();
+  CHECK_EQ(device.cancels, 3);
+
+  // & the set can be started again afterwards
+  CHECK(device.transfers.Start());
+  CHECK_EQ(device.transfers.Pending(), 4);
+  device.transfers.Stop();
+  CHECK_EQ(device.transfers.Pending(), 0);
+}
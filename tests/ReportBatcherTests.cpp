@@ -0,0 +1,195 @@
+#include "Test.hpp"
+#include "ReportBatcher.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// Long enough that the submitter thread never gets to a tick by itself, so only Flush/Stop send anything
+#define NEVER_TICK_US   60000000
+
+#define STRESS_TICK_US  1000
+#define STRESS_PADS     16
+#define STRESS_REPORTS  2000 // per pad
+
+struct FakeTarget {
+  std::mutex mutex;
+  std::vector<uint16_t> received; // wButtons of every report submitted to this target
+};
+
+static void FakeSubmit(void* target, const XUSB_REPORT& report)
+{
+  auto* fake = (FakeTarget*)target;
+  std::lock_guard<std::mutex> guard(fake->mutex);
+  fake->received.push_back(report.wButtons);
+}
+
+static XUSB_REPORT Report(uint16_t buttons)
+{
+  XUSB_REPORT report;
+  memset(&report, 0, sizeof(report));
+  report.wButtons = buttons;
+  return report;
+}
+
+TEST(NothingSentWithoutSubmitter)
+{
+  ReportBatcher batcher;
+  FakeTarget target;
+  batcher.Post(0, &target, Report(1));
+  CHECK_EQ(batcher.Flush(), 0);
+  CHECK(!batcher.Running());
+  CHECK(target.received.empty());
+}
+
+TEST(OnlyNewestReportSent)
+{
+  ReportBatcher batcher;
+  batcher.Start(NEVER_TICK_US, FakeSubmit);
+  CHECK(batcher.Running());
+
+  FakeTarget first, second;
+  batcher.Post(0, &first, Report(1));
+  batcher.Post(0, &first, Report(2));
+  batcher.Post(0, &first, Report(3));
+  batcher.Post(5, &second, Report(10));
+
+  CHECK_EQ(batcher.Flush(), 2);
+  CHECK_EQ(first.received.size(), 1);
+  CHECK_EQ(first.received[0], 3);
+  CHECK_EQ(second.received.size(), 1);
+  CHECK_EQ(second.received[0], 10);
+
+  // nothing new posted, nothing sent
+  CHECK_EQ(batcher.Flush(), 0);
+
+  auto stats = batcher.Stats();
+  CHECK_EQ(stats.ticks, 1);
+  CHECK_EQ(stats.reports, 2);
+  CHECK_EQ(stats.replaced, 2);
+
+  batcher.Stop();
+  CHECK(!batcher.Running());
+}
+
+TEST(InvalidSlotsIgnored)
+{
+  ReportBatcher batcher;
+  batcher.Start(NEVER_TICK_US, FakeSubmit);
+
+  FakeTarget target;
+  batcher.Post(-1, &target, Report(1));
+  batcher.Post(BATCH_MAX_TARGETS, &target, Report(2));
+  batcher.Remove(-1);
+  batcher.Remove(BATCH_MAX_TARGETS);
+  CHECK_EQ(batcher.Flush(), 0);
+  CHECK(target.received.empty());
+}
+
+TEST(RemoveDropsQueuedReport)
+{
+  ReportBatcher batcher;
+  batcher.Start(NEVER_TICK_US, FakeSubmit);
+
+  FakeTarget removed, kept;
+  batcher.Post(1, &removed, Report(1));
+  batcher.Post(2, &kept, Report(2));
+  batcher.Remove(1);
+
+  CHECK_EQ(batcher.Flush(), 1);
+  CHECK(removed.received.empty());
+  CHECK_EQ(kept.received.size(), 1);
+
+  // slot can be posted to again afterwards
+  batcher.Post(1, &kept, Report(3));
+  CHECK_EQ(batcher.Flush(), 1);
+  CHECK_EQ(kept.received.size(), 2);
+  CHECK_EQ(kept.received[1], 3);
+}
+
+TEST(StopSendsWhatsLeft)
+{
+  FakeTarget target;
+  {
+    ReportBatcher batcher;
+    batcher.Start(NEVER_TICK_US, FakeSubmit);
+    batcher.Post(3, &target, Report(7));
+    batcher.Stop();
+
+    CHECK_EQ(target.received.size(), 1);
+    CHECK_EQ(target.received[0], 7);
+  }
+
+  // destructor stops it too
+  {
+    ReportBatcher batcher;
+    batcher.Start(NEVER_TICK_US, FakeSubmit);
+    batcher.Post(3, &target, Report(8));
+  }
+  CHECK_EQ(target.received.size(), 2);
+  CHECK_EQ(target.received[1], 8);
+}
+
+TEST(TicksSendOnTheirOwn)
+{
+  ReportBatcher batcher;
+  batcher.Start(STRESS_TICK_US, FakeSubmit);
+
+  FakeTarget target;
+  batcher.Post(0, &target, Report(1));
+
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  size_t received = 0;
+  while (!received && std::chrono::steady_clock::now() < deadline)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::lock_guard<std::mutex> guard(target.mutex);
+    received = target.received.size();
+  }
+  CHECK_EQ(received, 1);
+  batcher.Stop();
+}
+
+// Pads post from their own threads while the submitter ticks: every pad must end up with its last report, reports must
+// arrive in the order they were posted, & everything posted must be either sent or replaced by a newer one
+TEST(PadsPostingConcurrently)
+{
+  ReportBatcher batcher;
+  batcher.Start(STRESS_TICK_US, FakeSubmit);
+
+  std::vector<FakeTarget> targets(STRESS_PADS);
+  std::vector<std::thread> pads;
+  for (int pad = 0; pad < STRESS_PADS; pad++)
+  {
+    pads.emplace_back([&batcher, &targets, pad]()
+    {
+      for (int i = 1; i <= STRESS_REPORTS; i++)
+      {
+        batcher.Post(pad, &targets[pad], Report((uint16_t)i));
+        if (i % 64 == 0)
+          std::this_thread::sleep_for(std::chrono::microseconds(200));
+      }
+    });
+  }
+
+  for (auto& pad : pads)
+    pad.join();
+  batcher.Stop();
+
+  int out_of_order = 0;
+  for (auto& target : targets)
+  {
+    CHECK(target.received.size() > 0);
+    if (target.received.size())
+      CHECK_EQ(target.received.back(), STRESS_REPORTS);
+
+    for (size_t i = 1; i < target.received.size(); i++)
+      if (target.received[i] <= target.received[i - 1])
+        out_of_order++;
+  }
+  CHECK_EQ(out_of_order, 0);
+
+  auto stats = batcher.Stats();
+  CHECK_EQ(stats.reports + stats.replaced, STRESS_PADS * STRESS_REPORTS);
+}
@@ -0,0 +1,262 @@
+#include "Test.hpp"
+#include "ResponseCurve.hpp"
+#include "XboxTranslator.hpp"
+
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+
+static XboxInputReport MakeReport()
+{
+  XboxInputReport report;
+  memset(&report, 0, sizeof(report));
+  report.bSize = sizeof(XboxInputReport);
+  return report;
+}
+
+static ResponseCurve Curve(const char* text)
+{
+  ResponseCurve curve;
+  ParseResponseCurve(text, curve);
+  return curve;
+}
+
+// a few of every kind, the ones the tests below check for endpoints & monotonicity
+static const char* curve_texts[] = {
+  "linear", "exponential 0.5", "exponential 2", "exponential 3.5", "scurve 2", "scurve 5",
+  "0:0, 50:25, 100:100", "0:10, 30:30, 70:90, 100:100", "0:0, 20:0, 100:80",
+};
+
+TEST(ParseNamedCurves)
+{
+  ResponseCurve curve;
+  CHECK(ParseResponseCurve("exponential 2.5", curve));
+  CHECK_EQ(curve.type, RESPONSE_CURVE_EXPONENTIAL);
+  CHECK(curve.exponent == 2.5f);
+
+  // names aren't case sensitive, & the exponent is kept if it's left out
+  CHECK(ParseResponseCurve("  S-Curve", curve));
+  CHECK_EQ(curve.type, RESPONSE_CURVE_SCURVE);
+  CHECK(curve.exponent == 2.5f);
+
+  CHECK(ParseResponseCurve("exp 3", curve));
+  CHECK_EQ(curve.type, RESPONSE_CURVE_EXPONENTIAL);
+  CHECK(curve.exponent == 3.0f);
+
+  CHECK(ParseResponseCurve("scurve", curve));
+  CHECK_EQ(curve.type, RESPONSE_CURVE_SCURVE);
+
+  CHECK(ParseResponseCurve("LINEAR", curve));
+  CHECK_EQ(curve.type, RESPONSE_CURVE_LINEAR);
+  CHECK(curve.IsLinear());
+}
+
+TEST(ParseCustomPoints)
+{
+  ResponseCurve curve;
+  CHECK(ParseResponseCurve("100:100, 0:0,50:25", curve));
+  CHECK_EQ(curve.type, RESPONSE_CURVE_CUSTOM);
+  CHECK_EQ(curve.points.size(), 3);
+
+  // sorted by input, percentages become 0 - 1
+  CHECK(curve.points[0] == std::make_pair(0.f, 0.f));
+  CHECK(curve.points[1] == std::make_pair(0.5f, 0.25f));
+  CHECK(curve.points[2] == std::make_pair(1.f, 1.f));
+
+  // anything outside 0 - 100% is clamped
+  CHECK(ParseResponseCurve("-10:-5 150:120", curve));
+  CHECK(curve.points[0] == std::make_pair(0.f, 0.f));
+  CHECK(curve.points[1] == std::make_pair(1.f, 1.f));
+}
+
+TEST(ParseRejectsMalformed)
+{
+  static const char* malformed[] = {
+    "", "   ", "bogus", "linear-ish 2", "exponential 0", "exponential -1", "exponential abc", "scurve 2x",
+    "50:25", "0:0, 50", "0:0, 50:", "0:0; 100:100", "0:0, :100", "a:b, c:d",
+  };
+
+  for (auto text : malformed)
+  {
+    // a curve that doesn't parse leaves the old one in place
+    ResponseCurve curve;
+    curve.type = RESPONSE_CURVE_SCURVE;
+    curve.exponent = 4.0f;
+    bool parsed = ParseResponseCurve(text, curve);
+    if (parsed)
+      printf("parsed \"%s\"\n", text);
+    CHECK(!parsed);
+    CHECK_EQ(curve.type, RESPONSE_CURVE_SCURVE);
+    CHECK(curve.exponent == 4.0f);
+    CHECK(curve.points.empty());
+  }
+}
+
+TEST(EndpointsAndMonotonic)
+{
+  static const int maxes[] = { 0xFF, SHRT_MAX };
+  for (auto text : curve_texts)
+  {
+    auto curve = Curve(text);
+    for (int max : maxes)
+    {
+      CHECK_EQ(EvaluateResponseCurve(curve, 0, max), 0);
+      CHECK_EQ(EvaluateResponseCurve(curve, -100, max), 0);
+
+      int last = 0, decreases = 0, out_of_range = 0;
+      int step = max > 0xFF ? 7 : 1;
+      for (int value = 0; value <= max; value += step)
+      {
+        int output = EvaluateResponseCurve(curve, value, max);
+        if (output < last)
+          decreases++;
+        if (output < 0 || output > max)
+          out_of_range++;
+        last = output;
+      }
+      if (decreases)
+        printf("\"%s\" isn't monotonic for max %d\n", text, max);
+      CHECK_EQ(decreases, 0);
+      CHECK_EQ(out_of_range, 0);
+    }
+  }
+
+  // curves that end at 100% reach the end of the axis
+  CHECK_EQ(EvaluateResponseCurve(Curve("exponential 2"), 0xFF, 0xFF), 0xFF);
+  CHECK_EQ(EvaluateResponseCurve(Curve("scurve 3"), SHRT_MAX, SHRT_MAX), SHRT_MAX);
+  CHECK_EQ(EvaluateResponseCurve(Curve("0:10, 30:30, 70:90, 100:100"), SHRT_MAX, SHRT_MAX), SHRT_MAX);
+  CHECK_EQ(EvaluateResponseCurve(Curve("0:0, 20:0, 100:80"), 0xFF, 0xFF), 204);
+}
+
+TEST(InteriorPoints)
+{
+  // custom points are interpolated linearly between their neighbours
+  auto custom = Curve("0:0, 50:25, 100:100");
+  CHECK_EQ(EvaluateResponseCurve(custom, 50, 200), 25);
+  CHECK_EQ(EvaluateResponseCurve(custom, 100, 200), 50);
+  CHECK_EQ(EvaluateResponseCurve(custom, 150, 200), 125);
+
+  // flat start, anything before the first point with an output is 0
+  auto flat = Curve("0:0, 20:0, 100:80");
+  CHECK_EQ(EvaluateResponseCurve(flat, 40, 200), 0);
+  CHECK_EQ(EvaluateResponseCurve(flat, 120, 200), 80);
+
+  CHECK_EQ(EvaluateResponseCurve(Curve("exponential 2"), 100, 200), 50);
+  CHECK_EQ(EvaluateResponseCurve(Curve("exponential 0.5"), 50, 200), 100);
+
+  // s-curves cross the middle at the middle, below it before & above it after
+  auto scurve = Curve("scurve 3");
+  CHECK_EQ(EvaluateResponseCurve(scurve, 100, 200), 100);
+  CHECK(EvaluateResponseCurve(scurve, 50, 200) < 50);
+  CHECK(EvaluateResponseCurve(scurve, 150, 200) > 150);
+}
+
+TEST(OuterAndAntiDeadzone)
+{
+  ResponseCurve curve;
+  curve.outer_deadzone = 55;
+  CHECK(!curve.IsLinear());
+  CHECK_EQ(EvaluateResponseCurve(curve, 100, 255), 128);
+  CHECK_EQ(EvaluateResponseCurve(curve, 200, 255), 255);
+  CHECK_EQ(EvaluateResponseCurve(curve, 255, 255), 255);
+
+  curve.outer_deadzone = 0;
+  curve.anti_deadzone = 55;
+  CHECK_EQ(EvaluateResponseCurve(curve, 0, 255), 0); // released stays released
+  CHECK_EQ(EvaluateResponseCurve(curve, 1, 255), 56);
+  CHECK_EQ(EvaluateResponseCurve(curve, 255, 255), 255);
+}
+
+// The translator applies curves after the deadzone: output should be the curve of whatever the deadzone let through
+TEST(TriggerCurveAfterDeadzone)
+{
+  combo_guideButton = 0;
+  combo_bindings.clear();
+
+  UserSettings settings;
+  settings.deadzone.bLeftTrigger = 30;
+  settings.deadzone.bRightTrigger = 80;
+  settings.curves[CURVE_LEFT_TRIGGER] = Curve("exponential 2");
+  settings.curves[CURVE_RIGHT_TRIGGER] = Curve("0:0, 50:25, 100:100");
+
+  XboxTranslator translator;
+  translator.SetSettings(settings);
+
+  for (int value = 0; value < 256; value++)
+  {
+    auto report = MakeReport();
+    report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] = (BYTE)value;
+    report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER] = (BYTE)value;
+
+    XUSB_REPORT output;
+    translator.Translate(report, &output);
+
+    short left, right;
+    XboxTranslator::deadZoneCalc(&left, NULL, value, 0, 30, 0xFF);
+    XboxTranslator::deadZoneCalc(&right, NULL, value, 0, 80, 0xFF);
+    CHECK_EQ(output.bLeftTrigger, EvaluateResponseCurve(settings.curves[CURVE_LEFT_TRIGGER], left, 0xFF));
+    CHECK_EQ(output.bRightTrigger, EvaluateResponseCurve(settings.curves[CURVE_RIGHT_TRIGGER], right, 0xFF));
+  }
+}
+
+// Sticks go through a lookup table on the radius, so they're only expected to be within a few LSB of evaluating the
+// curve directly on the radius deadZoneCalc leaves, & to keep pointing the same way
+TEST(StickCurveAfterDeadzone)
+{
+  combo_guideButton = 0;
+  combo_bindings.clear();
+
+  static const char* stick_curves[] = { "exponential 2", "scurve 3", "0:0, 50:25, 100:100" };
+  for (auto text : stick_curves)
+  {
+    UserSettings settings;
+    settings.deadzone.sThumbL = 4000;
+    settings.deadzone.sThumbR = 0;
+    settings.curves[CURVE_LEFT_STICK] = Curve(text);
+    settings.curves[CURVE_RIGHT_STICK] = Curve(text);
+
+    XboxTranslator translator;
+    translator.SetSettings(settings);
+
+    int mismatches = 0;
+    for (int x = SHRT_MIN; x <= SHRT_MAX; x += 1237)
+      for (int y = SHRT_MIN; y <= SHRT_MAX; y += 1291)
+      {
+        auto report = MakeReport();
+        report.Gamepad.sThumbLX = report.Gamepad.sThumbRY = (short)x;
+        report.Gamepad.sThumbLY = report.Gamepad.sThumbRX = (short)y;
+
+        XUSB_REPORT output;
+        translator.Translate(report, &output);
+
+        const short deadzones[2] = { settings.deadzone.sThumbL, settings.deadzone.sThumbR };
+        const short actual[2][2] = { { output.sThumbLX, output.sThumbLY }, { output.sThumbRX, output.sThumbRY } };
+        const short in[2][2] = { { (short)x, (short)y }, { (short)y, (short)x } };
+        for (int stick = 0; stick < 2; stick++)
+        {
+          short dz_x = in[stick][0], dz_y = in[stick][1];
+          if (deadzones[stick])
+            XboxTranslator::deadZoneCalc(&dz_x, &dz_y, in[stick][0], in[stick][1], deadzones[stick], SHRT_MAX);
+
+          int r = (int)sqrt((double)dz_x * dz_x + (double)dz_y * dz_y);
+          int expected_x = dz_x, expected_y = dz_y;
+          if (r > 0 && r < SHRT_MAX)
+          {
+            // anything past the edge of the circle is passed through, so only the inside gets curved
+            int curved = EvaluateResponseCurve(settings.curves[CURVE_LEFT_STICK + stick], r, SHRT_MAX);
+            expected_x = dz_x * curved / r;
+            expected_y = dz_y * curved / r;
+          }
+
+          if (abs(actual[stick][0] - expected_x) > 4 || abs(actual[stick][1] - expected_y) > 4)
+          {
+            if (!mismatches)
+              printf("\"%s\" stick %d at %d,%d: got %d,%d expected %d,%d\n", text, stick, x, y,
+                actual[stick][0], actual[stick][1], expected_x, expected_y);
+            mismatches++;
+          }
+        }
+      }
+    CHECK_EQ(mismatches, 0);
+  }
+}
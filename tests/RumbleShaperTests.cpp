@@ -0,0 +1,187 @@
+#include "Test.hpp"
+#include "RumbleShaper.hpp"
+
+// Flood sent to the simulated controller: an update every FLOOD_INTERVAL_US for FLOOD_US, each transfer takes BUS_TRANSFER_US
+#define FLOOD_INTERVAL_US  100
+#define FLOOD_US           2000000
+#define BUS_TRANSFER_US    2000
+
+TEST(FirstUpdateSentStraightAway)
+{
+  RumbleShaper shaper;
+  CHECK(!shaper.Pending());
+  CHECK(shaper.Push(100, 50));
+  CHECK(shaper.Pending());
+  CHECK_EQ(shaper.NextSendTime(), 0);
+
+  uint8_t large_motor = 0, small_motor = 0;
+  CHECK(shaper.Take(12345, large_motor, small_motor));
+  CHECK_EQ(large_motor, 100);
+  CHECK_EQ(small_motor, 50);
+  CHECK(!shaper.Pending());
+
+  // nothing left to take
+  CHECK(!shaper.Take(1000000, large_motor, small_motor));
+}
+
+TEST(DuplicatesDropped)
+{
+  RumbleShaper shaper;
+  uint8_t large_motor, small_motor;
+  shaper.Push(10, 20);
+  shaper.Take(0, large_motor, small_motor);
+
+  // same as what was sent
+  CHECK(!shaper.Push(10, 20));
+  CHECK(!shaper.Pending());
+
+  // same as what's pending
+  CHECK(shaper.Push(30, 40));
+  CHECK(!shaper.Push(30, 40));
+
+  // back to what was sent before the pending update went out cancels it
+  CHECK(!shaper.Push(10, 20));
+  CHECK(!shaper.Pending());
+
+  auto& stats = shaper.Stats();
+  CHECK_EQ(stats.received, 5);
+  CHECK_EQ(stats.sent, 1);
+  CHECK_EQ(stats.merged, 4);
+}
+
+TEST(RateLimitedAndMerged)
+{
+  RumbleShaper shaper;
+  uint8_t large_motor, small_motor;
+  shaper.Push(1, 1);
+  CHECK(shaper.Take(1000, large_motor, small_motor));
+
+  // burst before the interval is up, only the newest is sent once it is
+  shaper.Push(2, 2);
+  shaper.Push(3, 3);
+  shaper.Push(4, 4);
+  CHECK_EQ(shaper.NextSendTime(), 1000 + RUMBLE_MIN_INTERVAL_US);
+  CHECK(!shaper.Take(1000 + RUMBLE_MIN_INTERVAL_US - 1, large_motor, small_motor));
+  CHECK(shaper.Take(1000 + RUMBLE_MIN_INTERVAL_US, large_motor, small_motor));
+  CHECK_EQ(large_motor, 4);
+  CHECK_EQ(small_motor, 4);
+
+  auto& stats = shaper.Stats();
+  CHECK_EQ(stats.received, 4);
+  CHECK_EQ(stats.sent, 2);
+  CHECK_EQ(stats.merged, 2);
+}
+
+TEST(RetryAfterFailedSend)
+{
+  RumbleShaper shaper;
+  uint8_t large_motor, small_motor;
+  shaper.Push(50, 60);
+  shaper.Take(0, large_motor, small_motor);
+
+  // failed send goes back in the queue & can be sent again straight away
+  shaper.Retry(large_motor, small_motor);
+  CHECK(shaper.Pending());
+  CHECK(shaper.Take(1, large_motor, small_motor));
+  CHECK_EQ(large_motor, 50);
+  CHECK_EQ(small_motor, 60);
+
+  // newer update wins over the retry
+  shaper.Push(70, 80);
+  shaper.Retry(50, 60);
+  CHECK(shaper.Take(1 + RUMBLE_MIN_INTERVAL_US, large_motor, small_motor));
+  CHECK_EQ(large_motor, 70);
+
+  // after a failure the controller's state is unknown, so going back to the failed update isn't dropped as a duplicate
+  shaper.Retry(70, 80);
+  CHECK(shaper.Push(90, 90));
+  CHECK(shaper.Push(70, 80));
+  CHECK(shaper.Take(2 + RUMBLE_MIN_INTERVAL_US, large_motor, small_motor));
+  CHECK_EQ(large_motor, 70);
+}
+
+static void FloodRumble(uint64_t i, uint8_t& large_motor, uint8_t& small_motor)
+{
+  large_motor = (uint8_t)((i / 7) * 37);
+  small_motor = (i / 13) & 1 ? 255 : 0;
+  if ((i / 2000) & 1)
+    large_motor = small_motor = 0; // stretches of nothing but duplicates
+}
+
+// Floods the shaper on a simulated bus in virtual time, driven the same way XboxController drives its rumble transfer:
+// one transfer in-flight at most, the next is taken when it completes, or when the shaper's timer is due
+TEST(FloodOnSimulatedBus)
+{
+  const uint64_t count = FLOOD_US / FLOOD_INTERVAL_US;
+
+  RumbleShaper shaper;
+  bool in_flight = false;
+  uint64_t in_flight_done_us = 0;
+  uint8_t in_flight_large = 0, in_flight_small = 0;
+  uint8_t controller_large = 0, controller_small = 0;
+  uint8_t newest_large = 0, newest_small = 0;
+  uint64_t last_take_us = 0, newest_us = 0;
+  bool taken = false;
+  int too_fast = 0;
+  uint64_t max_stale_us = 0;
+
+  uint64_t next_update = 0;
+  uint64_t now = 0;
+  while (next_update < count || in_flight || shaper.Pending())
+  {
+    // next thing to happen: an update from the game, the transfer completing, or the shaper allowing the next send
+    uint64_t update_us = next_update < count ? next_update * FLOOD_INTERVAL_US : UINT64_MAX;
+    uint64_t done_us = in_flight ? in_flight_done_us : UINT64_MAX;
+    uint64_t timer_us = !in_flight && shaper.Pending() ? shaper.NextSendTime() : UINT64_MAX;
+    now = update_us;
+    if (done_us < now)
+      now = done_us;
+    if (timer_us < now)
+      now = timer_us;
+
+    if (now == done_us)
+    {
+      in_flight = false;
+      controller_large = in_flight_large;
+      controller_small = in_flight_small;
+    }
+
+    if (now == update_us)
+    {
+      // how long the controller was left behind the game before this update
+      if ((controller_large != newest_large || controller_small != newest_small) && now - newest_us > max_stale_us)
+        max_stale_us = now - newest_us;
+
+      FloodRumble(next_update++, newest_large, newest_small);
+      newest_us = now;
+      shaper.Push(newest_large, newest_small);
+    }
+
+    if (!in_flight && shaper.Take(now, in_flight_large, in_flight_small))
+    {
+      if (taken && now - last_take_us < RUMBLE_MIN_INTERVAL_US)
+        too_fast++;
+      taken = true;
+      last_take_us = now;
+
+      in_flight = true;
+      in_flight_done_us = now + BUS_TRANSFER_US;
+    }
+  }
+
+  CHECK_EQ(too_fast, 0);
+
+  // last update always makes it to the controller
+  CHECK_EQ(controller_large, newest_large);
+  CHECK_EQ(controller_small, newest_small);
+
+  auto& stats = shaper.Stats();
+  CHECK_EQ(stats.received, count);
+  CHECK_EQ(stats.merged + stats.sent, stats.received);
+
+  // no more sends than the interval allows over the whole flood (plus the first one)
+  CHECK(stats.sent <= FLOOD_US / RUMBLE_MIN_INTERVAL_US + 1);
+
+  // updates only ever wait for the interval & a transfer, never pile up behind each other
+  CHECK(max_stale_us <= RUMBLE_MIN_INTERVAL_US + BUS_TRANSFER_US + FLOOD_INTERVAL_US);
+}
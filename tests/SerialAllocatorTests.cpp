@@ -0,0 +1,187 @@
+#include "Test.hpp"
+#include "SerialAllocator.hpp"
+
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+// Stands in for the ViGEm bus, serials plugged in by anything (us or another client)
+struct FakeBus {
+  std::set<uint32_t> taken;
+  std::vector<uint32_t> tried;
+
+  bool Plug(uint32_t serial)
+  {
+    tried.push_back(serial);
+    return taken.insert(serial).second;
+  }
+};
+
+static uint32_t Allocate(SerialAllocator& serials, FakeBus& bus)
+{
+  return serials.Allocate([&bus](uint32_t serial) { return bus.Plug(serial); });
+}
+
+TEST(AllocateReleaseReuse)
+{
+  SerialAllocator serials(16);
+  FakeBus bus;
+  CHECK_EQ(Allocate(serials, bus), 1);
+  CHECK_EQ(Allocate(serials, bus), 2);
+  CHECK_EQ(Allocate(serials, bus), 3);
+  CHECK_EQ(serials.Attempts(), 3);
+
+  // lowest free serial is reused
+  serials.Release(2);
+  bus.taken.erase(2);
+  CHECK_EQ(Allocate(serials, bus), 2);
+  CHECK_EQ(Allocate(serials, bus), 4);
+
+  // releasing something that was never allocated (or out of range) does nothing
+  serials.Release(0);
+  serials.Release(10);
+  serials.Release(100);
+  CHECK_EQ(Allocate(serials, bus), 5);
+  CHECK_EQ(serials.Attempts(), 6);
+}
+
+TEST(ConflictsSkipped)
+{
+  SerialAllocator serials(16);
+  FakeBus bus;
+  bus.taken = { 1, 2, 4 }; // another client's targets
+
+  CHECK_EQ(Allocate(serials, bus), 3);
+  CHECK(bus.tried == std::vector<uint32_t>({ 1, 2, 3 }));
+
+  // known conflicts aren't tried again
+  bus.tried.clear();
+  CHECK_EQ(Allocate(serials, bus), 5);
+  CHECK(bus.tried == std::vector<uint32_t>({ 4, 5 }));
+
+  bus.tried.clear();
+  CHECK_EQ(Allocate(serials, bus), 6);
+  CHECK(bus.tried == std::vector<uint32_t>({ 6 }));
+}
+
+TEST(ReleaseClearsConflict)
+{
+  SerialAllocator serials(16);
+  FakeBus bus;
+  bus.taken = { 1 };
+  CHECK_EQ(Allocate(serials, bus), 2);
+
+  // whatever had serial 1 is gone & it's been released (eg. it ended up ours on a retry), it's free again
+  bus.taken.erase(1);
+  serials.Release(1);
+
+  bus.tried.clear();
+  CHECK_EQ(Allocate(serials, bus), 1);
+  CHECK(bus.tried == std::vector<uint32_t>({ 1 }));
+}
+
+TEST(Exhaustion)
+{
+  SerialAllocator serials(4);
+  FakeBus bus;
+  for (uint32_t serial = 1; serial <= 4; serial++)
+    CHECK_EQ(Allocate(serials, bus), serial);
+
+  // everything's ours, nothing to try
+  bus.tried.clear();
+  CHECK_EQ(Allocate(serials, bus), 0);
+  CHECK(bus.tried.empty());
+
+  serials.Release(3);
+  bus.taken.erase(3);
+  CHECK_EQ(Allocate(serials, bus), 3);
+}
+
+TEST(ExhaustedByConflictsRetriedOnce)
+{
+  SerialAllocator serials(3);
+  FakeBus bus;
+  bus.taken = { 1, 2, 3 };
+
+  // all conflict, so they all get one more try in case they've been freed since
+  CHECK_EQ(Allocate(serials, bus), 0);
+  CHECK(bus.tried == std::vector<uint32_t>({ 1, 2, 3, 1, 2, 3 }));
+
+  // & if one was freed in the meantime, it gets found
+  bus.tried.clear();
+  bus.taken.erase(2);
+  CHECK_EQ(Allocate(serials, bus), 2);
+  CHECK(bus.tried == std::vector<uint32_t>({ 1, 2 }));
+}
+
+TEST(SerialsPastFirstWord)
+{
+  SerialAllocator serials(130);
+  FakeBus bus;
+  for (uint32_t serial = 1; serial <= 100; serial++)
+    bus.taken.insert(serial);
+
+  CHECK_EQ(Allocate(serials, bus), 101);
+  for (uint32_t serial = 102; serial <= 130; serial++)
+    CHECK_EQ(Allocate(serials, bus), serial);
+
+  // max_serial isn't a multiple of 64, the rest of the last word doesn't count
+  bus.tried.clear();
+  CHECK_EQ(Allocate(serials, bus), 0);
+  for (auto serial : bus.tried)
+    CHECK(serial <= 130);
+}
+
+TEST(ResetForgetsEverything)
+{
+  SerialAllocator serials(8);
+  FakeBus bus;
+  bus.taken = { 1 };
+  CHECK_EQ(Allocate(serials, bus), 2);
+  CHECK_EQ(Allocate(serials, bus), 3);
+
+  // bus connection closed, all of our targets are gone
+  serials.Reset();
+  bus.taken = { 1 };
+  bus.tried.clear();
+  CHECK_EQ(Allocate(serials, bus), 2);
+  CHECK(bus.tried == std::vector<uint32_t>({ 1, 2 }));
+}
+
+TEST(ParallelAllocateGetsDistinctSerials)
+{
+  SerialAllocator serials(64);
+  std::mutex bus_mutex;
+  FakeBus bus;
+  bus.taken = { 3, 7 };
+
+  const int threads = 4;
+  const int per_thread = 10;
+  std::vector<uint32_t> allocated[threads];
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++)
+  {
+    workers.emplace_back([&, t]
+    {
+      for (int i = 0; i < per_thread; i++)
+        allocated[t].push_back(serials.Allocate([&](uint32_t serial)
+        {
+          std::lock_guard<std::mutex> guard(bus_mutex);
+          return bus.Plug(serial);
+        }));
+    });
+  }
+  for (auto& worker : workers)
+    worker.join();
+
+  std::set<uint32_t> all;
+  for (auto& serials_of_thread : allocated)
+    for (auto serial : serials_of_thread)
+    {
+      CHECK(serial != 0);
+      CHECK(serial != 3 && serial != 7);
+      all.insert(serial);
+    }
+  CHECK_EQ(all.size(), threads * per_thread);
+}
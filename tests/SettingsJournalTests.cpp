@@ -0,0 +1,232 @@
+#include "Test.hpp"
+#include "SettingsJournal.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#define makeDir(path) _mkdir(path)
+#define removeDir(path) _rmdir(path)
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#define makeDir(path) mkdir(path, 0755)
+#define removeDir(path) rmdir(path)
+#endif
+
+#define JOURNAL_PATH  "settings_journal_test.ini"
+#define TEMP_PATH     JOURNAL_PATH ".tmp"
+
+// Longest the writer thread should take to write settled changes, with some leeway for a busy machine
+#define WRITE_TIMEOUT_MS (SETTINGS_JOURNAL_DELAY_MS + 1500)
+
+static void WriteIni(const char* contents)
+{
+  std::ofstream file(JOURNAL_PATH, std::ios::binary | std::ios::trunc);
+  file << contents;
+}
+
+static std::string ReadIni()
+{
+  std::ifstream file(JOURNAL_PATH, std::ios::binary);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return contents.str();
+}
+
+// Waits up to timeout_ms for journal to have written target times, returns the number of writes
+static int WaitForWrites(SettingsJournal& journal, int target, int timeout_ms)
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (journal.Writes() < target && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  return journal.Writes();
+}
+
+TEST(ChangesCoalescedIntoOneWrite)
+{
+  WriteIni("[Default]\nDeadzoneLeftStick=0\n");
+
+  SettingsJournal journal;
+  journal.Open(JOURNAL_PATH);
+
+  // eg. holding a deadzone combination, only the last value needs writing
+  for (int i = 1; i <= 10; i++)
+    journal.Set("Default", "DeadzoneLeftStick", std::to_string(i * 500));
+  journal.Set("Default", "EnableGuide", "1");
+
+  CHECK_EQ(WaitForWrites(journal, 1, WRITE_TIMEOUT_MS), 1);
+  CHECK(ReadIni() == "[Default]\nDeadzoneLeftStick=5000\nEnableGuide=1\n");
+
+  // nothing more to write
+  std::this_thread::sleep_for(std::chrono::milliseconds(SETTINGS_JOURNAL_DELAY_MS * 2));
+  CHECK_EQ(journal.Writes(), 1);
+
+  journal.Close();
+  CHECK_EQ(journal.Writes(), 1);
+  std::remove(JOURNAL_PATH);
+}
+
+TEST(KeepsChangingSettingsWrittenByMaxDelay)
+{
+  WriteIni("[Default]\n");
+
+  SettingsJournal journal;
+  journal.Open(JOURNAL_PATH);
+
+  // changes never settle, still has to be written by SETTINGS_JOURNAL_MAX_DELAY_MS
+  auto start = std::chrono::steady_clock::now();
+  while (journal.Writes() == 0 &&
+    std::chrono::steady_clock::now() - start < std::chrono::milliseconds(SETTINGS_JOURNAL_MAX_DELAY_MS + 1500))
+  {
+    journal.Set("Default", "DeadzoneLeftStick", "1000");
+    std::this_thread::sleep_for(std::chrono::milliseconds(SETTINGS_JOURNAL_DELAY_MS / 5));
+  }
+  CHECK(journal.Writes() >= 1);
+
+  journal.Close();
+  std::remove(JOURNAL_PATH);
+}
+
+TEST(KeysAndSectionsInsertedIntoFile)
+{
+  WriteIni(
+    "; Xb2XInput settings\r\n"
+    "[Default]\r\n"
+    "EnableGuide = 0\r\n"
+    ";DeadzoneLeftStick=1\r\n"
+    "DeadzoneLeftStick=100\r\n"
+    "\r\n"
+    "[Remap]\r\n"
+    "A=B\r\n");
+
+  SettingsJournal journal;
+  journal.Open(JOURNAL_PATH);
+
+  // names aren't case-sensitive, existing ones keep their own case & spacing
+  journal.Set("default", "enableguide", "1");
+  journal.Set("Default", "DeadzoneLeftStick", "200");
+  journal.Set("Default", "EnableVibration", "0");
+  journal.Set("Remap", "B", "A");
+  journal.Set("Controller1", "EnableGuide", "1");
+  CHECK(journal.Flush());
+  CHECK_EQ(journal.Writes(), 1);
+  journal.Close();
+
+  CHECK(ReadIni() ==
+    "; Xb2XInput settings\n"
+    "[Default]\n"
+    "EnableGuide = 1\n"
+    ";DeadzoneLeftStick=1\n"
+    "DeadzoneLeftStick=200\n"
+    "EnableVibration=0\n"
+    "\n"
+    "[Remap]\n"
+    "A=B\n"
+    "B=A\n"
+    "\n"
+    "[Controller1]\n"
+    "EnableGuide=1\n");
+
+  std::remove(JOURNAL_PATH);
+}
+
+TEST(MissingFileCreated)
+{
+  std::remove(JOURNAL_PATH);
+
+  SettingsJournal journal;
+  journal.Open(JOURNAL_PATH);
+  journal.Set("Default", "EnableGuide", "1");
+  CHECK(journal.Flush());
+  journal.Close();
+
+  CHECK(ReadIni() == "[Default]\nEnableGuide=1\n");
+  std::remove(JOURNAL_PATH);
+}
+
+// The INI is replaced by renaming a fully written temp file over it, never rewritten in place
+TEST(WrittenThroughTempFile)
+{
+  WriteIni("[Default]\nEnableGuide=0\n");
+
+  // leftover from being killed mid-write, gets overwritten
+  {
+    std::ofstream temp(TEMP_PATH, std::ios::trunc);
+    temp << "[Broken";
+  }
+
+#ifndef _WIN32
+  // a reader that already had it open still sees the old file, it wasn't truncated & rewritten
+  std::ifstream reader(JOURNAL_PATH, std::ios::binary);
+#endif
+
+  SettingsJournal journal;
+  journal.Open(JOURNAL_PATH);
+  journal.Set("Default", "EnableGuide", "1");
+  CHECK(journal.Flush());
+  journal.Close();
+
+  CHECK(ReadIni() == "[Default]\nEnableGuide=1\n");
+  CHECK(!std::ifstream(TEMP_PATH).is_open());
+
+#ifndef _WIN32
+  std::stringstream old_contents;
+  old_contents << reader.rdbuf();
+  CHECK(old_contents.str() == "[Default]\nEnableGuide=0\n");
+#endif
+
+  std::remove(JOURNAL_PATH);
+}
+
+TEST(FailedWriteKeepsChanges)
+{
+  WriteIni("[Default]\nEnableGuide=0\n");
+
+  // a directory where the temp file goes stops it being written
+  std::remove(TEMP_PATH);
+  CHECK_EQ(makeDir(TEMP_PATH), 0);
+
+  SettingsJournal journal;
+  journal.Open(JOURNAL_PATH);
+  journal.Set("Default", "EnableGuide", "1");
+  journal.Set("Default", "EnableVibration", "1");
+  CHECK(!journal.Flush());
+  CHECK_EQ(journal.Writes(), 0);
+  CHECK(ReadIni() == "[Default]\nEnableGuide=0\n");
+
+  // writer thread doesn't keep trying on its own
+  std::this_thread::sleep_for(std::chrono::milliseconds(SETTINGS_JOURNAL_DELAY_MS * 2));
+  CHECK_EQ(journal.Writes(), 0);
+
+  // once it can be written, the next change writes the earlier ones too, without replacing newer values
+  removeDir(TEMP_PATH);
+  journal.Set("Default", "EnableGuide", "0");
+  CHECK_EQ(WaitForWrites(journal, 1, WRITE_TIMEOUT_MS), 1);
+  CHECK(ReadIni() == "[Default]\nEnableGuide=0\nEnableVibration=1\n");
+
+  journal.Close();
+  std::remove(JOURNAL_PATH);
+}
+
+TEST(FailedWriteRetriedByFlush)
+{
+  WriteIni("[Default]\n");
+  std::remove(TEMP_PATH);
+  CHECK_EQ(makeDir(TEMP_PATH), 0);
+
+  SettingsJournal journal;
+  journal.Open(JOURNAL_PATH);
+  journal.Set("Default", "EnableGuide", "1");
+  CHECK(!journal.Flush());
+
+  removeDir(TEMP_PATH);
+  CHECK(journal.Flush());
+  CHECK_EQ(journal.Writes(), 1);
+  CHECK(ReadIni() == "[Default]\nEnableGuide=1\n");
+
+  journal.Close();
+  std::remove(JOURNAL_PATH);
+}
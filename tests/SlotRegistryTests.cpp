@@ -0,0 +1,317 @@
+#include "Test.hpp"
+#include "SlotRegistry.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+struct Item {
+  int value;
+  int* destroyed;
+
+  Item(int value, int* destroyed = nullptr) : value(value), destroyed(destroyed) {}
+  ~Item()
+  {
+    if (destroyed)
+      (*destroyed)++;
+  }
+};
+
+static std::unique_ptr<Item> MakeItem(int value, int* destroyed = nullptr)
+{
+  return std::unique_ptr<Item>(new Item(value, destroyed));
+}
+
+// Same hash as SlotRegistry::indexHash, only used to find keys that collide
+static size_t IndexHash(uint64_t key)
+{
+  return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (REGISTRY_INDEX_SIZE - 1);
+}
+
+// First count keys (from 1 up) that hash to pos
+static std::vector<uint64_t> KeysHashingTo(size_t pos, int count)
+{
+  std::vector<uint64_t> keys;
+  for (uint64_t key = 1; (int)keys.size() < count; key++)
+    if (IndexHash(key) == pos)
+      keys.push_back(key);
+  return keys;
+}
+
+TEST(AddRemoveReuse)
+{
+  SlotRegistry<Item> registry;
+  auto guard = registry.Pin();
+
+  RegistryId first = registry.Add(MakeItem(1));
+  RegistryId second = registry.Add(MakeItem(2));
+  CHECK(first != 0);
+  CHECK(second != 0);
+  CHECK(first != second);
+  CHECK_EQ(registry.Count(), 2);
+  CHECK_EQ(registry.Get(first)->value, 1);
+  CHECK_EQ(registry.Get(second)->value, 2);
+}
+
+TEST(RemovedSlotReusedWithNewGeneration)
+{
+  SlotRegistry<Item> registry;
+  RegistryId first = registry.Add(MakeItem(1));
+  RegistryId second = registry.Add(MakeItem(2));
+
+  auto removed = registry.Remove(first);
+  CHECK(removed != nullptr);
+  CHECK_EQ(removed->value, 1);
+  CHECK_EQ(registry.Count(), 1);
+
+  // lowest free slot gets reused, but the ID is different
+  RegistryId third = registry.Add(MakeItem(3));
+  CHECK_EQ(REGISTRY_ID_SLOT(third), REGISTRY_ID_SLOT(first));
+  CHECK(third != first);
+  CHECK_EQ(third >> 8, (first >> 8) + 1);
+
+  {
+    auto guard = registry.Pin();
+    CHECK(registry.Get(first) == nullptr);
+    CHECK_EQ(registry.Get(third)->value, 3);
+    CHECK_EQ(registry.Get(second)->value, 2);
+  }
+
+  // same again, every reuse bumps the generation
+  RegistryId last = third;
+  for (int i = 0; i < 5; i++)
+  {
+    RegistryId old = last;
+    registry.Remove(old);
+    last = registry.Add(MakeItem(10 + i));
+    CHECK_EQ(REGISTRY_ID_SLOT(last), REGISTRY_ID_SLOT(first));
+    CHECK_EQ(last >> 8, (old >> 8) + 1);
+
+    auto guard = registry.Pin();
+    CHECK(registry.Get(old) == nullptr);
+    CHECK_EQ(registry.Get(last)->value, 10 + i);
+  }
+}
+
+TEST(StaleIdLookups)
+{
+  SlotRegistry<Item> registry;
+  RegistryId id = registry.Add(MakeItem(1));
+  CHECK(registry.SetKey(100, id));
+  registry.Remove(id);
+
+  // nothing finds it, & nothing can be done with it
+  {
+    auto guard = registry.Pin();
+    CHECK(registry.Get(id) == nullptr);
+    CHECK(registry.Get(0) == nullptr);
+    CHECK(registry.Find(100) == nullptr);
+  }
+  CHECK(registry.Remove(id) == nullptr);
+  CHECK(registry.Remove(0) == nullptr);
+  CHECK(!registry.SetKey(200, id));
+  CHECK(!registry.SetKey(200, 0));
+
+  // including once something else is in its slot
+  RegistryId reused = registry.Add(MakeItem(2));
+  CHECK_EQ(REGISTRY_ID_SLOT(reused), REGISTRY_ID_SLOT(id));
+  CHECK(!registry.SetKey(200, id));
+  CHECK(registry.Remove(id) == nullptr);
+
+  auto guard = registry.Pin();
+  CHECK_EQ(registry.Get(reused)->value, 2);
+  CHECK(registry.Find(100) == nullptr);
+}
+
+TEST(FullRegistryFreesItem)
+{
+  SlotRegistry<Item> registry;
+  for (int i = 0; i < REGISTRY_SLOTS; i++)
+    CHECK(registry.Add(MakeItem(i)) != 0);
+
+  int destroyed = 0;
+  CHECK_EQ(registry.Add(MakeItem(-1, &destroyed)), 0);
+  CHECK_EQ(destroyed, 1);
+  CHECK_EQ(registry.Count(), REGISTRY_SLOTS);
+}
+
+TEST(RegistryFreesItemsWhenDestroyed)
+{
+  int destroyed = 0;
+  {
+    SlotRegistry<Item> registry;
+    registry.Add(MakeItem(1, &destroyed));
+    registry.Add(MakeItem(2, &destroyed));
+    registry.Remove(registry.Add(MakeItem(3, &destroyed)));
+    CHECK_EQ(destroyed, 1);
+  }
+  CHECK_EQ(destroyed, 3);
+}
+
+TEST(KeysFindTheirItem)
+{
+  SlotRegistry<Item> registry;
+  RegistryId first = registry.Add(MakeItem(1));
+  RegistryId second = registry.Add(MakeItem(2));
+
+  // any number of keys per item
+  CHECK(registry.SetKey(0x1000, first));
+  CHECK(registry.SetKey(0x2000, first));
+  CHECK(registry.SetKey(0x3000, second));
+
+  // 0 & UINT64_MAX are reserved
+  CHECK(!registry.SetKey(0, first));
+  CHECK(!registry.SetKey(UINT64_MAX, first));
+
+  {
+    auto guard = registry.Pin();
+    CHECK_EQ(registry.Find(0x1000)->value, 1);
+    CHECK_EQ(registry.Find(0x2000)->value, 1);
+    CHECK_EQ(registry.Find(0x3000)->value, 2);
+    CHECK(registry.Find(0x4000) == nullptr);
+    CHECK(registry.Find(0) == nullptr);
+    CHECK(registry.Find(UINT64_MAX) == nullptr);
+  }
+
+  // setting it again moves it
+  CHECK(registry.SetKey(0x1000, second));
+  registry.RemoveKey(0x2000);
+  {
+    auto guard = registry.Pin();
+    CHECK_EQ(registry.Find(0x1000)->value, 2);
+    CHECK(registry.Find(0x2000) == nullptr);
+  }
+
+  // removing the item drops all of its keys
+  registry.Remove(second);
+  auto guard = registry.Pin();
+  CHECK(registry.Find(0x1000) == nullptr);
+  CHECK(registry.Find(0x3000) == nullptr);
+}
+
+TEST(CollidingKeys)
+{
+  SlotRegistry<Item> registry;
+  RegistryId ids[4];
+  for (int i = 0; i < 4; i++)
+    ids[i] = registry.Add(MakeItem(i));
+
+  auto keys = KeysHashingTo(17, 4);
+  for (int i = 0; i < 4; i++)
+    CHECK(registry.SetKey(keys[i], ids[i]));
+
+  // removing the start or middle of the probe chain can't hide the keys after it
+  registry.RemoveKey(keys[0]);
+  registry.RemoveKey(keys[2]);
+  {
+    auto guard = registry.Pin();
+    CHECK(registry.Find(keys[0]) == nullptr);
+    CHECK_EQ(registry.Find(keys[1])->value, 1);
+    CHECK(registry.Find(keys[2]) == nullptr);
+    CHECK_EQ(registry.Find(keys[3])->value, 3);
+  }
+
+  // removed entries get reused, & a key that's still further along isn't duplicated
+  CHECK(registry.SetKey(keys[0], ids[2]));
+  CHECK(registry.SetKey(keys[3], ids[0]));
+  auto guard = registry.Pin();
+  CHECK_EQ(registry.Find(keys[0])->value, 2);
+  CHECK_EQ(registry.Find(keys[3])->value, 0);
+}
+
+// Probe chains that start at the end of the index carry on from the start
+TEST(RemoveWrapsAroundIndex)
+{
+  SlotRegistry<Item> registry;
+  RegistryId ids[4];
+  for (int i = 0; i < 4; i++)
+    ids[i] = registry.Add(MakeItem(i));
+
+  // three in the last entry's chain (so they're in entries 255, 0 & 1), then one for entry 0 that has to go after them
+  auto last = KeysHashingTo(REGISTRY_INDEX_SIZE - 1, 3);
+  auto first = KeysHashingTo(0, 1);
+  for (int i = 0; i < 3; i++)
+    CHECK(registry.SetKey(last[i], ids[i]));
+  CHECK(registry.SetKey(first[0], ids[3]));
+
+  // removing the item with the key at the very end of the index leaves the wrapped ones findable
+  registry.Remove(ids[0]);
+  {
+    auto guard = registry.Pin();
+    CHECK(registry.Find(last[0]) == nullptr);
+    CHECK_EQ(registry.Find(last[1])->value, 1);
+    CHECK_EQ(registry.Find(last[2])->value, 2);
+    CHECK_EQ(registry.Find(first[0])->value, 3);
+  }
+
+  registry.Remove(ids[1]);
+  registry.RemoveKey(last[2]);
+  {
+    auto guard = registry.Pin();
+    CHECK_EQ(registry.Find(first[0])->value, 3);
+  }
+
+  // everything left can be removed & set again, the removed entries don't pile up
+  registry.Remove(ids[3]);
+  RegistryId id = registry.Add(MakeItem(9));
+  for (int round = 0; round < 4; round++)
+  {
+    for (size_t pos = 0; pos < REGISTRY_INDEX_SIZE; pos += 2)
+      CHECK(registry.SetKey(KeysHashingTo(pos, 1)[0] + round * 0x100000000ull, id));
+    for (size_t pos = 0; pos < REGISTRY_INDEX_SIZE; pos += 2)
+      registry.RemoveKey(KeysHashingTo(pos, 1)[0] + round * 0x100000000ull);
+  }
+  for (int i = 0; i < REGISTRY_INDEX_SIZE; i++)
+    CHECK(registry.SetKey(1000 + i, id));
+  CHECK(!registry.SetKey(5000, id)); // full
+}
+
+TEST(ForEachInSlotOrder)
+{
+  SlotRegistry<Item> registry;
+  RegistryId ids[3];
+  for (int i = 0; i < 3; i++)
+    ids[i] = registry.Add(MakeItem(i));
+  registry.Remove(ids[1]);
+
+  std::vector<RegistryId> seen;
+  auto guard = registry.Pin();
+  registry.ForEach([&seen](RegistryId id, Item&)
+  {
+    seen.push_back(id);
+  });
+  CHECK_EQ(seen.size(), 2);
+  CHECK_EQ(seen[0], ids[0]);
+  CHECK_EQ(seen[1], ids[2]);
+}
+
+// Remove can't hand the item back while a reader that could have found it is still pinned
+TEST(RemoveWaitsForReaders)
+{
+  SlotRegistry<Item> registry;
+  RegistryId id = registry.Add(MakeItem(1));
+  CHECK(registry.SetKey(100, id));
+
+  std::atomic<bool> removed(false);
+  auto guard = new SlotRegistry<Item>::Guard(registry.Pin());
+  Item* item = registry.Find(100);
+
+  std::thread remover([&registry, &removed, id]
+  {
+    registry.Remove(id);
+    removed = true;
+  });
+
+  // unlinked straight away, but not freed
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (registry.Count() && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::yield();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  CHECK(!removed);
+  CHECK_EQ(item->value, 1);
+
+  delete guard;
+  remover.join();
+  CHECK(removed);
+}
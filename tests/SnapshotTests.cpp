@@ -0,0 +1,179 @@
+#include "Test.hpp"
+#include "Snapshot.hpp"
+#include "XboxTranslator.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define STRESS_MS       250
+#define STRESS_READERS  2
+
+// Settings the stress writer publishes for step, every field is derived from step so a torn snapshot can be spotted
+static void StressSettings(UserSettings& settings, int step)
+{
+  step %= 8000;
+  settings.deadzone.sThumbL = step;
+  settings.deadzone.sThumbR = step;
+  settings.guide_enabled = (step & 1) != 0;
+  settings.remap_enabled = (step & 1) != 0;
+  settings.turbo_rate = step % 100 + 1;
+}
+
+static bool StressSettingsValid(const UserSettings& settings)
+{
+  int step = settings.deadzone.sThumbL;
+  return settings.deadzone.sThumbR == step && settings.guide_enabled == ((step & 1) != 0) &&
+    settings.remap_enabled == settings.guide_enabled && settings.turbo_rate == step % 100 + 1;
+}
+
+// Counts live instances, so snapshots that never get freed (or get freed twice) show up
+struct Counted {
+  static std::atomic<int> live;
+  int value = 0;
+
+  Counted() { live++; }
+  Counted(const Counted& other) : value(other.value) { live++; }
+  Counted& operator=(const Counted& other) { value = other.value; return *this; }
+  ~Counted() { live--; }
+};
+std::atomic<int> Counted::live{ 0 };
+
+TEST(PublishAndUpdate)
+{
+  Snapshot<Counted> snapshot;
+  CHECK_EQ(snapshot.Read().Version(), 0);
+  CHECK_EQ(snapshot.Read()->value, 0);
+
+  Counted value;
+  value.value = 5;
+  CHECK_EQ(snapshot.Publish(value), 1);
+  CHECK_EQ(snapshot.Read()->value, 5);
+
+  // Update starts from the current value
+  CHECK_EQ(snapshot.Update([](Counted& current) { current.value *= 3; }), 2);
+  auto reader = snapshot.Read();
+  CHECK_EQ(reader->value, 15);
+  CHECK_EQ(reader.Version(), 2);
+}
+
+TEST(OldSnapshotsFreed)
+{
+  int before = Counted::live;
+  {
+    Snapshot<Counted> snapshot;
+    for (int i = 0; i < 100; i++)
+      snapshot.Update([i](Counted& current) { current.value = i; });
+
+    // only the current snapshot is left
+    CHECK_EQ(Counted::live, before + 1);
+  }
+  CHECK_EQ(Counted::live, before);
+}
+
+TEST(ReaderPinsSnapshot)
+{
+  Snapshot<Counted> snapshot;
+  snapshot.Update([](Counted& current) { current.value = 1; });
+
+  std::atomic<bool> published{ false };
+  std::thread writer;
+  {
+    auto reader = snapshot.Read();
+
+    // the writer swaps in the new snapshot straight away, but can't free the old one while it's pinned
+    writer = std::thread([&]()
+    {
+      snapshot.Update([](Counted& current) { current.value = 2; });
+      published = true;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK(!published);
+    CHECK_EQ(reader->value, 1);
+    CHECK_EQ(reader.Version(), 1);
+  }
+
+  writer.join();
+  CHECK(published);
+  CHECK_EQ(snapshot.Read()->value, 2);
+}
+
+// Readers replay reports through a translator that picks up settings like XboxController::processInput does, while another
+// thread keeps changing them as fast as it can: every snapshot seen must be whole & versions must never go backwards
+TEST(StressNeverTorn)
+{
+  Snapshot<UserSettings> settings;
+  settings.Update([](UserSettings& value) { StressSettings(value, 0); });
+
+  std::atomic<bool> stop{ false };
+  std::atomic<int> writes{ 0 };
+  std::thread writer([&]()
+  {
+    for (int step = 1; !stop; step++)
+    {
+      settings.Update([step](UserSettings& value) { StressSettings(value, step); });
+      writes++;
+    }
+  });
+
+  std::atomic<int> torn{ 0 };
+  std::atomic<int> backwards{ 0 };
+  std::atomic<int> versions_seen{ 0 };
+  std::vector<std::thread> readers;
+  for (int i = 0; i < STRESS_READERS; i++)
+  {
+    readers.emplace_back([&]()
+    {
+      XboxInputReport input;
+      memset(&input, 0, sizeof(input));
+      input.bSize = sizeof(input);
+
+      XboxTranslator translator;
+      uint64_t translator_version = 0;
+      XUSB_REPORT gamepad;
+      int seen = 0;
+
+      auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(STRESS_MS);
+      for (int report = 0; std::chrono::steady_clock::now() < end; report++)
+      {
+        {
+          auto current = settings.Read();
+          if (!StressSettingsValid(*current))
+            torn++;
+
+          if (current.Version() < translator_version)
+            backwards++;
+
+          if (current.Version() != translator_version)
+          {
+            translator.SetSettings(*current);
+            translator_version = current.Version();
+            seen++;
+          }
+        }
+
+        input.Gamepad.sThumbLX = (short)(report * 37);
+        translator.Translate(input, &gamepad);
+
+        // translator has to be using the settings it was given
+        if (translator.Settings().deadzone.sThumbL != translator.Settings().deadzone.sThumbR)
+          torn++;
+      }
+      versions_seen += seen;
+    });
+  }
+
+  for (auto& reader : readers)
+    reader.join();
+  stop = true;
+  writer.join();
+
+  CHECK_EQ(torn, 0);
+  CHECK_EQ(backwards, 0);
+
+  // make sure the writer actually got to run alongside the readers
+  CHECK(writes > 0);
+  CHECK(versions_seen > STRESS_READERS);
+}
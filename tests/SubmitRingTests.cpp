@@ -0,0 +1,178 @@
+#include "Test.hpp"
+#include "SubmitRing.hpp"
+
+#include <functional>
+#include <vector>
+
+#define RING_MAX 8
+
+// Stands in for VIGEM_SUBMIT_SLOT, in_flight is what the driver would still be holding on to
+struct FakeSlot {
+  int report;
+  bool in_flight;
+  bool fails; // the driver fails this submission when it's waited for
+};
+
+typedef SubmitRing<FakeSlot, RING_MAX> FakeRing;
+
+// Records every slot waited for, like GetOverlappedResult would block until the driver's done with it
+struct Waiter {
+  std::vector<int> waited; // reports of each slot waited for, in order
+
+  bool operator()(FakeSlot& slot)
+  {
+    CHECK(slot.in_flight);
+    slot.in_flight = false;
+    waited.push_back(slot.report);
+    return !slot.fails;
+  }
+};
+
+// What vigem_target_submit does with the ring, returns the slot used
+static FakeSlot& Submit(FakeRing& ring, Waiter& waiter, int report, bool& failed, bool fails = false)
+{
+  auto& slot = ring.Next(std::ref(waiter), failed);
+  CHECK(!slot.in_flight); // never reused while the driver still has it
+  slot.report = report;
+  slot.in_flight = true;
+  slot.fails = fails;
+  ring.Submitted(slot);
+  return slot;
+}
+
+static FakeSlot& Submit(FakeRing& ring, Waiter& waiter, int report)
+{
+  bool failed;
+  return Submit(ring, waiter, report, failed);
+}
+
+TEST(ZeroedRingIsOff)
+{
+  FakeRing ring{};
+  CHECK_EQ(ring.Depth(), 0);
+  CHECK_EQ(ring.Pending(), 0);
+  CHECK_EQ(ring.FullWaits(), 0);
+
+  Waiter waiter;
+  CHECK(ring.Drain(std::ref(waiter)));
+  CHECK(waiter.waited.empty());
+}
+
+TEST(WrapsAroundDepthSlots)
+{
+  FakeRing ring{};
+  Waiter waiter;
+  CHECK(ring.SetDepth(3, std::ref(waiter)));
+  CHECK_EQ(ring.Depth(), 3);
+
+  // only the first 3 slots get used, in order
+  for (int report = 0; report < 10; report++)
+    CHECK(&Submit(ring, waiter, report) == &ring.At(report % 3));
+  CHECK_EQ(ring.Pending(), 3);
+}
+
+TEST(FullRingWaitsForOldest)
+{
+  FakeRing ring{};
+  Waiter waiter;
+  ring.SetDepth(4, std::ref(waiter));
+
+  // room for depth submissions without waiting on anything
+  for (int report = 0; report < 4; report++)
+    Submit(ring, waiter, report);
+  CHECK(waiter.waited.empty());
+  CHECK_EQ(ring.Pending(), 4);
+  CHECK_EQ(ring.FullWaits(), 0);
+
+  // after that every submission waits for the oldest one, so there's never more than depth outstanding
+  for (int report = 4; report < 20; report++)
+  {
+    Submit(ring, waiter, report);
+    CHECK_EQ(waiter.waited.back(), report - 4);
+    CHECK_EQ(ring.Pending(), 4);
+  }
+  CHECK_EQ(waiter.waited.size(), 16);
+  CHECK_EQ(ring.FullWaits(), 16);
+}
+
+TEST(UnsubmittedSlotNotWaitedFor)
+{
+  FakeRing ring{};
+  Waiter waiter;
+  ring.SetDepth(2, std::ref(waiter));
+
+  // DeviceIoControl failed outright, nothing's in flight to wait for when the ring comes back around to it
+  bool failed;
+  ring.Next(std::ref(waiter), failed);
+  Submit(ring, waiter, 1);
+  CHECK_EQ(ring.Pending(), 1);
+
+  Submit(ring, waiter, 2);
+  CHECK(waiter.waited.empty());
+  CHECK_EQ(ring.FullWaits(), 0);
+  CHECK_EQ(ring.Pending(), 2);
+}
+
+TEST(EarlierFailureReportedLater)
+{
+  FakeRing ring{};
+  Waiter waiter;
+  ring.SetDepth(2, std::ref(waiter));
+
+  bool failed;
+  Submit(ring, waiter, 0, failed, true);
+  CHECK(!failed);
+  Submit(ring, waiter, 1, failed);
+  CHECK(!failed);
+
+  // found out about by whichever submission reuses its slot
+  Submit(ring, waiter, 2, failed);
+  CHECK(failed);
+  Submit(ring, waiter, 3, failed);
+  CHECK(!failed);
+}
+
+TEST(SetDepthDrains)
+{
+  FakeRing ring{};
+  Waiter waiter;
+  ring.SetDepth(RING_MAX, std::ref(waiter));
+  for (int report = 0; report < 5; report++)
+    Submit(ring, waiter, report);
+
+  // too deep is refused & changes nothing
+  CHECK(!ring.SetDepth(RING_MAX + 1, std::ref(waiter)));
+  CHECK_EQ(ring.Depth(), RING_MAX);
+  CHECK_EQ(ring.Pending(), 5);
+  CHECK(waiter.waited.empty());
+
+  // everything in flight is waited for, & the ring starts again from the first slot
+  CHECK(ring.SetDepth(2, std::ref(waiter)));
+  CHECK_EQ(waiter.waited.size(), 5);
+  CHECK_EQ(ring.Pending(), 0);
+  CHECK(&Submit(ring, waiter, 5) == &ring.At(0));
+  CHECK(&Submit(ring, waiter, 6) == &ring.At(1));
+
+  CHECK(ring.SetDepth(0, std::ref(waiter)));
+  CHECK_EQ(ring.Depth(), 0);
+  CHECK_EQ(ring.Pending(), 0);
+  CHECK_EQ(waiter.waited.size(), 7);
+}
+
+TEST(DrainReportsFailures)
+{
+  FakeRing ring{};
+  Waiter waiter;
+  ring.SetDepth(3, std::ref(waiter));
+
+  bool failed;
+  Submit(ring, waiter, 0, failed);
+  Submit(ring, waiter, 1, failed, true);
+  Submit(ring, waiter, 2, failed);
+  CHECK(!ring.Drain(std::ref(waiter)));
+  CHECK_EQ(waiter.waited.size(), 3);
+
+  // nothing left to wait for
+  CHECK(ring.Drain(std::ref(waiter)));
+  CHECK_EQ(waiter.waited.size(), 3);
+}
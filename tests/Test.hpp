@@ -0,0 +1,47 @@
+#pragma once
+// Minimal test runner for the portable code, every tests/*.cpp is its own executable registered with ctest (see CMakeLists.txt)
+// TEST(name) defines a test, CHECK/CHECK_EQ record a failure & carry on with the rest of the test,
+// the executable's exit code is the number of tests that failed
+
+#include <cstdio>
+#include <vector>
+
+struct TestCase {
+  const char* name;
+  void (*fn)();
+};
+
+std::vector<TestCase>& RegisteredTests();
+
+// Failed checks in the test that's currently running
+extern int test_failures;
+
+struct TestRegistration {
+  TestRegistration(const char* name, void (*fn)()) { RegisteredTests().push_back({ name, fn }); }
+};
+
+#define TEST(name) \
+  static void name(); \
+  static TestRegistration name##_registration(#name, name); \
+  static void name()
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) \
+    { \
+      test_failures++; \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+    } \
+  } while (0)
+
+// Only for integer values, they're printed if they don't match
+#define CHECK_EQ(actual, expected) \
+  do { \
+    long long actual_value = (long long)(actual); \
+    long long expected_value = (long long)(expected); \
+    if (actual_value != expected_value) \
+    { \
+      test_failures++; \
+      printf("%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #actual, #expected, actual_value, expected_value); \
+    } \
+  } while (0)
@@ -0,0 +1,25 @@
+#include "Test.hpp"
+
+int test_failures = 0;
+
+std::vector<TestCase>& RegisteredTests()
+{
+  static std::vector<TestCase> tests;
+  return tests;
+}
+
+int main()
+{
+  int failed = 0;
+  for (auto& test : RegisteredTests())
+  {
+    test_failures = 0;
+    test.fn();
+    printf("%s %s\n", test_failures ? "FAIL" : "ok  ", test.name);
+    if (test_failures)
+      failed++;
+  }
+
+  printf("%d of %d tests failed\n", failed, (int)RegisteredTests().size());
+  return failed;
+}
@@ -0,0 +1,152 @@
+#include "Test.hpp"
+#include "TimerWheel.hpp"
+
+#include <vector>
+
+// Arbitrary start time, well away from 0 like TimerWheel::Now
+#define BASE_US 5000000000ull
+
+#define MS 1000ull
+
+struct Fired {
+  std::vector<uint64_t> times; // now_us each callback was ran with
+};
+
+static void OnTimer(void* context, uint64_t now_us)
+{
+  ((Fired*)context)->times.push_back(now_us);
+}
+
+// The wheel used to move its current tick up to the first deadline scheduled while it was idle, so a nearer timer
+// scheduled after that was held back until the first one was due (while NextDeadline still said it was due earlier)
+TEST(NearerTimerScheduledLater)
+{
+  TimerWheel wheel;
+  Fired later, sooner;
+  wheel.Schedule(BASE_US + 100 * MS, OnTimer, &later);
+  wheel.Schedule(BASE_US + 10 * MS, OnTimer, &sooner);
+  CHECK_EQ(wheel.Count(), 2);
+  CHECK_EQ(wheel.NextDeadline(), BASE_US + 10 * MS);
+
+  CHECK_EQ(wheel.Advance(BASE_US + 10 * MS - 1), 0);
+  CHECK_EQ(wheel.Advance(BASE_US + 10 * MS), 1);
+  CHECK_EQ(sooner.times.size(), 1);
+  CHECK(later.times.empty());
+  CHECK_EQ(wheel.NextDeadline(), BASE_US + 100 * MS);
+
+  CHECK_EQ(wheel.Advance(BASE_US + 99 * MS), 0);
+  CHECK_EQ(wheel.Advance(BASE_US + 100 * MS), 1);
+  CHECK_EQ(later.times.size(), 1);
+  CHECK_EQ(wheel.Count(), 0);
+  CHECK_EQ(wheel.NextDeadline(), UINT64_MAX);
+}
+
+TEST(OutOfOrderWhileRunning)
+{
+  TimerWheel wheel;
+  wheel.Advance(BASE_US);
+
+  // scheduled backwards, mixed with ones in the same tick
+  Fired fired[5];
+  const uint64_t offsets[5] = { 40 * MS, 30 * MS + 500, 30 * MS + 100, 20 * MS, 1 * MS };
+  for (int i = 0; i < 5; i++)
+    wheel.Schedule(BASE_US + offsets[i], OnTimer, &fired[i]);
+
+  const int order[5] = { 4, 3, 2, 1, 0 };
+  for (int i : order)
+  {
+    CHECK_EQ(wheel.NextDeadline(), BASE_US + offsets[i]);
+    CHECK_EQ(wheel.Advance(BASE_US + offsets[i]), 1);
+    CHECK_EQ(fired[i].times.size(), 1);
+  }
+}
+
+TEST(PastDeadlineRunsOnNextAdvance)
+{
+  TimerWheel wheel;
+  wheel.Advance(BASE_US);
+
+  Fired fired;
+  wheel.Schedule(BASE_US - 50 * MS, OnTimer, &fired);
+  CHECK_EQ(wheel.NextDeadline(), BASE_US - 50 * MS);
+  CHECK_EQ(wheel.Advance(BASE_US), 1);
+  CHECK_EQ(fired.times.size(), 1);
+  CHECK_EQ(fired.times[0], BASE_US);
+}
+
+// Slots get reused every TIMER_WHEEL_SLOTS ticks, a timer for a later trip around has to wait for it
+TEST(LaterTripsAroundWheel)
+{
+  TimerWheel wheel;
+  wheel.Advance(BASE_US);
+
+  const uint64_t far_us = BASE_US + (TIMER_WHEEL_SLOTS + 5) * TIMER_WHEEL_TICK_US;
+  const uint64_t near_us = BASE_US + 5 * TIMER_WHEEL_TICK_US;
+  Fired far, near;
+  wheel.Schedule(far_us, OnTimer, &far);
+  wheel.Schedule(near_us, OnTimer, &near);
+
+  CHECK_EQ(wheel.NextDeadline(), near_us);
+  CHECK_EQ(wheel.Advance(near_us), 1);
+  CHECK_EQ(near.times.size(), 1);
+  CHECK_EQ(wheel.NextDeadline(), far_us);
+
+  CHECK_EQ(wheel.Advance(far_us - 1), 0);
+  CHECK_EQ(wheel.Advance(far_us), 1);
+  CHECK_EQ(far.times.size(), 1);
+}
+
+TEST(CancelRemovesOnlyThatContext)
+{
+  TimerWheel wheel;
+  wheel.Advance(BASE_US);
+
+  Fired cancelled, kept;
+  wheel.Schedule(BASE_US + 5 * MS, OnTimer, &cancelled);
+  wheel.Schedule(BASE_US + 8 * MS, OnTimer, &kept);
+  wheel.Schedule(BASE_US + 9 * MS, OnTimer, &cancelled);
+  wheel.Schedule(BASE_US + 400 * MS, OnTimer, &cancelled);
+  CHECK_EQ(wheel.Count(), 4);
+
+  wheel.Cancel(&cancelled);
+  CHECK_EQ(wheel.Count(), 1);
+  CHECK_EQ(wheel.NextDeadline(), BASE_US + 8 * MS);
+
+  CHECK_EQ(wheel.Advance(BASE_US + 500 * MS), 1);
+  CHECK(cancelled.times.empty());
+  CHECK_EQ(kept.times.size(), 1);
+
+  // nothing left, cancelling again does nothing
+  wheel.Cancel(&cancelled);
+  CHECK_EQ(wheel.Count(), 0);
+}
+
+// Callbacks run without the wheel locked, so one can schedule itself again (like turbo does)
+struct Repeating {
+  TimerWheel* wheel;
+  uint64_t interval_us;
+  int remaining;
+  int ran = 0;
+};
+
+static void OnRepeat(void* context, uint64_t now_us)
+{
+  auto* repeat = (Repeating*)context;
+  repeat->ran++;
+  if (--repeat->remaining > 0)
+    repeat->wheel->Schedule(now_us + repeat->interval_us, OnRepeat, repeat);
+}
+
+TEST(CallbackReschedules)
+{
+  TimerWheel wheel;
+  wheel.Advance(BASE_US);
+
+  Repeating repeat = { &wheel, 50 * MS, 4 };
+  wheel.Schedule(BASE_US + 50 * MS, OnRepeat, &repeat);
+
+  for (uint64_t now = BASE_US; now <= BASE_US + 400 * MS; now += MS)
+    wheel.Advance(now);
+  CHECK_EQ(repeat.ran, 4);
+  CHECK_EQ(wheel.Count(), 0);
+}
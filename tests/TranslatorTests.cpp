@@ -0,0 +1,642 @@
+#include "Test.hpp"
+#include "XboxTranslator.hpp"
+
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+
+static XboxInputReport MakeReport(WORD buttons = 0)
+{
+  XboxInputReport report;
+  memset(&report, 0, sizeof(report));
+  report.bSize = sizeof(XboxInputReport);
+  report.Gamepad.wButtons = buttons;
+  return report;
+}
+
+// Combination globals are shared by every translator, put them back to their defaults before each test that uses them
+static void ResetCombos()
+{
+  combo_guideButton = 0;
+  combo_bindings.clear();
+  deadzoneCombinationEnabled = true;
+}
+
+TEST(ConvertButtonsCopiesDigitalButtons)
+{
+  ResetCombos();
+  XboxTranslator translator;
+  auto report = MakeReport(OGXINPUT_GAMEPAD_DPAD_UP | OGXINPUT_GAMEPAD_START | OGXINPUT_GAMEPAD_RIGHT_THUMB);
+
+  XUSB_REPORT output;
+  translator.Translate(report, &output);
+  CHECK_EQ(output.wButtons, XUSB_GAMEPAD_DPAD_UP | XUSB_GAMEPAD_START | XUSB_GAMEPAD_RIGHT_THUMB);
+}
+
+TEST(ConvertButtonsAnalogToDigital)
+{
+  ResetCombos();
+  XboxTranslator translator;
+
+  const struct {
+    int analog;
+    int button;
+  } buttons[] = {
+    { OGXINPUT_GAMEPAD_A, XUSB_GAMEPAD_A },
+    { OGXINPUT_GAMEPAD_B, XUSB_GAMEPAD_B },
+    { OGXINPUT_GAMEPAD_X, XUSB_GAMEPAD_X },
+    { OGXINPUT_GAMEPAD_Y, XUSB_GAMEPAD_Y },
+    { OGXINPUT_GAMEPAD_WHITE, XUSB_GAMEPAD_LEFT_SHOULDER },
+    { OGXINPUT_GAMEPAD_BLACK, XUSB_GAMEPAD_RIGHT_SHOULDER },
+  };
+
+  for (auto& button : buttons)
+  {
+    // any pressure at all counts as pressed
+    auto report = MakeReport();
+    report.Gamepad.bAnalogButtons[button.analog] = 1;
+
+    XUSB_REPORT output = { 0 };
+    translator.ConvertButtons(report, output);
+    CHECK_EQ(output.wButtons, button.button);
+
+    report.Gamepad.bAnalogButtons[button.analog] = 0;
+    output.wButtons = 0;
+    translator.ConvertButtons(report, output);
+    CHECK_EQ(output.wButtons, 0);
+  }
+}
+
+TEST(TriggerDeadzonesMatchReference)
+{
+  ResetCombos();
+  XboxTranslator translator;
+  UserSettings settings;
+  settings.deadzone.bLeftTrigger = 30;
+  settings.deadzone.bRightTrigger = 100;
+  translator.SetSettings(settings);
+
+  for (int value = 0; value < 256; value++)
+  {
+    auto report = MakeReport();
+    report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] = (BYTE)value;
+    report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER] = (BYTE)value;
+
+    XUSB_REPORT output;
+    translator.Translate(report, &output);
+
+    short left, right;
+    XboxTranslator::deadZoneCalc(&left, NULL, value, 0, 30, 0xFF);
+    XboxTranslator::deadZoneCalc(&right, NULL, value, 0, 100, 0xFF);
+    CHECK_EQ(output.bLeftTrigger, (BYTE)left);
+    CHECK_EQ(output.bRightTrigger, (BYTE)right);
+  }
+
+  // inside the deadzone is released, fully pressed stays fully pressed
+  auto report = MakeReport();
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] = 29;
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER] = 255;
+  XUSB_REPORT output;
+  translator.Translate(report, &output);
+  CHECK_EQ(output.bLeftTrigger, 0);
+  CHECK_EQ(output.bRightTrigger, 255);
+}
+
+// StickDeadzones replaced deadZoneCalc for the sticks, it should never be more than 1 LSB away from it
+TEST(StickDeadzonesMatchReference)
+{
+  static const short deadzones[] = { 1, 500, 4000, 7849, 8689, 16000, 32000, SHRT_MAX };
+
+  // step isn't a power of two so the sweep doesn't only hit round numbers, extremes are added separately
+  std::vector<int> values;
+  for (int value = SHRT_MIN; value <= SHRT_MAX; value += 61)
+    values.push_back(value);
+  values.push_back(SHRT_MAX);
+  values.push_back(-1);
+  values.push_back(0);
+  values.push_back(1);
+
+  int mismatches = 0;
+  for (auto deadzone : deadzones)
+  {
+    const short stick_deadzones[2] = { deadzone, deadzone };
+    for (auto x : values)
+      for (auto y : values)
+      {
+        // right stick gets the axes swapped, so both sticks see different values
+        const short in[4] = { (short)x, (short)y, (short)y, (short)x };
+        short out[4];
+        XboxTranslator::StickDeadzones(in, out, stick_deadzones);
+
+        short expected[4];
+        XboxTranslator::deadZoneCalc(&expected[0], &expected[1], in[0], in[1], deadzone, SHRT_MAX);
+        XboxTranslator::deadZoneCalc(&expected[2], &expected[3], in[2], in[3], deadzone, SHRT_MAX);
+
+        for (int i = 0; i < 4; i++)
+          if (abs(out[i] - expected[i]) > 1)
+          {
+            if (!mismatches)
+              printf("first mismatch: deadzone %d, stick %d,%d\n", deadzone, x, y);
+            mismatches++;
+            break;
+          }
+      }
+  }
+  CHECK_EQ(mismatches, 0);
+
+  // sticks resting inside the deadzone report the origin, no deadzone passes through untouched
+  const short resting[4] = { 3000, -3000, -32768, 32767 };
+  const short deadzone[2] = { 7849, 0 };
+  short out[4];
+  XboxTranslator::StickDeadzones(resting, out, deadzone);
+  CHECK_EQ(out[0], 0);
+  CHECK_EQ(out[1], 0);
+  CHECK_EQ(out[2], -32768);
+  CHECK_EQ(out[3], 32767);
+}
+
+TEST(RemapButtonsAndTriggers)
+{
+  ResetCombos();
+  XboxTranslator translator;
+  UserSettings settings;
+  settings.button_remap[XUSB_GAMEPAD_A] = XUSB_GAMEPAD_B;
+  settings.button_remap[XUSB_GAMEPAD_B] = XUSB_GAMEPAD_A;
+  settings.button_remap[XUSB_GAMEPAD_BACK] = XUSB_GAMEPAD_LT;
+  settings.button_remap[XUSB_GAMEPAD_LT] = XUSB_GAMEPAD_X | XUSB_GAMEPAD_RT;
+  settings.remap_enabled = true;
+  translator.SetSettings(settings);
+
+  auto report = MakeReport(OGXINPUT_GAMEPAD_DPAD_LEFT);
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_A] = 0xFF;
+
+  XUSB_REPORT output;
+  translator.Translate(report, &output);
+  CHECK_EQ(output.wButtons, XUSB_GAMEPAD_B | XUSB_GAMEPAD_DPAD_LEFT);
+
+  // button mapped to a trigger presses it fully
+  report = MakeReport(OGXINPUT_GAMEPAD_BACK);
+  translator.Translate(report, &output);
+  CHECK_EQ(output.wButtons, 0);
+  CHECK_EQ(output.bLeftTrigger, 255);
+
+  // trigger mapped to a button & the other trigger, which gets the trigger's value
+  report = MakeReport();
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] = 100;
+  translator.Translate(report, &output);
+  CHECK_EQ(output.wButtons, XUSB_GAMEPAD_X);
+  CHECK_EQ(output.bLeftTrigger, 0);
+  CHECK_EQ(output.bRightTrigger, 100);
+
+  // below the digital threshold the trigger isn't remapped
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] = 7;
+  translator.Translate(report, &output);
+  CHECK_EQ(output.wButtons, 0);
+  CHECK_EQ(output.bLeftTrigger, 7);
+  CHECK_EQ(output.bRightTrigger, 0);
+
+  // remap disabled leaves everything alone
+  settings.remap_enabled = false;
+  translator.SetSettings(settings);
+  report = MakeReport(OGXINPUT_GAMEPAD_BACK);
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_A] = 0xFF;
+  translator.Translate(report, &output);
+  CHECK_EQ(output.wButtons, XUSB_GAMEPAD_A | XUSB_GAMEPAD_BACK);
+  CHECK_EQ(output.bLeftTrigger, 0);
+}
+
+TEST(GuideCombination)
+{
+  ResetCombos();
+  combo_guideButton = XUSB_GAMEPAD_START | XUSB_GAMEPAD_BACK;
+
+  XboxTranslator translator;
+  UserSettings settings;
+  settings.guide_enabled = true;
+  translator.SetSettings(settings);
+
+  // combination is replaced by guide for as long as it's held
+  auto report = MakeReport(OGXINPUT_GAMEPAD_START | OGXINPUT_GAMEPAD_BACK | OGXINPUT_GAMEPAD_DPAD_DOWN);
+  XUSB_REPORT output;
+  for (int i = 0; i < 3; i++)
+  {
+    translator.Translate(report, &output);
+    CHECK_EQ(output.wButtons, XUSB_GAMEPAD_GUIDE | XUSB_GAMEPAD_DPAD_DOWN);
+  }
+
+  // only part of it held
+  report = MakeReport(OGXINPUT_GAMEPAD_START);
+  translator.Translate(report, &output);
+  CHECK_EQ(output.wButtons, XUSB_GAMEPAD_START);
+
+  // guide disabled passes the combination through
+  settings.guide_enabled = false;
+  translator.SetSettings(settings);
+  report = MakeReport(OGXINPUT_GAMEPAD_START | OGXINPUT_GAMEPAD_BACK);
+  translator.Translate(report, &output);
+  CHECK_EQ(output.wButtons, XUSB_GAMEPAD_START | XUSB_GAMEPAD_BACK);
+
+  ResetCombos();
+}
+
+TEST(GuideCombinationWithTrigger)
+{
+  ResetCombos();
+  combo_guideButton = XUSB_GAMEPAD_LT | XUSB_GAMEPAD_BACK;
+
+  XboxTranslator translator;
+  UserSettings settings;
+  settings.guide_enabled = true;
+  translator.SetSettings(settings);
+
+  auto report = MakeReport(OGXINPUT_GAMEPAD_BACK);
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] = 200;
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER] = 50;
+
+  // trigger in the combination is released on the output, the other one isn't touched
+  XUSB_REPORT output;
+  translator.Translate(report, &output);
+  CHECK_EQ(output.wButtons, XUSB_GAMEPAD_GUIDE);
+  CHECK_EQ(output.bLeftTrigger, 0);
+  CHECK_EQ(output.bRightTrigger, 50);
+
+  // trigger under the digital threshold doesn't count as pressed
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] = 7;
+  translator.Translate(report, &output);
+  CHECK_EQ(output.wButtons, XUSB_GAMEPAD_BACK);
+  CHECK_EQ(output.bLeftTrigger, 7);
+
+  ResetCombos();
+}
+
+// Translates a report with both triggers fully pressed, the given thumb buttons & dpad
+static void PressStickCombo(XboxTranslator& translator, WORD buttons)
+{
+  auto report = MakeReport(buttons);
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] = 0xFF;
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER] = 0xFF;
+
+  XUSB_REPORT output;
+  translator.Translate(report, &output);
+}
+
+static void ReleaseAll(XboxTranslator& translator)
+{
+  XUSB_REPORT output;
+  translator.Translate(MakeReport(), &output);
+}
+
+TEST(StickDeadzoneCombination)
+{
+  ResetCombos();
+  XboxTranslator translator;
+  UserSettings settings;
+  settings.deadzone.sThumbL = 1000;
+  settings.deadzone.sThumbR = 2000;
+  translator.SetSettings(settings);
+
+  // LT + RT + LS + Up raises the left stick deadzone once per press, holding it doesn't repeat
+  PressStickCombo(translator, OGXINPUT_GAMEPAD_LEFT_THUMB | OGXINPUT_GAMEPAD_DPAD_UP);
+  PressStickCombo(translator, OGXINPUT_GAMEPAD_LEFT_THUMB | OGXINPUT_GAMEPAD_DPAD_UP);
+  CHECK_EQ(translator.Settings().deadzone.sThumbL, 1500);
+  CHECK_EQ(translator.Settings().deadzone.sThumbR, 2000);
+  CHECK(translator.DeadzoneChanged());
+  CHECK(!translator.DeadzoneChanged());
+
+  ReleaseAll(translator);
+  PressStickCombo(translator, OGXINPUT_GAMEPAD_LEFT_THUMB | OGXINPUT_GAMEPAD_DPAD_UP);
+  CHECK_EQ(translator.Settings().deadzone.sThumbL, 2000);
+
+  // RS + Down lowers the right stick, Up wins if both are held
+  ReleaseAll(translator);
+  PressStickCombo(translator, OGXINPUT_GAMEPAD_RIGHT_THUMB | OGXINPUT_GAMEPAD_DPAD_DOWN);
+  CHECK_EQ(translator.Settings().deadzone.sThumbR, 1500);
+  ReleaseAll(translator);
+  PressStickCombo(translator, OGXINPUT_GAMEPAD_RIGHT_THUMB | OGXINPUT_GAMEPAD_DPAD_UP | OGXINPUT_GAMEPAD_DPAD_DOWN);
+  CHECK_EQ(translator.Settings().deadzone.sThumbR, 2000);
+
+  // clamped at 0
+  for (int i = 0; i < 6; i++)
+  {
+    ReleaseAll(translator);
+    PressStickCombo(translator, OGXINPUT_GAMEPAD_LEFT_THUMB | OGXINPUT_GAMEPAD_DPAD_DOWN);
+  }
+  CHECK_EQ(translator.Settings().deadzone.sThumbL, 0);
+
+  // only one trigger held isn't the combination
+  ReleaseAll(translator);
+  auto report = MakeReport(OGXINPUT_GAMEPAD_LEFT_THUMB | OGXINPUT_GAMEPAD_DPAD_UP);
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] = 0xFF;
+  XUSB_REPORT output;
+  translator.Translate(report, &output);
+  CHECK_EQ(translator.Settings().deadzone.sThumbL, 0);
+
+  // disabled combinations leave the deadzones alone
+  ReleaseAll(translator);
+  translator.DeadzoneChanged();
+  deadzoneCombinationEnabled = false;
+  PressStickCombo(translator, OGXINPUT_GAMEPAD_LEFT_THUMB | OGXINPUT_GAMEPAD_DPAD_UP);
+  CHECK_EQ(translator.Settings().deadzone.sThumbL, 0);
+  CHECK(!translator.DeadzoneChanged());
+
+  ResetCombos();
+}
+
+TEST(TriggerDeadzoneCombination)
+{
+  ResetCombos();
+  XboxTranslator translator;
+  UserSettings settings;
+  settings.deadzone.bLeftTrigger = 30;
+  settings.deadzone.bRightTrigger = 30;
+  translator.SetSettings(settings);
+
+  // LS + RS + LT + Up, right trigger fully released
+  auto report = MakeReport(OGXINPUT_GAMEPAD_LEFT_THUMB | OGXINPUT_GAMEPAD_RIGHT_THUMB | OGXINPUT_GAMEPAD_DPAD_UP);
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] = 0xFF;
+  XUSB_REPORT output;
+  translator.Translate(report, &output);
+  translator.Translate(report, &output);
+  CHECK_EQ(translator.Settings().deadzone.bLeftTrigger, 45);
+  CHECK_EQ(translator.Settings().deadzone.bRightTrigger, 30);
+  CHECK(translator.DeadzoneChanged());
+
+  // new deadzone applies straight away
+  CHECK_EQ(output.bLeftTrigger, 255);
+  ReleaseAll(translator);
+  report = MakeReport();
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] = 40;
+  translator.Translate(report, &output);
+  CHECK_EQ(output.bLeftTrigger, 0);
+
+  // LS + RS + RT + Down
+  report = MakeReport(OGXINPUT_GAMEPAD_LEFT_THUMB | OGXINPUT_GAMEPAD_RIGHT_THUMB | OGXINPUT_GAMEPAD_DPAD_DOWN);
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER] = 0xFF;
+  translator.Translate(report, &output);
+  CHECK_EQ(translator.Settings().deadzone.bLeftTrigger, 45);
+  CHECK_EQ(translator.Settings().deadzone.bRightTrigger, 15);
+
+  // both triggers held is the stick combination instead, which needs only one thumb
+  ReleaseAll(translator);
+  PressStickCombo(translator, OGXINPUT_GAMEPAD_LEFT_THUMB | OGXINPUT_GAMEPAD_RIGHT_THUMB | OGXINPUT_GAMEPAD_DPAD_UP);
+  CHECK_EQ(translator.Settings().deadzone.bLeftTrigger, 45);
+  CHECK_EQ(translator.Settings().deadzone.bRightTrigger, 15);
+}
+
+// Deadzone combination logic as it was before combinations moved to ComboMatcher, kept as a reference to test against
+struct ReferenceDeadzoneCombos {
+  Deadzone deadzone;
+  bool hold = false;
+
+  void Update(const XboxInputReport& input)
+  {
+    auto& pad = input.Gamepad;
+    bool ls = (pad.wButtons & OGXINPUT_GAMEPAD_LEFT_THUMB) != 0;
+    bool rs = (pad.wButtons & OGXINPUT_GAMEPAD_RIGHT_THUMB) != 0;
+    bool lt = pad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] >= 0x8;
+    bool rt = pad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER] >= 0x8;
+    bool up = (pad.wButtons & OGXINPUT_GAMEPAD_DPAD_UP) != 0;
+    bool direction = (pad.wButtons & (OGXINPUT_GAMEPAD_DPAD_UP | OGXINPUT_GAMEPAD_DPAD_DOWN)) != 0;
+
+    if ((ls != rs) && lt && rt && direction)
+    {
+      if (!hold)
+      {
+        int adjustment = up ? 500 : -500;
+        if (ls)
+          deadzone.sThumbL = (short)std::min(std::max(deadzone.sThumbL + adjustment, 0), SHRT_MAX);
+        if (rs)
+          deadzone.sThumbR = (short)std::min(std::max(deadzone.sThumbR + adjustment, 0), SHRT_MAX);
+        hold = true;
+      }
+    }
+    else if (ls && rs && (lt != rt) && direction)
+    {
+      if (!hold)
+      {
+        int adjustment = up ? 15 : -15;
+        if (pad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER])
+          deadzone.bLeftTrigger = (BYTE)std::min(std::max(deadzone.bLeftTrigger + adjustment, 0), 0xFF);
+        if (pad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER])
+          deadzone.bRightTrigger = (BYTE)std::min(std::max(deadzone.bRightTrigger + adjustment, 0), 0xFF);
+        hold = true;
+      }
+    }
+    else
+      hold = false;
+  }
+};
+
+// LT fully pressed & RT only just touched: both trigger deadzones go up, not only LT's
+TEST(TriggerCombinationAdjustsTouchedTrigger)
+{
+  ResetCombos();
+  XboxTranslator translator;
+  UserSettings settings;
+  settings.deadzone.bLeftTrigger = 30;
+  settings.deadzone.bRightTrigger = 30;
+  translator.SetSettings(settings);
+
+  auto report = MakeReport(OGXINPUT_GAMEPAD_LEFT_THUMB | OGXINPUT_GAMEPAD_RIGHT_THUMB | OGXINPUT_GAMEPAD_DPAD_UP);
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] = 255;
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER] = 4;
+  XUSB_REPORT output;
+  translator.Translate(report, &output);
+  CHECK_EQ(translator.Settings().deadzone.bLeftTrigger, 45);
+  CHECK_EQ(translator.Settings().deadzone.bRightTrigger, 45);
+
+  // RT getting touched while the combination is already held doesn't count as another press
+  ReleaseAll(translator);
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER] = 0;
+  translator.Translate(report, &output);
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER] = 4;
+  translator.Translate(report, &output);
+  CHECK_EQ(translator.Settings().deadzone.bLeftTrigger, 60);
+  CHECK_EQ(translator.Settings().deadzone.bRightTrigger, 45);
+}
+
+// Holding both thumbs with both triggers isn't the stick combination (or the trigger one)
+TEST(StickCombinationNeedsOneThumb)
+{
+  ResetCombos();
+  XboxTranslator translator;
+  UserSettings settings;
+  settings.deadzone.sThumbL = 1000;
+  settings.deadzone.sThumbR = 1000;
+  translator.SetSettings(settings);
+
+  PressStickCombo(translator, OGXINPUT_GAMEPAD_LEFT_THUMB | OGXINPUT_GAMEPAD_RIGHT_THUMB | OGXINPUT_GAMEPAD_DPAD_UP);
+  CHECK_EQ(translator.Settings().deadzone.sThumbL, 1000);
+  CHECK_EQ(translator.Settings().deadzone.sThumbR, 1000);
+  CHECK(!translator.DeadzoneChanged());
+}
+
+// Random sequences of reports made mostly of the buttons the combinations use, deadzones must follow the reference exactly
+TEST(DeadzoneCombinationsMatchReference)
+{
+  ResetCombos();
+  static const BYTE trigger_values[] = { 0, 1, 4, 7, 8, 9, 100, 255 };
+  static const WORD buttons[] = { OGXINPUT_GAMEPAD_LEFT_THUMB, OGXINPUT_GAMEPAD_RIGHT_THUMB, OGXINPUT_GAMEPAD_DPAD_UP,
+    OGXINPUT_GAMEPAD_DPAD_DOWN, OGXINPUT_GAMEPAD_START };
+
+  srand(5678);
+  for (int sequence = 0; sequence < 200; sequence++)
+  {
+    XboxTranslator translator;
+    UserSettings settings;
+    settings.deadzone.sThumbL = (short)(rand() % 4000);
+    settings.deadzone.sThumbR = (short)(rand() % 4000);
+    settings.deadzone.bLeftTrigger = (BYTE)(rand() % 64);
+    settings.deadzone.bRightTrigger = (BYTE)(rand() % 64);
+    translator.SetSettings(settings);
+
+    ReferenceDeadzoneCombos reference;
+    reference.deadzone = settings.deadzone;
+
+    // most reports only change one thing from the last one, like a real player pressing/releasing buttons
+    auto report = MakeReport();
+    int mismatches = 0;
+    for (int i = 0; i < 5000; i++)
+    {
+      int change = rand() % 8;
+      if (change < 5)
+        report.Gamepad.wButtons ^= buttons[change];
+      else if (change < 7)
+      {
+        int trigger = change == 5 ? OGXINPUT_GAMEPAD_LEFT_TRIGGER : OGXINPUT_GAMEPAD_RIGHT_TRIGGER;
+        report.Gamepad.bAnalogButtons[trigger] = trigger_values[rand() % 8];
+      }
+      else
+      {
+        report.Gamepad.wButtons = (WORD)(rand() & 0xFF);
+        report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER] = trigger_values[rand() % 8];
+        report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER] = trigger_values[rand() % 8];
+      }
+
+      XUSB_REPORT output;
+      translator.Translate(report, &output);
+      reference.Update(report);
+
+      if (memcmp(&translator.Settings().deadzone, &reference.deadzone, sizeof(Deadzone)))
+      {
+        if (!mismatches)
+          printf("sequence %d report %d: buttons %02x triggers %d %d\n", sequence, i, report.Gamepad.wButtons,
+            report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_LEFT_TRIGGER], report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER]);
+        mismatches++;
+
+        // carry on from the reference so one mismatch doesn't fail every report after it
+        settings.deadzone = reference.deadzone;
+        translator.SetSettings(settings);
+      }
+    }
+    CHECK_EQ(mismatches, 0);
+  }
+}
+
+// Deadzone combinations & tray toggles republish every setting, that mustn't cut off a macro or restart turbo
+TEST(SettingsChangeKeepsMacroPlaying)
+{
+  ResetCombos();
+  ComboBinding binding;
+  binding.combo = { XUSB_GAMEPAD_BACK, 0, COMBO_PRESS };
+  binding.output = 0;
+  binding.macro = { { XUSB_GAMEPAD_X, 100 }, { XUSB_GAMEPAD_Y, 100 } };
+  combo_bindings.push_back(binding);
+
+  const uint64_t start_us = 1000000;
+  XboxTranslator translator;
+  UserSettings settings;
+  translator.SetSettings(settings);
+
+  XUSB_REPORT output;
+  translator.Translate(MakeReport(OGXINPUT_GAMEPAD_BACK), &output, start_us);
+  CHECK_EQ(output.wButtons, XUSB_GAMEPAD_X);
+  translator.Translate(MakeReport(), &output, start_us + 10000);
+  CHECK_EQ(output.wButtons, XUSB_GAMEPAD_X);
+
+  settings.deadzone.sThumbL = 5000;
+  translator.SetSettings(settings);
+  settings.guide_enabled = true;
+  translator.SetSettings(settings);
+
+  CHECK(translator.RefreshTimedOutput(start_us + 150000, &output));
+  CHECK_EQ(output.wButtons, XUSB_GAMEPAD_Y);
+
+  // changing the combinations themselves does start over
+  translator.Translate(MakeReport(OGXINPUT_GAMEPAD_BACK), &output, start_us + 200000);
+  binding.combo.buttons = XUSB_GAMEPAD_START;
+  combo_bindings.push_back(binding);
+  translator.SetSettings(settings);
+  CHECK(!translator.RefreshTimedOutput(start_us + 210000, &output));
+
+  ResetCombos();
+}
+
+TEST(SettingsChangeKeepsTurbo)
+{
+  ResetCombos();
+  XboxTranslator translator;
+  UserSettings settings;
+  settings.turbo_buttons = XUSB_GAMEPAD_START;
+  settings.turbo_rate = 10; // 50ms pressed, 50ms released
+  translator.SetSettings(settings);
+
+  const uint64_t start_us = 1000000;
+  auto report = MakeReport(OGXINPUT_GAMEPAD_START);
+  XUSB_REPORT output;
+  translator.Translate(report, &output, start_us);
+  CHECK_EQ(output.wButtons, XUSB_GAMEPAD_START);
+  translator.Translate(report, &output, start_us + 60000);
+  CHECK_EQ(output.wButtons, 0);
+
+  settings.deadzone.bLeftTrigger = 40;
+  translator.SetSettings(settings);
+  translator.Translate(report, &output, start_us + 70000);
+  CHECK_EQ(output.wButtons, 0);
+  CHECK_EQ(translator.NextDeadline(), start_us + 100000);
+
+  // new rate restarts turbo from the next report
+  settings.turbo_rate = 5;
+  translator.SetSettings(settings);
+  translator.Translate(report, &output, start_us + 80000);
+  CHECK_EQ(output.wButtons, XUSB_GAMEPAD_START);
+  CHECK_EQ(translator.NextDeadline(), start_us + 180000);
+}
+
+TEST(SettingsChangeRebuildsChangedTables)
+{
+  ResetCombos();
+  XboxTranslator translator;
+  UserSettings settings;
+  settings.remap_enabled = true;
+  settings.button_remap[XUSB_GAMEPAD_START] = XUSB_GAMEPAD_BACK;
+  translator.SetSettings(settings);
+
+  XUSB_REPORT output;
+  translator.Translate(MakeReport(OGXINPUT_GAMEPAD_START), &output);
+  CHECK_EQ(output.wButtons, XUSB_GAMEPAD_BACK);
+
+  settings.button_remap[XUSB_GAMEPAD_START] = XUSB_GAMEPAD_DPAD_UP;
+  translator.SetSettings(settings);
+  translator.Translate(MakeReport(OGXINPUT_GAMEPAD_START), &output);
+  CHECK_EQ(output.wButtons, XUSB_GAMEPAD_DPAD_UP);
+
+  auto report = MakeReport();
+  report.Gamepad.bAnalogButtons[OGXINPUT_GAMEPAD_RIGHT_TRIGGER] = 128;
+  translator.Translate(report, &output);
+  CHECK_EQ(output.bRightTrigger, 128);
+
+  settings.curves[CURVE_RIGHT_TRIGGER].type = RESPONSE_CURVE_EXPONENTIAL;
+  translator.SetSettings(settings);
+  translator.Translate(report, &output);
+  CHECK_EQ(output.bRightTrigger, EvaluateResponseCurve(settings.curves[CURVE_RIGHT_TRIGGER], 128, 0xFF));
+  CHECK(output.bRightTrigger < 128);
+
+  combo_guideButton = XUSB_GAMEPAD_LEFT_THUMB | XUSB_GAMEPAD_RIGHT_THUMB;
+  settings.guide_enabled = true;
+  translator.SetSettings(settings);
+  translator.Translate(MakeReport(OGXINPUT_GAMEPAD_LEFT_THUMB | OGXINPUT_GAMEPAD_RIGHT_THUMB), &output);
+  CHECK_EQ(output.wButtons, XUSB_GAMEPAD_GUIDE);
+
+  ResetCombos();
+}
@@ -0,0 +1,198 @@
+#include "Test.hpp"
+#include "WarmPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <set>
+
+// Longest the refill thread should take to create a few objects, with some leeway for a busy machine
+#define REFILL_TIMEOUT_MS 2000
+
+// Stands in for creating/freeing ViGEm targets, objects are just numbers (0 being a failed create)
+struct FakeAllocator {
+  std::mutex mutex;
+  int next = 1;
+  int fail_next = 0; // number of creates that fail before they start working
+  std::set<int> live;
+  std::vector<int> destroyed;
+
+  int Create()
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (fail_next > 0)
+    {
+      fail_next--;
+      return 0;
+    }
+    live.insert(next);
+    return next++;
+  }
+
+  void Destroy(int item)
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    live.erase(item);
+    destroyed.push_back(item);
+  }
+
+  size_t Live() { std::lock_guard<std::mutex> guard(mutex); return live.size(); }
+};
+
+static void StartPool(WarmPool<int>& pool, size_t size, FakeAllocator& allocator)
+{
+  pool.Start(size, [&allocator] { return allocator.Create(); }, [&allocator](int item) { allocator.Destroy(item); });
+}
+
+// Waits up to timeout_ms for the pool to have count ready, returns how many are ready
+static size_t WaitForReady(WarmPool<int>& pool, size_t count, int timeout_ms = REFILL_TIMEOUT_MS)
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (pool.Ready() < count && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  return pool.Ready();
+}
+
+TEST(FillsToSize)
+{
+  FakeAllocator allocator;
+  WarmPool<int> pool;
+  StartPool(pool, 3, allocator);
+
+  CHECK_EQ(WaitForReady(pool, 3), 3);
+
+  // & stops there
+  std::this_thread::sleep_for(std::chrono::milliseconds(WARM_POOL_REFILL_DELAY_MS * 10));
+  CHECK_EQ(pool.Ready(), 3);
+  CHECK_EQ(pool.Stats().created, 3);
+  CHECK_EQ(allocator.Live(), 3);
+}
+
+TEST(TakeRefills)
+{
+  FakeAllocator allocator;
+  WarmPool<int> pool;
+  StartPool(pool, 2, allocator);
+  CHECK_EQ(WaitForReady(pool, 2), 2);
+
+  // oldest first
+  CHECK_EQ(pool.Take(), 1);
+  CHECK_EQ(pool.Take(), 2);
+  CHECK_EQ(pool.Stats().taken, 2);
+
+  CHECK_EQ(WaitForReady(pool, 2), 2);
+  CHECK_EQ(pool.Stats().created, 4);
+  CHECK_EQ(pool.Take(), 3);
+  CHECK_EQ(pool.Stats().missed, 0);
+}
+
+TEST(TakeFromEmptyPool)
+{
+  // not started, nothing to hand out, caller makes its own
+  WarmPool<int> idle;
+  CHECK_EQ(idle.Take(), 0);
+  CHECK_EQ(idle.Stats().missed, 1);
+
+  // started, but everything's failing to be created (eg. ViGEm bus went away)
+  FakeAllocator allocator;
+  allocator.fail_next = 1000;
+  WarmPool<int> pool;
+  StartPool(pool, 2, allocator);
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  CHECK_EQ(pool.Take(), 0);
+  CHECK_EQ(pool.Take(), 0);
+  CHECK_EQ(pool.Stats().missed, 2);
+  CHECK_EQ(pool.Stats().created, 0);
+}
+
+TEST(FailedCreateRetried)
+{
+  FakeAllocator allocator;
+  allocator.fail_next = 1;
+  WarmPool<int> pool;
+  StartPool(pool, 1, allocator);
+
+  // first attempt fails, next one's WARM_POOL_RETRY_MS later
+  CHECK_EQ(WaitForReady(pool, 1, WARM_POOL_RETRY_MS + REFILL_TIMEOUT_MS), 1);
+  CHECK_EQ(pool.Take(), 1);
+  CHECK_EQ(pool.Stats().created, 1);
+}
+
+TEST(StopDestroysPooledOnly)
+{
+  FakeAllocator allocator;
+  {
+    WarmPool<int> pool;
+    StartPool(pool, 3, allocator);
+    CHECK_EQ(WaitForReady(pool, 3), 3);
+
+    int taken = pool.Take();
+    CHECK_EQ(taken, 1);
+
+    pool.Stop();
+    CHECK_EQ(pool.Ready(), 0);
+
+    // whatever was still pooled is freed, the taken one belongs to whoever took it
+    // (the refill thread may or may not have replaced it before stopping)
+    CHECK(std::find(allocator.destroyed.begin(), allocator.destroyed.end(), taken) == allocator.destroyed.end());
+    CHECK_EQ(allocator.Live(), 1);
+    CHECK(allocator.live.count(taken));
+
+    // stopping again does nothing
+    pool.Stop();
+    CHECK_EQ(allocator.Live(), 1);
+  }
+
+  // nor does the destructor after Stop
+  CHECK_EQ(allocator.Live(), 1);
+}
+
+TEST(DestructorStops)
+{
+  FakeAllocator allocator;
+  {
+    WarmPool<int> pool;
+    StartPool(pool, 4, allocator);
+    CHECK_EQ(WaitForReady(pool, 4), 4);
+  }
+  CHECK_EQ(allocator.Live(), 0);
+  CHECK_EQ(allocator.destroyed.size(), 4);
+}
+
+TEST(ParallelTakes)
+{
+  FakeAllocator allocator;
+  WarmPool<int> pool;
+  StartPool(pool, 4, allocator);
+  CHECK_EQ(WaitForReady(pool, 4), 4);
+
+  std::mutex mutex;
+  std::vector<int> taken;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++)
+    threads.emplace_back([&]
+    {
+      for (int i = 0; i < 10; i++)
+      {
+        int item = pool.Take();
+        if (item)
+        {
+          std::lock_guard<std::mutex> guard(mutex);
+          taken.push_back(item);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+  for (auto& thread : threads)
+    thread.join();
+
+  // nothing handed out twice, & every Take was counted one way or the other
+  std::set<int> unique(taken.begin(), taken.end());
+  CHECK_EQ(unique.size(), taken.size());
+  auto stats = pool.Stats();
+  CHECK_EQ(stats.taken, taken.size());
+  CHECK_EQ(stats.taken + stats.missed, 40);
+
+  pool.Stop();
+  CHECK_EQ(allocator.Live(), taken.size());
+}
@@ -0,0 +1,66 @@
+// Portable benchmark runner: times the same stages as Xb2XInput.exe -benchmark (translation over a capture file, then
+// the simulated attach/hotplug/batching/etc. benchmarks), so they can be run & compared on any OS
+//
+// Usage: xb2x_bench <capture.xb2c> [-output <file>] [-baseline <file>]
+//   -output <file>     where to write the results (default benchmark.json)
+//   -baseline <file>   results from an earlier run to compare against
+//
+// Exit code is the number of stages that got slower than the baseline by more than BENCHMARK_REGRESSION_THRESHOLD_PCT,
+// or -1 if the capture couldn't be read or contained no input reports
+
+#include "TranslatorBenchmark.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+int main(int argc, char* argv[])
+{
+  std::string capture_path, baseline_path;
+  std::string output_path = "benchmark.json";
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!strcmp(argv[i], "-output") && value)
+      output_path = argv[++i];
+    else if (!strcmp(argv[i], "-baseline") && value)
+      baseline_path = argv[++i];
+    else if (!capture_path.length() && argv[i][0] != '-')
+      capture_path = argv[i];
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return -1;
+    }
+  }
+
+  if (!capture_path.length())
+  {
+    fprintf(stderr, "usage: %s <capture.xb2c> [-output <file>] [-baseline <file>]\n", argv[0]);
+    return -1;
+  }
+
+  CaptureReader capture;
+  if (!capture.Open(capture_path.c_str()))
+  {
+    fprintf(stderr, "failed to read capture file %s\n", capture_path.c_str());
+    return -1;
+  }
+
+  auto results = RunTranslatorBenchmark(capture);
+  if (!results.size())
+  {
+    fprintf(stderr, "capture doesn't contain any input reports\n");
+    return -1;
+  }
+
+  RunComponentBenchmarks(capture, results);
+
+  if (baseline_path.length() && !LoadBenchmarkBaseline(baseline_path.c_str(), results))
+    fprintf(stderr, "failed to read baseline results %s\n", baseline_path.c_str());
+
+  int regressions = WriteBenchmarkResults(output_path.c_str(), results, BENCHMARK_REGRESSION_THRESHOLD_PCT);
+  printf("%zu results written to %s, %d regressed\n", results.size(), output_path.c_str(), regressions);
+  return regressions;
+}
@@ -0,0 +1,100 @@
+// Headless capture replayer: feeds a capture file (see InputCapture.hpp) through XboxTranslator & reports what came out,
+// without ViGEm or any USB access, so translation changes can be checked against real captures on any OS
+//
+// Usage: xb2x_replay <capture.xb2c> [-realtime] [-print]
+//   -realtime   hand reports out at their recorded times instead of as fast as possible
+//   -print      print every translated report as it's produced
+//
+// Settings are the built-in defaults that XboxController::loadDefaultSettings starts from (guide enabled, no deadzones)
+// Prints a line per controller with its report count & a hash of every report it output, so two builds can be compared
+// Exit code is 0 if the capture was replayed, 1 if it couldn't be read or contained no input reports
+
+#include "InputCapture.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+struct ReplayTotals {
+  size_t reports = 0;
+  size_t rumbles = 0;
+  uint64_t hash = 14695981039346656037ull; // FNV-1a over each output report
+};
+
+static void HashReport(uint64_t& hash, const XUSB_REPORT& report)
+{
+  // hashed field by field, XUSB_REPORT has no padding but that shouldn't be relied on
+  const int values[] = { report.wButtons, report.bLeftTrigger, report.bRightTrigger,
+    report.sThumbLX, report.sThumbLY, report.sThumbRX, report.sThumbRY };
+
+  for (int value : values)
+  {
+    for (int byte = 0; byte < 2; byte++)
+    {
+      hash ^= (uint8_t)(value >> (byte * 8));
+      hash *= 1099511628211ull;
+    }
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  const char* path = nullptr;
+  bool realtime = false;
+  bool print = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-realtime"))
+      realtime = true;
+    else if (!strcmp(argv[i], "-print"))
+      print = true;
+    else if (!path && argv[i][0] != '-')
+      path = argv[i];
+    else
+    {
+      fprintf(stderr, "unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  if (!path)
+  {
+    fprintf(stderr, "usage: %s <capture.xb2c> [-realtime] [-print]\n", argv[0]);
+    return 1;
+  }
+
+  CaptureReader capture;
+  if (!capture.Open(path))
+  {
+    fprintf(stderr, "failed to read capture file %s\n", path);
+    return 1;
+  }
+
+  UserSettings settings;
+  settings.guide_enabled = true;
+  settings.vibration_enabled = true;
+
+  std::map<int, ReplayTotals> totals;
+  auto count = ReplayCapture(capture, settings, realtime, [&totals, print](int controller, const XUSB_REPORT& report)
+  {
+    auto& total = totals[controller];
+    total.reports++;
+    HashReport(total.hash, report);
+
+    if (print)
+      printf("%d: buttons %04x triggers %3d %3d left %6d %6d right %6d %6d\n", controller, report.wButtons,
+        report.bLeftTrigger, report.bRightTrigger, report.sThumbLX, report.sThumbLY, report.sThumbRX, report.sThumbRY);
+  }, [&totals](int controller, const CaptureRumble& rumble)
+  {
+    (void)rumble;
+    totals[controller].rumbles++;
+  });
+
+  for (auto& total : totals)
+    printf("controller %d: %zu reports, %zu rumble events, output hash %016llx\n", total.first, total.second.reports,
+      total.second.rumbles, (unsigned long long)total.second.hash);
+
+  printf("replayed %zu reports from %zu records\n", count, capture.Records().size());
+  return count ? 0 : 1;
+}